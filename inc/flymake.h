@@ -14,6 +14,7 @@
 #include "FlyStr.h"
 #include "FlyFile.h"
 #include "FlyToml.h"
+#include <sys/types.h>
 
 // allows source to be compiled with gcc or g++ compilers
 #ifdef __cplusplus
@@ -28,10 +29,19 @@
 #define FMK_SZ_VERSION        "1.0.1"
 #define FMK_SRC_DEPTH         3
 
+// benchmarks in tools/ are built with FMK_BENCH, so they can call a few static functions
+#ifdef FMK_BENCH
+#define FMK_STATIC
+#else
+#define FMK_STATIC static
+#endif
+
 typedef struct
 {
   bool_t  fAll;         // --all, build all files, clean all files, create all folders
+  bool_t  fCache;       // --cache, copy objects from the object cache rather than compile them
   bool_t  fRebuild;     // -B, build main project files even if already built
+  bool_t  fHash;        // --hash, files are changed if their contents changed, not their dates
   bool_t  fCpp;         // --cpp, used by cmd `new`, make a C++ program instead of C
   int     dbg;          // -D, enables --DEBUG=1 and -g flags
   int     debug;        // hidden option --debug
@@ -40,9 +50,11 @@ typedef struct
   bool_t  fRulesLib;    // -rl, use lib/ rules to build target folders
   bool_t  fRulesSrc;    // -rs, use src/ rules to build target folders
   bool_t  fRulesTools;  // -rt, use tools/ rules to build target files/folders
+  bool_t  fSandbox;     // --sandbox, compile each file as an action in a sandbox, see flymakeexec.c
   int     verbose;      // -v, default verbose
   bool_t  fWarning;     // -w- turns of warnings as errors (no -Werror)
   bool_t  fUserGuide;   // --user-guide, prints users guide
+  int     jobs;         // -j[=N], compile up to N files at once, bare -j is # of CPUs
 } flyMakeOpts_t;
 
 typedef enum
@@ -97,13 +109,14 @@ typedef struct
 } fmkToolList_t;
 
 // [compiler]
-// ".c" = {cc="cc {in} -c {incs}{warn}{debug}-o {out}", ll="cc {in} {libs}{debug}-o {out}"}
+// ".c" = {cc="cc {in} -c {incs}{warn}{debug}{dep}-o {out}", ll="cc {in} {libs}{debug}-o {out}"}
 typedef struct
 {
   void           *pNext;
   char           *szExts;     // e.g. ".c" or ".cc.cpp.cxx.c++"
-  char           *szCc;       // e.g. "cc {in} -c {incs}{warn}{debug}-o {out}"
+  char           *szCc;       // e.g. "cc {in} -c {incs}{warn}{debug}{dep}-o {out}"
   char           *szCcDbg;    // e.g. "-g -DDEBUG=1";
+  char           *szDep;      // e.g. "-MMD -MF ", followed by depfile, e.g. "src/out/foo.d"
   char           *szInc;      // e.g. "-I";
   char           *szWarn;     // e.g. "-Wall -Werror";
   char           *szLl;       // e.g. "cc {in} {libs}{debug}-o {out}"
@@ -136,13 +149,66 @@ typedef struct
   fmkRule_t       rule;     // FMK_RULE_LIB, FMK_RULE_SRC or FMK_RULE_TOOL
 } flyMakeFolder_t;
 
+// bump allocator for short-lived strings, see flymakearena.c. A zeroed arena is empty.
+typedef struct
+{
+  void                 *pFirst;       // blocks, oldest first
+  void                 *pCur;         // block being allocated from
+} flyMakeArena_t;
+
+// position in an arena, see FlyMakeArenaMark() and FlyMakeArenaReset()
+typedef struct
+{
+  void                 *pBlock;
+  size_t                used;
+} flyMakeArenaMark_t;
+
+// result of running a child process, see FlyMakeProcRun()
+typedef struct
+{
+  bool_t                fCapture;     // capture stdout/stderr into output, rather than print it
+  int                   exitCode;     // 0-255, or -1 if couldn't run or killed by a signal
+  int                   sig;          // signal that killed the process, or 0
+  double                seconds;      // elapsed time
+  flyStrSmart_t         output;       // stdout/stderr, if fCapture
+} flyMakeProc_t;
+
+// an input file of an action, see flymakeaction.c
+typedef struct
+{
+  char                 *szPath;       // e.g. "inc/foo.h"
+  uint64_t              digest;       // XXH64 of contents
+  size_t                size;         // size of contents
+} flyMakeActionInput_t;
+
+// a command with all of its inputs and outputs, so it can run anywhere, see flymakeaction.c
+typedef struct
+{
+  char                 *szCmdline;    // e.g. "cc src/foo.c -c -Iinc/ -o src/out/rel/foo.o"
+  flyMakeActionInput_t *aInputs;      // files read, e.g. "src/foo.c", "inc/foo.h"
+  unsigned              nInputs;
+  char                **aszDirs;      // folders that must exist, e.g. "inc/"
+  unsigned              nDirs;
+  char                **aszOutputs;   // files written, e.g. "src/out/rel/foo.o"
+  unsigned              nOutputs;
+  bool_t                fHermetic;    // FALSE if some inputs are unknown or outside the project
+} flyMakeAction_t;
+
+// a job run in a child process, see FlyMakeJobsAddFn(), returns exit code (0 if worked)
+// FMK_JOB_CHANGED-255 also mean it worked, and tell the caller something, see FlyMakeJobsExitCode()
+#define FMK_JOB_CHANGED   2
+typedef int (*pfnFlyMakeJob_t)(void *pArg);
+
+// called for each line of output, see FlyMakeProcLines(), returns FALSE to stop early
+typedef bool_t (*pfnFlyMakeProcLine_t)(const char *szLine, void *pArg);
+
 struct flyMakeState;  // so each dep can include a state
 
 // [dependencies]
 // dep1 = { path="../dep1/lib/dep1.a", inc="../dep1/inc/" }               # inc dependency
 // dep2 = { path="../dep2/" }                                             # path dependency
 // dep3 = { git="https://github.com/drewagislason/flylib", version="*" }  # git dependency
-typedef struct
+typedef struct flyMakeDep
 {
   void                 *pNext;
   char                 *szName;       // dependency name, e.g. foo
@@ -152,6 +218,10 @@ typedef struct
   char                 *szIncFolder;  // include folder, e.g. ../some_path/foo/inc/
   bool_t                fBuilt;       // TRUE if already built successfully
   struct flyMakeState  *pState;       // state for this dependency
+  struct flyMakeDep   **apNeeds;      // dependencies in this dependency's [dependencies]
+  unsigned              nNeeds;
+  char                 *szGitUrl;     // git= URL, or NULL if not a git dependency
+  uint64_t              specHash;     // hash of git=, version=, sha= and branch=, for flymake.lock
 } flyMakeDep_t;
 
 typedef struct flyMakeState
@@ -176,6 +246,9 @@ typedef struct flyMakeState
   char                *szProjVer;       // project version from flymake.toml file, e.g. "1.1.15"
   flyMakeCompiler_t   *pCompilerList;   // ptr to 1 or more compiler cmdlines for compiling, linking, etc..
   flyMakeFolder_t     *pFolderList;     // ptr to list of folders
+  void                *pScanList;       // folders already scanned, see FlyMakeScanSrcList()
+  void                *pDbList;         // build databases kept between builds, see FlyMakeDbOpen()
+  bool_t               fDbKeep;         // keep build databases loaded, for `flymake watch`
 
   // see FlyMakeDepAlloc()
   flyMakeDep_t       *pDepList;       // ptr to list of dependencies (may be NULL)
@@ -183,11 +256,22 @@ typedef struct flyMakeState
   flyStrSmart_t       incs;           // e.g. "-I. -Iinc/ -I../dep1/inc/ -Ideps/bar/inc/"
   bool_t              fLibCompiled;   // TRUE if any library source file was compiled, as we need to relink
 
+  // per-folder and per-file temporaries, see FlyMakeArenaMark()
+  flyMakeArena_t      arena;
+  flyStrSmart_t       cmdline;        // compile command-line, reused for each file
+
   // statistics
   unsigned            nCompiled;
   unsigned            nSrcFiles;
 } flyMakeState_t;
 
+// runs a request in the daemon's child process, see FlyMakeDaemonServe(), returns exit code
+#define FMK_DAEMON_FALLBACK  (-1)   // request can't be served by daemon, client runs it locally
+typedef int (*pfnFlyMakeDaemonReq_t)(flyMakeState_t *pState, int argc, const char *argv[]);
+
+// builds the project each time a source file changes, see FlyMakeWatch()
+typedef fmkErr_t (*pfnFlyMakeWatchBuild_t)(flyMakeState_t *pState, bool_t fDeps);
+
 // flymake.c
 void                FlyMakeErrExit              (void);
 fmkDebug_t          FlyMakeDebug                (void);
@@ -205,6 +289,63 @@ unsigned            FlyMakeStateDepth           (const flyMakeState_t *pState);
 // flymakeclean.c
 bool_t              FlyMakeCleanFiles           (flyMakeState_t *pState);
 
+// flymakeaction.c
+flyMakeAction_t    *FlyMakeActionNew            (const char *szCmdline);
+bool_t              FlyMakeActionAddInput       (flyMakeAction_t *pAction, const char *szPath);
+bool_t              FlyMakeActionAddDigest      (flyMakeAction_t *pAction, const char *szPath, uint64_t digest, size_t size);
+bool_t              FlyMakeActionAddIncludes    (flyMakeAction_t *pAction, const char *szSrc, const char *szIncs);
+bool_t              FlyMakeActionAddDir         (flyMakeAction_t *pAction, const char *szDir);
+bool_t              FlyMakeActionAddOutput      (flyMakeAction_t *pAction, const char *szPath);
+char               *FlyMakeActionFileAlloc      (const char *szPath, size_t *pSize);
+void                FlyMakeActionPrint          (const flyMakeAction_t *pAction);
+flyMakeAction_t    *FlyMakeActionFree           (flyMakeAction_t *pAction);
+
+// flymakearena.c
+void                FlyMakeArenaInit            (flyMakeArena_t *pArena);
+void                FlyMakeArenaUnInit          (flyMakeArena_t *pArena);
+void               *FlyMakeArenaAlloc           (flyMakeArena_t *pArena, size_t size);
+char               *FlyMakeArenaStrClone        (flyMakeArena_t *pArena, const char *sz);
+flyMakeArenaMark_t  FlyMakeArenaMark            (const flyMakeArena_t *pArena);
+void                FlyMakeArenaReset           (flyMakeArena_t *pArena, flyMakeArenaMark_t mark);
+void                FlyMakeArenaPrintStats      (void);
+
+// flymakecache.c
+bool_t              FlyMakeCacheObjGet          (flyMakeOpts_t *pOpts, const char *szSrc, const char *szCmdline,
+                                                 const char *szObj, const char *szDepFile);
+void                FlyMakeCacheObjPut          (flyMakeOpts_t *pOpts, const char *szSrc, const char *szCmdline,
+                                                 const char *szObj, const char *szDepFile);
+
+// flymakedaemon.c
+bool_t              FlyMakeDaemonServe          (flyMakeState_t *pState, const char *argv[], pfnFlyMakeDaemonReq_t pfnReq);
+bool_t              FlyMakeDaemonClient         (flyMakeOpts_t *pOpts, int argc, const char *argv[], int *pExitCode);
+
+// flymakedb.c
+void               *FlyMakeDbNew                (const char *szOutFolder, bool_t fHash);
+bool_t              FlyMakeDbIs                 (void *hDb);
+bool_t              FlyMakeDbIsCmdChanged       (void *hDb, const char *szSrc, uint64_t cmdHash);
+bool_t              FlyMakeDbIsUpToDate         (void *hDb, const char *szSrc, const sFlyFileInfo_t *pSrcInfo, const char *szObj,
+                                                 uint64_t cmdHash);
+bool_t              FlyMakeDbUpdate             (void *hDb, const char *szSrc, const char *szObj, const char *szDepFile, uint64_t cmdHash);
+void                FlyMakeDbRemove             (void *hDb, const char *szSrc);
+void                FlyMakeDbPrune              (void *hDb, const char **aszSrc, unsigned nSrc);
+bool_t              FlyMakeDbSave               (void *hDb);
+void               *FlyMakeDbFree               (void *hDb);
+void               *FlyMakeDbOpen               (flyMakeState_t *pState, const char *szOutFolder);
+void               *FlyMakeDbClose              (flyMakeState_t *pState, void *hDb);
+bool_t              FlyMakeDbIsClean            (void *hDb, const char *szSrc, uint64_t cmdHash);
+void                FlyMakeDbListChanged        (flyMakeState_t *pState, const char **aszPaths, unsigned nPaths);
+void                FlyMakeDbListFree           (flyMakeState_t *pState);
+bool_t              FlyMakeDbSigIsChanged       (const char *szSigFile, uint64_t hash);
+bool_t              FlyMakeDbSigSave            (const char *szSigFile, uint64_t hash);
+
+// flymakedepfile.c
+void               *FlyMakeDepFileNew           (const char *szDepFile);
+bool_t              FlyMakeDepFileIs            (void *hDepFile);
+unsigned            FlyMakeDepFileLen           (void *hDepFile);
+const char         *FlyMakeDepFileGetName       (void *hDepFile, unsigned i);
+bool_t              FlyMakeDepFileIsNewer       (void *hDepFile, time_t modTime);
+void               *FlyMakeDepFileFree          (void *hDepFile);
+
 // flymakedep.c
 bool_t              FlyMakeIsSameRoot           (flyMakeState_t *pState, const char *szTarget);
 bool_t              FlyMakeIsSameFolder         (const char *szFolder1, const char *szFolder2);
@@ -219,14 +360,51 @@ fmkTarget_t        *FlyMakeTargetAlloc          (flyMakeState_t *pState, const c
 fmkErr_t            FlyMakeBuildLibs            (flyMakeState_t *pState);
 fmkErr_t            FlyMakeBuild                (flyMakeState_t *pState, fmkTarget_t *pTarget, char **ppszErrExtra);
 
+// flymakeexec.c
+bool_t              FlyMakeExecInit             (flyMakeOpts_t *pOpts);
+bool_t              FlyMakeExecIsLocal          (void);
+int                 FlyMakeExecRun              (const flyMakeAction_t *pAction);
+
 // flymakefolders.c
 bool_t              FlyMakeCreateStdFolders     (flyMakeState_t *pState, const char *szFolder);
 bool_t              FlyMakeFolderCreate         (flyMakeOpts_t *pOpts, const char *szFolder);
+char               *FlyMakeCacheFolderAlloc     (flyMakeOpts_t *pOpts, const char *szSub);
 bool_t              FlyMakeFolderRemove         (fmkVerbose_t verbose, flyMakeOpts_t *pOpts, const char *szFolder);
 int                 FlyMakeSystem               (fmkVerbose_t verbose, flyMakeOpts_t *pOpts, const char *szCmdline);
 
+// flymakehash.c
+uint64_t            FlyMakeHash                 (const void *pData, size_t len, uint64_t seed);
+uint64_t            FlyMakeHashStr              (const char *sz);
+bool_t              FlyMakeHashFile             (const char *szPath, uint64_t *pHash);
+uint64_t            FlyMakeHashTool             (const char *szCmdline, uint64_t hash);
+
+// flymakejobs.c
+unsigned            FlyMakeJobsCpus             (void);
+void               *FlyMakeJobsNew              (flyMakeOpts_t *pOpts);
+bool_t              FlyMakeJobsIs               (void *hJobs);
+bool_t              FlyMakeJobsAdd              (void *hJobs, const char *szName, const char *szCmdline, unsigned tag);
+bool_t              FlyMakeJobsAddFn            (void *hJobs, const char *szName, const char *szCmdline,
+                                                 pfnFlyMakeJob_t pfnJob, void *pArg, unsigned tag);
+unsigned            FlyMakeJobsWait             (void *hJobs);
+unsigned            FlyMakeJobsWaitAny          (void *hJobs);
+unsigned            FlyMakeJobsLen              (void *hJobs);
+const char         *FlyMakeJobsGetName          (void *hJobs, unsigned i);
+const char         *FlyMakeJobsGetCmdline       (void *hJobs, unsigned i);
+unsigned            FlyMakeJobsGetTag           (void *hJobs, unsigned i);
+int                 FlyMakeJobsStatus           (void *hJobs, unsigned i);
+int                 FlyMakeJobsExitCode         (void *hJobs, unsigned i);
+void               *FlyMakeJobsFree             (void *hJobs);
+
+// flymakejobserver.c
+bool_t              FlyMakeJobServerInit        (flyMakeOpts_t *pOpts);
+void                FlyMakeJobServerExport      (bool_t fExport);
+int                 FlyMakeJobServerFd          (void);
+bool_t              FlyMakeJobServerAcquire     (void);
+void                FlyMakeJobServerRelease     (void);
+
 // flymakelist.c
-void               *FlyMakeSrcListNew           (flyMakeCompiler_t *pCompilerList, const char *szFolder, unsigned depth);
+void               *FlyMakeSrcListNew           (flyMakeCompiler_t *pCompilerList, const char *szFolder, unsigned depth,
+                                                 const char *szDepDir);
 void                FlyMakeSrcListPrint         (void *hSrcList);
 void               *FlyMakeSrcListFree          (void *hSrcList);
 bool_t              FlyMakeSrcListIs            (void *hSrcList);
@@ -238,6 +416,15 @@ fmkTool_t          *FlyMakeToolListFind         (const fmkToolList_t *pToolList,
 bool_t              FlyMakeToolListIs           (const fmkToolList_t *pToolList);
 void                FlyMakeToolListPrint        (const fmkToolList_t *pToolList);
 void                FlyMakeToolPrint            (const fmkTool_t *pTool);
+void               *FlyMakeScanSrcList          (flyMakeState_t *pState, const char *szFolder, unsigned depth);
+fmkToolList_t      *FlyMakeScanToolList         (flyMakeState_t *pState, const char *szFolder);
+void                FlyMakeScanListFree         (flyMakeState_t *pState);
+#ifdef FMK_BENCH
+fmkToolList_t      *FmkToolListAlloc            (void *hSrcList);
+#endif
+
+// flymakewatch.c
+bool_t              FlyMakeWatch                (flyMakeState_t *pState, const char *argv[], pfnFlyMakeWatchBuild_t pfnBuild);
 
 // flymakeprint.c
 int                 FlyMakePrintf               (const char *szFormat, ...);
@@ -247,6 +434,15 @@ void                FlyMakePrintErr             (fmkErr_t err, const char *szExt
 fmkErr_t            FlyMakeErrMem               (void);
 fmkErr_t            FlyMakeErrToml              (const flyMakeState_t *pState, const char *szToml, const char *szErr);
 
+// flymakeproc.c
+bool_t              FlyMakeProcNeedsShell       (const char *szCmdline);
+pid_t               FlyMakeProcSpawn            (const char *szCmdline, int fdOut, int fdClose);
+int                 FlyMakeProcWait             (pid_t pid);
+void                FlyMakeProcInit             (flyMakeProc_t *pProc, bool_t fCapture);
+int                 FlyMakeProcRun              (const char *szCmdline, flyMakeProc_t *pProc);
+int                 FlyMakeProcLines            (const char *szCmdline, pfnFlyMakeProcLine_t pfnLine, void *pArg);
+void                FlyMakeProcUnInit           (flyMakeProc_t *pProc);
+
 // flymaketoml.c
 char               *FlyMakeTomlKeyAlloc         (const char *szTomlKey);
 char               *FlyMakeTomlStrAlloc         (const char *szTomlStr);
@@ -272,12 +468,15 @@ char               *FlyMakeCompilerAllExts      (const flyMakeCompiler_t *pCompi
 flyMakeCompiler_t  *FlyMakeCompilerFind         (const flyMakeCompiler_t *pCompilerList, const char *szExt);
 flyMakeCompiler_t  *FlyMakeCompilerFindByKey    (const flyMakeCompiler_t *pCompilerList, const char *szTomlKey);
 bool_t              FlyMakeCompilerFmtCompile   (flyStrSmart_t *pStr,
+                                                 flyMakeArena_t *pArena,
                                                  const flyMakeCompiler_t *pCompiler,
                                                  const char *szIn,
                                                  const char *szIncs,
                                                  const char *szWarn,
                                                  const char *szDebug,
+                                                 const char *szDepFile,
                                                  const char *szOut);
+bool_t              FlyMakeCompilerHasDep       (const flyMakeCompiler_t *pCompiler);
 bool_t              FlyMakeCompilerFmtLink      (flyStrSmart_t *pStr,
                                                  const flyMakeCompiler_t *pCompiler,
                                                  const char *szIn,
@@ -288,6 +487,8 @@ bool_t              FlyMakeCompilerFmtLink      (flyStrSmart_t *pStr,
 // some cross module read-only data
 extern const char   g_szTomlFile[];
 extern const char   g_szFmtArchive[];
+extern const char   g_szFmtArchiveAdd[];
+extern const char   g_szFmtArchiveDel[];
 extern const char   m_szFmkBanner[];
 extern const char   g_szFlyMakeUserGuide[];
 
@@ -46,10 +46,10 @@ const char m_szFmkBanner[] =
   $ flymake run
 
   # flymake v1.0
-  mkdir src/out/
-  cc src/foo.c -c -I. -Iinc/  -Wall -Werror -o src/out/foo.o
-  cc src/foo_print.c -c -I. -Iinc/  -Wall -Werror -o src/out/foo_print.o
-  cc src/out/ *.o  -o src/foo
+  mkdir src/out/ src/out/rel/
+  cc src/foo.c -c -I. -Iinc/  -Wall -Werror -o src/out/rel/foo.o
+  cc src/foo_print.c -c -I. -Iinc/  -Wall -Werror -o src/out/rel/foo_print.o
+  cc src/out/rel/ *.o  -o src/foo
   # created program src/foo
 
   src/foo
@@ -62,10 +62,12 @@ const char m_szFmkBanner[] =
 typedef fmkErr_t (*pfnCmd_t)(flyMakeState_t *pState);
 static fmkErr_t FlyMakeCmdBuild(flyMakeState_t *pState);
 static fmkErr_t FlyMakeCmdClean(flyMakeState_t *pState);
+static fmkErr_t FlyMakeCmdDaemon(flyMakeState_t *pState);
 static fmkErr_t FlyMakeCmdNew  (flyMakeState_t *pState);
 static fmkErr_t FlyMakeCmdNop  (flyMakeState_t *pState);
 static fmkErr_t FlyMakeCmdRun  (flyMakeState_t *pState);
 static fmkErr_t FlyMakeCmdTest (flyMakeState_t *pState);
+static fmkErr_t FlyMakeCmdWatch(flyMakeState_t *pState);
 
 
 typedef struct
@@ -79,6 +81,10 @@ typedef struct
 static int        m_verbose;
 static fmkDebug_t m_debug;
 
+// command-line as given, before options are parsed, for the daemon, see FlyMakeCmdDaemon()
+static int          m_argc;
+static const char **m_argv;
+
 static const char m_szVersion[] = "flymake v" FMK_SZ_VERSION;
 static const char m_szHelp[]    =
   "Usage = flymake [options] command [args]\n"
@@ -91,34 +97,42 @@ static const char m_szHelp[]    =
   "Options:\n"
   "-B             Rebuild project (but not dependencies)\n"
   "-D[=#]         For build command: add -DDEBUG=1 flag when compiling. Use -D=2 to set -DDEBUG=2\n"
+  "-j[=#]         Compile up to # files at once. -j alone uses all CPUs. Default is 1 at a time\n"
   "-n             Dry run (don't create any files)\n"
   "-v[=#]         Verbose level: -v- (error output only), -v (default: some), or -v=2 (more)\n"
   "--             For run/test commands: all following args/opts are sent to subprogram(s)\n"
   "--all          Rebuild project plus all dependencies\n"
+  "--cache        Copy objects from a cache shared by all projects, rather than compile them\n"
   "--cpp          For new command: create a C++ project or package\n"
+  "--hash         Compile files whose contents changed, ignoring dates (for CI, NFS)\n"
   "--help         This help screen\n"
   "--lib          For new command: create library/ and test/ folders\n"
   "--rN           Force build rules for all targets to one of: --rl (lib), --rs (src), --rt (tool)\n"
+  "--sandbox      Compile each file in a sandbox with only its inputs, as a build server would\n"
   "--user-guide   Print flyamke user guide to the screen\n"
   "--version      Display flymake version\n"
   "-w-            Turn off warning as errors on compile\n"
   "\n"
   "Commands:\n"
   "\n"
-  "build  [--all] [-B] [-D] [--rN] [-w] [targets...]       Builds project or specific target(s)\n"
+  "build  [--all] [-B] [-D] [-j] [--rN] [-w] [targets...]  Builds project or specific target(s)\n"
   "clean  [--all] [-B]                                     Clean all .o and other temporary files\n"
+  "daemon [-j]                                             Keep project loaded, serve build/run/test from it\n"
   "new    [--all] [--cpp] [--lib] folder                   Create a new C or C++ project or package\n"
   "run    [--all] [-B] [-D] [targets...] [-- arg1 -opt1]   Build and run target program(s)\n"
-  "test   [--all] [-B] [-D] [targets...] [-- arg1 -opt1]   Build and run the program(s) in test/ folder\n";
+  "test   [--all] [-B] [-D] [targets...] [-- arg1 -opt1]   Build and run the program(s) in test/ folder\n"
+  "watch  [-B] [-D] [-j] [--rN] [-w] [targets...]          Build, then rebuild each time a source file changes\n";
 
 static flyMakeCmd_t aCmds[] =
 {
   { "build",  FlyMakeCmdBuild },
   { "clean",  FlyMakeCmdClean },
+  { "daemon", FlyMakeCmdDaemon },
   { "new",    FlyMakeCmdNew },
   { "nop",    FlyMakeCmdNop },
   { "run",    FlyMakeCmdRun },
   { "test",   FlyMakeCmdTest },
+  { "watch",  FlyMakeCmdWatch },
 };
 
 /*-------------------------------------------------------------------------------------------------
@@ -144,6 +158,9 @@ static pfnCmd_t FlyMakeFindCmd(const char *szCmdName)
 /*-------------------------------------------------------------------------------------------------
   Runs a single target program. Helper to FlyMakeCmdRun() and FlyMakeCmdTest()
 
+  A program that exits with an error or crashes (e.g. SIGSEGV, SIGABRT) doesn't stop the run, so
+  the remaining tests still run. Only a program that can't be started at all is an error.
+
   @param    szTarget    program to run, e.g. "src/foo"
   @param    pOpts       command-line options from state
   @param    pCmdline    working buffer to build command-line
@@ -152,8 +169,8 @@ static pfnCmd_t FlyMakeFindCmd(const char *szCmdName)
 *///-----------------------------------------------------------------------------------------------
 static fmkErr_t FmkRun(const char *szTarget, flyMakeOpts_t *pOpts, flyStrSmart_t *pCmdline, const flyStrSmart_t *pArgs)
 {
-  fmkErr_t  err = FMK_ERR_NONE;
-  int       ret;
+  flyMakeProc_t   proc;
+  fmkErr_t        err = FMK_ERR_NONE;
 
   // create the cmdline
   FlyStrSmartCpy(pCmdline, "");
@@ -167,9 +184,15 @@ static fmkErr_t FmkRun(const char *szTarget, flyMakeOpts_t *pOpts, flyStrSmart_t
     FlyMakePrintf("\n%s\n\n", pCmdline->sz);
   if(!pOpts->fNoBuild)
   {
-    ret = system(pCmdline->sz);
-    if(ret < 0)
-      err = FMK_ERR_BAD_PROG;
+    FlyMakeProcInit(&proc, FALSE);
+    if(FlyMakeProcRun(pCmdline->sz, &proc) < 0)
+    {
+      if(proc.sig)
+        FlyMakePrintf("# %s killed by signal %d (%s)\n", szTarget, proc.sig, strsignal(proc.sig));
+      else
+        err = FMK_ERR_BAD_PROG;
+    }
+    FlyMakeProcUnInit(&proc);
   }
 
   return err;
@@ -191,7 +214,7 @@ static fmkErr_t FmkRunTools(flyMakeState_t *pState, const char *szFolder, flyStr
   fmkErr_t        err = FMK_ERR_NONE;
   unsigned        i;
 
-  pToolList = FlyMakeToolListNew(pState->pCompilerList, szFolder);
+  pToolList = FlyMakeScanToolList(pState, szFolder);
   if(pToolList)
   {
     // large enough for most tool names. Very long tool names will expand the smart buffer
@@ -206,7 +229,6 @@ static fmkErr_t FmkRunTools(flyMakeState_t *pState, const char *szFolder, flyStr
       err = FmkRun(pToolPath->sz, &pState->opts, pCmdline, pArgs);
     }
   }
-  FlyMakeToolListFree(pToolList);
   return err;
 }
 
@@ -350,25 +372,14 @@ static fmkErr_t FlyMakeCmdNop(flyMakeState_t *pState)
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Build the project or a set of targets
-
-  Syntax: build [--all] [-B] [-D] [--rN] [-w] [targets...]
-
-  Build Command-line Examples:
-
-      $ flymake build
-      $ flymake build -B
-      $ flymake build lib/ src/
-      $ flymake build -rt mytools/ examples/
-      $ flymake build -rs mysource/
-      $ flymake build -rl mylib/
-      $ flymake build ../myfolder/ -D --all
-      $ flymake build tools/my_tool test/test_my_tool
+  Build the project or targets, optionally without building dependencies first. See
+  FlyMakeCmdBuild().
 
   @param    pState    cmdline options, etc...
+  @param    fDeps     TRUE to build dependencies first, FALSE if they are known up to date
   @return   FMK_ERR_NONE or 
 *///-----------------------------------------------------------------------------------------------
-static fmkErr_t FlyMakeCmdBuild(flyMakeState_t *pState)
+static fmkErr_t FmkBuild(flyMakeState_t *pState, bool_t fDeps)
 {
   fmkTarget_t    *pTarget     = NULL;
   char           *szErrExtra  = "";
@@ -382,7 +393,8 @@ static fmkErr_t FlyMakeCmdBuild(flyMakeState_t *pState)
 
   // recursively discover and build dependencies
   // results in a list of dependencies for the root project and updated pState->incs and ->libs
-  err = FlyMakeDepListBuild(pState);
+  if(fDeps)
+    err = FlyMakeDepListBuild(pState);
   nArgs = FlyCliNumArgs(pState->pCli);
 
   if(!err)
@@ -417,6 +429,30 @@ static fmkErr_t FlyMakeCmdBuild(flyMakeState_t *pState)
   return err;
 }
 
+/*-------------------------------------------------------------------------------------------------
+  Build the project or a set of targets
+
+  Syntax: build [--all] [-B] [-D] [--rN] [-w] [targets...]
+
+  Build Command-line Examples:
+
+      $ flymake build
+      $ flymake build -B
+      $ flymake build lib/ src/
+      $ flymake build -rt mytools/ examples/
+      $ flymake build -rs mysource/
+      $ flymake build -rl mylib/
+      $ flymake build ../myfolder/ -D --all
+      $ flymake build tools/my_tool test/test_my_tool
+
+  @param    pState    cmdline options, etc...
+  @return   FMK_ERR_NONE or 
+*///-----------------------------------------------------------------------------------------------
+static fmkErr_t FlyMakeCmdBuild(flyMakeState_t *pState)
+{
+  return FmkBuild(pState, TRUE);
+}
+
 /*-------------------------------------------------------------------------------------------------
   Build entire project then run the given target file(s) and folder(s).
 
@@ -628,6 +664,230 @@ fmkVerbose_t FlyMakeVerbose(void)
   return m_verbose;
 }
 
+/*-------------------------------------------------------------------------------------------------
+  Parse the command-line in pState->pCli into pState->opts, with defaults for any options not
+  given. Exits on a bad option.
+
+  @param    pState    state with pCli set, whose cliOpts point to pState->opts
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkOptsParse(flyMakeState_t *pState)
+{
+  const flyCli_t     *pCli      = pState->pCli;
+  int                 i;
+  bool_t              fJobsCpus = FALSE;
+
+  // a bare -j (no =N) means use all online CPUs
+  for(i = 1; i < *pCli->pArgc && strcmp(pCli->argv[i], "--") != 0; ++i)
+  {
+    if(strcmp(pCli->argv[i], "-j") == 0)
+      fJobsCpus = TRUE;
+  }
+
+  // defaults
+  memset(&pState->opts, 0, sizeof(pState->opts));
+  pState->opts.verbose = FMK_VERBOSE_SOME;
+  pState->opts.fWarning = TRUE;
+
+  // parse the cmdline line into state fields
+  if(FlyCliParse(pCli) != FLYCLI_ERR_NONE)
+    FlyMakeErrExit();
+  if(pState->opts.fAll)
+    pState->opts.fRebuild = TRUE;
+  if(fJobsCpus)
+    pState->opts.jobs = (int)FlyMakeJobsCpus();
+  m_debug = pState->opts.debug;
+  if(pState->opts.fNoBuild && !pState->opts.verbose)
+    pState->opts.verbose = FMK_VERBOSE_SOME;
+
+  // verbose is a global state
+  m_verbose = pState->opts.verbose;
+
+  // don't allow two or more build rules
+  if((pState->opts.fRulesLib && (pState->opts.fRulesSrc || pState->opts.fRulesTools)) || 
+     (pState->opts.fRulesSrc && pState->opts.fRulesTools))
+  {
+    FlyMakePrintf("flymake error: select only one of --rl, --rs or --rt\n");
+    FlyMakeErrExit();
+  }
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Find the command on the command-line, e.g. "flymake run". Exits if not a command.
+
+  @param    pState    state with pCli set
+  @return   ptr to the command function, pfnCmd_t
+*///-----------------------------------------------------------------------------------------------
+static pfnCmd_t FmkCmdFind(flyMakeState_t *pState)
+{
+  const char   *szCmd;
+  pfnCmd_t      pfnCmd;
+
+  // assume build command if no arguments to flymake
+  if(FlyCliNumArgs(pState->pCli) < 2)
+  {
+    pfnCmd = FlyMakeFindCmd("build");
+    FlyAssert(pfnCmd);
+  }
+
+  // determine command
+  else
+  {
+    szCmd = FlyCliArg(pState->pCli, 1);
+    pfnCmd = FlyMakeFindCmd(szCmd);
+    if(!pfnCmd)
+    {
+      FlyMakePrintf("flymake error: Command `%s` not found. See flymake --help\n", szCmd);
+      FlyMakeErrExit();
+    }
+  }
+
+  return pfnCmd;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Print the flymake banner (and shell script header if -n) before running the command
+
+  @param    pState    state with opts parsed
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkPrintBanner(flyMakeState_t *pState)
+{
+  if(pState->opts.fNoBuild)
+    FmkPrintScriptHeader(*pState->pCli->pArgc, pState->pCli->argv);
+  if(FlyMakeDebug())
+    FlyMakePrintf(m_szFmkBanner, m_szVersion);
+  else if(pState->opts.verbose)
+    FlyMakePrintf("\n# %s\n", m_szVersion);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Run a request sent to the daemon, in a child process of the daemon. The project is already
+  loaded in pState, with dependencies discovered.
+
+  Falls back to the client if the request needs the project loaded differently, e.g. another
+  project, or with -D or --rN options the daemon wasn't started with.
+
+  @param    pState    loaded root project state
+  @param    argc      # of args from client
+  @param    argv      args from client, e.g. "flymake" "build" "-j"
+  @return   exit code, or FMK_DAEMON_FALLBACK
+*///-----------------------------------------------------------------------------------------------
+static int FmkDaemonRequest(flyMakeState_t *pState, int argc, const char *argv[])
+{
+  flyMakeOpts_t   loadOpts      = pState->opts;
+  flyCli_t        cli           = *pState->pCli;
+  flyMakeDep_t   *pDep;
+  pfnCmd_t        pfnCmd;
+  char           *szRootFolder;
+  fmkErr_t        err           = FMK_ERR_NONE;
+  bool_t          fSame         = TRUE;
+
+  // parse the client's command-line into the loaded state
+  cli.pArgc = &argc;
+  cli.argv  = argv;
+  pState->pCli = &cli;
+  FmkOptsParse(pState);
+  pfnCmd = FmkCmdFind(pState);
+
+  // the daemon only serves its own project, loaded with the same options
+  if(pfnCmd == FlyMakeCmdNew || pfnCmd == FlyMakeCmdDaemon || pfnCmd == FlyMakeCmdWatch || pState->opts.fUserGuide ||
+     pState->opts.dbg != loadOpts.dbg || pState->opts.fRulesLib != loadOpts.fRulesLib ||
+     pState->opts.fRulesSrc != loadOpts.fRulesSrc || pState->opts.fRulesTools != loadOpts.fRulesTools)
+  {
+    fSame = FALSE;
+  }
+  else if(FlyCliNumArgs(&cli) >= 3)
+  {
+    szRootFolder = FlyMakeTomlRootFind(FlyCliArg(&cli, 2), pState->pCompilerList, &err);
+    if(!szRootFolder || err || !FlyMakeIsSameFolder(pState->szRoot, szRootFolder))
+      fSame = FALSE;
+    FlyFreeIf(szRootFolder);
+  }
+  if(!fSame)
+    return FMK_DAEMON_FALLBACK;
+
+  // dependencies were discovered with the daemon's options
+  for(pDep = pState->pDepList; pDep; pDep = pDep->pNext)
+  {
+    if(pDep->pState)
+      pDep->pState->opts = pState->opts;
+  }
+
+  FlyMakeJobServerInit(&pState->opts);
+  FlyMakeExecInit(&pState->opts);
+  FmkPrintBanner(pState);
+  err = (*pfnCmd)(pState);
+  if(FlyMakeDebug())
+    FlyMakeArenaPrintStats();
+
+  FlyMakePrintf("\n");
+  return err ? 1 : 0;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Keep the project loaded and serve build, run, test and clean commands from other flymake
+  invocations in this folder until Ctrl-C, see flymakedaemon.c.
+
+  @param    pState    cmdline options, etc...
+  @return   FMK_ERR_NONE if worked
+*///-----------------------------------------------------------------------------------------------
+static fmkErr_t FlyMakeCmdDaemon(flyMakeState_t *pState)
+{
+  fmkErr_t  err;
+
+  // discover dependencies once, as they are found from the loaded project in every request
+  err = FlyMakeDepDiscover(pState);
+  if(!err && !FlyMakeDaemonServe(pState, m_argv, FmkDaemonRequest))
+    err = FMK_ERR_CUSTOM;
+
+  return err;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Build for `flymake watch`. Each build starts as if libraries weren't compiled, so programs are
+  only relinked when something they need changed. Dependencies are only built when the watcher
+  saw a change that may affect them, and -B only rebuilds the first time.
+
+  The build databases stay loaded between builds (see FlyMakeDbOpen()), and the watcher has told
+  them what changed (see FlyMakeDbListChanged()), so only the affected files are even looked at.
+
+  @param    pState    cmdline options, etc...
+  @param    fDeps     TRUE to build dependencies too, e.g. first build
+  @return   FMK_ERR_NONE if worked
+*///-----------------------------------------------------------------------------------------------
+static fmkErr_t FmkWatchBuild(flyMakeState_t *pState, bool_t fDeps)
+{
+  fmkErr_t  err;
+
+  pState->fLibCompiled = FALSE;
+  err = FmkBuild(pState, fDeps);
+  pState->opts.fRebuild = FALSE;
+  if(FlyMakeDebug())
+    FlyMakeArenaPrintStats();
+
+  return err;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Build the project or target(s), then build again each time a source file changes, until Ctrl-C.
+  See flymakewatch.c.
+
+  Syntax: flymake watch [-B] [-D] [-j] [--rN] [-w] [targets...]
+
+  @param    pState    cmdline options, etc...
+  @return   FMK_ERR_NONE if worked
+*///-----------------------------------------------------------------------------------------------
+static fmkErr_t FlyMakeCmdWatch(flyMakeState_t *pState)
+{
+  fmkErr_t  err = FMK_ERR_NONE;
+
+  if(!FlyMakeWatch(pState, m_argv, FmkWatchBuild))
+    err = FMK_ERR_CUSTOM;
+
+  return err;
+}
+
 /*!------------------------------------------------------------------------------------------------
   Main entry to program
   @return   0 if worked, 1 if failed
@@ -639,16 +899,20 @@ int main(int argc, const char *argv[])
   {
     { "-B",      &state.opts.fRebuild,      FLYCLI_BOOL },
     { "-D",      &state.opts.dbg,           FLYCLI_INT  },
+    { "-j",      &state.opts.jobs,          FLYCLI_INT  },
     { "-n",      &state.opts.fNoBuild,      FLYCLI_BOOL },
     { "-v",      &state.opts.verbose,       FLYCLI_INT  },
     { "-w",      &state.opts.fWarning,      FLYCLI_INT  },
     { "--all",   &state.opts.fAll,          FLYCLI_BOOL },
+    { "--cache", &state.opts.fCache,        FLYCLI_BOOL },
     { "--cpp",   &state.opts.fCpp,          FLYCLI_BOOL },
     { "--debug", &state.opts.debug,         FLYCLI_INT  },
+    { "--hash",  &state.opts.fHash,         FLYCLI_BOOL },
     { "--lib",   &state.opts.fLib,          FLYCLI_BOOL },
     { "--rl",    &state.opts.fRulesLib,     FLYCLI_BOOL },
     { "--rs",    &state.opts.fRulesSrc,     FLYCLI_BOOL },
     { "--rt",    &state.opts.fRulesTools,   FLYCLI_BOOL },
+    { "--sandbox", &state.opts.fSandbox,    FLYCLI_BOOL },
     { "--user-guide", &state.opts.fUserGuide, FLYCLI_BOOL },
   };
   const flyCli_t cli =
@@ -661,25 +925,27 @@ int main(int argc, const char *argv[])
     .szHelp     = m_szHelp
   };
   pfnCmd_t            pfnCmd        = NULL;
-  const char         *szCmd;
   const char         *szPath;
   char               *szRootFolder;
   int                 nArgs;
+  int                 exitCode;
   bool_t              fWorked       = TRUE;
   fmkErr_t            err           = FMK_ERR_NONE;
 
-  // initialize flymake state
+  // keep the command-line as given, as parsing removes the options
+  m_argc = argc;
+  m_argv = FlyAlloc(sizeof(*m_argv) * (argc + 1));
+  if(!m_argv)
+  {
+    FlyMakeErrMem();
+    FlyMakeErrExit();
+  }
+  memcpy(m_argv, argv, sizeof(*m_argv) * (argc + 1));
+
+  // initialize flymake state and parse the cmdline line into state fields
   FlyMakeStateInit(&state);
   state.pCli = &cli;
-  state.opts.verbose = FMK_VERBOSE_SOME;
-  state.opts.fWarning = TRUE;
-
-  // parse the cmdline line into state fields
-  if(FlyCliParse(&cli) != FLYCLI_ERR_NONE)
-    FlyMakeErrExit();
-  if(state.opts.fAll)
-    state.opts.fRebuild = TRUE;
-  m_debug = state.opts.debug;
+  FmkOptsParse(&state);
 
   // print the manual to the screen
   if(state.opts.fUserGuide)
@@ -688,47 +954,25 @@ int main(int argc, const char *argv[])
     exit(0);
   }
 
-  if(state.opts.fNoBuild)
+  // a daemon running in this folder has the project loaded already, let it run the command
+  pfnCmd = FmkCmdFind(&state);
+  if(pfnCmd != FlyMakeCmdNew && pfnCmd != FlyMakeCmdDaemon && pfnCmd != FlyMakeCmdWatch &&
+     FlyMakeDaemonClient(&state.opts, m_argc, m_argv, &exitCode))
   {
-    if(!state.opts.verbose)
-      state.opts.verbose = FMK_VERBOSE_SOME;
-    FmkPrintScriptHeader(argc, argv);
+    return exitCode;
   }
 
-  // verbose is a global state
-  m_verbose = state.opts.verbose;
-  if(FlyMakeDebug())
-    FlyMakePrintf(m_szFmkBanner, m_szVersion);
-  else if(state.opts.verbose)
-    FlyMakePrintf("\n# %s\n", m_szVersion);
-
-  // don't allow two or more build rules
-  if((state.opts.fRulesLib && (state.opts.fRulesSrc || state.opts.fRulesTools)) || 
-     (state.opts.fRulesSrc && state.opts.fRulesTools))
+  // share job slots with make and any nested builds. The daemon does this for each request.
+  if(pfnCmd != FlyMakeCmdDaemon)
   {
-    FlyMakePrintf("flymake error: select only one of --rl, --rs or --rt\n");
-    FlyMakeErrExit();
-  }
+    FlyMakeJobServerInit(&state.opts);
 
-  // assume build command if no arguments to flymake
-  nArgs = FlyCliNumArgs(&cli);
-  if(nArgs < 2)
-  {
-    pfnCmd = FlyMakeFindCmd("build");
-    FlyAssert(pfnCmd);
+    // compiles run locally, or with --sandbox through the sandbox executor
+    FlyMakeExecInit(&state.opts);
   }
 
-  // determine command
-  else
-  {
-    szCmd = FlyCliArg(&cli, 1);
-    pfnCmd = FlyMakeFindCmd(szCmd);
-    if(!pfnCmd)
-    {
-      FlyMakePrintf("flymake error: Command `%s` not found. See flymake --help\n", szCmd);
-      FlyMakeErrExit();
-    }
-  }
+  FmkPrintBanner(&state);
+  nArgs = FlyCliNumArgs(&cli);
 
   // making a new project
   if(pfnCmd == FlyMakeCmdNew)
@@ -784,6 +1028,8 @@ int main(int argc, const char *argv[])
 
   // execute the command
   err = (*pfnCmd)(&state);
+  if(FlyMakeDebug())
+    FlyMakeArenaPrintStats();
 
   FlyMakePrintf("\n");
   return err ? 1 : 0;
@@ -0,0 +1,513 @@
+/**************************************************************************************************
+  flymakeaction.c - describes a command as a hermetic action: command-line, inputs and outputs
+  Copyright 2024 Drew Gislason
+  license: <https://mit-license.org>
+
+  An action lists every file a command reads, with a digest of its contents, the folders it expects
+  to exist and the files it writes. An action that only reads its inputs can be run anywhere, for
+  example in a sandbox or on a build server, and its outputs copied back. See flymakeexec.c.
+
+  Paths are relative to the current folder, e.g. "src/foo.c". An input with an absolute path, such
+  as a system header, is part of the toolchain, so is not sent with the action. An input outside the
+  current folder (e.g. "../foo/inc/foo.h") makes the action not hermetic, so it only runs locally.
+**************************************************************************************************/
+#include "flymake.h"
+
+#define ACTION_MAX_FILES  8   // allocate blocks of files
+
+/*-------------------------------------------------------------------------------------------------
+  Make room for one more entry in an array that grows in blocks of ACTION_MAX_FILES
+
+  @param    ppArray     ptr to array
+  @param    elemSize    size of each element
+  @param    len         # of elements in use
+  @return   TRUE if worked, FALSE if out of memory
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkActionGrow(void **ppArray, size_t elemSize, unsigned len)
+{
+  void     *pNew;
+  bool_t    fWorked = TRUE;
+
+  if(len % ACTION_MAX_FILES == 0)
+  {
+    pNew = FlyRealloc(*ppArray, elemSize * (len + ACTION_MAX_FILES));
+    if(!pNew)
+      fWorked = FALSE;
+    else
+      *ppArray = pNew;
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Is this path in the current folder, that is relative and without ".." parts?
+
+  @param    szPath    e.g. "inc/foo.h"
+  @return   TRUE if in the current folder
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkActionPathIsLocal(const char *szPath)
+{
+  const char   *psz;
+  bool_t        fLocal = TRUE;
+
+  if(isslash(*szPath) || *szPath == '~')
+    fLocal = FALSE;
+  for(psz = szPath; fLocal && (psz = strstr(psz, "..")) != NULL; psz += 2)
+  {
+    if((psz == szPath || isslash(psz[-1])) && (psz[2] == '\0' || isslash(psz[2])))
+      fLocal = FALSE;
+  }
+
+  return fLocal;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Create a new action for a command-line. Add its inputs, folders and outputs before running it.
+
+  Example use:
+
+      flyMakeAction_t *pAction = FlyMakeActionNew("cc src/foo.c -c -Iinc/ -o src/out/rel/foo.o");
+
+      FlyMakeActionAddInput(pAction, "src/foo.c");
+      FlyMakeActionAddInput(pAction, "inc/foo.h");
+      FlyMakeActionAddDir(pAction, "inc/");
+      FlyMakeActionAddOutput(pAction, "src/out/rel/foo.o");
+      if(FlyMakeExecRun(pAction) != 0)
+        printf("failed\n");
+      FlyMakeActionFree(pAction);
+
+  @param    szCmdline   command-line, e.g. "cc src/foo.c -c -Iinc/ -o src/out/rel/foo.o"
+  @return   ptr to action, or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+flyMakeAction_t * FlyMakeActionNew(const char *szCmdline)
+{
+  flyMakeAction_t  *pAction;
+
+  pAction = FlyAllocZ(sizeof(*pAction));
+  if(pAction)
+  {
+    pAction->fHermetic = TRUE;
+    pAction->szCmdline = FlyStrClone(szCmdline);
+    if(!pAction->szCmdline)
+    {
+      FlyFree(pAction);
+      pAction = NULL;
+    }
+  }
+
+  return pAction;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add an input file, e.g. the source or a header. Its contents are hashed now, so a file that
+  changes before the action runs is caught.
+
+  A missing input or one outside the current folder makes the action not hermetic. An absolute
+  path is part of the toolchain, so is ignored.
+
+  @param    pAction   ptr to action
+  @param    szPath    e.g. "inc/foo.h"
+  @return   TRUE if worked, FALSE if out of memory
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeActionAddInput(flyMakeAction_t *pAction, const char *szPath)
+{
+  char       *pData;
+  size_t      size;
+  bool_t      fWorked = TRUE;
+
+  // an absolute path is part of the toolchain, e.g. "/usr/include/stdio.h"
+  if(!isslash(*szPath))
+  {
+    pData = FmkActionPathIsLocal(szPath) ? FlyMakeActionFileAlloc(szPath, &size) : NULL;
+    if(!pData)
+      pAction->fHermetic = FALSE;
+    else
+      fWorked = FlyMakeActionAddDigest(pAction, szPath, FlyMakeHash(pData, size, 0), size);
+    FlyFreeIf(pData);
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add an input file by its digest, without reading it, e.g. an action received from elsewhere.
+  Adding the same file twice is harmless.
+
+  @param    pAction   ptr to action
+  @param    szPath    e.g. "inc/foo.h"
+  @param    digest    XXH64 of contents
+  @param    size      size of contents
+  @return   TRUE if worked, FALSE if out of memory
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeActionAddDigest(flyMakeAction_t *pAction, const char *szPath, uint64_t digest, size_t size)
+{
+  flyMakeActionInput_t   *pInput;
+  unsigned                i;
+  bool_t                  fWorked = TRUE;
+
+  for(i = 0; i < pAction->nInputs; ++i)
+  {
+    if(strcmp(pAction->aInputs[i].szPath, szPath) == 0)
+      break;
+  }
+
+  if(!FmkActionPathIsLocal(szPath))
+    pAction->fHermetic = FALSE;
+  else if(i >= pAction->nInputs)
+  {
+    if(!FmkActionGrow((void **)&pAction->aInputs, sizeof(*pAction->aInputs), pAction->nInputs))
+      fWorked = FALSE;
+    else
+    {
+      pInput = &pAction->aInputs[pAction->nInputs];
+      pInput->szPath = FlyStrClone(szPath);
+      pInput->digest = digest;
+      pInput->size   = size;
+      if(!pInput->szPath)
+        fWorked = FALSE;
+      else
+        ++pAction->nInputs;
+    }
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add a file or folder name to a list of names, e.g. outputs
+
+  @param    paszNames   ptr to array of names
+  @param    pLen        ptr to # of names
+  @param    szName      name to add
+  @return   TRUE if worked, FALSE if out of memory
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkActionAddName(char ***paszNames, unsigned *pLen, const char *szName)
+{
+  bool_t    fWorked = FALSE;
+
+  if(FmkActionGrow((void **)paszNames, sizeof(char *), *pLen))
+  {
+    (*paszNames)[*pLen] = FlyStrClone(szName);
+    if((*paszNames)[*pLen])
+    {
+      ++(*pLen);
+      fWorked = TRUE;
+    }
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add a folder the command expects to exist, e.g. an include folder "inc/", or "src/out/rel/"
+
+  @param    pAction   ptr to action
+  @param    szDir     e.g. "inc/"
+  @return   TRUE if worked, FALSE if out of memory
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeActionAddDir(flyMakeAction_t *pAction, const char *szDir)
+{
+  bool_t    fWorked = TRUE;
+
+  if(!FmkActionPathIsLocal(szDir))
+    pAction->fHermetic = FALSE;
+  else
+    fWorked = FmkActionAddName(&pAction->aszDirs, &pAction->nDirs, szDir);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add an output file the command writes, e.g. "src/out/rel/foo.o"
+
+  @param    pAction   ptr to action
+  @param    szPath    e.g. "src/out/rel/foo.o"
+  @return   TRUE if worked, FALSE if out of memory
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeActionAddOutput(flyMakeAction_t *pAction, const char *szPath)
+{
+  bool_t    fWorked = TRUE;
+
+  if(!FmkActionPathIsLocal(szPath))
+    pAction->fHermetic = FALSE;
+  else
+    fWorked = FmkActionAddName(&pAction->aszOutputs, &pAction->nOutputs, szPath);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Remove "./" and "x/../" parts from a path, without looking at the disk, e.g. "./inc/../foo.h"
+  becomes "foo.h". A leading "../" is kept.
+
+  @param    szPath    path to normalize in place
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkActionPathNormalize(char *szPath)
+{
+  const char   *pSrc  = szPath;
+  const char   *pSeg;
+  char         *pDst  = szPath;
+  char         *pPrev;
+  size_t        len;
+  bool_t        fSlash;
+
+  while(*pSrc)
+  {
+    pSeg   = pSrc;
+    len    = strcspn(pSeg, "/");
+    fSlash = pSeg[len] ? TRUE : FALSE;
+    pSrc   = pSeg + len + (fSlash ? 1 : 0);
+    if(len == 1 && *pSeg == '.')
+      continue;
+
+    // find the folder before this one, e.g. "inc/" in "src/inc/"
+    pPrev = pDst;
+    if(pPrev > szPath)
+    {
+      --pPrev;
+      while(pPrev > szPath && pPrev[-1] != '/')
+        --pPrev;
+    }
+    if(len == 2 && strncmp(pSeg, "..", 2) == 0 && pPrev < pDst && *pPrev != '/' && strncmp(pPrev, "../", 3) != 0)
+    {
+      pDst = pPrev;
+      continue;
+    }
+
+    memmove(pDst, pSeg, len);
+    pDst += len;
+    if(fSlash)
+      *pDst++ = '/';
+  }
+  *pDst = '\0';
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Find a header on disk, the way the compiler would. A "quoted" header is looked for beside the
+  file that includes it first, then in the include folders. An <angled> header is only looked for
+  in the include folders.
+
+  @param    pPath       return value, e.g. "inc/foo.h"
+  @param    szFile      file with the #include, e.g. "src/foo.c"
+  @param    szName      e.g. "foo.h"
+  @param    len         length of szName
+  @param    fQuoted     TRUE if #include "foo.h", FALSE if #include <foo.h>
+  @param    szIncs      include folders, e.g. ". inc/ deps/bar/inc/"
+  @return   TRUE if found, FALSE if not (e.g. a system header)
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkActionFindHeader(flyStrSmart_t *pPath, const char *szFile, const char *szName, size_t len,
+                                  bool_t fQuoted, const char *szIncs)
+{
+  const char   *psz;
+  size_t        lenDir;
+  bool_t        fFound  = FALSE;
+
+  if(fQuoted)
+  {
+    psz = strrchr(szFile, '/');
+    lenDir = psz ? (size_t)(psz - szFile) + 1 : 0;
+    FlyStrSmartSprintf(pPath, "%.*s%.*s", (int)lenDir, szFile, (int)len, szName);
+    if(pPath->sz)
+    {
+      FmkActionPathNormalize(pPath->sz);
+      fFound = FlyFileExistsFile(pPath->sz);
+    }
+  }
+
+  for(psz = szIncs; !fFound && (lenDir = FlyStrArgLen(psz)) != 0; psz = FlyStrArgNext(psz))
+  {
+    FlyStrSmartSprintf(pPath, "%.*s%s%.*s", (int)lenDir, psz, isslash(psz[lenDir - 1]) ? "" : "/",
+                       (int)len, szName);
+    if(pPath->sz)
+    {
+      FmkActionPathNormalize(pPath->sz);
+      fFound = FlyFileExistsFile(pPath->sz);
+    }
+  }
+
+  return fFound;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add the headers a file includes as inputs. A header that can't be found is a system header, so
+  is part of the toolchain. A computed include, e.g. #include MY_HEADER, can't be followed, so the
+  action is not hermetic.
+
+  Headers in #if blocks are added whether used or not, which is harmless.
+
+  @param    pAction   ptr to action
+  @param    szFile    e.g. "src/foo.c"
+  @param    szText    contents of szFile
+  @param    szIncs    include folders, e.g. ". inc/ deps/bar/inc/"
+  @return   TRUE if worked, FALSE if out of memory
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkActionScanFile(flyMakeAction_t *pAction, const char *szFile, const char *szText,
+                                const char *szIncs)
+{
+  flyStrSmart_t   path;
+  const char     *psz;
+  const char     *pszEnd;
+  bool_t          fQuoted;
+  bool_t          fWorked = TRUE;
+
+  FlyStrSmartInit(&path);
+  for(psz = szText; fWorked && psz && *psz; psz = FlyStrLineNext(psz))
+  {
+    psz = FlyStrSkipWhite(psz);
+    if(*psz != '#')
+      continue;
+    psz = FlyStrSkipWhite(psz + 1);
+    if(strncmp(psz, "include", 7) != 0)
+      continue;
+    psz = FlyStrSkipWhite(psz + 7);
+
+    if(*psz == '"' || *psz == '<')
+    {
+      fQuoted = (*psz == '"') ? TRUE : FALSE;
+      ++psz;
+      pszEnd = psz + strcspn(psz, fQuoted ? "\"\n" : ">\n");
+      if(*pszEnd != '\n' && *pszEnd != '\0' &&
+         FmkActionFindHeader(&path, szFile, psz, (size_t)(pszEnd - psz), fQuoted, szIncs))
+      {
+        fWorked = FlyMakeActionAddInput(pAction, path.sz);
+      }
+    }
+    else
+      pAction->fHermetic = FALSE;
+  }
+  FlyStrSmartUnInit(&path);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add a C or C++ source file and every header it includes, directly or through other headers, as
+  inputs. The include folders are added as folders, as the command-line refers to them.
+
+  @param    pAction   ptr to action
+  @param    szSrc     e.g. "src/foo.c"
+  @param    szIncs    include folders, e.g. ". inc/ deps/bar/inc/"
+  @return   TRUE if worked, FALSE if out of memory
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeActionAddIncludes(flyMakeAction_t *pAction, const char *szSrc, const char *szIncs)
+{
+  flyStrSmart_t   dir;
+  const char     *psz;
+  char           *pData;
+  size_t          size;
+  size_t          len;
+  unsigned        i;
+  bool_t          fWorked = TRUE;
+
+  FlyStrSmartInit(&dir);
+  for(psz = szIncs; fWorked && (len = FlyStrArgLen(psz)) != 0; psz = FlyStrArgNext(psz))
+  {
+    FlyStrSmartSprintf(&dir, "%.*s", (int)len, psz);
+    fWorked = dir.sz ? FlyMakeActionAddDir(pAction, dir.sz) : FALSE;
+  }
+  FlyStrSmartUnInit(&dir);
+
+  // each header added is scanned in turn, so this follows nested includes
+  i = pAction->nInputs;
+  if(fWorked)
+    fWorked = FlyMakeActionAddInput(pAction, szSrc);
+  for(; fWorked && i < pAction->nInputs; ++i)
+  {
+    pData = FlyMakeActionFileAlloc(pAction->aInputs[i].szPath, &size);
+    if(pData)
+    {
+      fWorked = FmkActionScanFile(pAction, pAction->aInputs[i].szPath, pData, szIncs);
+      FlyFree(pData);
+    }
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Read a whole file, which may be binary, e.g. an object file
+
+  @param    szPath    path to file
+  @param    pSize     return value, size of file in bytes
+  @return   allocated contents, '\0' terminated, or NULL if couldn't read it
+*///-----------------------------------------------------------------------------------------------
+char * FlyMakeActionFileAlloc(const char *szPath, size_t *pSize)
+{
+  FILE     *fp;
+  char     *pData = NULL;
+  long      size;
+
+  fp = fopen(szPath, "rb");
+  if(fp)
+  {
+    if(fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) >= 0 && fseek(fp, 0, SEEK_SET) == 0)
+    {
+      pData = FlyAlloc((size_t)size + 1);
+      if(pData && fread(pData, 1, (size_t)size, fp) != (size_t)size)
+      {
+        FlyFree(pData);
+        pData = NULL;
+      }
+      if(pData)
+      {
+        pData[size] = '\0';
+        *pSize = (size_t)size;
+      }
+    }
+    fclose(fp);
+  }
+
+  return pData;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Print the action, for debugging
+
+  @param    pAction   ptr to action
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeActionPrint(const flyMakeAction_t *pAction)
+{
+  unsigned    i;
+
+  FlyMakePrintf("action: %s, fHermetic %u\n", pAction->szCmdline, pAction->fHermetic);
+  for(i = 0; i < pAction->nInputs; ++i)
+  {
+    FlyMakePrintf("  in  %016llx %6zu %s\n", (unsigned long long)pAction->aInputs[i].digest,
+                  pAction->aInputs[i].size, pAction->aInputs[i].szPath);
+  }
+  for(i = 0; i < pAction->nDirs; ++i)
+    FlyMakePrintf("  dir %s\n", pAction->aszDirs[i]);
+  for(i = 0; i < pAction->nOutputs; ++i)
+    FlyMakePrintf("  out %s\n", pAction->aszOutputs[i]);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Free the action
+
+  @param    pAction   ptr to action from FlyMakeActionNew(), or NULL
+  @return   NULL
+*///-----------------------------------------------------------------------------------------------
+flyMakeAction_t * FlyMakeActionFree(flyMakeAction_t *pAction)
+{
+  unsigned    i;
+
+  if(pAction)
+  {
+    for(i = 0; i < pAction->nInputs; ++i)
+      FlyFree(pAction->aInputs[i].szPath);
+    for(i = 0; i < pAction->nDirs; ++i)
+      FlyFree(pAction->aszDirs[i]);
+    for(i = 0; i < pAction->nOutputs; ++i)
+      FlyFree(pAction->aszOutputs[i]);
+    FlyFreeIf(pAction->aInputs);
+    FlyFreeIf(pAction->aszDirs);
+    FlyFreeIf(pAction->aszOutputs);
+    FlyFreeIf(pAction->szCmdline);
+    FlyFree(pAction);
+  }
+
+  return NULL;
+}
@@ -0,0 +1,191 @@
+/**************************************************************************************************
+  flymakearena.c - bump allocator for short-lived strings during a build
+  Copyright 2024 Drew Gislason
+  license: <https://mit-license.org>
+
+  Building a folder makes a handful of small strings for each file (object name, depfile name,
+  include and dependency options...). Rather than a malloc() and free() for each, they come from
+  the state's arena (see flyMakeState_t) and are all released at once:
+
+      mark = FlyMakeArenaMark(&pState->arena);
+      szOutFile = FlyMakeArenaAlloc(&pState->arena, size);
+      ...
+      FlyMakeArenaReset(&pState->arena, mark);
+
+  Blocks are kept after a reset, so once the arena has grown to fit a folder, the next folder
+  doesn't allocate at all. Memory from the arena is never freed individually.
+**************************************************************************************************/
+#include "flymake.h"
+
+#define ARENA_BLOCK_SIZE   16384  // usable bytes in a typical block
+#define ARENA_ALIGN            8  // every allocation is aligned to this
+
+typedef struct fmkArenaBlock
+{
+  struct fmkArenaBlock *pNext;
+  size_t                size;     // usable bytes after the header
+  size_t                used;
+} fmkArenaBlock_t;
+
+// header is rounded up so data after it is aligned
+#define ARENA_HDR_SIZE  ((sizeof(fmkArenaBlock_t) + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1))
+
+// statistics for all arenas, see FlyMakeArenaPrintStats()
+static unsigned m_nAllocs;
+static unsigned m_nBlocks;
+static size_t   m_sizeBlocks;
+
+/*-------------------------------------------------------------------------------------------------
+  Initialize an empty arena. A zeroed arena is also empty.
+
+  @param    pArena    arena to initialize
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeArenaInit(flyMakeArena_t *pArena)
+{
+  memset(pArena, 0, sizeof(*pArena));
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Free all blocks in the arena. Everything allocated from it is no longer valid.
+
+  @param    pArena    arena to free
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeArenaUnInit(flyMakeArena_t *pArena)
+{
+  fmkArenaBlock_t  *pBlock;
+  fmkArenaBlock_t  *pNext;
+
+  for(pBlock = pArena->pFirst; pBlock; pBlock = pNext)
+  {
+    pNext = pBlock->pNext;
+    m_sizeBlocks -= pBlock->size;
+    FlyFree(pBlock);
+  }
+  FlyMakeArenaInit(pArena);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Allocate memory from the arena. Released by FlyMakeArenaReset() or FlyMakeArenaUnInit().
+
+  @param    pArena    arena to allocate from
+  @param    size      size in bytes
+  @return   ptr to memory (not zeroed), or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+void * FlyMakeArenaAlloc(flyMakeArena_t *pArena, size_t size)
+{
+  fmkArenaBlock_t  *pCur  = pArena->pCur;
+  fmkArenaBlock_t  *pNext;
+  void             *pMem  = NULL;
+
+  size = (size + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1);
+
+  // current block is full, move to the next, reusing blocks kept by FlyMakeArenaReset()
+  if(!pCur || pCur->used + size > pCur->size)
+  {
+    pNext = pCur ? pCur->pNext : NULL;
+    if(!pNext || size > pNext->size)
+    {
+      pNext = FlyAlloc(ARENA_HDR_SIZE + ((size > ARENA_BLOCK_SIZE) ? size : ARENA_BLOCK_SIZE));
+      if(pNext)
+      {
+        pNext->size = (size > ARENA_BLOCK_SIZE) ? size : ARENA_BLOCK_SIZE;
+        if(pCur)
+        {
+          pNext->pNext = pCur->pNext;
+          pCur->pNext  = pNext;
+        }
+        else
+        {
+          pNext->pNext   = NULL;
+          pArena->pFirst = pNext;
+        }
+        ++m_nBlocks;
+        m_sizeBlocks += pNext->size;
+      }
+    }
+    if(pNext)
+    {
+      pNext->used  = 0;
+      pArena->pCur = pCur = pNext;
+    }
+    else
+      pCur = NULL;
+  }
+
+  if(pCur)
+  {
+    pMem = (char *)pCur + ARENA_HDR_SIZE + pCur->used;
+    pCur->used += size;
+    ++m_nAllocs;
+  }
+
+  return pMem;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Allocate a copy of a string from the arena
+
+  @param    pArena    arena to allocate from
+  @param    sz        string to copy
+  @return   copy of string, or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+char * FlyMakeArenaStrClone(flyMakeArena_t *pArena, const char *sz)
+{
+  char     *szCopy;
+  size_t    size;
+
+  size = strlen(sz) + 1;
+  szCopy = FlyMakeArenaAlloc(pArena, size);
+  if(szCopy)
+    memcpy(szCopy, sz, size);
+
+  return szCopy;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Remember the current position in the arena, see FlyMakeArenaReset()
+
+  @param    pArena    arena
+  @return   mark
+*///-----------------------------------------------------------------------------------------------
+flyMakeArenaMark_t FlyMakeArenaMark(const flyMakeArena_t *pArena)
+{
+  flyMakeArenaMark_t  mark;
+
+  mark.pBlock = pArena->pCur;
+  mark.used   = pArena->pCur ? ((fmkArenaBlock_t *)pArena->pCur)->used : 0;
+
+  return mark;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Release everything allocated from the arena since the mark. Blocks are kept for reuse.
+
+  @param    pArena    arena
+  @param    mark      from FlyMakeArenaMark()
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeArenaReset(flyMakeArena_t *pArena, flyMakeArenaMark_t mark)
+{
+  fmkArenaBlock_t  *pCur;
+
+  // arena was empty when marked, start over at first block
+  pCur = mark.pBlock ? mark.pBlock : pArena->pFirst;
+  if(pCur)
+    pCur->used = mark.pBlock ? mark.used : 0;
+  pArena->pCur = pCur;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Print allocation statistics for all arenas, for --debug. The # of allocations is the # of
+  malloc()/free() pairs the build didn't need.
+
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeArenaPrintStats(void)
+{
+  FlyMakePrintf("dbg: arena: %u allocs from %u blocks, %zu bytes held\n", m_nAllocs, m_nBlocks,
+                m_sizeBlocks);
+}
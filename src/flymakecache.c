@@ -0,0 +1,393 @@
+/**************************************************************************************************
+  flymakecache.c - object cache shared by all projects, so an unchanged file is never compiled twice
+  Copyright 2024 Drew Gislason
+  license: <https://mit-license.org>
+
+  With --cache, each file compiled stores its object and depfile in ~/.cache/flymake/obj/. The entry
+  is keyed by a hash of the compile command-line, the compiler program, the source file and every
+  header in the depfile. A fresh clone, a branch switch or `flymake clean` then copies the objects
+  from the cache, rather than compiling them.
+
+  The headers a source file includes are only known after compiling it, so a manifest per source
+  file, keyed by the command-line and source contents, lists each set of headers seen before and the
+  entry it made, e.g. ~/.cache/flymake/obj/0123456789abcdef.m:
+
+      fedcba9876543210 src/foo.c inc/foo.h inc/bar.h
+      89abcdef01234567 src/foo.c inc/foo.h
+
+  Only compilers with a {dep} marker are cached, as without a depfile, a change to a header would go
+  unnoticed.
+
+  When the command-line generates debug info (a "-g" option other than "-g0"), the working folder
+  is also part of the key, as the compiler records it in the object (DW_AT_comp_dir). Otherwise a
+  debugger would be pointed at whichever checkout compiled the object first. Release objects are
+  still shared by every checkout.
+**************************************************************************************************/
+#include "flymake.h"
+#include "FlyStr.h"
+#include <unistd.h>
+
+static const char m_szManifestExt[] = ".m";
+static const char m_szObjExt[]      = ".o";
+static const char m_szDepExt[]      = ".d";
+
+static char    *m_szCacheFolder = NULL;   // e.g. "~/.cache/flymake/obj/"
+static bool_t   m_fCacheInit    = FALSE;
+
+/*-------------------------------------------------------------------------------------------------
+  Return the object cache folder, created on first use, e.g. "~/.cache/flymake/obj/"
+
+  @param    pOpts     options, for --cache
+  @return   folder, or NULL if not caching
+*///-----------------------------------------------------------------------------------------------
+static const char * FmkCacheFolder(flyMakeOpts_t *pOpts)
+{
+  if(!m_fCacheInit && pOpts->fCache && !pOpts->fNoBuild)
+  {
+    m_fCacheInit = TRUE;
+    m_szCacheFolder = FlyMakeCacheFolderAlloc(pOpts, "obj/");
+  }
+
+  return pOpts->fCache ? m_szCacheFolder : NULL;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Allocate the path to a file in the cache, e.g. "~/.cache/flymake/obj/0123456789abcdef.o"
+
+  @param    szFolder    cache folder
+  @param    key         key of entry
+  @param    szExt       e.g. ".o"
+  @return   allocated path, or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+static char * FmkCachePathAlloc(const char *szFolder, uint64_t key, const char *szExt)
+{
+  char       *szPath;
+  size_t      size;
+
+  size = strlen(szFolder) + 16 + strlen(szExt) + 1;
+  szPath = FlyAlloc(size);
+  if(szPath)
+    snprintf(szPath, size, "%s%016llx%s", szFolder, (unsigned long long)key, szExt);
+
+  return szPath;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add a file's name and contents to a hash
+
+  @param    szPath    path to file, e.g. "inc/foo.h"
+  @param    pHash     hash so far, returns the new hash
+  @return   TRUE if the file could be read
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkCacheHashFile(const char *szPath, uint64_t *pHash)
+{
+  char       *pData;
+  size_t      size;
+  bool_t      fWorked = FALSE;
+
+  // read with its size, as a file may contain '\0'
+  pData = FlyMakeActionFileAlloc(szPath, &size);
+  if(pData)
+  {
+    *pHash = FlyMakeHash(szPath, strlen(szPath) + 1, *pHash);
+    *pHash = FlyMakeHash(pData, size, *pHash);
+    FlyFree(pData);
+    fWorked = TRUE;
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Does the command-line generate debug info? That is, any "-g" option other than "-g0", e.g. "-g",
+  "-g3" or "-ggdb".
+
+  @param    szCmdline   e.g. "cc src/foo.c -c -I. -g -DDEBUG=1 -o src/out/dbg1/foo.o"
+  @return   TRUE if debug info
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkCacheIsDebug(const char *szCmdline)
+{
+  const char *psz;
+  unsigned    len;
+  bool_t      fDebug  = FALSE;
+
+  for(psz = szCmdline; !fDebug && (len = FlyStrArgLen(psz)) != 0; psz = FlyStrArgNext(psz))
+  {
+    if(len >= 2 && strncmp(psz, "-g", 2) == 0 && !(len == 3 && psz[2] == '0'))
+      fDebug = TRUE;
+  }
+
+  return fDebug;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Hash the command-line, compiler program and source file, the key of the source file's manifest.
+  With debug info, the working folder is hashed too, see the top of this file.
+
+  @param    szSrc       e.g. "src/foo.c"
+  @param    szCmdline   e.g. "cc src/foo.c -c -I. -Wall -Werror -MMD -MF src/out/rel/foo.d -o ..."
+  @param    pKey        return value, key of manifest
+  @return   TRUE if worked, FALSE if the source file couldn't be read
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkCacheSrcKey(const char *szSrc, const char *szCmdline, uint64_t *pKey)
+{
+  char    szCwd[PATH_MAX];
+  bool_t  fWorked = TRUE;
+
+  *pKey = FlyMakeHashTool(szCmdline, FlyMakeHashStr(szCmdline));
+  if(FmkCacheIsDebug(szCmdline))
+  {
+    if(getcwd(szCwd, sizeof(szCwd)))
+      *pKey = FlyMakeHash(szCwd, strlen(szCwd) + 1, *pKey);
+    else
+      fWorked = FALSE;
+  }
+  if(fWorked)
+    fWorked = FmkCacheHashFile(szSrc, pKey);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Copy a file. Copies to a temporary file first, then renames it, so another flymake never sees a
+  partial file.
+
+  @param    szFrom    file to copy
+  @param    szTo      file to create or replace
+  @return   TRUE if worked
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkCacheCopy(const char *szFrom, const char *szTo)
+{
+  FILE           *fpFrom;
+  FILE           *fpTo    = NULL;
+  flyStrSmart_t   tmp;
+  char            aBuf[8192];
+  size_t          len;
+  bool_t          fWorked = FALSE;
+
+  FlyStrSmartInit(&tmp);
+  fpFrom = fopen(szFrom, "rb");
+  if(fpFrom)
+  {
+    FlyStrSmartSprintf(&tmp, "%s.%ld", szTo, (long)getpid());
+    if(tmp.sz)
+      fpTo = fopen(tmp.sz, "wb");
+  }
+
+  if(fpTo)
+  {
+    fWorked = TRUE;
+    while((len = fread(aBuf, 1, sizeof(aBuf), fpFrom)) > 0)
+    {
+      if(fwrite(aBuf, 1, len, fpTo) != len)
+      {
+        fWorked = FALSE;
+        break;
+      }
+    }
+    if(ferror(fpFrom))
+      fWorked = FALSE;
+    if(fclose(fpTo) != 0)
+      fWorked = FALSE;
+    if(fWorked && rename(tmp.sz, szTo) != 0)
+      fWorked = FALSE;
+    if(!fWorked)
+      remove(tmp.sz);
+  }
+  if(fpFrom)
+    fclose(fpFrom);
+  FlyStrSmartUnInit(&tmp);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Look in the cache for the object a compile would make. If found, copies the object and depfile
+  into the out folder, e.g. "src/out/rel/foo.o" and "src/out/rel/foo.d".
+
+  Copies rather than links, as the compiler may write a later object in place.
+
+  @param    pOpts       options, for --cache
+  @param    szSrc       e.g. "src/foo.c"
+  @param    szCmdline   command-line that would compile szSrc
+  @param    szObj       e.g. "src/out/rel/foo.o"
+  @param    szDepFile   e.g. "src/out/rel/foo.d", or NULL if the compiler doesn't make one
+  @return   TRUE if restored from the cache, FALSE if it must be compiled
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeCacheObjGet(flyMakeOpts_t *pOpts, const char *szSrc, const char *szCmdline,
+                          const char *szObj, const char *szDepFile)
+{
+  const char     *szFolder;
+  char           *szManifest  = NULL;
+  char           *szContents  = NULL;
+  char           *szEntry     = NULL;
+  char           *szLine;
+  char           *szNext;
+  char           *szName;
+  char           *psz;
+  uint64_t        srcKey;
+  uint64_t        key;
+  uint64_t        hash;
+  bool_t          fMatch;
+  bool_t          fFound      = FALSE;
+
+  szFolder = FmkCacheFolder(pOpts);
+  if(szFolder && szDepFile && FmkCacheSrcKey(szSrc, szCmdline, &srcKey))
+  {
+    szManifest = FmkCachePathAlloc(szFolder, srcKey, m_szManifestExt);
+    if(szManifest)
+      szContents = FlyFileRead(szManifest);
+  }
+
+  // each line is a key followed by the files hashed into it
+  for(szLine = szContents; !fFound && szLine && *szLine; szLine = szNext)
+  {
+    szNext = strchr(szLine, '\n');
+    if(szNext)
+      *szNext++ = '\0';
+    else
+      szNext = szLine + strlen(szLine);
+
+    key    = strtoull(szLine, &psz, 16);
+    hash   = srcKey;
+    fMatch = (psz != szLine) ? TRUE : FALSE;
+    while(fMatch && *psz)
+    {
+      while(*psz == ' ')
+        ++psz;
+      szName = psz;
+      while(*psz && *psz != ' ')
+        ++psz;
+      if(*psz)
+        *psz++ = '\0';
+      if(*szName && !FmkCacheHashFile(szName, &hash))
+        fMatch = FALSE;
+    }
+
+    if(fMatch && hash == key)
+    {
+      szEntry = FmkCachePathAlloc(szFolder, key, m_szObjExt);
+      if(szEntry && FmkCacheCopy(szEntry, szObj))
+      {
+        FlyFree(szEntry);
+        szEntry = FmkCachePathAlloc(szFolder, key, m_szDepExt);
+        if(szEntry && FmkCacheCopy(szEntry, szDepFile))
+          fFound = TRUE;
+      }
+      FlyFreeIf(szEntry);
+      szEntry = NULL;
+    }
+  }
+
+  if(fFound)
+    FlyMakePrintfEx(FMK_VERBOSE_SOME, "# %s from cache\n", szObj);
+  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "FlyMakeCacheObjGet(%s), fFound %u\n", szSrc, fFound);
+
+  FlyFreeIf(szManifest);
+  FlyFreeIf(szContents);
+
+  return fFound;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Store a freshly compiled object and its depfile in the cache, so the same compile elsewhere can
+  use it. Failing to store is not an error, the object is just not cached.
+
+  @param    pOpts       options, for --cache
+  @param    szSrc       e.g. "src/foo.c"
+  @param    szCmdline   command-line that compiled szSrc
+  @param    szObj       e.g. "src/out/rel/foo.o"
+  @param    szDepFile   e.g. "src/out/rel/foo.d", or NULL if the compiler doesn't make one
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeCacheObjPut(flyMakeOpts_t *pOpts, const char *szSrc, const char *szCmdline,
+                        const char *szObj, const char *szDepFile)
+{
+  const char     *szFolder;
+  const char     *szName;
+  void           *hDepFile    = NULL;
+  char           *szManifest  = NULL;
+  char           *szContents  = NULL;
+  char           *szEntry;
+  FILE           *fp;
+  flyStrSmart_t   line;
+  uint64_t        srcKey;
+  uint64_t        key         = 0;
+  unsigned        i;
+  bool_t          fWorked     = FALSE;
+
+  FlyStrSmartInit(&line);
+  szFolder = FmkCacheFolder(pOpts);
+  if(szFolder && szDepFile && FmkCacheSrcKey(szSrc, szCmdline, &srcKey))
+    hDepFile = FlyMakeDepFileNew(szDepFile);
+
+  // e.g. "fedcba9876543210 src/foo.c inc/foo.h"
+  if(hDepFile)
+  {
+    fWorked = TRUE;
+    key = srcKey;
+    for(i = 0; fWorked && i < FlyMakeDepFileLen(hDepFile); ++i)
+    {
+      szName = FlyMakeDepFileGetName(hDepFile, i);
+      if(strchr(szName, ' ') || !FmkCacheHashFile(szName, &key))
+        fWorked = FALSE;
+    }
+    if(fWorked)
+    {
+      FlyStrSmartSprintf(&line, "%016llx", (unsigned long long)key);
+      for(i = 0; i < FlyMakeDepFileLen(hDepFile); ++i)
+      {
+        FlyStrSmartCat(&line, " ");
+        FlyStrSmartCat(&line, FlyMakeDepFileGetName(hDepFile, i));
+      }
+      FlyStrSmartCat(&line, "\n");
+      if(!line.sz)
+        fWorked = FALSE;
+    }
+  }
+
+  // another flymake may have stored the same entry, which is fine
+  if(fWorked)
+  {
+    szEntry = FmkCachePathAlloc(szFolder, key, m_szObjExt);
+    if(!szEntry || !FmkCacheCopy(szObj, szEntry))
+      fWorked = FALSE;
+    FlyFreeIf(szEntry);
+  }
+  if(fWorked)
+  {
+    szEntry = FmkCachePathAlloc(szFolder, key, m_szDepExt);
+    if(!szEntry || !FmkCacheCopy(szDepFile, szEntry))
+      fWorked = FALSE;
+    FlyFreeIf(szEntry);
+  }
+
+  // append to the manifest, unless already there
+  if(fWorked)
+  {
+    szManifest = FmkCachePathAlloc(szFolder, srcKey, m_szManifestExt);
+    if(szManifest)
+      szContents = FlyFileRead(szManifest);
+    if(!szManifest || (szContents && strstr(szContents, line.sz)))
+      fWorked = FALSE;
+  }
+  if(fWorked)
+  {
+    fp = fopen(szManifest, "a");
+    if(!fp)
+      fWorked = FALSE;
+    else
+    {
+      if(fputs(line.sz, fp) < 0)
+        fWorked = FALSE;
+      fclose(fp);
+    }
+  }
+
+  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "FlyMakeCacheObjPut(%s), fWorked %u\n", szSrc, fWorked);
+
+  FlyMakeDepFileFree(hDepFile);
+  FlyFreeIf(szManifest);
+  FlyFreeIf(szContents);
+  FlyStrSmartUnInit(&line);
+}
@@ -21,7 +21,7 @@ void FmkDelToolsProg(flyMakeState_t *pState, const char *szFolder)
   unsigned        i;
 
   pCmdline = FlyStrSmartAlloc(strlen(szFolder) + 42);
-  pToolList = FlyMakeToolListNew(pState->pCompilerList, szFolder);
+  pToolList = FlyMakeScanToolList(pState, szFolder);
   if(pToolList && pCmdline)
   {
     for(i = 0; i < pToolList->nTools; ++i)
@@ -33,8 +33,6 @@ void FmkDelToolsProg(flyMakeState_t *pState, const char *szFolder)
   }
   if(pCmdline)
     FlyStrSmartFree(pCmdline);
-  if(pToolList)
-    FlyMakeToolListFree(pToolList);
 }
 
 /*-------------------------------------------------------------------------------------------------
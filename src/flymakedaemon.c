@@ -0,0 +1,529 @@
+/**************************************************************************************************
+  flymakedaemon.c - keeps a project loaded in memory and serves build requests over a unix socket
+  Copyright 2024 Drew Gislason
+  license: <https://mit-license.org>
+
+  Each run of flymake finds the project root, parses flymake.toml, sets up the compiler list, finds
+  the project folders and discovers the dependencies before it compiles anything. `flymake daemon`
+  does that once, then waits for requests. A later `flymake build` (or run, test, clean) in the
+  same folder connects to the daemon, which forks a child with the project already loaded to run
+  the command. The client passes its stdin, stdout and stderr with the request, so the output goes
+  straight to the client's terminal. It also passes its environment, so the command sees the
+  client's PATH, CC and so on, not the daemon's. The client exits with the command's exit code.
+
+      flymake                                 daemon
+      -------                                 ------
+      1 byte, with fds 0, 1 and 2
+      args <argc>\n
+      <len>\n<arg> ...
+      env <count>\n
+      <len>\n<NAME=value> ...
+                                              exit <code>\n, or
+                                              fallback\n (client runs the command itself)
+
+  The daemon is found by the current folder: its socket is "~/.cache/flymake/daemon/<hash>.sock",
+  where <hash> is of the full path of the current folder.
+
+  If flymake.toml, flymake.lock or the list of folders in the project root changes, the daemon
+  restarts itself, so requests never see stale settings.
+**************************************************************************************************/
+#include "flymake.h"
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define DAEMON_SZ_LINE     32       // longest protocol line
+#define DAEMON_MAX_ARGS    256      // most args in a request
+#define DAEMON_MAX_ENV     4096     // most environment variables in a request
+#define DAEMON_MAX_LEN     131072   // longest arg or environment variable
+
+extern char **environ;
+
+static volatile sig_atomic_t  m_fStop = FALSE;
+
+/*-------------------------------------------------------------------------------------------------
+  Path to the daemon's socket for the current folder, e.g.
+  "/home/me/.cache/flymake/daemon/0123456789abcdef.sock"
+
+  @param    pOpts     options, for FlyMakeCacheFolderAlloc()
+  @param    pAddr     return value, address of socket
+  @return   TRUE if worked, FALSE if no cache folder or path is too long for a socket
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDaemonAddr(flyMakeOpts_t *pOpts, struct sockaddr_un *pAddr)
+{
+  char         szCwd[PATH_MAX];
+  char        *szFolder;
+  int          len     = -1;
+
+  memset(pAddr, 0, sizeof(*pAddr));
+  pAddr->sun_family = AF_UNIX;
+  szFolder = FlyMakeCacheFolderAlloc(pOpts, "daemon/");
+  if(szFolder && getcwd(szCwd, sizeof(szCwd)))
+  {
+    len = snprintf(pAddr->sun_path, sizeof(pAddr->sun_path), "%s%016llx.sock", szFolder,
+                   (unsigned long long)FlyMakeHashStr(szCwd));
+  }
+  FlyFreeIf(szFolder);
+
+  return (len > 0 && (size_t)len < sizeof(pAddr->sun_path)) ? TRUE : FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Signature of the files that, when changed, mean the loaded project is stale
+
+  @param    pState    root project state
+  @return   hash of paths, modified times and sizes
+*///-----------------------------------------------------------------------------------------------
+static uint64_t FmkDaemonSig(const flyMakeState_t *pState)
+{
+  const flyMakeDep_t   *pDep;
+  flyStrSmart_t         path;
+  struct stat           st;
+  uint64_t              hash  = 0;
+  unsigned              i;
+
+  FlyStrSmartInit(&path);
+  for(i = 0; i < 3; ++i)
+  {
+    if(i == 0)
+      FlyStrSmartCpy(&path, pState->szTomlFilePath ? pState->szTomlFilePath : "");
+    else if(i == 1)
+      FlyStrSmartSprintf(&path, "%sflymake.lock", pState->szRoot);
+    else
+      FlyStrSmartSprintf(&path, "%s.", pState->szRoot);
+
+    memset(&st, 0, sizeof(st));
+    if(path.sz && stat(path.sz, &st) == 0)
+    {
+      hash = FlyMakeHash(&st.st_mtime, sizeof(st.st_mtime), hash);
+      hash = FlyMakeHash(&st.st_size, sizeof(st.st_size), hash);
+    }
+  }
+
+  // a dependency's flymake.toml, e.g. "../dep1/flymake.toml"
+  for(pDep = pState->pDepList; pDep; pDep = pDep->pNext)
+  {
+    if(pDep->pState && pDep->pState->szTomlFilePath && stat(pDep->pState->szTomlFilePath, &st) == 0)
+    {
+      hash = FlyMakeHash(&st.st_mtime, sizeof(st.st_mtime), hash);
+      hash = FlyMakeHash(&st.st_size, sizeof(st.st_size), hash);
+    }
+  }
+  FlyStrSmartUnInit(&path);
+
+  return hash;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Read a protocol line, without the '\n'
+
+  @param    fp        socket, opened for reading
+  @param    szLine    buffer for line
+  @return   TRUE if a complete line was read
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDaemonReadLine(FILE *fp, char szLine[DAEMON_SZ_LINE])
+{
+  size_t    len;
+  bool_t    fWorked = FALSE;
+
+  if(fgets(szLine, DAEMON_SZ_LINE, fp))
+  {
+    len = strlen(szLine);
+    if(len && szLine[len - 1] == '\n')
+    {
+      szLine[len - 1] = '\0';
+      fWorked = TRUE;
+    }
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Daemon: receive the client's stdin, stdout and stderr, sent with the first byte of the request
+
+  @param    fd        connected socket
+  @param    aFds      return value, the 3 file descriptors
+  @return   TRUE if received all 3
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDaemonRecvFds(int fd, int aFds[3])
+{
+  struct msghdr     msg;
+  struct iovec      iov;
+  struct cmsghdr   *pCmsg;
+  char              aCtrl[CMSG_SPACE(3 * sizeof(int))];
+  char              c;
+  bool_t            fWorked = FALSE;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base       = &c;
+  iov.iov_len        = 1;
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = aCtrl;
+  msg.msg_controllen = sizeof(aCtrl);
+  if(recvmsg(fd, &msg, 0) == 1)
+  {
+    pCmsg = CMSG_FIRSTHDR(&msg);
+    if(pCmsg && pCmsg->cmsg_level == SOL_SOCKET && pCmsg->cmsg_type == SCM_RIGHTS &&
+       pCmsg->cmsg_len == CMSG_LEN(3 * sizeof(int)))
+    {
+      memcpy(aFds, CMSG_DATA(pCmsg), 3 * sizeof(int));
+      fWorked = TRUE;
+    }
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Daemon: read a list of strings from a request, e.g. args "flymake" "build" "-j", or the client's
+  environment "PATH=/usr/bin" "CC=clang"
+
+  @param    fp        socket, opened for reading
+  @param    szKey     list keyword, "args" or "env"
+  @param    maxCount  most strings allowed in the list
+  @param    pCount    return value, # of strings
+  @return   allocated list, NULL terminated, free each string and the list, or NULL if failed
+*///-----------------------------------------------------------------------------------------------
+static char ** FmkDaemonReadList(FILE *fp, const char *szKey, unsigned maxCount, int *pCount)
+{
+  char          szLine[DAEMON_SZ_LINE];
+  char        **aszList = NULL;
+  unsigned      count   = 0;
+  unsigned      i;
+  size_t        keyLen;
+  size_t        len;
+  bool_t        fWorked = FALSE;
+
+  keyLen = strlen(szKey);
+  if(FmkDaemonReadLine(fp, szLine) && strncmp(szLine, szKey, keyLen) == 0 &&
+     sscanf(&szLine[keyLen], " %u", &count) == 1 && count <= maxCount)
+  {
+    aszList = FlyAllocZ(sizeof(char *) * (count + 1));
+  }
+
+  for(i = 0; aszList && i < count; ++i)
+  {
+    if(!FmkDaemonReadLine(fp, szLine) || sscanf(szLine, "%zu", &len) != 1 || len >= DAEMON_MAX_LEN)
+      break;
+    aszList[i] = FlyAlloc(len + 1);
+    if(!aszList[i] || fread(aszList[i], 1, len, fp) != len)
+      break;
+    aszList[i][len] = '\0';
+  }
+  if(aszList && i == count)
+    fWorked = TRUE;
+
+  if(!fWorked && aszList)
+  {
+    for(i = 0; i < count; ++i)
+      FlyFreeIf(aszList[i]);
+    FlyFree(aszList);
+    aszList = NULL;
+  }
+  *pCount = (int)count;
+
+  return aszList;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Client: send a list of strings with its keyword, see FmkDaemonReadList()
+
+  @param    fp        socket, opened for writing
+  @param    szKey     list keyword, "args" or "env"
+  @param    count     # of strings
+  @param    aszList   list of strings
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkDaemonWriteList(FILE *fp, const char *szKey, unsigned count, const char * const aszList[])
+{
+  unsigned  i;
+
+  fprintf(fp, "%s %u\n", szKey, count);
+  for(i = 0; i < count; ++i)
+    fprintf(fp, "%zu\n%s", strlen(aszList[i]), aszList[i]);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Daemon: handle one request, in its own process, so the loaded project is never changed by it
+
+  @param    pState    root project state
+  @param    fd        connected socket
+  @param    pfnReq    runs the command
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkDaemonServeRequest(flyMakeState_t *pState, int fd, pfnFlyMakeDaemonReq_t pfnReq)
+{
+  FILE         *fp        = NULL;
+  char        **argv      = NULL;
+  char        **aszEnv    = NULL;
+  int           aFds[3];
+  int           argc      = 0;
+  int           nEnv      = 0;
+  int           exitCode  = 1;
+  int           i;
+
+  if(FmkDaemonRecvFds(fd, aFds))
+  {
+    fp = fdopen(fd, "r+b");
+    if(fp)
+      argv = FmkDaemonReadList(fp, "args", DAEMON_MAX_ARGS, &argc);
+    if(argv)
+      aszEnv = FmkDaemonReadList(fp, "env", DAEMON_MAX_ENV, &nEnv);
+    if(argv && argc && aszEnv)
+    {
+      FlyMakePrintf("#");
+      for(i = 0; i < argc; ++i)
+        FlyMakePrintf(" %s", argv[i]);
+      FlyMakePrintf("\n");
+      fflush(stdout);
+
+      // the command's output goes to the client
+      for(i = 0; i < 3; ++i)
+      {
+        dup2(aFds[i], i);
+        close(aFds[i]);
+      }
+
+      // the command runs with the client's environment, e.g. after switching toolchains
+      environ = aszEnv;
+      exitCode = (*pfnReq)(pState, argc, (const char **)argv);
+      fflush(stdout);
+      fflush(stderr);
+      if(exitCode == FMK_DAEMON_FALLBACK)
+        fprintf(fp, "fallback\n");
+      else
+        fprintf(fp, "exit %d\n", exitCode);
+      fflush(fp);
+    }
+  }
+
+  if(fp)
+    fclose(fp);
+  else
+    close(fd);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Stop serving on SIGINT or SIGTERM
+*///-----------------------------------------------------------------------------------------------
+static void FmkDaemonSignal(int sig)
+{
+  (void)sig;
+  m_fStop = TRUE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Listen on the daemon's socket. If another daemon is already serving this folder, fails. A socket
+  left behind by a daemon that was killed is replaced.
+
+  @param    pAddr     address of socket
+  @return   listening socket, or -1 if failed
+*///-----------------------------------------------------------------------------------------------
+static int FmkDaemonListen(const struct sockaddr_un *pAddr)
+{
+  int     fd;
+  int     fdListen  = -1;
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd >= 0 && connect(fd, (const struct sockaddr *)pAddr, sizeof(*pAddr)) == 0)
+    FlyMakePrintf("flymake error: a daemon is already running for this folder\n");
+  else
+  {
+    unlink(pAddr->sun_path);
+    fdListen = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    // requests must not inherit the listening socket
+    if(fdListen >= 0)
+      fcntl(fdListen, F_SETFD, FD_CLOEXEC);
+    if(fdListen >= 0 && (bind(fdListen, (const struct sockaddr *)pAddr, sizeof(*pAddr)) != 0 ||
+       listen(fdListen, 16) != 0))
+    {
+      FlyMakePrintf("flymake error: could not create socket %s\n", pAddr->sun_path);
+      close(fdListen);
+      fdListen = -1;
+    }
+  }
+  if(fd >= 0)
+    close(fd);
+
+  return fdListen;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Serve build requests for the project until stopped with Ctrl-C. The project state must already
+  be loaded (see FlyMakeTomlAlloc()), with dependencies discovered. If the project's settings
+  change, the daemon starts over by running itself again with the same command-line.
+
+  @param    pState    root project state
+  @param    argv      command-line of the daemon, NULL terminated, to restart it
+  @param    pfnReq    runs the command of a request, in a child process
+  @return   FALSE if couldn't start, TRUE when stopped
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeDaemonServe(flyMakeState_t *pState, const char *argv[], pfnFlyMakeDaemonReq_t pfnReq)
+{
+  struct sockaddr_un  addr;
+  struct pollfd       pfd;
+  uint64_t            sig;
+  pid_t               pid;
+  int                 fdListen  = -1;
+  int                 fd;
+  bool_t              fRestart  = FALSE;
+
+  if(FmkDaemonAddr(&pState->opts, &addr))
+    fdListen = FmkDaemonListen(&addr);
+  if(fdListen < 0)
+    return FALSE;
+
+  FlyMakePrintf("# flymake daemon serving %s, Ctrl-C to stop\n", pState->szFullPath);
+  sig = FmkDaemonSig(pState);
+  signal(SIGINT, FmkDaemonSignal);
+  signal(SIGTERM, FmkDaemonSignal);
+  signal(SIGCHLD, SIG_IGN);   // requests are reaped automatically
+  while(!m_fStop && !fRestart)
+  {
+    pfd.fd      = fdListen;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    if(poll(&pfd, 1, 1000) <= 0)
+      continue;
+    fd = accept(fdListen, NULL, NULL);
+    if(fd < 0)
+      continue;
+
+    // settings changed, the client runs this one itself, the restarted daemon serves the next
+    if(FmkDaemonSig(pState) != sig)
+    {
+      FlyMakePrintf("# project settings changed, restarting daemon\n");
+      if(write(fd, "fallback\n", 9) != 9)
+        FlyMakeDbgPrintf(FMK_DEBUG_SOME, "daemon: client closed\n");
+      fRestart = TRUE;
+    }
+    else
+    {
+      fflush(stdout);
+      pid = fork();
+      if(pid == 0)
+      {
+        signal(SIGCHLD, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        close(fdListen);
+        FmkDaemonServeRequest(pState, fd, pfnReq);
+        _exit(0);
+      }
+    }
+
+    close(fd);
+  }
+
+  close(fdListen);
+  unlink(addr.sun_path);
+  if(fRestart)
+  {
+    signal(SIGCHLD, SIG_DFL);
+    fflush(stdout);
+    execvp(argv[0], (char * const *)argv);
+    FlyMakePrintf("flymake error: could not restart daemon\n");
+  }
+
+  return TRUE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Client: send a request to the daemon serving the current folder, if any, and wait for it to run
+  the command. Not used inside a make jobserver, as the daemon couldn't share its job slots.
+
+  @param    pOpts       options, for FlyMakeCacheFolderAlloc()
+  @param    argc        # of args, from main()
+  @param    argv        args as given to main(), before options were parsed
+  @param    pExitCode   return value, exit code of the command
+  @return   TRUE if the daemon ran the command, FALSE if run it locally
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeDaemonClient(flyMakeOpts_t *pOpts, int argc, const char *argv[], int *pExitCode)
+{
+  struct sockaddr_un  addr;
+  struct msghdr       msg;
+  struct iovec        iov;
+  struct cmsghdr     *pCmsg;
+  char                aCtrl[CMSG_SPACE(3 * sizeof(int))];
+  char                szLine[DAEMON_SZ_LINE];
+  const char         *szMakeFlags;
+  FILE               *fp        = NULL;
+  unsigned            nEnv      = 0;
+  void              (*pfnSigPipe)(int) = SIG_DFL;
+  int                 aFds[3]   = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+  int                 fd        = -1;
+  bool_t              fServed   = FALSE;
+
+  // zeroed since the jobserver path skips FmkDaemonAddr()
+  memset(&addr, 0, sizeof(addr));
+  szMakeFlags = getenv("MAKEFLAGS");
+  if((!szMakeFlags || !strstr(szMakeFlags, "jobserver")) && FmkDaemonAddr(pOpts, &addr))
+  {
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  // the first byte carries stdin, stdout and stderr. A restarting daemon closes the socket early,
+  // so don't die writing to it.
+  if(fd >= 0)
+  {
+    pfnSigPipe = signal(SIGPIPE, SIG_IGN);
+    memset(&msg, 0, sizeof(msg));
+    memset(aCtrl, 0, sizeof(aCtrl));
+    iov.iov_base       = "F";
+    iov.iov_len        = 1;
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = aCtrl;
+    msg.msg_controllen = sizeof(aCtrl);
+    pCmsg = CMSG_FIRSTHDR(&msg);
+    pCmsg->cmsg_level  = SOL_SOCKET;
+    pCmsg->cmsg_type   = SCM_RIGHTS;
+    pCmsg->cmsg_len    = CMSG_LEN(sizeof(aFds));
+    memcpy(CMSG_DATA(pCmsg), aFds, sizeof(aFds));
+    fflush(stdout);
+    if(sendmsg(fd, &msg, 0) == 1)
+      fp = fdopen(fd, "r+b");
+    if(!fp)
+      close(fd);
+  }
+
+  if(fp)
+  {
+    while(environ && environ[nEnv])
+      ++nEnv;
+    FmkDaemonWriteList(fp, "args", (unsigned)argc, argv);
+    FmkDaemonWriteList(fp, "env", nEnv, (const char * const *)environ);
+    fflush(fp);
+
+    // no reply means the command exited early, e.g. a bad option
+    *pExitCode = 1;
+    fServed    = TRUE;
+    if(FmkDaemonReadLine(fp, szLine))
+    {
+      if(strcmp(szLine, "fallback") == 0)
+        fServed = FALSE;
+      else
+        sscanf(szLine, "exit %d", pExitCode);
+    }
+    fclose(fp);
+  }
+  if(fd >= 0)
+    signal(SIGPIPE, pfnSigPipe);
+
+  FlyMakeDbgPrintf(FMK_DEBUG_SOME, "FlyMakeDaemonClient(%s), fServed %u\n", addr.sun_path, fServed);
+
+  return fServed;
+}
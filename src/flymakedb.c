@@ -0,0 +1,1248 @@
+/**************************************************************************************************
+  flymakedb.c - per out/ folder build database, so a no-op build is one read plus a few stats
+  Copyright 2024 Drew Gislason
+  license: <https://mit-license.org>
+
+  The database, e.g. "src/out/.flymake.db", records for each source file that was compiled into
+  the out/ folder: the source modified time and size, the object modified time, the hash of the
+  command-line that compiled it and its header prerequisites (from the depfile, if any).
+
+  With --hash, the contents of the source and each header are also hashed (XXH64), and a file is
+  only considered changed if its contents changed. Modified times can't be trusted after a git
+  checkout or on a network filesystem. A file with the same modified time and size as recorded is
+  not read again, so a no-op build still only stats each file.
+
+  `flymake watch` keeps the databases loaded between builds (see FlyMakeDbOpen()). A record found
+  up to date (or just compiled) is clean until FlyMakeDbListChanged() is told its source or one of
+  its headers changed, so a file nothing changed for isn't even stat'd on the next build.
+
+  File format (host byte order, as the file is local to the build):
+
+      header:   "FMKDB\0\0\0", u32 version, u32 nRecords
+      record:   u32 len, source path, sig source, i64 objModTime, u64 cmdHash, u32 nDeps,
+                { u32 len, dependency path, sig dependency } * nDeps
+      sig:      i64 modTime, i64 size, u64 hash (0 if not hashed)
+**************************************************************************************************/
+#include "flymake.h"
+#include <unistd.h>
+
+#define DB_SANCHK       8821
+#define DB_VERSION         2
+#define DB_MAX_RECORDS    64  // allocate blocks of records
+#define DB_STAT_BUCKETS  256  // header stat cache, must be power of 2
+
+static const char m_szDbName[]  = ".flymake.db";
+static const char m_szDbMagic[] = "FMKDB\0\0";  // 8 bytes with '\0'
+
+// what a file looked like when its object was compiled
+typedef struct
+{
+  int64_t       modTime;
+  int64_t       size;
+  uint64_t      hash;         // XXH64 of contents, or 0 if not hashed (no --hash)
+} fmkDbSig_t;
+
+typedef struct
+{
+  char         *szSrc;        // e.g. "src/foo.c"
+  fmkDbSig_t    src;
+  int64_t       objModTime;
+  uint64_t      cmdHash;      // see FlyMakeHashStr()
+  unsigned      nDeps;
+  char         *szDeps;       // nDeps '\0' terminated paths, one after the other
+  size_t        sizeDeps;
+  fmkDbSig_t   *aDepSigs;     // one per dependency
+  bool_t        fKeep;        // not saved, see FlyMakeDbPrune()
+  bool_t        fClean;       // not saved, up to date and unchanged since, see FlyMakeDbIsClean()
+} fmkDbRec_t;
+
+// a header that has been stat'd (and perhaps hashed) this build
+typedef struct fmkDbStat
+{
+  struct fmkDbStat *pNext;
+  bool_t            fExists;
+  bool_t            fHashed;
+  fmkDbSig_t        sig;
+  char              szPath[1]; // allocated to fit
+} fmkDbStat_t;
+
+typedef struct
+{
+  unsigned      sanchk;
+  char         *szDbPath;     // e.g. "src/out/.flymake.db"
+  fmkDbRec_t   *aRecs;        // always sorted by szSrc
+  unsigned      nRecs;
+  unsigned      maxRecs;
+  bool_t        fDirty;       // needs saving
+  bool_t        fHash;        // --hash, compare contents, not just modified times
+  fmkDbStat_t  *apStats[DB_STAT_BUCKETS];
+} fmkDb_t;
+
+// a database kept loaded between builds, see FlyMakeDbOpen()
+typedef struct
+{
+  void         *pNext;
+  char         *szOutFolder;  // e.g. "src/out/rel/"
+  void         *hDb;
+} fmkDbKept_t;
+
+/*-------------------------------------------------------------------------------------------------
+  Is this a build database?
+
+  @param  hDb     handle from FlyMakeDbNew()
+  @return TRUE if this is a build database
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeDbIs(void *hDb)
+{
+  fmkDb_t  *pDb = hDb;
+  return (pDb && pDb->sanchk == DB_SANCHK) ? TRUE : FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Free the contents of a record, but not the record itself
+*///-----------------------------------------------------------------------------------------------
+static void FmkDbRecFree(fmkDbRec_t *pRec)
+{
+  FlyFreeIf(pRec->szSrc);
+  FlyFreeIf(pRec->szDeps);
+  FlyFreeIf(pRec->aDepSigs);
+  memset(pRec, 0, sizeof(*pRec));
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Binary search for a record by source name
+
+  @param  pDb     ptr to database
+  @param  szSrc   source file, e.g. "src/foo.c"
+  @param  pIndex  return value, index of record, or where it would be inserted if not found
+  @return ptr to record, or NULL if not found
+*///-----------------------------------------------------------------------------------------------
+static fmkDbRec_t * FmkDbSearch(fmkDb_t *pDb, const char *szSrc, unsigned *pIndex)
+{
+  fmkDbRec_t   *pRec  = NULL;
+  unsigned      lo    = 0;
+  unsigned      hi    = pDb->nRecs;
+  unsigned      mid;
+  int           cmp;
+
+  while(lo < hi)
+  {
+    mid = lo + (hi - lo) / 2;
+    cmp = strcmp(szSrc, pDb->aRecs[mid].szSrc);
+    if(cmp == 0)
+    {
+      pRec = &pDb->aRecs[mid];
+      lo = mid;
+      break;
+    }
+    if(cmp < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  *pIndex = lo;
+
+  return pRec;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Find a record by source name
+
+  @param  pDb     ptr to database
+  @param  szSrc   source file, e.g. "src/foo.c"
+  @return ptr to record, or NULL if not found
+*///-----------------------------------------------------------------------------------------------
+static fmkDbRec_t * FmkDbFind(fmkDb_t *pDb, const char *szSrc)
+{
+  unsigned    i;
+  return FmkDbSearch(pDb, szSrc, &i);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add a new, empty record for the source file in sorted order. Assumes it's not already in the
+  database.
+
+  @param  pDb     ptr to database
+  @param  szSrc   source file, e.g. "src/foo.c"
+  @return ptr to record, or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+static fmkDbRec_t * FmkDbAdd(fmkDb_t *pDb, const char *szSrc)
+{
+  fmkDbRec_t   *aRecsNew;
+  fmkDbRec_t   *pRec      = NULL;
+  char         *szSrcNew;
+  unsigned      maxRecs;
+  unsigned      i;
+
+  if(pDb->nRecs >= pDb->maxRecs)
+  {
+    maxRecs = pDb->maxRecs ? pDb->maxRecs * 2 : DB_MAX_RECORDS;
+    aRecsNew = FlyRealloc(pDb->aRecs, sizeof(fmkDbRec_t) * maxRecs);
+    if(aRecsNew)
+    {
+      pDb->aRecs   = aRecsNew;
+      pDb->maxRecs = maxRecs;
+    }
+  }
+
+  szSrcNew = FlyStrClone(szSrc);
+  if(szSrcNew && pDb->nRecs < pDb->maxRecs)
+  {
+    FmkDbSearch(pDb, szSrc, &i);
+    pRec = &pDb->aRecs[i];
+    memmove(pRec + 1, pRec, sizeof(*pRec) * (pDb->nRecs - i));
+    memset(pRec, 0, sizeof(*pRec));
+    pRec->szSrc = szSrcNew;
+    ++pDb->nRecs;
+  }
+  else
+    FlyFreeIf(szSrcNew);
+
+  return pRec;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add a dependency (e.g. a header) to a database record
+
+  @param  pRec    ptr to record
+  @param  szDep   path to dependency, e.g. "inc/foo.h"
+  @param  pSig    what the dependency looked like when compiled
+  @return TRUE if worked, FALSE if out of memory
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDbRecAddDep(fmkDbRec_t *pRec, const char *szDep, const fmkDbSig_t *pSig)
+{
+  char         *szDepsNew;
+  fmkDbSig_t   *aDepSigsNew;
+  size_t        len;
+  bool_t        fWorked = TRUE;
+
+  len = strlen(szDep) + 1;
+  szDepsNew = FlyRealloc(pRec->szDeps, pRec->sizeDeps + len);
+  if(szDepsNew)
+    pRec->szDeps = szDepsNew;
+  aDepSigsNew = FlyRealloc(pRec->aDepSigs, sizeof(fmkDbSig_t) * (pRec->nDeps + 1));
+  if(aDepSigsNew)
+    pRec->aDepSigs = aDepSigsNew;
+
+  if(!szDepsNew || !aDepSigsNew)
+    fWorked = FALSE;
+  else
+  {
+    memcpy(&szDepsNew[pRec->sizeDeps], szDep, len);
+    pRec->sizeDeps += len;
+    pRec->aDepSigs[pRec->nDeps] = *pSig;
+    ++pRec->nDeps;
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Read exactly size bytes from the file
+
+  @return TRUE if read all bytes
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDbRead(FILE *fp, void *p, size_t size)
+{
+  return (fread(p, 1, size, fp) == size) ? TRUE : FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Read the signature of a file
+
+  @return TRUE if read all bytes
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDbReadSig(FILE *fp, fmkDbSig_t *pSig)
+{
+  return (FmkDbRead(fp, &pSig->modTime, sizeof(pSig->modTime)) && FmkDbRead(fp, &pSig->size, sizeof(pSig->size)) &&
+          FmkDbRead(fp, &pSig->hash, sizeof(pSig->hash))) ? TRUE : FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Read a length prefixed string into allocated memory
+
+  @return allocated string or NULL if failed
+*///-----------------------------------------------------------------------------------------------
+static char * FmkDbReadStr(FILE *fp)
+{
+  char       *sz  = NULL;
+  uint32_t    len;
+
+  if(FmkDbRead(fp, &len, sizeof(len)) && len < PATH_MAX)
+  {
+    sz = FlyAlloc(len + 1);
+    if(sz)
+    {
+      if(FmkDbRead(fp, sz, len))
+        sz[len] = '\0';
+      else
+      {
+        FlyFree(sz);
+        sz = NULL;
+      }
+    }
+  }
+
+  return sz;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Load the database file. If missing, wrong version or corrupt, the database is simply empty and
+  everything is checked the slow way (and then recorded).
+
+  @param  pDb     ptr to database, with szDbPath filled in
+  @return none
+*///-----------------------------------------------------------------------------------------------
+static void FmkDbLoad(fmkDb_t *pDb)
+{
+  FILE         *fp;
+  fmkDbRec_t   *pRec;
+  fmkDbSig_t    sig;
+  char         *szDep;
+  char          szMagic[sizeof(m_szDbMagic)];
+  uint32_t      version;
+  uint32_t      nRecs   = 0;
+  uint32_t      nDeps;
+  unsigned      i;
+  unsigned      j;
+  bool_t        fWorked = TRUE;
+
+  fp = fopen(pDb->szDbPath, "rb");
+  if(!fp)
+    fWorked = FALSE;
+
+  if(fWorked)
+  {
+    if(!FmkDbRead(fp, szMagic, sizeof(szMagic)) || memcmp(szMagic, m_szDbMagic, sizeof(szMagic)) != 0 ||
+       !FmkDbRead(fp, &version, sizeof(version)) || version != DB_VERSION ||
+       !FmkDbRead(fp, &nRecs, sizeof(nRecs)))
+    {
+      fWorked = FALSE;
+    }
+  }
+
+  for(i = 0; fWorked && i < nRecs; ++i)
+  {
+    szDep = FmkDbReadStr(fp);
+    pRec  = szDep ? FmkDbAdd(pDb, szDep) : NULL;
+    FlyFreeIf(szDep);
+    if(!pRec ||
+       !FmkDbReadSig(fp, &pRec->src) ||
+       !FmkDbRead(fp, &pRec->objModTime, sizeof(pRec->objModTime)) ||
+       !FmkDbRead(fp, &pRec->cmdHash,    sizeof(pRec->cmdHash)) ||
+       !FmkDbRead(fp, &nDeps,            sizeof(nDeps)))
+    {
+      fWorked = FALSE;
+      break;
+    }
+
+    for(j = 0; fWorked && j < nDeps; ++j)
+    {
+      szDep = FmkDbReadStr(fp);
+      if(!szDep || !FmkDbReadSig(fp, &sig) || !FmkDbRecAddDep(pRec, szDep, &sig))
+        fWorked = FALSE;
+      FlyFreeIf(szDep);
+    }
+  }
+
+  // missing or corrupt database, start over
+  if(fp)
+  {
+    fclose(fp);
+    if(!fWorked)
+    {
+      for(i = 0; i < pDb->nRecs; ++i)
+        FmkDbRecFree(&pDb->aRecs[i]);
+      pDb->nRecs  = 0;
+      pDb->fDirty = TRUE;
+    }
+  }
+
+  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "FmkDbLoad(%s), fWorked %u, nRecs %u\n", pDb->szDbPath, fWorked, pDb->nRecs);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Forget the files stat'd, so they are stat'd again on the next build
+
+  @param  pDb     ptr to database
+  @return none
+*///-----------------------------------------------------------------------------------------------
+static void FmkDbStatsFree(fmkDb_t *pDb)
+{
+  fmkDbStat_t  *pStat;
+  fmkDbStat_t  *pStatNext;
+  unsigned      i;
+
+  for(i = 0; i < DB_STAT_BUCKETS; ++i)
+  {
+    pStat = pDb->apStats[i];
+    while(pStat)
+    {
+      pStatNext = pStat->pNext;
+      FlyFree(pStat);
+      pStat = pStatNext;
+    }
+    pDb->apStats[i] = NULL;
+  }
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Open the build database for an out folder. Never fails unless out of memory: if there is no
+  database file yet, the database starts empty.
+
+  @param    szOutFolder   e.g. "src/out/"
+  @param    fHash         TRUE to compare file contents (--hash), FALSE for just modified times
+  @return   handle to database or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+void * FlyMakeDbNew(const char *szOutFolder, bool_t fHash)
+{
+  fmkDb_t    *pDb;
+  size_t      size;
+
+  pDb = FlyAllocZ(sizeof(*pDb));
+  if(pDb)
+  {
+    size = strlen(szOutFolder) + sizeof(m_szDbName) + 1;
+    pDb->szDbPath = FlyAlloc(size);
+    if(!pDb->szDbPath)
+    {
+      FlyFree(pDb);
+      pDb = NULL;
+    }
+    else
+    {
+      pDb->sanchk = DB_SANCHK;
+      pDb->fHash  = fHash;
+      FlyStrZCpy(pDb->szDbPath, szOutFolder, size);
+      FlyStrPathAppend(pDb->szDbPath, m_szDbName, size);
+      FmkDbLoad(pDb);
+    }
+  }
+
+  return pDb;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Get the modified time and size of a dependency, e.g. a header. Each is stat'd at most once per
+  build.
+
+  @param    pDb       ptr to database
+  @param    szPath    path to dependency, e.g. "inc/foo.h"
+  @return   ptr to stat, or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+static fmkDbStat_t * FmkDbStat(fmkDb_t *pDb, const char *szPath)
+{
+  fmkDbStat_t     *pStat;
+  sFlyFileInfo_t   info;
+  unsigned         bucket;
+
+  bucket = (unsigned)(FlyMakeHashStr(szPath) & (DB_STAT_BUCKETS - 1));
+  pStat  = pDb->apStats[bucket];
+  while(pStat && strcmp(pStat->szPath, szPath) != 0)
+    pStat = pStat->pNext;
+
+  // remember it for the next source file that includes it
+  if(!pStat)
+  {
+    pStat = FlyAllocZ(sizeof(*pStat) + strlen(szPath));
+    if(pStat)
+    {
+      strcpy(pStat->szPath, szPath);
+      FlyFileInfoInit(&info);
+      pStat->fExists     = (FlyFileInfoGetEx(&info, szPath) && info.fExists) ? TRUE : FALSE;
+      pStat->sig.modTime = (int64_t)info.modTime;
+      pStat->sig.size    = (int64_t)info.size;
+      pStat->pNext       = pDb->apStats[bucket];
+      pDb->apStats[bucket] = pStat;
+    }
+  }
+
+  return pStat;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Hash the contents of a dependency, at most once per build
+
+  @param    pStat     ptr to stat from FmkDbStat()
+  @return   TRUE if hashed, FALSE if couldn't read it
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDbStatHash(fmkDbStat_t *pStat)
+{
+  if(!pStat->fHashed)
+  {
+    pStat->fHashed = TRUE;
+    if(!pStat->fExists || !FlyMakeHashFile(pStat->szPath, &pStat->sig.hash))
+      pStat->fExists = FALSE;
+  }
+
+  return pStat->fExists;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  With --hash, is this file the same as when its object was compiled? Only reads the file if its
+  modified time or size differs. If the contents are the same, the new modified time and size are
+  recorded, so the next build doesn't read it again.
+
+  @param    pDb       ptr to database
+  @param    szPath    path to file, e.g. "inc/foo.h"
+  @param    pSig      what the file looked like when compiled
+  @return   TRUE if same
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDbIsSame(fmkDb_t *pDb, const char *szPath, fmkDbSig_t *pSig)
+{
+  fmkDbStat_t  *pStat;
+  bool_t        fSame = FALSE;
+
+  pStat = FmkDbStat(pDb, szPath);
+  if(pStat && pStat->fExists)
+  {
+    if(pStat->sig.modTime == pSig->modTime && pStat->sig.size == pSig->size)
+      fSame = TRUE;
+    else if(pSig->hash && FmkDbStatHash(pStat) && pStat->sig.hash == pSig->hash)
+    {
+      FlyMakeDbgPrintf(FMK_DEBUG_MORE, "  %s touched, but contents same\n", szPath);
+      pSig->modTime = pStat->sig.modTime;
+      pSig->size    = pStat->sig.size;
+      pDb->fDirty   = TRUE;
+      fSame = TRUE;
+    }
+  }
+
+  return fSame;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Has the command-line that compiles this source file changed since it was last compiled? For
+  example, -D or -w- was given this time, but not last time.
+
+  @param    hDb         handle from FlyMakeDbNew()
+  @param    szSrc       source file, e.g. "src/foo.c"
+  @param    cmdHash     hash of the command-line, see FlyMakeHashStr()
+  @return   TRUE if changed or not in database, FALSE if same (or no database to tell)
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeDbIsCmdChanged(void *hDb, const char *szSrc, uint64_t cmdHash)
+{
+  fmkDbRec_t       *pRec;
+  bool_t            fChanged = FALSE;
+
+  if(FlyMakeDbIs(hDb))
+  {
+    pRec = FmkDbFind(hDb, szSrc);
+    if(!pRec || pRec->cmdHash != cmdHash)
+      fChanged = TRUE;
+  }
+
+  return fChanged;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Is this source file up to date according to the database? That is, the source file has the same
+  date and size as when it was compiled, it would be compiled with the same command-line, the
+  object file hasn't changed since and no dependency (header) is newer than the object file.
+
+  With --hash, the source and dependencies need only have the same contents as when compiled.
+
+  @param    hDb         handle from FlyMakeDbNew()
+  @param    szSrc       source file, e.g. "src/foo.c"
+  @param    pSrcInfo    info (already stat'd) about source file
+  @param    szObj       object file, e.g. "src/out/foo.o"
+  @param    cmdHash     hash of the command-line, see FlyMakeHashStr()
+  @return   TRUE if up to date, FALSE if not in database or needs compiling
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeDbIsUpToDate(void *hDb, const char *szSrc, const sFlyFileInfo_t *pSrcInfo, const char *szObj,
+                           uint64_t cmdHash)
+{
+  fmkDb_t          *pDb     = hDb;
+  fmkDbRec_t       *pRec    = NULL;
+  fmkDbStat_t      *pStat;
+  const char       *szDep;
+  sFlyFileInfo_t    info;
+  unsigned          i;
+  bool_t            fUpToDate = FALSE;
+
+  if(FlyMakeDbIs(hDb))
+    pRec = FmkDbFind(pDb, szSrc);
+
+  // same source and command-line as when compiled
+  if(pRec && pRec->cmdHash == cmdHash)
+  {
+    if(pRec->src.modTime == (int64_t)pSrcInfo->modTime && pRec->src.size == (int64_t)pSrcInfo->size)
+      fUpToDate = TRUE;
+    else if(pDb->fHash && FmkDbIsSame(pDb, szSrc, &pRec->src))
+      fUpToDate = TRUE;
+  }
+
+  // object hasn't been touched since
+  if(fUpToDate)
+  {
+    FlyFileInfoInit(&info);
+    if(!FlyFileInfoGetEx(&info, szObj) || !info.fExists || pRec->objModTime != (int64_t)info.modTime)
+      fUpToDate = FALSE;
+  }
+
+  // no header is newer than the object (or with --hash, no header has changed)
+  if(fUpToDate)
+  {
+    szDep = pRec->szDeps;
+    for(i = 0; i < pRec->nDeps; ++i)
+    {
+      if(pDb->fHash)
+      {
+        if(!FmkDbIsSame(pDb, szDep, &pRec->aDepSigs[i]))
+          fUpToDate = FALSE;
+      }
+      else
+      {
+        pStat = FmkDbStat(pDb, szDep);
+        if(!pStat || !pStat->fExists || difftime((time_t)pStat->sig.modTime, (time_t)pRec->objModTime) > 0)
+          fUpToDate = FALSE;
+      }
+      if(!fUpToDate)
+        break;
+      szDep += strlen(szDep) + 1;
+    }
+  }
+  if(fUpToDate)
+    pRec->fClean = TRUE;
+
+  FlyMakeDbgPrintf(FMK_DEBUG_MUCH, "FlyMakeDbIsUpToDate(%s) pRec %p, fUpToDate %u\n", szSrc, pRec, fUpToDate);
+
+  return fUpToDate;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Is this source file known to be up to date, without looking at any file? Only for databases kept
+  between builds by `flymake watch`: the file was found up to date (or compiled) by an earlier
+  build, and FlyMakeDbListChanged() hasn't been told of a change to it or its headers since.
+
+  @param    hDb         handle from FlyMakeDbOpen()
+  @param    szSrc       source file, e.g. "src/foo.c"
+  @param    cmdHash     hash of the command-line, see FlyMakeHashStr()
+  @return   TRUE if known up to date, FALSE if it must be checked
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeDbIsClean(void *hDb, const char *szSrc, uint64_t cmdHash)
+{
+  fmkDbRec_t   *pRec    = NULL;
+  bool_t        fClean  = FALSE;
+
+  if(FlyMakeDbIs(hDb))
+    pRec = FmkDbFind(hDb, szSrc);
+  if(pRec && pRec->fClean && pRec->cmdHash == cmdHash)
+    fClean = TRUE;
+
+  return fClean;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Record that the source file was compiled (or found up to date) into the object file.
+
+  @param    hDb         handle from FlyMakeDbNew()
+  @param    szSrc       source file, e.g. "src/foo.c"
+  @param    szObj       object file, e.g. "src/out/foo.o"
+  @param    szDepFile   depfile from the compiler, e.g. "src/out/foo.d", or NULL
+  @param    cmdHash     hash of the command-line that compiled the file, see FlyMakeHashStr()
+  @return   TRUE if worked, FALSE if source or object missing or out of memory
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeDbUpdate(void *hDb, const char *szSrc, const char *szObj, const char *szDepFile, uint64_t cmdHash)
+{
+  fmkDb_t          *pDb       = hDb;
+  fmkDbRec_t       *pRec      = NULL;
+  fmkDbStat_t      *pStat;
+  void             *hDepFile  = NULL;
+  const char       *szDep;
+  sFlyFileInfo_t    srcInfo;
+  sFlyFileInfo_t    objInfo;
+  uint64_t          srcHash   = 0;
+  unsigned          i;
+  bool_t            fWorked   = TRUE;
+
+  if(!FlyMakeDbIs(hDb))
+    fWorked = FALSE;
+
+  if(fWorked)
+  {
+    FlyFileInfoInit(&srcInfo);
+    FlyFileInfoInit(&objInfo);
+    if(!FlyFileInfoGetEx(&srcInfo, szSrc) || !srcInfo.fExists ||
+       !FlyFileInfoGetEx(&objInfo, szObj) || !objInfo.fExists)
+    {
+      fWorked = FALSE;
+    }
+  }
+  if(fWorked && pDb->fHash && !FlyMakeHashFile(szSrc, &srcHash))
+    fWorked = FALSE;
+
+  // a missing or bad depfile means we can't trust the record
+  if(fWorked && szDepFile)
+  {
+    hDepFile = FlyMakeDepFileNew(szDepFile);
+    if(!hDepFile)
+      fWorked = FALSE;
+  }
+
+  if(fWorked)
+  {
+    pRec = FmkDbFind(pDb, szSrc);
+    if(pRec)
+    {
+      FlyFreeIf(pRec->szDeps);
+      FlyFreeIf(pRec->aDepSigs);
+      pRec->szDeps   = NULL;
+      pRec->aDepSigs = NULL;
+      pRec->sizeDeps = 0;
+      pRec->nDeps    = 0;
+    }
+    else
+      pRec = FmkDbAdd(pDb, szSrc);
+    if(!pRec)
+      fWorked = FALSE;
+  }
+
+  if(fWorked)
+  {
+    pRec->src.modTime = (int64_t)srcInfo.modTime;
+    pRec->src.size    = (int64_t)srcInfo.size;
+    pRec->src.hash    = srcHash;
+    pRec->objModTime  = (int64_t)objInfo.modTime;
+    pRec->cmdHash     = cmdHash;
+    for(i = 0; fWorked && i < FlyMakeDepFileLen(hDepFile); ++i)
+    {
+      // the source file itself is already checked
+      szDep = FlyMakeDepFileGetName(hDepFile, i);
+      if(strcmp(szDep, szSrc) == 0)
+        continue;
+      pStat = FmkDbStat(pDb, szDep);
+      if(!pStat || (pDb->fHash && !FmkDbStatHash(pStat)))
+        fWorked = FALSE;
+      else
+        fWorked = FmkDbRecAddDep(pRec, szDep, &pStat->sig);
+    }
+    pRec->fClean = TRUE;
+    pDb->fDirty  = TRUE;
+  }
+
+  FlyMakeDepFileFree(hDepFile);
+
+  // don't leave a partial record
+  if(!fWorked)
+    FlyMakeDbRemove(hDb, szSrc);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Remove the source file from the database, e.g. because it failed to compile.
+
+  @param    hDb         handle from FlyMakeDbNew()
+  @param    szSrc       source file, e.g. "src/foo.c"
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeDbRemove(void *hDb, const char *szSrc)
+{
+  fmkDb_t          *pDb   = hDb;
+  fmkDbRec_t       *pRec;
+
+  if(FlyMakeDbIs(hDb))
+  {
+    pRec = FmkDbFind(pDb, szSrc);
+    if(pRec)
+    {
+      FmkDbRecFree(pRec);
+      --pDb->nRecs;
+      memmove(pRec, pRec + 1, sizeof(*pRec) * (pDb->nRecs - (unsigned)(pRec - pDb->aRecs)));
+      pDb->fDirty = TRUE;
+    }
+  }
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Remove all sources from the database that are not in the list, e.g. because they were deleted or
+  renamed. Only call this with the complete list of sources for the out folder.
+
+  @param    hDb         handle from FlyMakeDbNew()
+  @param    aszSrc      array of source files, e.g. "src/foo.c", in any order
+  @param    nSrc        # of source files in array
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeDbPrune(void *hDb, const char **aszSrc, unsigned nSrc)
+{
+  fmkDb_t          *pDb   = hDb;
+  fmkDbRec_t       *pRec;
+  unsigned          i;
+  unsigned          j;
+
+  if(FlyMakeDbIs(hDb))
+  {
+    for(i = 0; i < pDb->nRecs; ++i)
+      pDb->aRecs[i].fKeep = FALSE;
+    for(i = 0; i < nSrc; ++i)
+    {
+      pRec = FmkDbFind(pDb, aszSrc[i]);
+      if(pRec)
+        pRec->fKeep = TRUE;
+    }
+
+    // squeeze out the records not kept, preserving sort order
+    for(i = j = 0; i < pDb->nRecs; ++i)
+    {
+      if(pDb->aRecs[i].fKeep)
+        pDb->aRecs[j++] = pDb->aRecs[i];
+      else
+      {
+        FlyMakeDbgPrintf(FMK_DEBUG_MORE, "FlyMakeDbPrune: %s\n", pDb->aRecs[i].szSrc);
+        FmkDbRecFree(&pDb->aRecs[i]);
+        pDb->fDirty = TRUE;
+      }
+    }
+    pDb->nRecs = j;
+  }
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Write a length prefixed string
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDbWriteStr(FILE *fp, const char *sz)
+{
+  uint32_t  len = (uint32_t)strlen(sz);
+  return (fwrite(&len, sizeof(len), 1, fp) == 1 && fwrite(sz, 1, len, fp) == len) ? TRUE : FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Write the signature of a file
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDbWriteSig(FILE *fp, const fmkDbSig_t *pSig)
+{
+  return (fwrite(&pSig->modTime, sizeof(pSig->modTime), 1, fp) == 1 &&
+          fwrite(&pSig->size, sizeof(pSig->size), 1, fp) == 1 &&
+          fwrite(&pSig->hash, sizeof(pSig->hash), 1, fp) == 1) ? TRUE : FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Save the database if it has changed. Writes to a temporary file, then renames it so a build
+  that is interrupted never leaves a partial database. The temporary file is named by process
+  id, so two flymakes saving the same database at once don't write into the same file.
+
+  @param    hDb         handle from FlyMakeDbNew()
+  @return   TRUE if worked (or nothing to save), FALSE if couldn't write
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeDbSave(void *hDb)
+{
+  fmkDb_t      *pDb       = hDb;
+  FILE         *fp        = NULL;
+  fmkDbRec_t   *pRec;
+  flyStrSmart_t tmp;
+  const char   *szDep;
+  uint32_t      u32;
+  unsigned      i;
+  unsigned      j;
+  bool_t        fWorked   = TRUE;
+
+  if(!FlyMakeDbIs(hDb) || !pDb->fDirty)
+    return TRUE;
+
+  FlyStrSmartInit(&tmp);
+  FlyStrSmartSprintf(&tmp, "%s.%ld.tmp", pDb->szDbPath, (long)getpid());
+  if(!tmp.sz)
+    fWorked = FALSE;
+  else
+  {
+    fp = fopen(tmp.sz, "wb");
+    if(!fp)
+      fWorked = FALSE;
+  }
+
+  if(fWorked)
+  {
+    u32 = DB_VERSION;
+    fWorked = (fwrite(m_szDbMagic, sizeof(m_szDbMagic), 1, fp) == 1) ? TRUE : FALSE;
+    if(fWorked)
+      fWorked = (fwrite(&u32, sizeof(u32), 1, fp) == 1) ? TRUE : FALSE;
+    u32 = pDb->nRecs;
+    if(fWorked)
+      fWorked = (fwrite(&u32, sizeof(u32), 1, fp) == 1) ? TRUE : FALSE;
+
+    for(i = 0; fWorked && i < pDb->nRecs; ++i)
+    {
+      pRec = &pDb->aRecs[i];
+      u32  = pRec->nDeps;
+      if(!FmkDbWriteStr(fp, pRec->szSrc) ||
+         !FmkDbWriteSig(fp, &pRec->src) ||
+         fwrite(&pRec->objModTime, sizeof(pRec->objModTime), 1, fp) != 1 ||
+         fwrite(&pRec->cmdHash,    sizeof(pRec->cmdHash), 1, fp) != 1 ||
+         fwrite(&u32,              sizeof(u32), 1, fp) != 1)
+      {
+        fWorked = FALSE;
+      }
+
+      szDep = pRec->szDeps;
+      for(j = 0; fWorked && j < pRec->nDeps; ++j)
+      {
+        fWorked = (FmkDbWriteStr(fp, szDep) && FmkDbWriteSig(fp, &pRec->aDepSigs[j])) ? TRUE : FALSE;
+        szDep += strlen(szDep) + 1;
+      }
+    }
+  }
+
+  if(fp)
+  {
+    if(fclose(fp) != 0)
+      fWorked = FALSE;
+    if(fWorked && rename(tmp.sz, pDb->szDbPath) != 0)
+      fWorked = FALSE;
+    if(!fWorked)
+      remove(tmp.sz);
+  }
+  if(fWorked)
+    pDb->fDirty = FALSE;
+
+  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "FlyMakeDbSave(%s), nRecs %u, fWorked %u\n", pDb->szDbPath, pDb->nRecs, fWorked);
+  FlyStrSmartUnInit(&tmp);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Has the signature of a link or archive changed? The signature file, e.g. "src/out/foo.sig",
+  holds the hash of the command-line that last created the program or library. For example, the
+  release objects were linked last time, but the debug objects are to be linked this time.
+
+  @param    szSigFile   path to signature file, e.g. "src/out/foo.sig"
+  @param    hash        hash of the command-line, see FlyMakeHashStr()
+  @return   TRUE if changed or no signature file, FALSE if same
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeDbSigIsChanged(const char *szSigFile, uint64_t hash)
+{
+  FILE               *fp;
+  unsigned long long  sigHash;
+  bool_t              fChanged = TRUE;
+
+  fp = fopen(szSigFile, "r");
+  if(fp)
+  {
+    if(fscanf(fp, "%llx", &sigHash) == 1 && (uint64_t)sigHash == hash)
+      fChanged = FALSE;
+    fclose(fp);
+  }
+
+  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "FlyMakeDbSigIsChanged(%s), fChanged %u\n", szSigFile, fChanged);
+
+  return fChanged;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Save the signature of a link or archive, see FlyMakeDbSigIsChanged().
+
+  @param    szSigFile   path to signature file, e.g. "src/out/foo.sig"
+  @param    hash        hash of the command-line, see FlyMakeHashStr()
+  @return   TRUE if worked, FALSE if couldn't write the file
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeDbSigSave(const char *szSigFile, uint64_t hash)
+{
+  FILE     *fp;
+  bool_t    fWorked = FALSE;
+
+  fp = fopen(szSigFile, "w");
+  if(fp)
+  {
+    if(fprintf(fp, "%016llx\n", (unsigned long long)hash) > 0)
+      fWorked = TRUE;
+    if(fclose(fp) != 0)
+      fWorked = FALSE;
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Free the database. Does not save it, see FlyMakeDbSave().
+
+  @param    hDb         handle from FlyMakeDbNew()
+  @return   NULL
+*///-----------------------------------------------------------------------------------------------
+void * FlyMakeDbFree(void *hDb)
+{
+  fmkDb_t      *pDb = hDb;
+  unsigned      i;
+
+  if(FlyMakeDbIs(hDb))
+  {
+    for(i = 0; i < pDb->nRecs; ++i)
+      FmkDbRecFree(&pDb->aRecs[i]);
+    FlyFreeIf(pDb->aRecs);
+    FmkDbStatsFree(pDb);
+    FlyFreeIf(pDb->szDbPath);
+    memset(pDb, 0, sizeof(*pDb));
+    FlyFree(pDb);
+  }
+
+  return NULL;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Open the build database for an out folder, see FlyMakeDbNew(). With pState->fDbKeep (`flymake
+  watch`), the database stays loaded in the state between builds, and only files changed since
+  are checked, see FlyMakeDbListChanged(). Close it with FlyMakeDbClose().
+
+  If the database file is gone, e.g. `flymake clean` in another terminal, it is loaded again, as
+  the objects are likely gone too.
+
+  @param    pState        state that keeps the databases
+  @param    szOutFolder   e.g. "src/out/"
+  @return   handle to database or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+void * FlyMakeDbOpen(flyMakeState_t *pState, const char *szOutFolder)
+{
+  fmkDbKept_t      *pKept;
+  sFlyFileInfo_t    info;
+  void             *hDb;
+
+  if(!pState->fDbKeep)
+    return FlyMakeDbNew(szOutFolder, pState->opts.fHash);
+
+  for(pKept = pState->pDbList; pKept; pKept = pKept->pNext)
+  {
+    if(strcmp(pKept->szOutFolder, szOutFolder) == 0)
+      break;
+  }
+
+  if(pKept)
+  {
+    FlyFileInfoInit(&info);
+    if(FlyFileInfoGetEx(&info, ((fmkDb_t *)pKept->hDb)->szDbPath) && info.fExists)
+      FmkDbStatsFree(pKept->hDb);
+    else
+    {
+      hDb = FlyMakeDbNew(szOutFolder, pState->opts.fHash);
+      if(hDb)
+      {
+        FlyMakeDbFree(pKept->hDb);
+        pKept->hDb = hDb;
+      }
+    }
+  }
+
+  // first build of this out folder, if out of memory just don't keep it
+  else
+  {
+    hDb   = FlyMakeDbNew(szOutFolder, pState->opts.fHash);
+    pKept = FlyAllocZ(sizeof(*pKept));
+    if(pKept)
+      pKept->szOutFolder = FlyStrClone(szOutFolder);
+    if(!hDb || !pKept || !pKept->szOutFolder)
+    {
+      if(pKept)
+      {
+        FlyFreeIf(pKept->szOutFolder);
+        FlyFree(pKept);
+      }
+      return hDb;
+    }
+    pKept->hDb = hDb;
+    pState->pDbList = FlyListAppend(pState->pDbList, pKept);
+  }
+
+  return pKept->hDb;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Close a database from FlyMakeDbOpen(). Saves it (unless -n), then frees it, unless it is kept
+  loaded by the state.
+
+  @param    pState      state that keeps the databases
+  @param    hDb         handle from FlyMakeDbOpen(), or NULL
+  @return   NULL
+*///-----------------------------------------------------------------------------------------------
+void * FlyMakeDbClose(flyMakeState_t *pState, void *hDb)
+{
+  fmkDbKept_t  *pKept;
+
+  if(!pState->opts.fNoBuild)
+    FlyMakeDbSave(hDb);
+  for(pKept = pState->pDbList; pKept; pKept = pKept->pNext)
+  {
+    if(pKept->hDb == hDb)
+      break;
+  }
+  if(!pKept)
+    FlyMakeDbFree(hDb);
+
+  return NULL;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Normalize a path so paths to the same file from the watcher and the compiler's depfile compare
+  equal, e.g. "src/../inc/foo.h" and "./inc//foo.h" are both "inc/foo.h".
+
+  @param    szPath      path, e.g. "src/../inc/foo.h"
+  @param    szNorm      return value, normalized path
+  @param    size        sizeof(szNorm)
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkDbPathNorm(const char *szPath, char *szNorm, size_t size)
+{
+  size_t    root  = 0;
+  size_t    len;
+  size_t    last;
+  size_t    n;
+
+  if(*szPath == '/')
+    szNorm[root++] = '/';
+  len = root;
+
+  // each component is followed by '/' in szNorm, e.g. "inc/foo.h/"
+  while(*szPath)
+  {
+    n = strcspn(szPath, "/");
+
+    // start of last component, e.g. "src/" of "a/src/"
+    last = len;
+    if(len > root)
+    {
+      last = len - 1;
+      while(last > root && szNorm[last - 1] != '/')
+        --last;
+    }
+
+    if(n == 0 || (n == 1 && *szPath == '.'))
+      ;
+    else if(n == 2 && strncmp(szPath, "..", 2) == 0 && len > root && strncmp(&szNorm[last], "../", 3) != 0)
+      len = last;
+    else if(len + n + 2 <= size)
+    {
+      memcpy(&szNorm[len], szPath, n);
+      len += n;
+      szNorm[len++] = '/';
+    }
+
+    szPath += n;
+    if(*szPath == '/')
+      ++szPath;
+  }
+
+  if(len > root)
+    --len;
+  szNorm[len] = '\0';
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Is this path one of the changed paths? Only normalizes it if the file name matches one.
+
+  @param    szPath      path, e.g. "src/foo.c" or "src/../inc/foo.h"
+  @param    aszNorm     normalized changed paths, see FmkDbPathNorm()
+  @param    nPaths      # of changed paths
+  @return   TRUE if changed
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDbIsChangedPath(const char *szPath, char **aszNorm, unsigned nPaths)
+{
+  char          szNorm[PATH_MAX];
+  const char   *szName;
+  const char   *szNormName;
+  unsigned      i;
+  bool_t        fNormed   = FALSE;
+
+  szName = strrchr(szPath, '/');
+  szName = szName ? szName + 1 : szPath;
+  for(i = 0; i < nPaths; ++i)
+  {
+    szNormName = strrchr(aszNorm[i], '/');
+    szNormName = szNormName ? szNormName + 1 : aszNorm[i];
+    if(strcmp(szName, szNormName) == 0)
+    {
+      if(!fNormed)
+      {
+        FmkDbPathNorm(szPath, szNorm, sizeof(szNorm));
+        fNormed = TRUE;
+      }
+      if(strcmp(szNorm, aszNorm[i]) == 0)
+        return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Tell the databases kept by the state (see FlyMakeDbOpen()) which files changed since the last
+  build. Each source file that changed, or includes a header that changed, is checked on the next
+  build. Every other file is still known to be up to date, see FlyMakeDbIsClean().
+
+  @param    pState      state that keeps the databases
+  @param    aszPaths    changed files, e.g. "src/foo.c", "inc/foo.h", or NULL to check every file
+  @param    nPaths      # of changed files
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeDbListChanged(flyMakeState_t *pState, const char **aszPaths, unsigned nPaths)
+{
+  fmkDbKept_t  *pKept;
+  fmkDb_t      *pDb;
+  fmkDbRec_t   *pRec;
+  char        **aszNorm   = NULL;
+  char          szNorm[PATH_MAX];
+  const char   *szDep;
+  unsigned      i;
+  unsigned      j;
+
+  // normalize changed paths once, if out of memory check every file
+  if(aszPaths && nPaths)
+  {
+    aszNorm = FlyAllocZ(sizeof(char *) * nPaths);
+    for(i = 0; aszNorm && i < nPaths; ++i)
+    {
+      FmkDbPathNorm(aszPaths[i], szNorm, sizeof(szNorm));
+      aszNorm[i] = FlyStrClone(szNorm);
+      if(!aszNorm[i])
+        aszPaths = NULL;
+    }
+    if(!aszNorm)
+      aszPaths = NULL;
+  }
+
+  for(pKept = pState->pDbList; pKept; pKept = pKept->pNext)
+  {
+    pDb = pKept->hDb;
+    for(i = 0; i < pDb->nRecs; ++i)
+    {
+      pRec = &pDb->aRecs[i];
+      if(!pRec->fClean)
+        continue;
+      if(!aszPaths || FmkDbIsChangedPath(pRec->szSrc, aszNorm, nPaths))
+        pRec->fClean = FALSE;
+      szDep = pRec->szDeps;
+      for(j = 0; pRec->fClean && j < pRec->nDeps; ++j)
+      {
+        if(FmkDbIsChangedPath(szDep, aszNorm, nPaths))
+          pRec->fClean = FALSE;
+        szDep += strlen(szDep) + 1;
+      }
+      if(!pRec->fClean)
+        FlyMakeDbgPrintf(FMK_DEBUG_MORE, "  %s changed\n", pRec->szSrc);
+    }
+  }
+
+  if(aszNorm)
+  {
+    for(i = 0; i < nPaths; ++i)
+      FlyFreeIf(aszNorm[i]);
+    FlyFree(aszNorm);
+  }
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Free the databases kept by the state, see FlyMakeDbOpen(). They were saved when closed.
+
+  @param    pState      state that keeps the databases
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeDbListFree(flyMakeState_t *pState)
+{
+  fmkDbKept_t  *pKept;
+
+  while(pState->pDbList)
+  {
+    pKept = pState->pDbList;
+    pState->pDbList = pKept->pNext;
+    FlyMakeDbFree(pKept->hDb);
+    FlyFree(pKept->szOutFolder);
+    FlyFree(pKept);
+  }
+}
@@ -6,10 +6,26 @@
 #include "flymake.h"
 #include "FlySemVer.h"
 #include "FlyStr.h"
+#include <unistd.h>
 
 static const char m_szOutFolder[]  = FMK_SZ_OUT;        // e.g. "out/"
-static const char m_szOutFiles[]   = FMK_SZ_OUT "*.o";  // e.g. "out/*.o"
+static const char m_szSigExt[]     = ".sig";            // e.g. "src/out/foo.sig"
+static const char m_szRspExt[]     = ".rsp";            // e.g. "src/out/rel/foo.rsp"
+static const char m_szLstExt[]     = ".lst";            // e.g. "lib/out/rel/foo.lst"
 static const char m_szDepTable[]   = "dependencies";    // in flymake.toml, [dependencies]
+static const char m_szLockFile[]   = "flymake.lock";    // resolved dependencies, see FmkDepLockSave()
+static const char m_szLockTable[]  = "lock";            // in flymake.lock, [lock]
+static const char m_szLockVer[]    = "1";               // flymake.lock format version
+static const char m_szCacheExt[]   = ".cache";          // e.g. "deps/foo/out/foo.cache"
+
+// object lists longer than this are passed to the linker or archiver in a response file
+#define FMK_RSP_MIN   4000
+
+// most git dependencies cloned at once, see FmkDepCloneAll()
+#define FMK_CLONE_JOBS  8
+
+// deepest chain of dependencies hashed into an artifact cache key, see FmkDepCacheKey()
+#define FMK_CACHE_DEPTH 16
 
 // states and keys for proecessing dependencies
 typedef struct
@@ -23,6 +39,9 @@ typedef struct
   tomlKey_t      keyVer;        // key if version= "1.2" is present (version range)
   tomlKey_t      keySha;        // key if sha= "cba1855" is present
   tomlKey_t      keyBranch;     // key if branch= "main" is present
+  tomlKey_t      keyClone;      // key if clone= "shallow" is present
+  bool_t         fCloned;       // already cloned by FmkDepCloneAll(), just check out the version
+  const char    *szLock;        // flymake.lock loaded into memory, or NULL
 } fmkDepKeys_t;
 
 typedef struct
@@ -31,6 +50,33 @@ typedef struct
   tomlKey_t   *pKey;
 } fmkDepKeyVal_t;
 
+// how much of a git dependency is cloned, see FmkDepCloneMode()
+typedef enum
+{
+  FMK_CLONE_FULL = 0,   // all branches, all history
+  FMK_CLONE_SHALLOW,    // one branch, last commit only: git clone --depth 1
+  FMK_CLONE_PARTIAL,    // all history, file contents fetched on checkout: git clone --filter=blob:none
+  FMK_CLONE_INVALID
+} fmkDepClone_t;
+
+// finding a version in tags or git log, see FmkDepVersionFind()
+typedef struct
+{
+  const char    *szRange;       // version range, e.g. "1.2"
+  bool_t         fTags;         // lines are "sha tagname", not "sha subject"
+  char          *szSha;         // found SHA, e.g. "cba1855"
+  char          *szVer;         // found version, e.g. "1.2.1"
+} fmkDepVerFind_t;
+
+// build state of each dependency, see FmkDepListBuildDag()
+typedef enum
+{
+  FMK_DEP_WAITING = 0,
+  FMK_DEP_RUNNING,
+  FMK_DEP_DONE,
+  FMK_DEP_FAILED
+} fmkDepBuild_t;
+
 
 /*-------------------------------------------------------------------------------------------------
   print the dependency
@@ -40,6 +86,8 @@ typedef struct
 *///-----------------------------------------------------------------------------------------------
 void FlyMakeDepPrint(const flyMakeDep_t *pDep)
 {
+  unsigned  i;
+
   FlyMakePrintf("\n---- pDep %p ----\n", pDep);
   FlyAssert(pDep);
   FlyMakePrintf("  pNext       %p\n", pDep->pNext);
@@ -48,6 +96,10 @@ void FlyMakeDepPrint(const flyMakeDep_t *pDep)
   FlyMakePrintf("  szIncFolder %s\n", FlyStrNullOk(pDep->szIncFolder));
   FlyMakePrintf("  libs        %s\n", FlyStrNullOk(pDep->libs.sz));
   FlyMakePrintf("  fBuilt      %s\n", FlyStrTrueFalse(pDep->fBuilt));
+  FlyMakePrintf("  apNeeds     ");
+  for(i = 0; i < pDep->nNeeds; ++i)
+    FlyMakePrintf("%s ", pDep->apNeeds[i]->szName);
+  FlyMakePrintf("\n");
   FlyMakePrintf("  pState      %p {", pDep->pState);
   if(pDep->pState && pDep->pState->szTomlFilePath)
     FlyMakePrintf("  szTomlFile=%s", pDep->pState->szTomlFilePath);
@@ -142,38 +194,25 @@ bool_t FlyMakeIsSameFolder(const char *szFolder1, const char *szFolder2)
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Add a path to a smart string folder. Example: "../folder" + "file.c" = "../folder/file.c"
-
-  @param    pFolder       Smart string with folder in it
-  @param    szFile        a file or subfolders to be 
-  @return   0 if worked, -1 if program doesn't exist, 1-n = program error
-*///-----------------------------------------------------------------------------------------------
-static void FmkSmartPathCat(flyStrSmart_t *pFolder, const char *szFile)
-{
-  if(strpbrk(pFolder->sz, "/\\"))
-  {
-    if(!FlyStrIsSlash(FlyStrCharLast(pFolder->sz)))
-      FlyStrSmartCat(pFolder, "/");
-  }
-  FlyStrSmartCat(pFolder, szFile);
-}
-
-/*-------------------------------------------------------------------------------------------------
-  Allocate an outfile name from the input file and output folder
+  Allocate an outfile name from the input file, output folder and output extension. The name is
+  allocated from the arena, so isn't freed, see FlyMakeArenaReset().
 
+  @param    pArena          arena to allocate from, e.g. &pState->arena
+  @param    szOutFolder     output folder (e.g. src/out/)
   @param    szInFileName    input filename (e.g. src/file.c)
-  @return   smart string containing output filername (e.g. src/out/file.o)
+  @param    szObjExt        output file extension (e.g. ".o" or ".d")
+  @return   string containing output filename (e.g. src/out/file.o), or NULL if out of memory
 *///-----------------------------------------------------------------------------------------------
-static char * FmkGetOutName(const char *szOutFolder, const char *szInFileName)
+static char * FmkGetOutNameExt(flyMakeArena_t *pArena, const char *szOutFolder, const char *szInFileName,
+                               const char *szObjExt)
 {
-  static const char   szObjExt[] = ".o";
   char               *szOutName;
   const char         *szBase;
   unsigned            len;
   size_t              size;
 
   size = strlen(szOutFolder) + strlen(szInFileName) + strlen(szObjExt) + 3;
-  szOutName = FlyAlloc(size);
+  szOutName = FlyMakeArenaAlloc(pArena, size);
   if(szOutName)
   {
     FlyStrZCpy(szOutName, szOutFolder, size);
@@ -186,1834 +225,4657 @@ static char * FmkGetOutName(const char *szOutFolder, const char *szInFileName)
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Compile a single file to a single obj in the out folder. Assumes folder/out is already made.
-
-  1. If out/file.o is newer than file.c, then doesn't need to compile
-  2. If pState->opts.fRebuild is set, always compiles
+  Allocate an outfile name from the input file and output folder, from the arena
 
-  @param    pState            flymake state
-  @param    szOutFolder       e.g. "src/out/"
-  @param    szFileName        e.g. "src/myufile.c"
-  @return   -1 if failed, 0 if worked, 1 if didn't need to compile
+  @param    pArena          arena to allocate from, e.g. &pState->arena
+  @param    szOutFolder     output folder (e.g. src/out/)
+  @param    szInFileName    input filename (e.g. src/file.c)
+  @return   string containing output filename (e.g. src/out/file.o), or NULL if out of memory
 *///-----------------------------------------------------------------------------------------------
-static int FmkCompileFile(flyMakeState_t *pState, const char *szOutFolder, const char *szFileName)
+static char * FmkGetOutName(flyMakeArena_t *pArena, const char *szOutFolder, const char *szInFileName)
 {
-  const flyMakeCompiler_t  *pCompiler;
-  char               *szOutFile     = NULL;
-  flyStrSmart_t      *pCmdline      = NULL;
-  char               *szWarn;
-  char               *szDebug;
-  time_t              srcFileModTime;
-  bool_t              fBuild        = TRUE;
-  int                 ret           = 0;
-  sFlyFileInfo_t      info;
+  return FmkGetOutNameExt(pArena, szOutFolder, szInFileName, ".o");
+}
 
-  ++pState->nSrcFiles;
-  if(FlyMakeDebug() >= FMK_DEBUG_MORE)
-    FlyMakePrintf("FmkCompileFile(out=%s, file=%s), nSrcFiles %u\n", szOutFolder, szFileName, pState->nSrcFiles);
+/*-------------------------------------------------------------------------------------------------
+  Allocate the out folder for a source folder. Each configuration (release, or debug level from -D)
+  has its own objects, so switching between debug and release doesn't recompile everything.
 
-  // e.g. "cc %s -c %s%s%s-o %s" where %s is: {in} {incs} {warn} {cc_dbg} {out}
-  // the file list should only contain known file extenstions, so this should always succeed
-  pCompiler  = FlyMakeCompilerFind(pState->pCompilerList, FlyStrPathExt(szFileName));
-  FlyAssert(pCompiler);
+      src/      => src/out/rel/ or src/out/dbg1/
+      ../foo/   => ../foo/out/rel/
 
-  // verify source file exists
-  FlyFileInfoInit(&info);
-  if(!FlyFileInfoGetEx(&info, szFileName) || !info.fExists)
+  @param    pState      state of flymake
+  @param    szFolder    source folder, e.g. "src/"
+  @param    fConfig     TRUE to include configuration folder, FALSE for just "src/out/"
+  @return   allocated out folder, or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+static char * FmkOutFolderAlloc(const flyMakeState_t *pState, const char *szFolder, bool_t fConfig)
+{
+  char       *szOutFolder;
+  char        szConfig[16];
+  size_t      size;
+
+  if(pState->opts.dbg)
+    snprintf(szConfig, sizeof(szConfig), "dbg%d/", pState->opts.dbg);
+  else
+    FlyStrZCpy(szConfig, "rel/", sizeof(szConfig));
+
+  size = strlen(szFolder) + sizeof(m_szOutFolder) + strlen(szConfig) + 2;
+  szOutFolder = FlyAlloc(size);
+  if(szOutFolder)
   {
-    if(FlyMakeDebug())
-      FlyMakePrintf("dbg: Internal Error: file %s does not exist!\n", szFileName);
-    ret = -1;
+    FlyStrZCpy(szOutFolder, szFolder, size);
+    FlyStrPathAppend(szOutFolder, m_szOutFolder, size);
+    if(fConfig)
+      FlyStrZCat(szOutFolder, szConfig, size);
   }
-  if(ret >= 0 && info.fIsDir)
+
+  return szOutFolder;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Make the out folder for the current configuration, e.g. "src/out/rel/" (OK if already exists)
+
+  @param    pState      state of flymake
+  @param    szFolder    source folder, e.g. "src/"
+  @return   allocated out folder, or NULL if out of memory or couldn't make folder
+*///-----------------------------------------------------------------------------------------------
+static char * FmkOutFolderCreate(flyMakeState_t *pState, const char *szFolder)
+{
+  char       *szOutFolder;
+  bool_t      fWorked     = TRUE;
+
+  // make "src/out/", then "src/out/rel/"
+  szOutFolder = FmkOutFolderAlloc(pState, szFolder, FALSE);
+  if(!szOutFolder || !FlyMakeFolderCreate(&pState->opts, szOutFolder))
+    fWorked = FALSE;
+  FlyFreeIf(szOutFolder);
+
+  szOutFolder = NULL;
+  if(fWorked)
   {
-    if(FlyMakeDebug())
-      FlyMakePrintf("dbg: Internal Error: %s is not a file!\n", szFileName);
-    ret = -1;
+    szOutFolder = FmkOutFolderAlloc(pState, szFolder, TRUE);
+    if(!szOutFolder || !FlyMakeFolderCreate(&pState->opts, szOutFolder))
+      fWorked = FALSE;
   }
-  srcFileModTime = info.modTime;
 
-  // verify we can make outfile
-  if(ret >= 0)
+  if(!fWorked && szOutFolder)
   {
-    szOutFile = FmkGetOutName(szOutFolder, szFileName);
-    if(szOutFile == NULL)
-    {
-      FlyMakeErrMem();
-      ret = -1;
-    }
+    FlyFree(szOutFolder);
+    szOutFolder = NULL;
   }
 
-  // check date of folder/out/file.o vs folder/file.c to see if it needs to be compiled
-  if(ret >= 0)
+  return szOutFolder;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Is the link or archive out of date because it was made with a different command-line? For
+  example, the release objects were linked last time, but the debug objects are linked this time.
+
+  The signature is kept in the out folder for all configurations, e.g. "src/out/foo.sig". It
+  includes the list of objects, so adding, removing or renaming a source file also relinks.
+
+  @param    pState      state of flymake
+  @param    szFolder    source folder, e.g. "src/"
+  @param    szTarget    program or library, e.g. "src/foo" or "lib/foo.a"
+  @param    szCmdline   command-line to create target
+  @param    szObjs      list of objects, if not already in szCmdline (e.g. response file), or NULL
+  @param    fSave       FALSE to check the signature, TRUE to save it after creating target
+  @return   TRUE if signature changed (or if fSave, saved), FALSE if not
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkLinkSig(flyMakeState_t *pState, const char *szFolder, const char *szTarget,
+                         const char *szCmdline, const char *szObjs, bool_t fSave)
+{
+  flyMakeArenaMark_t  mark;
+  char               *szOutFolder;
+  char               *szSigFile   = NULL;
+  uint64_t            hash;
+  bool_t              fChanged    = TRUE;
+
+  mark = FlyMakeArenaMark(&pState->arena);
+  hash = FlyMakeHashStr(szCmdline);
+  if(szObjs)
+    hash = FlyMakeHash(szObjs, strlen(szObjs), hash);
+
+  szOutFolder = FmkOutFolderAlloc(pState, szFolder, FALSE);
+  if(szOutFolder)
+    szSigFile = FmkGetOutNameExt(&pState->arena, szOutFolder, szTarget, m_szSigExt);
+  if(szSigFile)
   {
-    FlyFileInfoInit(&info);
-    if(!pState->opts.fRebuild && FlyFileInfoGetEx(&info, szOutFile))
-    {
-      if(difftime(srcFileModTime, info.modTime) <= 0)
-        fBuild = FALSE;
-    }
+    if(fSave)
+      fChanged = pState->opts.fNoBuild ? FALSE : FlyMakeDbSigSave(szSigFile, hash);
+    else
+      fChanged = FlyMakeDbSigIsChanged(szSigFile, hash);
   }
+  FlyFreeIf(szOutFolder);
+  FlyMakeArenaReset(&pState->arena, mark);
 
-  // create cmdline, e.g. cc src/file.c -c -I. -Iinc/ -Wall -Werror -o src/out/file.o
-  // "cc %s -c %s%s%s-o %s" where %s is: {in} {incs} {warn} {cc_dbg} {out}
-  if(ret >= 0 && fBuild)
+  return fChanged;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Get the linker or archiver input for a list of objects. Short lists are used as is. Long lists are
+  written to a response file, e.g. "src/out/rel/foo.rsp", and the input is "@src/out/rel/foo.rsp".
+
+  @param    pState        state of flymake
+  @param    szOutFolder   e.g. "src/out/rel/"
+  @param    szTarget      program or library, e.g. "src/foo"
+  @param    szObjs        list of objects, e.g. "src/out/rel/foo.o src/out/rel/bar.o "
+  @param    pIn           return value, input for {in} or archive command-line
+  @return   TRUE if worked, FALSE if out of memory or couldn't write response file
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkObjsIn(flyMakeState_t *pState, const char *szOutFolder, const char *szTarget,
+                        const char *szObjs, flyStrSmart_t *pIn)
+{
+  flyMakeArenaMark_t  mark;
+  char               *szRspFile;
+  char               *szRsp;
+  char               *psz;
+  bool_t              fWorked   = TRUE;
+
+  if(strlen(szObjs) < FMK_RSP_MIN)
+    fWorked = FlyStrSmartCpy(pIn, szObjs) ? TRUE : FALSE;
+  else
   {
-    pCmdline = FlyStrSmartAlloc(128);
-    if(pCmdline)
+    // one object per line
+    mark      = FlyMakeArenaMark(&pState->arena);
+    szRspFile = FmkGetOutNameExt(&pState->arena, szOutFolder, szTarget, m_szRspExt);
+    szRsp     = FlyMakeArenaStrClone(&pState->arena, szObjs);
+    if(!szRspFile || !szRsp)
+      fWorked = FALSE;
+    else
     {
-      szWarn = pState->opts.fWarning ? pCompiler->szWarn : "";
-      szDebug = pState->opts.dbg ? pCompiler->szCcDbg : "";
-      if(!FlyMakeCompilerFmtCompile(pCmdline, pCompiler, szFileName, pState->incs.sz,
-            szWarn, szDebug, szOutFile))
+      for(psz = szRsp; *psz; ++psz)
       {
-        FlyMakeErrMem();
-        ret = -1;
+        if(*psz == ' ')
+          *psz = '\n';
       }
-      else
+      if(!pState->opts.fNoBuild && !FlyFileWrite(szRspFile, szRsp))
       {
-        // any return not zero is an error
-        ret = FlyMakeSystem(FMK_VERBOSE_SOME, &pState->opts, pCmdline->sz);
-        if(ret != 0)
-          ret = -1;
-
-        // update statistics
-        else
-          ++pState->nCompiled;
+        FlyMakePrintErr(FMK_ERR_WRITE, szRspFile);
+        fWorked = FALSE;
       }
-      FlyStrSmartFree(pCmdline);
+      FlyStrSmartCpy(pIn, "@");
+      FlyStrSmartCat(pIn, szRspFile);
     }
-    else
-      ret = -1;
+    FlyMakeArenaReset(&pState->arena, mark);
   }
 
-  FlyFreeIf(szOutFile);
+  return fWorked;
+}
 
-  if(ret >= 0 && !fBuild)
-    ret = 1;
+/*-------------------------------------------------------------------------------------------------
+  Compare two strings, for sorting and searching an array of strings
+*///-----------------------------------------------------------------------------------------------
+static int FmkStrCmp(const void *p1, const void *p2)
+{
+  return strcmp(*(const char * const *)p1, *(const char * const *)p2);
+}
 
-  return ret;
+/*-------------------------------------------------------------------------------------------------
+  Split a list of objects, e.g. "lib/out/rel/foo.o lib/out/rel/bar.o ", into a sorted array. The
+  array and its strings are a single allocation, so free with FlyFree().
+
+  @param    szObjs    list of objects separated by whitespace
+  @param    pLen      return value, # of objects
+  @return   allocated sorted array of objects, or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+static char ** FmkObjsArrayNew(const char *szObjs, unsigned *pLen)
+{
+  char        **aszObjs;
+  char         *psz;
+  unsigned      nObjs;
+  unsigned      i     = 0;
+  size_t        len;
+
+  // worst case is every other char is an object
+  len = strlen(szObjs);
+  nObjs = (unsigned)(len / 2) + 1;
+  aszObjs = FlyAlloc(sizeof(char *) * nObjs + len + 1);
+  if(aszObjs)
+  {
+    psz = (char *)&aszObjs[nObjs];
+    memcpy(psz, szObjs, len + 1);
+    while(*psz)
+    {
+      while(isspace((unsigned char)*psz))
+        *psz++ = '\0';
+      if(*psz)
+      {
+        aszObjs[i++] = psz;
+        while(*psz && !isspace((unsigned char)*psz))
+          ++psz;
+      }
+    }
+    FlySortQSort(aszObjs, i, sizeof(char *), FmkStrCmp);
+  }
+  *pLen = i;
+
+  return aszObjs;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Compile a folder full of files. Does not link, just creates {folder}/out/file(s).o
+  Run an archive command on a list of objects, e.g. "ar -rs lib/foo.a lib/out/rel/foo.o"
 
-  Used for both library and source rules (FMK_RULE_LIB, FMK_RULE_SRC), but not tools. See FmkTool
+  @param    pState        state of flymake
+  @param    szFmt         archive format, e.g. g_szFmtArchive, with "%s" for library and objects
+  @param    szOutFolder   e.g. "lib/out/rel/"
+  @param    szLib         library, e.g. "lib/foo.a"
+  @param    szObjs        list of objects or members, e.g. "lib/out/rel/foo.o lib/out/rel/bar.o "
+  @return   TRUE if worked, FALSE if failed
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkArchive(flyMakeState_t *pState, const char *szFmt, const char *szOutFolder,
+                         const char *szLib, const char *szObjs)
+{
+  flyStrSmart_t  *pIn       = NULL;
+  flyStrSmart_t  *pCmdline  = NULL;
+  bool_t          fWorked   = TRUE;
 
-  The # of files compiled is returned in pFilesCompiled (0-n). If all files are up to date, and no
-  option forces compile, then nothing is compiled.
+  pIn = FlyStrSmartAlloc(PATH_MAX);
+  if(!pIn)
+  {
+    FlyMakeErrMem();
+    fWorked = FALSE;
+  }
+  else if(!FmkObjsIn(pState, szOutFolder, szLib, szObjs, pIn))
+    fWorked = FALSE;
 
-  Also returns 1st file extension, so caller can know which "compiler" to use to link this project.
+  if(fWorked)
+  {
+    pCmdline = FlyStrSmartNewEx("", strlen(szFmt) + strlen(szLib) + strlen(pIn->sz));
+    if(!pCmdline)
+    {
+      FlyMakeErrMem();
+      fWorked = FALSE;
+    }
+    else
+    {
+      FlyStrSmartSprintf(pCmdline, szFmt, szLib, pIn->sz);
+      if(FlyMakeSystem(FMK_VERBOSE_SOME, &pState->opts, pCmdline->sz) != 0)
+        fWorked = FALSE;
+    }
+  }
 
-  Duties:
+  FlyStrSmartFree(pCmdline);
+  FlyStrSmartFree(pIn);
 
-  1. Makes a list of all source files,  file.c, file2.cpp, etc...
-  2. Only returns FALSE if a compile failed.
-  3. Returns TRUE even if there are no files to compile.
-  4. Only compiles if source file .c is newer than .o. unless option --all or -B was used
+  return fWorked;
+}
 
-  @param    pState            state of flymake (flags, etc...)
-  @param    szFolder          e.g. "", "src/" or "lib/"
-  @param    pFilesCompiled    return value, # of files compiled (0-n)
-  @param    szExt             optional return value if not NULL, the 1st file extension
-  @return   TRUE if worked, FALSE if failed to compile a file
+/*-------------------------------------------------------------------------------------------------
+  Update an existing library in place. Deletes members whose source files are gone and replaces only
+  the members whose objects are new or were compiled since the library was last archived, so the
+  time to archive depends on what changed, not on the size of the library.
+
+  @param    pState        state of flymake
+  @param    szOutFolder   e.g. "lib/out/rel/"
+  @param    szLib         library, e.g. "lib/foo.a"
+  @param    szObjs        current list of objects, e.g. "lib/out/rel/foo.o lib/out/rel/bar.o "
+  @param    szPrevObjs    list of objects in the library when it was last archived
+  @param    pfUpdated     return value, TRUE if the library was changed
+  @return   TRUE if worked, FALSE if failed
 *///-----------------------------------------------------------------------------------------------
-static bool_t FmkCompileFolder(flyMakeState_t *pState, const char *szFolder, unsigned *pFilesCompiled, char *szExt)
+static bool_t FmkLibUpdate(flyMakeState_t *pState, const char *szOutFolder, const char *szLib,
+                           const char *szObjs, const char *szPrevObjs, bool_t *pfUpdated)
 {
-  void           *hSrcList        = NULL;
-  char           *szOutFolder     = NULL;
-  const char     *szFileName;
-  unsigned        nFilesCompiled  = 0;
+  sFlyFileInfo_t  info;
+  char          **aszObjs   = NULL;
+  char          **aszPrev   = NULL;
+  flyStrSmart_t  *pList     = NULL;
+  time_t          libTime   = 0;
+  unsigned        nObjs     = 0;
+  unsigned        nPrev     = 0;
+  unsigned        len;
   unsigned        i;
-  unsigned        size;
-  int             ret;
-  bool_t          fWorked         = TRUE;
+  bool_t          fWorked   = TRUE;
 
-  // default to no file extension returned
-  if(szExt)
-    *szExt = '\0';
+  *pfUpdated = FALSE;
 
-  if(FlyMakeDebug())
-    FlyMakePrintf("FmkCompileFolder(%s)\n", szFolder);
+  FlyFileInfoInit(&info);
+  if(FlyFileInfoGetEx(&info, szLib))
+    libTime = info.modTime;
 
-  hSrcList = FlyMakeSrcListNew(pState->pCompilerList, szFolder, FlyMakeStateDepth(pState));
-  if(hSrcList && FlyMakeSrcListLen(hSrcList) > 0)
+  aszObjs = FmkObjsArrayNew(szObjs, &nObjs);
+  aszPrev = FmkObjsArrayNew(szPrevObjs, &nPrev);
+  pList   = FlyStrSmartAlloc(PATH_MAX);
+  if(!aszObjs || !aszPrev || !pList)
   {
-    // allocate the output folder
-    FlyAssert(*szFolder == '\0' || FlyStrPathIsFolder(szFolder));
-    size = strlen(szFolder) + strlen(m_szOutFolder) + 2;
-    szOutFolder = FlyAllocZ(size);
-    if(!szOutFolder)
-      fWorked = FALSE;
+    FlyMakeErrMem();
+    fWorked = FALSE;
+  }
 
-    // make out/ folder, e.g. "src/out" (OK if already exists)
-    else
+  // delete members whose source files were deleted or renamed, e.g. "ar -ds lib/foo.a old.o"
+  if(fWorked)
+  {
+    for(i = 0; i < nPrev; ++i)
     {
-      FlyStrZCpy(szOutFolder, szFolder, size);
-      FlyStrPathAppend(szOutFolder, m_szOutFolder, size);
-      if(!FlyMakeFolderCreate(&pState->opts, szOutFolder))
-        fWorked = FALSE;
+      if(!bsearch(&aszPrev[i], aszObjs, nObjs, sizeof(char *), FmkStrCmp))
+      {
+        FlyStrSmartCat(pList, FlyStrPathNameBase(aszPrev[i], &len));
+        FlyStrSmartCat(pList, " ");
+      }
+    }
+    if(*pList->sz)
+    {
+      *pfUpdated = TRUE;
+      fWorked = FmkArchive(pState, g_szFmtArchiveDel, szOutFolder, szLib, pList->sz);
     }
   }
 
-  if(fWorked && hSrcList && FlyMakeSrcListLen(hSrcList) > 0)
+  // replace members that are new or were recompiled, e.g. "ar -rs lib/foo.a lib/out/rel/foo.o"
+  // an object from the same second as the library is included, as it may be newer
+  if(fWorked)
   {
-    // return first file extension (so link can use proper link options)
-    szFileName = FlyMakeSrcListGetName(hSrcList, 0);
-    if(szExt)
-      FlyStrZCpy(szExt, FlyStrPathExt(szFileName), FMK_SZ_EXT_MAX);
-
-    nFilesCompiled = 0;
-    for(i = 0; i < FlyMakeSrcListLen(hSrcList); ++i)
+    FlyStrSmartCpy(pList, "");
+    for(i = 0; i < nObjs; ++i)
     {
-      szFileName = FlyMakeSrcListGetName(hSrcList, i);
-      ret = FmkCompileFile(pState, szOutFolder, szFileName);
-      if(ret < 0)
-        fWorked = FALSE;
-      if(ret == 0)
-        ++nFilesCompiled;
+      FlyFileInfoInit(&info);
+      if(!bsearch(&aszObjs[i], aszPrev, nPrev, sizeof(char *), FmkStrCmp) ||
+         !FlyFileInfoGetEx(&info, aszObjs[i]) || difftime(info.modTime, libTime) >= 0)
+      {
+        FlyStrSmartCat(pList, aszObjs[i]);
+        FlyStrSmartCat(pList, " ");
+      }
+    }
+    if(*pList->sz)
+    {
+      *pfUpdated = TRUE;
+      fWorked = FmkArchive(pState, g_szFmtArchiveAdd, szOutFolder, szLib, pList->sz);
     }
-    if(fWorked && !nFilesCompiled)
-      FlyMakePrintfEx(FMK_VERBOSE_MORE, "# %s folder up to date\n", szFolder);
   }
 
-  // done with source files
-  FlyMakeSrcListFree(hSrcList);
-  FlyFreeIf(szOutFolder);
-
-  *pFilesCompiled = nFilesCompiled;
+  FlyFreeIf(aszObjs);
+  FlyFreeIf(aszPrev);
+  FlyStrSmartFree(pList);
 
   return fWorked;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Compile a single tool from a set of one or more source files
+  Remove objects and depfiles in the out folder that no longer have a source file, e.g. because it
+  was deleted or renamed. Also removes them from the build database.
 
   @param    pState        state of flymake
-  @param    pTool         list of .c files, and target link name
-  @return   -1 if failed, 0 if worked, 1 if no need to compile or link
+  @param    szOutFolder   e.g. "src/out/rel/"
+  @param    hDb           build database for the out folder, or NULL
+  @param    aszSrc        complete list of source files that build into the out folder
+  @param    nSrc          # of source files
+  @return   none
 *///-----------------------------------------------------------------------------------------------
-static int FmkToolCompile(flyMakeState_t *pState, const char *szOutFolder, const fmkTool_t *pTool)
+static void FmkOutFolderPrune(flyMakeState_t *pState, const char *szOutFolder, void *hDb,
+                              const char **aszSrc, unsigned nSrc)
 {
-  const flyMakeCompiler_t  *pCompiler;
-  char               *szObj         = NULL; // single obj
-  flyStrSmart_t      *pInObjs       = NULL; // list of input objs for linking
-  flyStrSmart_t      *pToolOut      = NULL;
-  flyStrSmart_t      *pCmdline      = NULL;
-  char               *szDebug;
+  flyMakeArenaMark_t  mark;
+  void               *hList     = NULL;
+  char              **aszBase;
+  char               *szBase;
+  char               *szPattern = NULL;
+  const char         *szName;
+  const char         *szExt;
+  flyStrSmart_t       cmdline;
   unsigned            i;
-  unsigned            nCompiled     = 0;
-  int                 ret           = 0;
-  bool_t              fWorked       = TRUE;
+  size_t              size;
 
-  // compile each source file in this tool
-  for(i = 0; i < pTool->nSrcFiles; ++i)
-  {
-    ret = FmkCompileFile(pState, szOutFolder, pTool->aszSrcFiles[i]);
+  FlyMakeDbPrune(hDb, aszSrc, nSrc);
+  mark = FlyMakeArenaMark(&pState->arena);
+  FlyStrSmartInit(&cmdline);
 
-    // didn't work, e.g. source file didn't compile due to source code errors
-    if(ret < 0)
+  // sorted base names of objects that should be there, e.g. "foo" for "src/foo.c"
+  aszBase = FlyMakeArenaAlloc(&pState->arena, sizeof(char *) * nSrc);
+  if(aszBase)
+  {
+    for(i = 0; i < nSrc; ++i)
     {
-      fWorked = FALSE;
-      break;
+      aszBase[i] = FmkGetOutNameExt(&pState->arena, "", aszSrc[i], "");
+      if(!aszBase[i])
+        break;
     }
-
-    // ret of 1 means it didn't compile because source file is not newer than obj file
-    // so only ret == 0 (worked and compiled) means this source file compiled
-    if(ret == 0)
-      ++nCompiled;
+    if(i == nSrc)
+      FlySortQSort(aszBase, nSrc, sizeof(char *), FmkStrCmp);
+    else
+      nSrc = 0;
   }
 
-  // assume link will use linker of the 1st source file
-  if(fWorked)
+  size = strlen(szOutFolder) + 2;
+  szPattern = FlyMakeArenaAlloc(&pState->arena, size);
+  if(szPattern)
   {
-    pCompiler  = FlyMakeCompilerFind(pState->pCompilerList, FlyStrPathExt(pTool->aszSrcFiles[0]));
-    FlyAssert(pCompiler);
+    FlyStrZCpy(szPattern, szOutFolder, size);
+    FlyStrZCat(szPattern, "*", size);
+    hList = FlyFileListNew(szPattern);
   }
 
-  // create a place to hold list of objs for this tool
-  if(fWorked)
+  for(i = 0; aszBase && nSrc && i < FlyFileListLen(hList); ++i)
   {
-    pInObjs = FlyStrSmartAlloc(PATH_MAX);
-    if(!pInObjs)
+    szName = FlyFileListGetName(hList, i);
+    szExt  = FlyStrPathExt(szName);
+    if(!szExt || (strcmp(szExt, ".o") != 0 && strcmp(szExt, ".d") != 0))
+      continue;
+    szBase = FmkGetOutNameExt(&pState->arena, "", szName, "");
+    if(szBase && !bsearch(&szBase, aszBase, nSrc, sizeof(char *), FmkStrCmp))
     {
-      FlyMakeErrMem();
-      fWorked = FALSE;
+      FlyStrSmartSprintf(&cmdline, "rm -f %s", szName);
+      if(cmdline.sz)
+        FlyMakeSystem(FMK_VERBOSE_MORE, &pState->opts, cmdline.sz);
     }
   }
 
-  // create list of input objs for linking, e.g. "out/tool.o out/tool2.o "
-  if(fWorked)
-  {
-    for(i = 0; i < pTool->nSrcFiles; ++i)
-    {
-      szObj = FmkGetOutName(szOutFolder, pTool->aszSrcFiles[i]);
-      if(!szObj)
-      {
-        FlyMakeErrMem();
-        fWorked = FALSE;
-        break;
-      }
-      FlyStrSmartCat(pInObjs, szObj);
-      FlyStrSmartCat(pInObjs, " ");
-      FlyFree(szObj);
-    }
-  }
+  FlyStrSmartUnInit(&cmdline);
+  FlyFileListFree(hList);
+  FlyMakeArenaReset(&pState->arena, mark);
+}
 
-  // create output name for tool, e.g. "test/test_foo"
-  if(fWorked)
+/*-------------------------------------------------------------------------------------------------
+  Record the result of a compile in the build database, so the next build can skip the file.
+  Nothing is recorded with -n, as nothing was compiled.
+
+  @param    pState        flymake state
+  @param    szOutFolder   e.g. "src/out/"
+  @param    hDb           build database, or NULL
+  @param    szFileName    e.g. "src/myfile.c"
+  @param    szCmdline     command-line that compiled the file
+  @param    fWorked       TRUE if compiled, FALSE if failed
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkCompileRecord(flyMakeState_t *pState, const char *szOutFolder, void *hDb,
+                             const char *szFileName, const char *szCmdline, bool_t fWorked)
+{
+  const flyMakeCompiler_t  *pCompiler;
+  flyMakeArenaMark_t        mark;
+  char                     *szOutFile;
+  char                     *szDepFile = NULL;
+
+  if(hDb && !pState->opts.fNoBuild)
   {
-    pToolOut = FlyStrSmartAlloc(strlen(pTool->aszSrcFiles[0]) + strlen(pTool->szName) + 1);
-    if(!pToolOut)
-    {
-      FlyMakeErrMem();
-      fWorked = FALSE;
-    }
+    if(!fWorked)
+      FlyMakeDbRemove(hDb, szFileName);
     else
     {
-      FlyStrSmartCpy(pToolOut, pTool->aszSrcFiles[0]);
-      FlyStrPathOnly(pToolOut->sz);
-      FlyStrSmartCat(pToolOut, pTool->szName);
-      if(!FlyFileExistsFile(pToolOut->sz))
-      {
-        ++nCompiled;
-        ++pState->nCompiled;
-      }
+      mark = FlyMakeArenaMark(&pState->arena);
+      pCompiler = FlyMakeCompilerFind(pState->pCompilerList, FlyStrPathExt(szFileName));
+      szOutFile = FmkGetOutName(&pState->arena, szOutFolder, szFileName);
+      if(pCompiler && FlyMakeCompilerHasDep(pCompiler))
+        szDepFile = FmkGetOutNameExt(&pState->arena, szOutFolder, szFileName, ".d");
+      if(szOutFile)
+        FlyMakeDbUpdate(hDb, szFileName, szOutFile, szDepFile, FlyMakeHashStr(szCmdline));
+      FlyMakeArenaReset(&pState->arena, mark);
     }
   }
+}
 
-  // if we need to link the tool, do it
-  if(fWorked && (nCompiled || pState->opts.fRebuild))
-  {
-    // make sure we can get the memory
-    pCmdline = FlyStrSmartAlloc(PATH_MAX);
-    if(!pCmdline)
-    {
-      FlyMakeErrMem();
-      fWorked = FALSE;
-    }
-    else
-    {
-      // create output name for tool, e.g. "test/test_foo"
-      FlyStrSmartCpy(pToolOut, pTool->aszSrcFiles[0]);
-      FlyStrPathOnly(pToolOut->sz);
-      FlyStrSmartCat(pToolOut, pTool->szName);
+/*-------------------------------------------------------------------------------------------------
+  Store a file just compiled in the object cache, if --cache. See flymakecache.c.
 
-      szDebug = pState->opts.dbg ? pCompiler->szLlDbg : "";
+  @param    pState        flymake state
+  @param    szOutFolder   e.g. "src/out/rel/"
+  @param    szFileName    e.g. "src/myfile.c"
+  @param    szCmdline     command-line that compiled the file
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkCompileCachePut(flyMakeState_t *pState, const char *szOutFolder, const char *szFileName,
+                               const char *szCmdline)
+{
+  const flyMakeCompiler_t  *pCompiler;
+  flyMakeArenaMark_t        mark;
+  char                     *szOutFile;
+  char                     *szDepFile = NULL;
 
-      // convert from {markers} into the command-line for link
-      if(!FlyMakeCompilerFmtLink(pCmdline, pCompiler, pInObjs->sz, pState->libs.sz,
-                            szDebug, pToolOut->sz))
-      {
-        FlyMakeErrMem();
-        fWorked = FALSE;
-      }
+  if(pState->opts.fCache && !pState->opts.fNoBuild)
+  {
+    mark = FlyMakeArenaMark(&pState->arena);
+    pCompiler = FlyMakeCompilerFind(pState->pCompilerList, FlyStrPathExt(szFileName));
+    szOutFile = FmkGetOutName(&pState->arena, szOutFolder, szFileName);
+    if(pCompiler && FlyMakeCompilerHasDep(pCompiler))
+      szDepFile = FmkGetOutNameExt(&pState->arena, szOutFolder, szFileName, ".d");
+    if(szOutFile && szDepFile)
+      FlyMakeCacheObjPut(&pState->opts, szFileName, szCmdline, szOutFile, szDepFile);
+    FlyMakeArenaReset(&pState->arena, mark);
+  }
+}
 
-      if(fWorked)
-      {
-        ret = FlyMakeSystem(FMK_VERBOSE_SOME, &pState->opts, pCmdline->sz);
-        if(ret != 0)
-          FlyMakePrintf("# failed to create %s\n\n", pTool->szName);
-        else
-          FlyMakePrintf("# created program %s\n\n", pTool->szName);
-      }
-      FlyStrSmartFree(pCmdline);
+/*-------------------------------------------------------------------------------------------------
+  Describe a compile as an action: the source, every header it includes, the include folders and
+  the object and depfile it writes. See flymakeaction.c.
+
+  @param    pState        flymake state
+  @param    szFileName    e.g. "src/myfile.c"
+  @param    szCmdline     command-line that compiles the file
+  @param    szOutFile     e.g. "src/out/rel/myfile.o"
+  @param    szDepFile     e.g. "src/out/rel/myfile.d", or NULL
+  @return   allocated action, or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+static flyMakeAction_t * FmkCompileActionNew(flyMakeState_t *pState, const char *szFileName,
+                                             const char *szCmdline, const char *szOutFile,
+                                             const char *szDepFile)
+{
+  flyMakeAction_t  *pAction;
+
+  pAction = FlyMakeActionNew(szCmdline);
+  if(pAction)
+  {
+    if(!FlyMakeActionAddIncludes(pAction, szFileName, pState->incs.sz ? pState->incs.sz : "") ||
+       !FlyMakeActionAddOutput(pAction, szOutFile) || (szDepFile && !FlyMakeActionAddOutput(pAction, szDepFile)))
+    {
+      pAction = FlyMakeActionFree(pAction);
     }
   }
 
-  // everything was already up to date (nothing to compile or link)
-  else if(fWorked && nCompiled == 0 && !pState->opts.fRebuild)
-    ret = 1;
-
-  // cleanup
-  FlyStrSmartFree(pToolOut);
-  FlyStrSmartFree(pInObjs);
+  return pAction;
+}
 
-  // some kind of problem (e.g. system didn't compile or memory issue)
-  if(!fWorked)
-    ret = -1;
+/*-------------------------------------------------------------------------------------------------
+  Run a compile action in a child process, see FlyMakeJobsAddFn()
 
-  return ret;
+  @param    pArg      action from FmkCompileActionNew()
+  @return   0 if worked, 1 if failed
+*///-----------------------------------------------------------------------------------------------
+static int FmkCompileActionJob(void *pArg)
+{
+  return (FlyMakeExecRun(pArg) == 0) ? 0 : 1;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Build lib/ or any folder under lib rules. Folder must exist and have at least 1 source file.
+  Compile a single file to a single obj in the out folder. Assumes folder/out is already made.
 
-  1. Compile each file with `-I. -I../inc -Wall -Werror lib/file.c -o lib/out`
-  2. Create library using `ar -crs libname.a lib/out/ *.o`
+  1. If the build database (see flymakedb.c) says the file is up to date, doesn't need to compile.
+     With `flymake watch`, it knows without a stat if nothing changed for it, see FlyMakeDbIsClean()
+  2. If out/file.o is newer than file.c, then doesn't need to compile (not with --hash)
+  3. If pState->opts.fRebuild is set, always compiles
+  4. If the compiler has a {dep} marker, out/file.d lists headers. If any are newer, compiles
+  5. If the command-line differs from the one that compiled out/file.o (e.g. -D), compiles
+  6. With --cache, an object from the object cache counts as compiled, see flymakecache.c
+  7. With --sandbox, the compile runs as an action through the executor, see flymakeexec.c
 
-  @param  pState    state of flymake
-  @param  szFolder  folder to build under lib/ rules, e.g. lib/ or ../myfolder/
-  @return TRUE if worked, FALSE if failed
+  If hJobs is not NULL, the compile is queued to the job pool and 0 is returned. The caller must
+  wait on the pool (see FmkCompileJobsWait()) for the actual results.
+
+  Names and options for the file come from the arena and are released before returning, and the
+  command-line reuses pState->cmdline, so a file that is up to date doesn't touch the heap.
+
+  @param    pState            flymake state
+  @param    szOutFolder       e.g. "src/out/"
+  @param    szFileName        e.g. "src/myufile.c"
+  @param    hJobs             job pool for -j, or NULL to compile now
+  @param    hDb               build database for the out folder, or NULL
+  @param    tag               tag for job pool, e.g. tool index
+  @return   -1 if failed, 0 if worked (or queued), 1 if didn't need to compile
 *///-----------------------------------------------------------------------------------------------
-bool_t FlyMakeBuildLib(flyMakeState_t *pState, const char *szFolder)
+static int FmkCompileFile(flyMakeState_t *pState, const char *szOutFolder, const char *szFileName,
+                          void *hJobs, void *hDb, unsigned tag)
 {
-  static const char   szObjs[]        = "*.o";
-  char               *pszLibName      = NULL;
-  flyStrSmart_t      *pCmdline        = NULL;
-  flyStrSmart_t      *pObjs           = NULL;
-  unsigned            nFilesCompiled  = 0;
-  bool_t              fWorked;
+  const flyMakeCompiler_t  *pCompiler;
+  flyMakeArenaMark_t  mark;
+  flyMakeAction_t    *pAction       = NULL;
+  char               *szOutFile     = NULL;
+  char               *szDepFile     = NULL;
+  void               *hDepFile;
+  flyStrSmart_t      *pCmdline      = &pState->cmdline;
+  char               *szWarn;
+  char               *szDebug;
+  uint64_t            cmdHash       = 0;
+  bool_t              fBuild        = TRUE;
+  int                 ret           = 0;
+  bool_t              fClean        = FALSE;
+  sFlyFileInfo_t      srcInfo;
+  sFlyFileInfo_t      info;
 
-  // compile any files in the folder than need compiling
+  ++pState->nSrcFiles;
   if(FlyMakeDebug() >= FMK_DEBUG_MORE)
-    FmkBanner(FMK_VERBOSE_NONE, szFolder, "Lib Rules");
-  if(FlyMakeDebug())
-    FlyMakePrintf("FlyMakeBuildLib(fAll %u, fRebuild %u, %s)\n", pState->opts.fAll, pState->opts.fRebuild, szFolder);
-
-  // must have 2 replacement strings for libname and objs
-  FlyAssert(FlyStrCount(g_szFmtArchive, "%s") == 2);
+    FlyMakePrintf("FmkCompileFile(out=%s, file=%s), nSrcFiles %u\n", szOutFolder, szFileName, pState->nSrcFiles);
+  mark = FlyMakeArenaMark(&pState->arena);
 
-  // compile the files in the lib folder
-  fWorked = FmkCompileFolder(pState, szFolder, &nFilesCompiled, NULL);
+  // e.g. "cc %s -c %s%s%s-o %s" where %s is: {in} {incs} {warn} {cc_dbg} {out}
+  // the file list should only contain known file extenstions, so this should always succeed
+  pCompiler  = FlyMakeCompilerFind(pState->pCompilerList, FlyStrPathExt(szFileName));
+  FlyAssert(pCompiler);
 
-  if(fWorked)
+  // verify we can make outfile
+  if(ret >= 0)
   {
-    pszLibName = FlyMakeFolderAllocLibName(pState, szFolder);
-    if(pszLibName == NULL)
+    szOutFile = FmkGetOutName(&pState->arena, szOutFolder, szFileName);
+    if(FlyMakeCompilerHasDep(pCompiler))
+      szDepFile = FmkGetOutNameExt(&pState->arena, szOutFolder, szFileName, ".d");
+    if(szOutFile == NULL || (FlyMakeCompilerHasDep(pCompiler) && szDepFile == NULL))
     {
       FlyMakeErrMem();
-      fWorked = FALSE;
+      ret = -1;
     }
-    else if(!FlyFileExistsFile(pszLibName))
-      ++nFilesCompiled;
   }
 
-  // archive the file into a static library, e.g. "lib/myproj.a"
-  if(fWorked && nFilesCompiled)
+  // create cmdline, e.g. cc src/file.c -c -I. -Iinc/ -Wall -Werror -o src/out/file.o
+  // "cc %s -c %s%s%s-o %s" where %s is: {in} {incs} {warn} {cc_dbg} {out}
+  if(ret >= 0)
   {
-    pState->fLibCompiled = TRUE;
-    if(fWorked)
+    szWarn = pState->opts.fWarning ? pCompiler->szWarn : "";
+    szDebug = pState->opts.dbg ? pCompiler->szCcDbg : "";
+    if(!FlyMakeCompilerFmtCompile(pCmdline, &pState->arena, pCompiler, szFileName, pState->incs.sz,
+          szWarn, szDebug, szDepFile, szOutFile))
     {
-      pCmdline = FlyStrSmartNewEx("", strlen(g_szFmtArchive) + strlen(pszLibName) + sizeof(m_szOutFolder) + sizeof(szObjs));
-      if(pCmdline == NULL)
-        fWorked = FALSE;
+      FlyMakeErrMem();
+      ret = -1;
     }
-    if(fWorked)
+    else
+      cmdHash = FlyMakeHashStr(pCmdline->sz);
+  }
+
+  // with `flymake watch`, nothing changed for this file since the last build
+  if(ret >= 0 && !pState->opts.fRebuild && FlyMakeDbIsClean(hDb, szFileName, cmdHash))
+    fClean = TRUE;
+
+  // verify source file exists
+  if(ret >= 0 && !fClean)
+  {
+    FlyFileInfoInit(&srcInfo);
+    if(!FlyFileInfoGetEx(&srcInfo, szFileName) || !srcInfo.fExists)
     {
-      pObjs = FlyStrSmartNewEx(szFolder, strlen(szFolder) + sizeof(m_szOutFiles) + 16);
-      if(pObjs == NULL)
-        fWorked = FALSE;
-      else
-        FmkSmartPathCat(pObjs, m_szOutFiles); // e.g. "lib/out/*.o"
+      if(FlyMakeDebug())
+        FlyMakePrintf("dbg: Internal Error: file %s does not exist!\n", szFileName);
+      ret = -1;
     }
-    if(fWorked)
+    else if(srcInfo.fIsDir)
     {
-      // e.g. "ar -crs projname.a lib/out/*.o:"
-      // e.g. "ar -crs ../somefolder.a ../somefolder/out/*.o"
-      FlyStrSmartSprintf(pCmdline, g_szFmtArchive, pszLibName, pObjs->sz);
-      fWorked = FlyMakeSystem(FMK_VERBOSE_SOME, &pState->opts, pCmdline->sz) == 0 ? TRUE : FALSE;
-      if(!fWorked)
-        FlyMakePrintfEx(FMK_VERBOSE_SOME, "# failed to create %s\n\n", pszLibName);
-      else
-        FlyMakePrintfEx(FMK_VERBOSE_SOME, "# created library %s\n\n", pszLibName);
-
-      if(pszLibName)
-        FlyFree(pszLibName);
+      if(FlyMakeDebug())
+        FlyMakePrintf("dbg: Internal Error: %s is not a file!\n", szFileName);
+      ret = -1;
     }
   }
 
-  return fWorked;
-}
-
-/*-------------------------------------------------------------------------------------------------
-  Build src/ folder or any folder under src rules
-
-  1. Compile each file with `-I. -Iinc/ -Wall -Werror` or user set cmdline
-  2. Optional `-DDEBUG=1`
-  3. link with static library, e.g. lib/projname.a and any dependency libraries
-
-  @param  pState    state of flymake
-  @param  szFolder  folder to build under src/ rules
-  @return TRUE if worked, FALSE if failed
-*///-----------------------------------------------------------------------------------------------
-static bool_t FlyMakeBuildSrc(flyMakeState_t *pState, const char *szFolder)
-{
-  const flyMakeCompiler_t *pCompiler;
-  char           *szTarget        = NULL;
-  flyStrSmart_t  *pCmdline        = NULL;
-  flyStrSmart_t  *pInFiles        = NULL;
-  char           *szDebug;
-  char            szExt[FMK_SZ_EXT_MAX];
-  unsigned        nFilesCompiled  = 0;
-  bool_t          fWorked;
-  size_t          sizeIn;
-
-  if(FlyMakeDebug() >= FMK_DEBUG_MORE)
-    FmkBanner(FMK_VERBOSE_NONE, szFolder, "Src Rules");
-  if(FlyMakeDebug())
-    FlyMakePrintf("FlyMakeBuildSrc(fAll %u, fRebuild %u, %s)\n", pState->opts.fAll, pState->opts.fRebuild, szFolder);
+  if(ret >= 0 && fClean)
+    fBuild = FALSE;
 
-  // compile the folder
-  fWorked = FmkCompileFolder(pState, szFolder, &nFilesCompiled, szExt);
-  if(pState->fLibCompiled)
-    ++nFilesCompiled;
+  // the build database knows the file is up to date without reading the depfile
+  else if(ret >= 0 && !pState->opts.fRebuild && FlyMakeDbIsUpToDate(hDb, szFileName, &srcInfo, szOutFile, cmdHash))
+    fBuild = FALSE;
 
-  // get target name, e.g. "src/foo"
-  // note: szExt is empty if no source code in folder
-  if(fWorked && *szExt)
+  // otherwise check date of folder/out/file.o vs folder/file.c to see if it needs to be compiled
+  // with --hash, dates can't be trusted, so a file the database doesn't know is up to date is compiled
+  else if(ret >= 0 && !pState->opts.fHash)
   {
-    szTarget = FlyMakeFolderAllocSrcName(pState, szFolder);
-    if(!szTarget)
+    FlyFileInfoInit(&info);
+    if(!pState->opts.fRebuild && FlyFileInfoGetEx(&info, szOutFile))
     {
-      FlyMakeErrMem();
-      fWorked = FALSE;
+      if(difftime(srcInfo.modTime, info.modTime) <= 0)
+        fBuild = FALSE;
+    }
+
+    // check any headers in folder/out/file.d. If no depfile, compile to create one
+    if(!fBuild && szDepFile)
+    {
+      hDepFile = FlyMakeDepFileNew(szDepFile);
+      if(!hDepFile || FlyMakeDepFileIsNewer(hDepFile, info.modTime))
+        fBuild = TRUE;
+      FlyMakeDepFileFree(hDepFile);
     }
-    if(!FlyFileExistsFile(szTarget))
+
+    // different compiler flags than last time, or unknown flags because not in database
+    if(!fBuild && FlyMakeDbIsCmdChanged(hDb, szFileName, cmdHash))
     {
-      ++nFilesCompiled;
-      ++pState->nCompiled;
+      FlyMakeDbgPrintf(FMK_DEBUG_MORE, "  %s command-line changed\n", szFileName);
+      fBuild = TRUE;
     }
+
+    // up to date, so remember that for next time
+    if(!fBuild)
+      FmkCompileRecord(pState, szOutFolder, hDb, szFileName, pCmdline->sz, TRUE);
   }
 
-  // no need to link if no new obj files
-  if(fWorked && *szExt && (nFilesCompiled || pState->opts.fRebuild))
+  // same command-line, source and headers compiled before, perhaps in another project
+  if(ret >= 0 && fBuild && !pState->opts.fRebuild &&
+     FlyMakeCacheObjGet(&pState->opts, szFileName, pCmdline->sz, szOutFile, szDepFile))
   {
-    // get the compiler cmdline for this source file
-    pCompiler = FlyMakeCompilerFind(pState->pCompilerList, szExt);
-    FlyAssert(pCompiler && pCompiler->szLl);
+    ++pState->nCompiled;
+    FmkCompileRecord(pState, szOutFolder, hDb, szFileName, pCmdline->sz, TRUE);
+  }
 
-    sizeIn    = strlen(szFolder) + sizeof(m_szOutFiles) + 1;
-    pInFiles  = FlyStrSmartAlloc(sizeIn);
-    pCmdline  = FlyStrSmartAlloc(strlen(pCompiler->szLl) + sizeIn + strlen(pState->libs.sz) +
-                                 strlen(pCompiler->szLlDbg) + strlen(szTarget) + 1);
-    if(!pCmdline || !pInFiles)
+  else if(ret >= 0 && fBuild)
+  {
+    if(!FlyMakeExecIsLocal())
     {
-      FlyMakeErrMem();
-      fWorked = FALSE;
+      pAction = FmkCompileActionNew(pState, szFileName, pCmdline->sz, szOutFile, szDepFile);
+      if(!pAction)
+      {
+        FlyMakeErrMem();
+        ret = -1;
+      }
     }
-    else
-    {
-      // e.g. "src/out/*.o
-      FlyStrSmartCpy(pInFiles, szFolder);
-      FmkSmartPathCat(pInFiles, m_szOutFiles);
-
-      szDebug = pState->opts.dbg ? pCompiler->szLlDbg : "";
 
-      // create link command-line from {markers}
-      // e.g. cc src/out/*.o lib/projname.a -DDEBUG=1 -o src/projname
-      if(!FlyMakeCompilerFmtLink(pCmdline, pCompiler, pInFiles->sz, pState->libs.sz, szDebug, szTarget))
+    if(ret >= 0 && hJobs)
+    {
+      // statistics and database are updated when the job completes, see FmkCompileJobsWait()
+      if(pAction)
       {
-        FlyMakeErrMem();
-        fWorked = FALSE;
+        if(!FlyMakeJobsAddFn(hJobs, szFileName, pCmdline->sz, FmkCompileActionJob, pAction, tag))
+          ret = -1;
       }
+      else if(!FlyMakeJobsAdd(hJobs, szFileName, pCmdline->sz, tag))
+        ret = -1;
+    }
+    else if(ret >= 0)
+    {
+      // any return not zero is an error
+      if(pAction)
+        ret = FlyMakeExecRun(pAction);
+      else
+        ret = FlyMakeSystem(FMK_VERBOSE_SOME, &pState->opts, pCmdline->sz);
+      if(ret != 0)
+        ret = -1;
+
+      // update statistics
       else
       {
-        // link the files/lib and create target
-        if((FlyMakeSystem(FMK_VERBOSE_SOME, &pState->opts, pCmdline->sz) != 0))
-          fWorked = FALSE;
-        if(!fWorked)
-          FlyMakePrintfEx(FMK_VERBOSE_SOME, "# failed to create %s\n\n", szTarget);
-        else
-          FlyMakePrintfEx(FMK_VERBOSE_SOME, "# created program %s\n\n", szTarget);
+        ++pState->nCompiled;
+        FmkCompileCachePut(pState, szOutFolder, szFileName, pCmdline->sz);
       }
+      FmkCompileRecord(pState, szOutFolder, hDb, szFileName, pCmdline->sz, (ret == 0) ? TRUE : FALSE);
     }
-
-    FlyStrSmartFree(pCmdline);
   }
 
-  FlyStrFreeIf(szTarget);
+  FlyMakeActionFree(pAction);
+  FlyMakeArenaReset(&pState->arena, mark);
 
-  return fWorked;
+  if(ret >= 0 && !fBuild)
+    ret = 1;
+
+  return ret;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Build the target using "tools" rules.
-
-  1. Look for basepairs in the tools folder to build
-    1a. If target is non NULL, then just build that one target (not all targets in folder)
-  2. Basepairs are file.c file.h. Will also build/link file2.c, fileme.c, etc...
-  3. Standalone targets are file.c with no file.h other files
-  4. Links with any libraries and/or dependency libraries (pState->szDepLibs)
-
-  @param  pState    state of flymake
-  @param  szFolder  folder containing target, e.g. src/ or ../myfolder/
-  @param  szTarget  a specific tool name or NULL if building all tools in folder
-  @return TRUE if worked, FALSE if failed
+  Wait for all queued compiles in the job pool to complete. Reports each file that failed and
+  updates statistics for each that compiled.
+
+  @param    pState        flymake state
+  @param    szOutFolder   e.g. "src/out/"
+  @param    hJobs         job pool filled by FmkCompileFile()
+  @param    hDb           build database for the out folder, or NULL
+  @return   # of files that failed to compile
 *///-----------------------------------------------------------------------------------------------
-static bool_t FlyMakeBuildTools(flyMakeState_t *pState, const char *szFolder, const char *szTarget)
+static unsigned FmkCompileJobsWait(flyMakeState_t *pState, const char *szOutFolder, void *hJobs, void *hDb)
 {
-  fmkToolList_t   *pToolList;
-  char           *szOutFolder     = NULL;
-  unsigned        size;
-  unsigned        i;
-  unsigned        nToolsCompiled  = 0;
-  int             ret             = 0;
-  bool_t          fFound;
-
-  // debugging
-  FlyMakeDbgPrintf(FMK_DEBUG_SOME, "FlyMakeBuildTools(szFolder %s, szTarget %s) fAll %u, fRebuild %u\n",
-                  FlyStrNullOk(szFolder), FlyStrNullOk(szTarget), pState->opts.fAll, pState->opts.fRebuild);
+  unsigned    nFailed;
+  unsigned    i;
+  bool_t      fWorked;
 
-  // get the list of tools and src files for those tools
-  // if the folder is invalid, then no tool list is created
-  pToolList = FlyMakeToolListNew(pState->pCompilerList, szFolder);
-  if(!pToolList)
-    ret = -1;
-  else
+  nFailed = FlyMakeJobsWait(hJobs);
+  for(i = 0; i < FlyMakeJobsLen(hJobs); ++i)
   {
-    if(pToolList->nTools == 0)
-      FlyMakePrintfEx(FMK_VERBOSE_SOME, "# folder '%s' contains no source files\n", szFolder);
+    fWorked = (FlyMakeJobsStatus(hJobs, i) == 0) ? TRUE : FALSE;
+    if(fWorked)
+    {
+      ++pState->nCompiled;
+      FmkCompileCachePut(pState, szOutFolder, FlyMakeJobsGetName(hJobs, i), FlyMakeJobsGetCmdline(hJobs, i));
+    }
     else
-      FmkBanner(FMK_VERBOSE_MORE, szTarget ? szTarget : szFolder, "Tool Rules");
-
-    if(FlyMakeDebug() >= FMK_DEBUG_MORE)
-      FlyMakeToolListPrint(pToolList);
+      FlyMakePrintf("# failed to compile %s\n", FlyMakeJobsGetName(hJobs, i));
+    FmkCompileRecord(pState, szOutFolder, hDb, FlyMakeJobsGetName(hJobs, i),
+                     FlyMakeJobsGetCmdline(hJobs, i), fWorked);
   }
 
-  // get a string for creating paths, can create both "folder/prog_file" or "folder/out/"
-  if(ret >= 0)
+  return nFailed;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Compile a folder full of files. Does not link, just creates {folder}/out/{config}/file(s).o
+
+  Used for both library and source rules (FMK_RULE_LIB, FMK_RULE_SRC), but not tools. See FmkTool
+
+  The # of files compiled is returned in pFilesCompiled (0-n). If all files are up to date, and no
+  option forces compile, then nothing is compiled.
+
+  Also returns 1st file extension, so caller can know which "compiler" to use to link this project,
+  and the exact list of objects, so only those are linked or archived.
+
+  Duties:
+
+  1. Makes a list of all source files,  file.c, file2.cpp, etc...
+  2. Only returns FALSE if a compile failed.
+  3. Returns TRUE even if there are no files to compile.
+  4. Only compiles if source file .c is newer than .o. unless option --all or -B was used
+  5. With -j, compiles up to pState->opts.jobs files at once
+  6. Remembers what was compiled in the build database, out/.flymake.db
+  7. Removes objects from out/ whose source files are gone
+
+  @param    pState            state of flymake (flags, etc...)
+  @param    szFolder          e.g. "", "src/" or "lib/"
+  @param    pFilesCompiled    return value, # of files compiled (0-n)
+  @param    szExt             optional return value if not NULL, the 1st file extension
+  @param    pObjs             optional return value if not NULL, e.g. "src/out/rel/a.o src/out/rel/b.o "
+  @return   TRUE if worked, FALSE if failed to compile a file
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkCompileFolder(flyMakeState_t *pState, const char *szFolder, unsigned *pFilesCompiled, char *szExt,
+                               flyStrSmart_t *pObjs)
+{
+  flyMakeArenaMark_t  mark;
+  void               *hSrcList        = NULL;
+  void               *hJobs           = NULL;
+  void               *hDb             = NULL;
+  char               *szOutFolder     = NULL;
+  char               *szObj;
+  const char        **aszSrc;
+  const char         *szFileName;
+  unsigned            nFilesCompiled  = 0;
+  unsigned            nFailed;
+  unsigned            i;
+  int                 ret;
+  bool_t              fWorked         = TRUE;
+
+  // default to no file extension returned
+  if(szExt)
+    *szExt = '\0';
+
+  if(FlyMakeDebug())
+    FlyMakePrintf("FmkCompileFolder(%s)\n", szFolder);
+
+  // temporaries for this folder are released all at once at the end
+  mark = FlyMakeArenaMark(&pState->arena);
+
+  hSrcList = FlyMakeScanSrcList(pState, szFolder, FlyMakeStateDepth(pState));
+  if(hSrcList && FlyMakeSrcListLen(hSrcList) > 0)
   {
-    size = strlen(m_szOutFolder);
-    if(szTarget && strlen(szTarget) > size)
-      size = strlen(szTarget);
-    size += strlen(szFolder) + 3;
-    szOutFolder = FlyAlloc(size);
+    // make out/ folder for this configuration, e.g. "src/out/rel/" (OK if already exists)
+    FlyAssert(*szFolder == '\0' || FlyStrPathIsFolder(szFolder));
+    szOutFolder = FmkOutFolderCreate(pState, szFolder);
     if(!szOutFolder)
-      ret = -1;
+      fWorked = FALSE;
   }
 
-  // indicate bad target program if not found in tool list
-  if(ret >= 0 && szTarget)
+  if(fWorked && hSrcList && FlyMakeSrcListLen(hSrcList) > 0)
   {
-    fFound = FALSE;
-    for(i = 0; i < pToolList->nTools; ++i)
+    // return first file extension (so link can use proper link options)
+    szFileName = FlyMakeSrcListGetName(hSrcList, 0);
+    if(szExt)
+      FlyStrZCpy(szExt, FlyStrPathExt(szFileName), FMK_SZ_EXT_MAX);
+
+    // compile files in parallel if -j
+    if(pState->opts.jobs > 1)
+      hJobs = FlyMakeJobsNew(&pState->opts);
+    hDb = FlyMakeDbOpen(pState, szOutFolder);
+
+    nFilesCompiled = 0;
+    for(i = 0; i < FlyMakeSrcListLen(hSrcList); ++i)
     {
-      if(strcmp(szTarget, pToolList->apTools[i]->szName) == 0)
+      szFileName = FlyMakeSrcListGetName(hSrcList, i);
+      ret = FmkCompileFile(pState, szOutFolder, szFileName, hJobs, hDb, 0);
+      if(ret < 0)
+        fWorked = FALSE;
+      if(ret == 0)
+        ++nFilesCompiled;
+
+      // e.g. "src/out/rel/file.o "
+      if(pObjs)
       {
-        fFound = TRUE;
-        break;
+        szObj = FmkGetOutName(&pState->arena, szOutFolder, szFileName);
+        if(!szObj)
+        {
+          FlyMakeErrMem();
+          fWorked = FALSE;
+        }
+        else
+        {
+          FlyStrSmartCat(pObjs, szObj);
+          FlyStrSmartCat(pObjs, " ");
+        }
       }
     }
-    if(!fFound)
+
+    // each queued file counted above, less those that failed
+    if(hJobs)
     {
-      FlyAssert(size && szOutFolder && szTarget);
-      FlyStrZCpy(szOutFolder, szFolder, size);
-      FlyStrPathAppend(szOutFolder, szTarget, size);
-      FlyMakePrintErr(FMK_ERR_BAD_PROG, szOutFolder);
-      ret = -1;
+      nFailed = FmkCompileJobsWait(pState, szOutFolder, hJobs, hDb);
+      if(nFailed)
+        fWorked = FALSE;
+      nFilesCompiled = FlyMakeJobsLen(hJobs) - nFailed;
+      hJobs = FlyMakeJobsFree(hJobs);
     }
-  }
-
-  // make out folder, e.g. "tools/out/", if needed
-  if(ret >= 0 && pToolList->nTools)
-  {
-    FlyAssert(szFolder);
-    FlyStrZCpy(szOutFolder, szFolder, size);
-    FlyStrPathAppend(szOutFolder, m_szOutFolder, size);
-    if(!FlyMakeFolderCreate(&pState->opts, szOutFolder))
-      ret = -1;
-  }
 
-  if(ret >= 0 && pToolList->nTools)
-  {
-    for(i = 0; i < pToolList->nTools; ++i)
+    // remove objects of deleted or renamed source files
+    aszSrc = FlyMakeArenaAlloc(&pState->arena, sizeof(char *) * FlyMakeSrcListLen(hSrcList));
+    if(aszSrc)
     {
-      if(szTarget == NULL || strcmp(szTarget, pToolList->apTools[i]->szName) == 0)
-      {
-        ret = FmkToolCompile(pState, szOutFolder, pToolList->apTools[i]);
-        if(ret < 0)
-          break;
-        if(ret == 0)
-          ++nToolsCompiled;
-      }
+      for(i = 0; i < FlyMakeSrcListLen(hSrcList); ++i)
+        aszSrc[i] = FlyMakeSrcListGetName(hSrcList, i);
+      FmkOutFolderPrune(pState, szOutFolder, hDb, aszSrc, FlyMakeSrcListLen(hSrcList));
     }
 
-    // if no tools needed compiling, then folder was up to date
-    if(ret >= 0 && pToolList->nTools && !nToolsCompiled)
+    hDb = FlyMakeDbClose(pState, hDb);
+    if(fWorked && !nFilesCompiled)
       FlyMakePrintfEx(FMK_VERBOSE_MORE, "# %s folder up to date\n", szFolder);
   }
 
-  // cleanup
-  if(szOutFolder)
-    FlyFree(szOutFolder);
-  if(pToolList)
-    FlyMakeToolListFree(pToolList);
+  FlyFreeIf(szOutFolder);
+  FlyMakeArenaReset(&pState->arena, mark);
 
-  return ret >= 0 ? TRUE : FALSE;
+  *pFilesCompiled = nFilesCompiled;
+
+  return fWorked;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Free a single dependency. Does not remove from any list.
+  Link a single tool from its already compiled objects. Only links if any objects were compiled,
+  the tool doesn't exist, it was linked with a different command-line (e.g. -D) or -B was used.
 
-  @param    pDep
-  @return   NULL
+  @param    pState        state of flymake
+  @param    szOutFolder   e.g. "test/out/rel/"
+  @param    pTool         list of .c files, and target link name
+  @param    nCompiled     # of source files compiled for this tool
+  @return   -1 if failed, 0 if worked, 1 if no need to link
 *///-----------------------------------------------------------------------------------------------
-static void * FmkDepFree(flyMakeDep_t *pDep)
+static int FmkToolLink(flyMakeState_t *pState, const char *szOutFolder, const fmkTool_t *pTool, unsigned nCompiled)
 {
-  FlyStrFreeIf(pDep->szName);
-  FlyStrFreeIf(pDep->szVer);
-  FlyStrFreeIf(pDep->szRange);
-  FlyStrSmartUnInit(&pDep->libs);
-  FlyStrFreeIf(pDep->szIncFolder);
-  if(pDep->pState)
-    FlyMakeStateFree(pDep->pState);
+  const flyMakeCompiler_t  *pCompiler;
+  flyMakeArenaMark_t  mark;
+  char               *szObj         = NULL; // single obj
+  char               *szFolder      = NULL; // folder of tool, e.g. "test/"
+  flyStrSmart_t      *pInObjs       = NULL; // list of input objs for linking
+  flyStrSmart_t      *pToolOut      = NULL;
+  flyStrSmart_t      *pCmdline      = NULL;
+  char               *szDebug;
+  unsigned            i;
+  int                 ret           = 0;
+  bool_t              fWorked       = TRUE;
 
-  memset(pDep, 0, sizeof(*pDep));
-  FlyFree(pDep);
-  return NULL;
-}
+  // assume link will use linker of the 1st source file
+  if(fWorked)
+  {
+    pCompiler  = FlyMakeCompilerFind(pState->pCompilerList, FlyStrPathExt(pTool->aszSrcFiles[0]));
+    FlyAssert(pCompiler);
+  }
 
-/*-------------------------------------------------------------------------------------------------
-  Free the entire dependency state chain. Does not delete any files, just frees memory.
+  // create a place to hold list of objs for this tool
+  if(fWorked)
+  {
+    pInObjs = FlyStrSmartAlloc(PATH_MAX);
+    if(!pInObjs)
+    {
+      FlyMakeErrMem();
+      fWorked = FALSE;
+    }
+  }
 
-  @param    pDepList    dependency list
-  @return   none
-*///-----------------------------------------------------------------------------------------------
-void FlyMakeDepListFree(flyMakeDep_t *pDepList)
-{
-  flyMakeDep_t  *pDep;
-  flyMakeDep_t  *pDepNext;
+  // create list of input objs for linking, e.g. "out/rel/tool.o out/rel/tool2.o "
+  if(fWorked)
+  {
+    mark = FlyMakeArenaMark(&pState->arena);
+    for(i = 0; i < pTool->nSrcFiles; ++i)
+    {
+      szObj = FmkGetOutName(&pState->arena, szOutFolder, pTool->aszSrcFiles[i]);
+      if(!szObj)
+      {
+        FlyMakeErrMem();
+        fWorked = FALSE;
+        break;
+      }
+      FlyStrSmartCat(pInObjs, szObj);
+      FlyStrSmartCat(pInObjs, " ");
+    }
+    FlyMakeArenaReset(&pState->arena, mark);
+  }
 
-  pDep = pDepList;
-  while(pDep)
+  // create output name for tool, e.g. "test/test_foo"
+  if(fWorked)
   {
-    pDepNext = pDep->pNext;
-    if(pDep->pState)
-      FlyMakeStateFree(pDep->pState);
-    FmkDepFree(pDep);
-    pDep = pDepNext;
+    szFolder = FlyStrClone(pTool->aszSrcFiles[0]);
+    pToolOut = FlyStrSmartAlloc(strlen(pTool->aszSrcFiles[0]) + strlen(pTool->szName) + 1);
+    if(!pToolOut || !szFolder)
+    {
+      FlyMakeErrMem();
+      fWorked = FALSE;
+    }
+    else
+    {
+      FlyStrPathOnly(szFolder);
+      FlyStrSmartCpy(pToolOut, szFolder);
+      FlyStrSmartCat(pToolOut, pTool->szName);
+      if(!FlyFileExistsFile(pToolOut->sz))
+      {
+        ++nCompiled;
+        ++pState->nCompiled;
+      }
+    }
   }
-}
 
-/*-------------------------------------------------------------------------------------------------
-  Allocate a version. If the TOML string is NULL, then use "*" for version.
+  // convert from {markers} into the command-line for link
+  if(fWorked)
+  {
+    pCmdline = FlyStrSmartAlloc(PATH_MAX);
+    szDebug = pState->opts.dbg ? pCompiler->szLlDbg : "";
+    if(!pCmdline || !FlyMakeCompilerFmtLink(pCmdline, pCompiler, pInObjs->sz, pState->libs.sz,
+                                             szDebug, pToolOut->sz))
+    {
+      FlyMakeErrMem();
+      fWorked = FALSE;
+    }
+  }
 
-  @param    szTomlStr   ptr to a TOML string, e.g. "1.2.3", or NULL
-  @return   none
-*///-----------------------------------------------------------------------------------------------
-static char * FmkTomlVerAlloc(const char *szTomlStr)
-{
-  char     *szVersion;
+  // linked last time with other objects or options, e.g. release, now debug
+  if(fWorked && !nCompiled && FmkLinkSig(pState, szFolder, pToolOut->sz, pCmdline->sz, NULL, FALSE))
+    ++nCompiled;
 
-  szVersion = szTomlStr ? FlyMakeTomlStrAlloc(szTomlStr) : FlyStrClone("*");
+  // if we need to link the tool, do it
+  if(fWorked && (nCompiled || pState->opts.fRebuild))
+  {
+    ret = FlyMakeSystem(FMK_VERBOSE_SOME, &pState->opts, pCmdline->sz);
+    if(ret != 0)
+      FlyMakePrintf("# failed to create %s\n\n", pTool->szName);
+    else
+    {
+      FmkLinkSig(pState, szFolder, pToolOut->sz, pCmdline->sz, NULL, TRUE);
+      FlyMakePrintf("# created program %s\n\n", pTool->szName);
+    }
+  }
 
-  return szVersion;
-}
+  // everything was already up to date (nothing to compile or link)
+  else if(fWorked && nCompiled == 0 && !pState->opts.fRebuild)
+    ret = 1;
 
-/*-------------------------------------------------------------------------------------------------
-  Peek at a character in the TOML string.
+  // cleanup
+  FlyStrSmartFree(pCmdline);
+  FlyStrSmartFree(pToolOut);
+  FlyStrSmartFree(pInObjs);
+  FlyFreeIf(szFolder);
 
-  @param  szTomlStr   a TOML string
-  @param  i           index into character
-  @return 1st char of TOML string or '\0' if not a TOML string
-*///-----------------------------------------------------------------------------------------------
-static char FmkTomlPeek(const char *szTomlStr)
-{
-  char  c = 0;
-  if(*szTomlStr == '"' || *szTomlStr == '\'')
-    c = szTomlStr[1];
-  return c;
+  // some kind of problem (e.g. system didn't compile or memory issue)
+  if(!fWorked)
+    ret = -1;
+
+  return ret;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Create a TOML path from the root path and the TOML path string
+  Compile a single tool from a set of one or more source files
 
-  @param  szRoot        root folder, e.g. "", "../" or "/Users/me/work/git/my_project/"
-  @param  szTomlPath    TOML string for path or file, e.g. "../my_package"
-  @return ptr to a string containing the combined path
+  @param    pState        state of flymake
+  @param    szOutFolder   e.g. "test/out/"
+  @param    pTool         list of .c files, and target link name
+  @param    hDb           build database for the out folder, or NULL
+  @return   -1 if failed, 0 if worked, 1 if no need to compile or link
 *///-----------------------------------------------------------------------------------------------
-static char * FmkTomlPath(const char *szRoot, const char *szTomlPath)
+static int FmkToolCompile(flyMakeState_t *pState, const char *szOutFolder, const fmkTool_t *pTool, void *hDb)
 {
-  char       *pszPath;
-  unsigned    size = 0;
-  unsigned    len;
-  bool_t      fRelativePath = FALSE;
+  unsigned            i;
+  unsigned            nCompiled     = 0;
+  int                 ret           = 0;
 
-  if(!(isslash(FmkTomlPeek(szTomlPath)) || (FmkTomlPeek(szTomlPath) == '~')))
+  // compile each source file in this tool
+  for(i = 0; i < pTool->nSrcFiles; ++i)
   {
-    fRelativePath = TRUE;
-    size = strlen(szRoot);
-  }
-  size += FlyTomlStrLen(szTomlPath) + 1;
+    ret = FmkCompileFile(pState, szOutFolder, pTool->aszSrcFiles[i], NULL, hDb, 0);
 
-  pszPath = FlyAlloc(size);
-  if(pszPath)
-  {
-    len = 0;
-    if(fRelativePath)
-    {
-      strcpy(pszPath, szRoot);
-      len = strlen(szRoot);
-    }
-    FlyTomlStrCpy(&pszPath[len], szTomlPath, size - len);
+    // didn't work, e.g. source file didn't compile due to source code errors
+    if(ret < 0)
+      break;
+
+    // ret of 1 means it didn't compile because source file is not newer than obj file
+    // so only ret == 0 (worked and compiled) means this source file compiled
+    if(ret == 0)
+      ++nCompiled;
   }
 
-  return pszPath;
+  if(ret >= 0)
+    ret = FmkToolLink(pState, szOutFolder, pTool, nCompiled);
+
+  return ret;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Allocate a new dependency. Does NOT add the dependency to any list.
-
-  Essentially initializes to 0 and fills in name and version range (pDep->szRange). No other
-  fields are filled in.
-
-  If szRange is NULL, use default version range "*" (any).
-
-  @param    szName    ptr to name of dependency package
-  @param    szRange   NULL or ptr to TOML version string, e.g. "1.2.3"
-  @return   ptr to flyMakeDep_t or NULL
+  Compile all the tools in the tool list at once in the job pool (-j), then link each tool.
+
+  If any file fails to compile, no tools are linked.
+
+  @param    pState          state of flymake
+  @param    szOutFolder     e.g. "test/out/"
+  @param    pToolList       list of tools in folder
+  @param    szTarget        a specific tool name or NULL if building all tools in folder
+  @param    hJobs           job pool from FlyMakeJobsNew()
+  @param    hDb             build database for the out folder, or NULL
+  @param    pToolsCompiled  return value, # of tools compiled/linked
+  @return   -1 if failed, 0 if worked
 *///-----------------------------------------------------------------------------------------------
-static flyMakeDep_t * FmkDepNew(const char *szName, const char *szRange)
+static int FmkToolListCompileJobs(flyMakeState_t *pState, const char *szOutFolder,
+                                  const fmkToolList_t *pToolList, const char *szTarget,
+                                  void *hJobs, void *hDb, unsigned *pToolsCompiled)
 {
-  flyMakeDep_t *pDep;
+  const fmkTool_t    *pTool;
+  unsigned           *anCompiled;   // # of files compiled per tool
+  unsigned            nJobs;
+  unsigned            i;
+  unsigned            j;
+  int                 ret           = 0;
+  int                 retFile;
 
-  pDep = FlyAlloc(sizeof(*pDep));
-  if(pDep)
+  anCompiled = FlyAllocZ(sizeof(*anCompiled) * pToolList->nTools);
+  if(!anCompiled)
   {
-    // initialize dependecy
-    memset(pDep, 0, sizeof(*pDep));
-
-    // allocate version range string
-    if(szRange == NULL)
-      pDep->szRange = FlyStrClone("*");
-    else
-      pDep->szRange = FlyMakeTomlStrAlloc(szRange);
-
-    // allocate name string 
-    pDep->szName = FlyStrClone(szName);
-
-    if(!pDep->szName || !pDep->szRange)
-      pDep = FmkDepFree(pDep);
+    FlyMakeErrMem();
+    ret = -1;
   }
 
-  return pDep;
-}
+  // queue every source file of every tool that needs compiling
+  for(i = 0; ret >= 0 && i < pToolList->nTools; ++i)
+  {
+    pTool = pToolList->apTools[i];
+    if(szTarget == NULL || strcmp(szTarget, pTool->szName) == 0)
+    {
+      for(j = 0; j < pTool->nSrcFiles; ++j)
+      {
+        nJobs = FlyMakeJobsLen(hJobs);
+        retFile = FmkCompileFile(pState, szOutFolder, pTool->aszSrcFiles[j], hJobs, hDb, i);
+        if(retFile < 0)
+          ret = -1;
 
-/*-------------------------------------------------------------------------------------------------
-  Find the dependency by name in a list, case sensitive.
+        // from the object cache, so compiled without a job
+        else if(retFile == 0 && FlyMakeJobsLen(hJobs) == nJobs)
+          ++anCompiled[i];
+      }
+    }
+  }
 
-  @param  pDepList    a list of dependencies
-  @param  szName      the name to find
-  @return ptr to dependency if found, NULL if not found
-*///-----------------------------------------------------------------------------------------------
-static flyMakeDep_t * FmkDepFind(const flyMakeDep_t *pDepList, const char *szName)
-{
-  const flyMakeDep_t   *pDep;
+  // tally compiled files per tool
+  if(FmkCompileJobsWait(pState, szOutFolder, hJobs, hDb))
+    ret = -1;
+  for(i = 0; ret >= 0 && i < FlyMakeJobsLen(hJobs); ++i)
+    ++anCompiled[FlyMakeJobsGetTag(hJobs, i)];
 
-  pDep = pDepList;
-  while(pDep)
+  // link each tool
+  for(i = 0; ret >= 0 && i < pToolList->nTools; ++i)
   {
-    if(strcmp(szName, pDep->szName) == 0)
-      break;
-    pDep = pDep->pNext;
+    pTool = pToolList->apTools[i];
+    if(szTarget == NULL || strcmp(szTarget, pTool->szName) == 0)
+    {
+      ret = FmkToolLink(pState, szOutFolder, pTool, anCompiled[i]);
+      if(ret == 0)
+        ++(*pToolsCompiled);
+    }
   }
+  if(ret > 0)
+    ret = 0;
 
-  return (flyMakeDep_t *)pDep;
+  FlyFreeIf(anCompiled);
+
+  return ret;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Find the dependency by TOML key in the dependency list
+  Build lib/ or any folder under lib rules. Folder must exist and have at least 1 source file.
 
-  @param  pDepList    a list of dependencies
-  @param  szTomlKey   ptr to a TOML key that may be a dependency
-  @return ptr to dependency if found, NULL if not found
+  1. Compile each file with `-I. -I../inc -Wall -Werror lib/file.c -o lib/out/rel/file.o`
+  2. Create library using `ar -crs libname.a lib/out/rel/file.o ...`, with only the objects of the
+     current source files, so objects from deleted or renamed files are never archived
+  3. Or, if the library already exists for this configuration, update just the changed members
+     with `ar -rs` and delete the removed ones with `ar -ds`
+
+  The objects in the library are remembered in a list file, e.g. lib/out/rel/libname.lst.
+
+  @param  pState    state of flymake
+  @param  szFolder  folder to build under lib/ rules, e.g. lib/ or ../myfolder/
+  @return TRUE if worked, FALSE if failed
 *///-----------------------------------------------------------------------------------------------
-static flyMakeDep_t * FmkDepTomlFind(const flyMakeDep_t *pDepList, const char *szTomlKey)
+bool_t FlyMakeBuildLib(flyMakeState_t *pState, const char *szFolder)
 {
-  const flyMakeDep_t   *pDep  = NULL;
-  char                 *szName;
-  unsigned              size;
-
-  size = FlyTomlKeyLen(szTomlKey) + 1;
-  szName = FlyAllocZ(size);
-  if(szName)
-  {
-    FlyTomlKeyCpy(szName, szTomlKey, size);
-    pDep = FmkDepFind(pDepList, szName);
-    FlyFree(szName);
-  }
+  flyMakeArenaMark_t  mark;
+  char               *pszLibName      = NULL;
+  char               *szOutFolder     = NULL;
+  char               *szLstFile       = NULL;
+  char               *szPrevObjs      = NULL;
+  flyStrSmart_t      *pSig            = NULL;
+  flyStrSmart_t      *pObjs           = NULL;
+  unsigned            nFilesCompiled  = 0;
+  bool_t              fFull           = FALSE;
+  bool_t              fUpdated        = FALSE;
+  bool_t              fWorked;
 
-  return (flyMakeDep_t *)pDep;
-}
+  // compile any files in the folder than need compiling
+  if(FlyMakeDebug() >= FMK_DEBUG_MORE)
+    FmkBanner(FMK_VERBOSE_NONE, szFolder, "Lib Rules");
+  if(FlyMakeDebug())
+    FlyMakePrintf("FlyMakeBuildLib(fAll %u, fRebuild %u, %s)\n", pState->opts.fAll, pState->opts.fRebuild, szFolder);
 
-/*-------------------------------------------------------------------------------------------------
-  Adds include folder and library file to appropriate states.
+  // must have 2 replacement strings for libname and objs
+  FlyAssert(FlyStrCount(g_szFmtArchive, "%s") == 2);
+  FlyAssert(FlyStrCount(g_szFmtArchiveAdd, "%s") == 2);
+  FlyAssert(FlyStrCount(g_szFmtArchiveDel, "%s") == 2);
 
-  1. If not NULL, adds the inc folder to the state who's flymake.toml file is being processed.
-  2. If not NULL, adds the library file to the root folder.
+  // compile the files in the lib folder
+  mark  = FlyMakeArenaMark(&pState->arena);
+  pObjs = FlyStrSmartAlloc(PATH_MAX);
+  if(!pObjs)
+  {
+    FlyMakeErrMem();
+    fWorked = FALSE;
+  }
+  else
+    fWorked = FmkCompileFolder(pState, szFolder, &nFilesCompiled, NULL, pObjs);
 
-  @param  pDepKeys      contains both root and state which is processing flymake.toml
-  @param  szIncFolder   include folder string, e.g. "../packages/foo/inc/" or NULL
-  @param  szLibFile     library file string, e.g. "../packages/foo/lib/foo.a" or NULL
-  @return none
-*///-----------------------------------------------------------------------------------------------
-static void FmkDepAddIncLibs(fmkDepKeys_t *pDepKeys, const char *szIncFolder, flyStrSmart_t *pLibs)
-{
-  // add dependency inc folder (.e.g. dep/foo/inc/) to root state so it can compile properly
-  // no need to add current folder -I. as that's already added to every project
-  if(szIncFolder)
+  // signature is the archive command for this configuration, e.g. "ar -crs lib/foo.a lib/out/rel/"
+  if(fWorked)
   {
-    FlyStrSmartCat(&pDepKeys->pState->incs, szIncFolder);
-    FlyStrSmartCat(&pDepKeys->pState->incs, " ");
+    pszLibName  = FlyMakeFolderAllocLibName(pState, szFolder);
+    szOutFolder = FmkOutFolderAlloc(pState, szFolder, TRUE);
+    if(pszLibName && szOutFolder)
+    {
+      szLstFile = FmkGetOutNameExt(&pState->arena, szOutFolder, pszLibName, m_szLstExt);
+      pSig = FlyStrSmartNewEx("", strlen(g_szFmtArchive) + strlen(pszLibName) + strlen(szOutFolder));
+    }
+    if(!pszLibName || !szOutFolder || !szLstFile || !pSig)
+    {
+      FlyMakeErrMem();
+      fWorked = FALSE;
+    }
+    else
+      FlyStrSmartSprintf(pSig, g_szFmtArchive, pszLibName, szOutFolder);
   }
 
-  // add library to root state
-  if(pLibs)
+  // archive from scratch if missing or archived last time from another configuration, e.g.
+  // release, now debug. Otherwise, update only if the objects changed since last time.
+  if(fWorked)
   {
-    FlyStrSmartCat(&pDepKeys->pRootState->libs, pLibs->sz);
-    FlyStrSmartCat(&pDepKeys->pRootState->libs, " ");
+    if(!pState->opts.fRebuild && FlyFileExistsFile(pszLibName) &&
+       !FmkLinkSig(pState, szFolder, pszLibName, pSig->sz, NULL, FALSE))
+      szPrevObjs = FlyFileRead(szLstFile);
+    if(!szPrevObjs)
+      fFull = TRUE;
+    else if(nFilesCompiled || strcmp(szPrevObjs, pObjs->sz) != 0)
+      fUpdated = TRUE;
   }
-}
 
-/*-------------------------------------------------------------------------------------------------
-  Returns # of dependencies in this TOML file
+  // if the archive step fails, the list file is gone, so the next build archives from scratch
+  if(fWorked && (fFull || fUpdated))
+  {
+    if(!pState->opts.fNoBuild)
+      remove(szLstFile);
 
-  @param  szTomlFile    flymake.toml, loaded into memory
-  @return 0-n, number of dependencies
-*///-----------------------------------------------------------------------------------------------
-static unsigned FmkDepNumDependencies(const char *szTomlFile)
-{
-  const char   *psz;
-  tomlKey_t     key;
-  unsigned      nDeps = 0;
+    // e.g. "ar -crs projname.a lib/out/rel/foo.o lib/out/rel/bar.o "
+    // e.g. "ar -crs ../somefolder.a @../somefolder/out/rel/somefolder.rsp"
+    // start from an empty archive, as "ar -crs" would keep members of removed objects
+    if(fFull)
+    {
+      if(!pState->opts.fNoBuild)
+        remove(pszLibName);
+      fWorked = FmkArchive(pState, g_szFmtArchive, szOutFolder, pszLibName, pObjs->sz);
+    }
+    else
+      fWorked = FmkLibUpdate(pState, szOutFolder, pszLibName, pObjs->sz, szPrevObjs, &fUpdated);
 
-  if(szTomlFile)
-  {
-    psz = FlyTomlTableFind(szTomlFile, m_szDepTable);
-    while(psz)
+    if(!fWorked)
+      FlyMakePrintfEx(FMK_VERBOSE_SOME, "# failed to create %s\n\n", pszLibName);
+    else
     {
-      psz = FlyTomlKeyIter(psz, &key);
-      if(psz)
-        ++nDeps;
+      if(!pState->opts.fNoBuild && !FlyFileWrite(szLstFile, pObjs->sz))
+        FlyMakePrintErr(FMK_ERR_WRITE, szLstFile);
+      FmkLinkSig(pState, szFolder, pszLibName, pSig->sz, NULL, TRUE);
+      if(fFull || fUpdated)
+      {
+        pState->fLibCompiled = TRUE;
+        FlyMakePrintfEx(FMK_VERBOSE_SOME, "# %s library %s\n\n", fFull ? "created" : "updated", pszLibName);
+      }
     }
   }
 
-  return nDeps;
+  FlyStrSmartFree(pSig);
+  FlyStrSmartFree(pObjs);
+  FlyFreeIf(szPrevObjs);
+  FlyMakeArenaReset(&pState->arena, mark);
+  FlyFreeIf(pszLibName);
+  FlyFreeIf(szOutFolder);
+
+  return fWorked;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Checks version of depenency vs desired version range. If dep not found, always passes
+  Build src/ folder or any folder under src rules
 
-  @param  pDepKeys    Information needed to process dependency
-  @param  szDepName   name of dependency, e.g. "foo"
-  @param  szRange     Version range, e.g. "1.2", which means >= 1.2.0 and <= 2.0.0
-  @param  ppDep       Returned dependency or NULL if not found
-  @return FMK_ERR_NONE or FMK_ERR_CUSTOM
+  1. Compile each file with `-I. -Iinc/ -Wall -Werror` or user set cmdline
+  2. Optional `-DDEBUG=1`
+  3. link with static library, e.g. lib/projname.a and any dependency libraries
+
+  @param  pState    state of flymake
+  @param  szFolder  folder to build under src/ rules
+  @return TRUE if worked, FALSE if failed
 *///-----------------------------------------------------------------------------------------------
-static fmkErr_t FmkDepVersionValidate(
-  fmkDepKeys_t *pDepKeys,
-  const char *szDepName,
-  const char *szRange,
-  flyMakeDep_t **ppDep)
+static bool_t FlyMakeBuildSrc(flyMakeState_t *pState, const char *szFolder)
 {
-  flyMakeDep_t   *pDep = NULL;
-  fmkErr_t        err = FMK_ERR_NONE;
+  const flyMakeCompiler_t *pCompiler;
+  char           *szTarget        = NULL;
+  char           *szOutFolder     = NULL;
+  flyStrSmart_t  *pCmdline        = NULL;
+  flyStrSmart_t  *pInFiles        = NULL;
+  flyStrSmart_t  *pObjs           = NULL;
+  char           *szDebug;
+  char            szExt[FMK_SZ_EXT_MAX];
+  unsigned        nFilesCompiled  = 0;
+  bool_t          fWorked;
 
-  // check that version of package doesn't conflict with specified version range
-  pDep = FmkDepFind(pDepKeys->pRootState->pDepList, szDepName);
-  if(pDep && !FlySemVerMatch(szRange, pDep->szVer))
+  if(FlyMakeDebug() >= FMK_DEBUG_MORE)
+    FmkBanner(FMK_VERBOSE_NONE, szFolder, "Src Rules");
+  if(FlyMakeDebug())
+    FlyMakePrintf("FlyMakeBuildSrc(fAll %u, fRebuild %u, %s)\n", pState->opts.fAll, pState->opts.fRebuild, szFolder);
+
+  // compile the folder
+  pObjs     = FlyStrSmartAlloc(PATH_MAX);
+  pInFiles  = FlyStrSmartAlloc(PATH_MAX);
+  if(!pObjs || !pInFiles)
   {
-    err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keyInc.szValue, "version conflict");
-    FlyMakePrintf("  Previous version %s\n", pDep->szVer);
+    FlyMakeErrMem();
+    fWorked = FALSE;
   }
-  *ppDep = pDep;
-
-  return err;
-}
-
-/*-------------------------------------------------------------------------------------------------
-  Creates a valid flyMakeState_t upon success. Fails if folder does not point to a valid package.
-
-  Also returns the newly created state so that package can be built with flymake.
-
-  Tasks:
-
-  1. Determines root of project, inc/ and lib/ folders
-  2. Reads flymake.toml and determines version based on that
-  3. Sets build option to --rl (library rules)
+  else
+    fWorked = FmkCompileFolder(pState, szFolder, &nFilesCompiled, szExt, pObjs);
+  if(pState->fLibCompiled)
+    ++nFilesCompiled;
 
-  Possible errors:
+  // get target name, e.g. "src/foo"
+  // note: szExt is empty if no source code in folder
+  if(fWorked && *szExt)
+  {
+    szTarget = FlyMakeFolderAllocSrcName(pState, szFolder);
+    szOutFolder = FmkOutFolderAlloc(pState, szFolder, TRUE);
+    if(!szTarget || !szOutFolder)
+    {
+      FlyMakeErrMem();
+      fWorked = FALSE;
+    }
+    else if(!FlyFileExistsFile(szTarget))
+    {
+      ++nFilesCompiled;
+      ++pState->nCompiled;
+    }
+  }
+
+  // create link command-line from {markers}
+  // e.g. cc src/out/dbg1/foo.o src/out/dbg1/bar.o lib/projname.a -DDEBUG=1 -o src/projname
+  if(fWorked && *szExt)
+  {
+    // get the compiler cmdline for this source file
+    pCompiler = FlyMakeCompilerFind(pState->pCompilerList, szExt);
+    FlyAssert(pCompiler && pCompiler->szLl);
+
+    // e.g. "src/out/rel/foo.o src/out/rel/bar.o " or "@src/out/rel/foo.rsp"
+    if(!FmkObjsIn(pState, szOutFolder, szTarget, pObjs->sz, pInFiles))
+      fWorked = FALSE;
+    else
+    {
+      pCmdline  = FlyStrSmartAlloc(strlen(pCompiler->szLl) + strlen(pInFiles->sz) + strlen(pState->libs.sz) +
+                                   strlen(pCompiler->szLlDbg) + strlen(szTarget) + 1);
+      if(!pCmdline)
+      {
+        FlyMakeErrMem();
+        fWorked = FALSE;
+      }
+    }
+    if(fWorked)
+    {
+      szDebug = pState->opts.dbg ? pCompiler->szLlDbg : "";
+      if(!FlyMakeCompilerFmtLink(pCmdline, pCompiler, pInFiles->sz, pState->libs.sz, szDebug, szTarget))
+      {
+        FlyMakeErrMem();
+        fWorked = FALSE;
+      }
+    }
+  }
+
+  // linked last time from another configuration or set of objects, e.g. release, now debug
+  if(fWorked && *szExt && !nFilesCompiled && FmkLinkSig(pState, szFolder, szTarget, pCmdline->sz, pObjs->sz, FALSE))
+  {
+    ++nFilesCompiled;
+    ++pState->nCompiled;
+  }
+
+  // no need to link if no new obj files
+  if(fWorked && *szExt && (nFilesCompiled || pState->opts.fRebuild))
+  {
+    // link the files/lib and create target
+    if((FlyMakeSystem(FMK_VERBOSE_SOME, &pState->opts, pCmdline->sz) != 0))
+      fWorked = FALSE;
+    if(!fWorked)
+      FlyMakePrintfEx(FMK_VERBOSE_SOME, "# failed to create %s\n\n", szTarget);
+    else
+    {
+      FmkLinkSig(pState, szFolder, szTarget, pCmdline->sz, pObjs->sz, TRUE);
+      FlyMakePrintfEx(FMK_VERBOSE_SOME, "# created program %s\n\n", szTarget);
+    }
+  }
+
+  FlyStrSmartFree(pCmdline);
+  FlyStrSmartFree(pInFiles);
+  FlyStrSmartFree(pObjs);
+  FlyStrFreeIf(szTarget);
+  FlyFreeIf(szOutFolder);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Build the target using "tools" rules.
+
+  1. Look for basepairs in the tools folder to build
+    1a. If target is non NULL, then just build that one target (not all targets in folder)
+  2. Basepairs are file.c file.h. Will also build/link file2.c, fileme.c, etc...
+  3. Standalone targets are file.c with no file.h other files
+  4. Links with any libraries and/or dependency libraries (pState->szDepLibs)
+
+  @param  pState    state of flymake
+  @param  szFolder  folder containing target, e.g. src/ or ../myfolder/
+  @param  szTarget  a specific tool name or NULL if building all tools in folder
+  @return TRUE if worked, FALSE if failed
+*///-----------------------------------------------------------------------------------------------
+static bool_t FlyMakeBuildTools(flyMakeState_t *pState, const char *szFolder, const char *szTarget)
+{
+  fmkToolList_t   *pToolList;
+  void           *hJobs           = NULL;
+  void           *hDb             = NULL;
+  char           *szOutFolder     = NULL;
+  const char    **aszSrc;
+  unsigned        nSrc;
+  unsigned        size;
+  unsigned        i;
+  unsigned        nToolsCompiled  = 0;
+  int             ret             = 0;
+  bool_t          fFound;
+
+  // debugging
+  FlyMakeDbgPrintf(FMK_DEBUG_SOME, "FlyMakeBuildTools(szFolder %s, szTarget %s) fAll %u, fRebuild %u\n",
+                  FlyStrNullOk(szFolder), FlyStrNullOk(szTarget), pState->opts.fAll, pState->opts.fRebuild);
+
+  // get the list of tools and src files for those tools
+  // if the folder is invalid, then no tool list is created
+  pToolList = FlyMakeScanToolList(pState, szFolder);
+  if(!pToolList)
+    ret = -1;
+  else
+  {
+    if(pToolList->nTools == 0)
+      FlyMakePrintfEx(FMK_VERBOSE_SOME, "# folder '%s' contains no source files\n", szFolder);
+    else
+      FmkBanner(FMK_VERBOSE_MORE, szTarget ? szTarget : szFolder, "Tool Rules");
+
+    if(FlyMakeDebug() >= FMK_DEBUG_MORE)
+      FlyMakeToolListPrint(pToolList);
+  }
+
+  // indicate bad target program if not found in tool list
+  if(ret >= 0 && szTarget)
+  {
+    fFound = FALSE;
+    for(i = 0; i < pToolList->nTools; ++i)
+    {
+      if(strcmp(szTarget, pToolList->apTools[i]->szName) == 0)
+      {
+        fFound = TRUE;
+        break;
+      }
+    }
+    if(!fFound)
+    {
+      // e.g. "folder/prog_file"
+      size = strlen(szFolder) + strlen(szTarget) + 2;
+      szOutFolder = FlyAlloc(size);
+      if(szOutFolder)
+      {
+        FlyStrZCpy(szOutFolder, szFolder, size);
+        FlyStrPathAppend(szOutFolder, szTarget, size);
+      }
+      FlyMakePrintErr(FMK_ERR_BAD_PROG, szOutFolder ? szOutFolder : szTarget);
+      ret = -1;
+    }
+  }
+
+  // make out folder for this configuration, e.g. "tools/out/rel/", if needed
+  if(ret >= 0 && pToolList->nTools)
+  {
+    FlyAssert(szFolder);
+    szOutFolder = FmkOutFolderCreate(pState, szFolder);
+    if(!szOutFolder)
+      ret = -1;
+  }
+
+  if(ret >= 0 && pToolList->nTools)
+  {
+    // compile files in parallel if -j
+    if(pState->opts.jobs > 1)
+      hJobs = FlyMakeJobsNew(&pState->opts);
+    hDb = FlyMakeDbOpen(pState, szOutFolder);
+
+    if(hJobs)
+    {
+      ret = FmkToolListCompileJobs(pState, szOutFolder, pToolList, szTarget, hJobs, hDb, &nToolsCompiled);
+      hJobs = FlyMakeJobsFree(hJobs);
+    }
+    else
+    {
+      for(i = 0; i < pToolList->nTools; ++i)
+      {
+        if(szTarget == NULL || strcmp(szTarget, pToolList->apTools[i]->szName) == 0)
+        {
+          ret = FmkToolCompile(pState, szOutFolder, pToolList->apTools[i], hDb);
+          if(ret < 0)
+            break;
+          if(ret == 0)
+            ++nToolsCompiled;
+        }
+      }
+    }
+
+    // building all tools, so remove objects of deleted or renamed source files
+    nSrc = FlyMakeSrcListLen(pToolList->hSrcList);
+    if(ret >= 0 && szTarget == NULL)
+    {
+      aszSrc = FlyAlloc(sizeof(char *) * nSrc);
+      if(aszSrc)
+      {
+        for(i = 0; i < nSrc; ++i)
+          aszSrc[i] = FlyMakeSrcListGetName(pToolList->hSrcList, i);
+        FmkOutFolderPrune(pState, szOutFolder, hDb, aszSrc, nSrc);
+        FlyFree(aszSrc);
+      }
+    }
+
+    hDb = FlyMakeDbClose(pState, hDb);
+
+    // if no tools needed compiling, then folder was up to date
+    if(ret >= 0 && pToolList->nTools && !nToolsCompiled)
+      FlyMakePrintfEx(FMK_VERBOSE_MORE, "# %s folder up to date\n", szFolder);
+  }
+
+  // cleanup
+  if(szOutFolder)
+    FlyFree(szOutFolder);
+
+  return ret >= 0 ? TRUE : FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Free a single dependency and its state, if any. Does not remove from any list.
+
+  @param    pDep
+  @return   NULL
+*///-----------------------------------------------------------------------------------------------
+static void * FmkDepFree(flyMakeDep_t *pDep)
+{
+  FlyStrFreeIf(pDep->szName);
+  FlyStrFreeIf(pDep->szVer);
+  FlyStrFreeIf(pDep->szRange);
+  FlyStrSmartUnInit(&pDep->libs);
+  FlyStrFreeIf(pDep->szIncFolder);
+  FlyFreeIf(pDep->apNeeds);
+  FlyStrFreeIf(pDep->szGitUrl);
+  if(pDep->pState)
+    FlyMakeStateFree(pDep->pState);
+
+  memset(pDep, 0, sizeof(*pDep));
+  FlyFree(pDep);
+  return NULL;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Free the entire dependency state chain. Does not delete any files, just frees memory.
+
+  @param    pDepList    dependency list
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeDepListFree(flyMakeDep_t *pDepList)
+{
+  flyMakeDep_t  *pDep;
+  flyMakeDep_t  *pDepNext;
+
+  pDep = pDepList;
+  while(pDep)
+  {
+    pDepNext = pDep->pNext;
+    FmkDepFree(pDep);
+    pDep = pDepNext;
+  }
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Allocate a version. If the TOML string is NULL, then use "*" for version.
+
+  @param    szTomlStr   ptr to a TOML string, e.g. "1.2.3", or NULL
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static char * FmkTomlVerAlloc(const char *szTomlStr)
+{
+  char     *szVersion;
+
+  szVersion = szTomlStr ? FlyMakeTomlStrAlloc(szTomlStr) : FlyStrClone("*");
+
+  return szVersion;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Peek at a character in the TOML string.
+
+  @param  szTomlStr   a TOML string
+  @param  i           index into character
+  @return 1st char of TOML string or '\0' if not a TOML string
+*///-----------------------------------------------------------------------------------------------
+static char FmkTomlPeek(const char *szTomlStr)
+{
+  char  c = 0;
+  if(*szTomlStr == '"' || *szTomlStr == '\'')
+    c = szTomlStr[1];
+  return c;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Create a TOML path from the root path and the TOML path string
+
+  @param  szRoot        root folder, e.g. "", "../" or "/Users/me/work/git/my_project/"
+  @param  szTomlPath    TOML string for path or file, e.g. "../my_package"
+  @return ptr to a string containing the combined path
+*///-----------------------------------------------------------------------------------------------
+static char * FmkTomlPath(const char *szRoot, const char *szTomlPath)
+{
+  char       *pszPath;
+  unsigned    size = 0;
+  unsigned    len;
+  bool_t      fRelativePath = FALSE;
+
+  if(!(isslash(FmkTomlPeek(szTomlPath)) || (FmkTomlPeek(szTomlPath) == '~')))
+  {
+    fRelativePath = TRUE;
+    size = strlen(szRoot);
+  }
+  size += FlyTomlStrLen(szTomlPath) + 1;
+
+  pszPath = FlyAlloc(size);
+  if(pszPath)
+  {
+    len = 0;
+    if(fRelativePath)
+    {
+      strcpy(pszPath, szRoot);
+      len = strlen(szRoot);
+    }
+    FlyTomlStrCpy(&pszPath[len], szTomlPath, size - len);
+  }
+
+  return pszPath;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Allocate a new dependency. Does NOT add the dependency to any list.
+
+  Essentially initializes to 0 and fills in name and version range (pDep->szRange). No other
+  fields are filled in.
+
+  If szRange is NULL, use default version range "*" (any).
+
+  @param    szName    ptr to name of dependency package
+  @param    szRange   NULL or ptr to TOML version string, e.g. "1.2.3"
+  @return   ptr to flyMakeDep_t or NULL
+*///-----------------------------------------------------------------------------------------------
+static flyMakeDep_t * FmkDepNew(const char *szName, const char *szRange)
+{
+  flyMakeDep_t *pDep;
+
+  pDep = FlyAlloc(sizeof(*pDep));
+  if(pDep)
+  {
+    // initialize dependecy
+    memset(pDep, 0, sizeof(*pDep));
+
+    // allocate version range string
+    if(szRange == NULL)
+      pDep->szRange = FlyStrClone("*");
+    else
+      pDep->szRange = FlyMakeTomlStrAlloc(szRange);
+
+    // allocate name string 
+    pDep->szName = FlyStrClone(szName);
+
+    if(!pDep->szName || !pDep->szRange)
+      pDep = FmkDepFree(pDep);
+  }
+
+  return pDep;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Find the dependency by name in a list, case sensitive.
+
+  @param  pDepList    a list of dependencies
+  @param  szName      the name to find
+  @return ptr to dependency if found, NULL if not found
+*///-----------------------------------------------------------------------------------------------
+static flyMakeDep_t * FmkDepFind(const flyMakeDep_t *pDepList, const char *szName)
+{
+  const flyMakeDep_t   *pDep;
+
+  pDep = pDepList;
+  while(pDep)
+  {
+    if(strcmp(szName, pDep->szName) == 0)
+      break;
+    pDep = pDep->pNext;
+  }
+
+  return (flyMakeDep_t *)pDep;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Find the dependency by TOML key in the dependency list
+
+  @param  pDepList    a list of dependencies
+  @param  szTomlKey   ptr to a TOML key that may be a dependency
+  @return ptr to dependency if found, NULL if not found
+*///-----------------------------------------------------------------------------------------------
+static flyMakeDep_t * FmkDepTomlFind(const flyMakeDep_t *pDepList, const char *szTomlKey)
+{
+  const flyMakeDep_t   *pDep  = NULL;
+  char                 *szName;
+  unsigned              size;
+
+  size = FlyTomlKeyLen(szTomlKey) + 1;
+  szName = FlyAllocZ(size);
+  if(szName)
+  {
+    FlyTomlKeyCpy(szName, szTomlKey, size);
+    pDep = FmkDepFind(pDepList, szName);
+    FlyFree(szName);
+  }
+
+  return (flyMakeDep_t *)pDep;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Remember that the dependency whose flymake.toml is being processed needs another dependency, so
+  they are built in the right order. See FlyMakeDepListBuild().
+
+  @param  pRootState    root project state, with the dependency list
+  @param  pState        state of the dependency whose flymake.toml is being processed
+  @param  szTomlKey     TOML key of the needed dependency, e.g. foo in foo = { path="../foo/" }
+  @return FMK_ERR_NONE or FMK_ERR_MEM
+*///-----------------------------------------------------------------------------------------------
+static fmkErr_t FmkDepNeedsAdd(flyMakeState_t *pRootState, flyMakeState_t *pState, const char *szTomlKey)
+{
+  flyMakeDep_t   *pDep;
+  flyMakeDep_t   *pNeed;
+  flyMakeDep_t  **apNeeds;
+  unsigned        i;
+  fmkErr_t        err   = FMK_ERR_NONE;
+
+  // find the dependency being processed
+  pDep = pRootState->pDepList;
+  while(pDep && pDep->pState != pState)
+    pDep = pDep->pNext;
+
+  pNeed = FmkDepTomlFind(pRootState->pDepList, szTomlKey);
+  if(pDep && pNeed && pDep != pNeed)
+  {
+    for(i = 0; i < pDep->nNeeds; ++i)
+    {
+      if(pDep->apNeeds[i] == pNeed)
+        break;
+    }
+    if(i >= pDep->nNeeds)
+    {
+      apNeeds = FlyRealloc(pDep->apNeeds, sizeof(flyMakeDep_t *) * (pDep->nNeeds + 1));
+      if(!apNeeds)
+        err = FlyMakeErrMem();
+      else
+      {
+        apNeeds[pDep->nNeeds] = pNeed;
+        pDep->apNeeds = apNeeds;
+        ++pDep->nNeeds;
+      }
+    }
+  }
+
+  return err;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Adds include folder and library file to appropriate states.
+
+  1. If not NULL, adds the inc folder to the state who's flymake.toml file is being processed.
+  2. If not NULL, adds the library file to the root folder.
+
+  @param  pDepKeys      contains both root and state which is processing flymake.toml
+  @param  szIncFolder   include folder string, e.g. "../packages/foo/inc/" or NULL
+  @param  szLibFile     library file string, e.g. "../packages/foo/lib/foo.a" or NULL
+  @return none
+*///-----------------------------------------------------------------------------------------------
+static void FmkDepAddIncLibs(fmkDepKeys_t *pDepKeys, const char *szIncFolder, flyStrSmart_t *pLibs)
+{
+  // add dependency inc folder (.e.g. dep/foo/inc/) to root state so it can compile properly
+  // no need to add current folder -I. as that's already added to every project
+  if(szIncFolder)
+  {
+    FlyStrSmartCat(&pDepKeys->pState->incs, szIncFolder);
+    FlyStrSmartCat(&pDepKeys->pState->incs, " ");
+  }
+
+  // add library to root state
+  if(pLibs)
+  {
+    FlyStrSmartCat(&pDepKeys->pRootState->libs, pLibs->sz);
+    FlyStrSmartCat(&pDepKeys->pRootState->libs, " ");
+  }
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Returns # of dependencies in this TOML file
+
+  @param  szTomlFile    flymake.toml, loaded into memory
+  @return 0-n, number of dependencies
+*///-----------------------------------------------------------------------------------------------
+static unsigned FmkDepNumDependencies(const char *szTomlFile)
+{
+  const char   *psz;
+  tomlKey_t     key;
+  unsigned      nDeps = 0;
+
+  if(szTomlFile)
+  {
+    psz = FlyTomlTableFind(szTomlFile, m_szDepTable);
+    while(psz)
+    {
+      psz = FlyTomlKeyIter(psz, &key);
+      if(psz)
+        ++nDeps;
+    }
+  }
+
+  return nDeps;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Checks version of depenency vs desired version range. If dep not found, always passes
+
+  @param  pDepKeys    Information needed to process dependency
+  @param  szDepName   name of dependency, e.g. "foo"
+  @param  szRange     Version range, e.g. "1.2", which means >= 1.2.0 and <= 2.0.0
+  @param  ppDep       Returned dependency or NULL if not found
+  @return FMK_ERR_NONE or FMK_ERR_CUSTOM
+*///-----------------------------------------------------------------------------------------------
+static fmkErr_t FmkDepVersionValidate(
+  fmkDepKeys_t *pDepKeys,
+  const char *szDepName,
+  const char *szRange,
+  flyMakeDep_t **ppDep)
+{
+  flyMakeDep_t   *pDep = NULL;
+  fmkErr_t        err = FMK_ERR_NONE;
+
+  // check that version of package doesn't conflict with specified version range
+  pDep = FmkDepFind(pDepKeys->pRootState->pDepList, szDepName);
+  if(pDep && !FlySemVerMatch(szRange, pDep->szVer))
+  {
+    err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keyInc.szValue, "version conflict");
+    FlyMakePrintf("  Previous version %s\n", pDep->szVer);
+  }
+  *ppDep = pDep;
+
+  return err;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Create a new empty state for a dependency, cloning options from the root state.
+
+  @param  pRootState    root project state
+  @return new state, or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+static flyMakeState_t * FmkDepStateNew(flyMakeState_t *pRootState)
+{
+  flyMakeState_t *pState;
+
+  pState = FlyMakeStateClone(pRootState);
+  if(pState)
+  {
+    // always compile with lib rules, and don't rebuild with -B, only --all
+    pState->opts.fRulesLib = TRUE;
+    pState->opts.fRulesSrc = pState->opts.fRulesTools = FALSE;
+    pState->opts.fRebuild = (pState->opts.fAll) ? TRUE : FALSE;
+  }
+
+  return pState;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Creates a valid flyMakeState_t upon success. Fails if folder does not point to a valid package.
+
+  Also returns the newly created state so that package can be built with flymake.
+
+  Tasks:
+
+  1. Determines root of project, inc/ and lib/ folders
+  2. Reads flymake.toml and determines version based on that
+  3. Sets build option to --rl (library rules)
+
+  Possible errors:
+
+  1. folder not a project (that is, contains no source files)
+  2. invalid flymake.toml file
+  3. project cannot be built as object file library (package)
+
+  @param  pDepKeys    All the information needed to proce
+  @param  szFolder    file folder, e.g. "../foo/" or "deps/bar/"
+  @param  szDepName   
+  @param  ppState     Returned flyMakeState_t
+  @return FMK_ERR_NONE, FMK_ERR_MEM, FMK_ERR_CUSTOM
+*///-----------------------------------------------------------------------------------------------
+static fmkErr_t FmkDepPackageValidate(
+  fmkDepKeys_t *pDepKeys,
+  const char *szFolder,
+  const char *szDepName,
+  const char *szVer,
+  flyMakeState_t **ppState)
+{
+  flyMakeState_t *pState        = NULL;
+  fmkErr_t        err           = FMK_ERR_NONE;
+  const char     *szValue       = NULL;
+
+
+  FlyAssertDbg(pDepKeys && pDepKeys->pRootState);
+  FlyAssertDbg(szFolder);
+  FlyAssertDbg(ppState);
+
+  // create a new empty state, cloning options
+  if(!err)
+  {
+    pState = FmkDepStateNew(pDepKeys->pRootState);
+    if(!pState)
+      err = FlyMakeErrMem();
+  }
+
+  // verify it's a valid root folder of a project
+  if(!err && !FlyMakeTomlRootFill(pState, szFolder))
+  {
+    szValue = pDepKeys->keyGit.szValue ? pDepKeys->keyGit.szValue : pDepKeys->keyPath.szValue;
+    err = FlyMakeErrToml(pDepKeys->pState, szValue, "folder not a project");
+  }
+
+  // validate flymake.toml and allocate things like the name
+  if(!err && !FlyMakeTomlAlloc(pState, szDepName))
+  {
+    FlyAssert(szValue);
+    err = FlyMakeErrToml(pDepKeys->pState, szValue, "invalid flymake.toml file");
+  }
+
+  // fixup project version
+  if(!err && !pState->szProjVer)
+  {
+    if(szVer)
+      pState->szProjVer = FlyStrClone(szVer);
+    else
+      pState->szProjVer = FlyStrClone("*");
+  }
+
+  if(!err && !FlyMakeFolderFindByRule(pState->pFolderList, FMK_RULE_LIB))
+  {
+    FlyMakeStatePrint(pState);
+    err = FlyMakeErrToml(pDepKeys->pState, szValue, "project cannot be built as library");
+  }
+
+  // failed, free state
+  if(err)
+    FlyMakeStateFree(pState);
+  else
+    *ppState = pState;
+
+  return err;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Vallidates and adds the git or package dependency to the deplist.
+
+  1. Checks that the folder can be built into one or more a libraries.
+  3. Validates actual version of project vs range specified by dependency
+  2. Adds lib to root project, adds inc/ folder to project referencing dependency
+
+  The actual version found depends on a variety of factors:
+
+  szRange  | szVer  | flymake.toml | resulting szProjVer
+  -------- | ------ | ------------ | -------------------
+  1.0      | NULL   | NULL         | *
+  1.0      | 1.3    | NULL         | 1.3
+  1.0      | 1.3    | 1.2          | 1.2
+
+  @param  pDepKeys    Information needed to process dependency
+  @param  szFolder    Folder to add
+
+  @return FMK_ERR_NONE or FMK_ERR_CUSTOM
+*///-----------------------------------------------------------------------------------------------
+static fmkErr_t FmkDepPackageAdd(
+  fmkDepKeys_t *pDepKeys,
+  const char *szFolder,
+  const char *szDepName,
+  const char *szRange,    // version range specified by use, defaults to *
+  const char *szVer,      // may be NULL, what was found in git log
+  flyMakeDep_t **ppDep)
+{
+  flyMakeDep_t     *pDep;
+  flyMakeState_t   *pState  = NULL;
+  char             *szLibs;
+  fmkErr_t          err     = FMK_ERR_NONE;
+
+  // allocate a new state if this folder is a valid package
+  err = FmkDepPackageValidate(pDepKeys, szFolder, szDepName, szVer, &pState);
+  if(!err)
+  {
+    FlyAssert(pState);
+  }
+
+  // create new dependency
+  if(!err)
+  {
+    pDep = FmkDepNew(szDepName, szRange);
+    if(!pDep)
+      err = FlyMakeErrMem();
+    else
+    {
+      pDep->szVer       = FlyStrClone(pState->szProjVer);
+      szLibs            = FlyStrSmartCpy(&pDep->libs, pState->libs.sz);
+      pDep->szIncFolder = FlyStrClone(pState->szInc);
+      pDep->pState      = pState;
+      if(!pDep->szVer || !szLibs || !pDep->szIncFolder)
+        err = FlyMakeErrMem();
+    }
+  }
+
+  // add dependency to root state
+  if(!err)
+    pDepKeys->pRootState->pDepList = FlyListAppend(pDepKeys->pRootState->pDepList, pDep);
+
+  // validate version of package vs specified version range (also fills in ppDep)
+  if(!err)
+    err = FmkDepVersionValidate(pDepKeys, szDepName, szRange, ppDep);
+
+  // add include/ folder to current state and and library/file.a to root state
+  if(!err)
+    FmkDepAddIncLibs(pDepKeys, pState->szInc, &pState->libs);
+
+  if(err)
+    *ppDep = NULL;
+
+  return err;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Look in this line for semantic version, e.g. v1.2.3. or version 1 or ver 2.0.
+
+  @param  szLine    a line of text
+  @param  lineLen   length of line
+  @return ptr to allocated string if semver found, otherwise NULL
+*///-----------------------------------------------------------------------------------------------
+char * FmkDepVerFindInLine(const char *szLine, unsigned lineLen)
+{
+  static const char  *aVerStrs[] = { "version", "ver", "v"};
+  char               *szSemVer = NULL;
+  unsigned            i;
+  unsigned            n;
+  bool_t              fFound = FALSE;
+
+  while(lineLen && !fFound)
+  {
+    if(toupper(*szLine) == 'V')
+    {
+      for(i = 0; i < NumElements(aVerStrs); ++i)
+      {
+        n = strlen(aVerStrs[i]);
+        if(strncasecmp(szLine, aVerStrs[i], n) == 0)
+        {
+          szLine = FlyStrSkipWhite(szLine + n);
+          n = FlySemVerCpy(NULL, szLine, lineLen);
+          if(n != 0)
+          {
+            szSemVer = FlyAlloc(n + 1);
+            FlySemVerCpy(szSemVer, szLine, n + 1);
+            fFound = TRUE;
+            break;
+          }
+        }
+      }
+    }
+    ++szLine;
+    --lineLen;
+  }
+
+  return szSemVer;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Get the path to the versions cache file, e.g. "~/.cache/flymake/git/versions"
+
+  @param  pOpts     Options, for -n
+  @return allocated path, or NULL if no cache
+*///-----------------------------------------------------------------------------------------------
+static char * FmkDepVerCacheAlloc(flyMakeOpts_t *pOpts)
+{
+  static const char   szVersions[] = "versions";
+  char               *szCache;
+  char               *szPath  = NULL;
+  unsigned            size;
+
+  szCache = FlyMakeCacheFolderAlloc(pOpts, "git/");
+  if(szCache)
+  {
+    size = strlen(szCache) + sizeof(szVersions);
+    szPath = FlyAlloc(size);
+    if(szPath)
+    {
+      FlyStrZCpy(szPath, szCache, size);
+      FlyStrZCat(szPath, szVersions, size);
+    }
+    FlyFree(szCache);
+  }
+
+  return szPath;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Compare two semantic versions, e.g. "1.10.0" > "1.9.2". Only major.minor.patch are compared.
+
+  @param  szVer1    a version, e.g. "1.10.0"
+  @param  szVer2    a version, e.g. "1.9.2"
+  @return <0 if szVer1 is lower, 0 if same, >0 if szVer1 is higher
+*///-----------------------------------------------------------------------------------------------
+static int FmkDepVerCmp(const char *szVer1, const char *szVer2)
+{
+  unsigned long   n1;
+  unsigned long   n2;
+  unsigned        i;
+  int             cmp = 0;
+
+  for(i = 0; cmp == 0 && i < 3; ++i)
+  {
+    n1 = strtoul(szVer1, (char **)&szVer1, 10);
+    n2 = strtoul(szVer2, (char **)&szVer2, 10);
+    if(n1 != n2)
+      cmp = (n1 < n2) ? -1 : 1;
+    if(*szVer1 == '.')
+      ++szVer1;
+    if(*szVer2 == '.')
+      ++szVer2;
+  }
+
+  return cmp;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Check one line of `git for-each-ref` or `git log --oneline` output for a version in the range.
+  Called by FlyMakeProcLines() or for each line of tags.
+
+  A tag line is "sha tagname", e.g. "07d2d5d v1.0" or "07d2d5d 1.0.2". The highest matching tag
+  wins. A log line is "sha subject", e.g. "cba1855 fixes #271 v1.2.1 Added SemVer". The first
+  (newest) matching commit wins.
+
+  @param  szLine    a line, e.g. "cba1855 fixes #271 v1.2.1 Added SemVer"
+  @param  pArg      ptr to fmkDepVerFind_t
+  @return FALSE if found in log (stop looking), TRUE to keep looking
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDepVerFindLine(const char *szLine, void *pArg)
+{
+  fmkDepVerFind_t  *pFind     = pArg;
+  const char       *szTag;
+  char             *szSemVer;
+  unsigned          lineLen;
+  unsigned          size;
+
+  lineLen = (unsigned)FlyStrLineLen(szLine);
+  szSemVer = FmkDepVerFindInLine(szLine, lineLen);
+
+  // tags don't need the 'v', e.g. "1.0.2"
+  if(!szSemVer && pFind->fTags)
+  {
+    szTag = FlyStrArgNext(szLine);
+    size = 0;
+    if(szTag > szLine && szTag < szLine + lineLen)
+      size = FlySemVerCpy(NULL, szTag, lineLen - (unsigned)(szTag - szLine));
+    if(size && (szTag[size] == '\0' || isspace((unsigned char)szTag[size])))
+    {
+      szSemVer = FlyAlloc(size + 1);
+      if(szSemVer)
+        FlySemVerCpy(szSemVer, szTag, size + 1);
+    }
+  }
+
+  if(szSemVer)
+  {
+    // debugging
+    if(FlyMakeDebug() >= FMK_DEBUG_MORE)
+      FlyMakePrintf("dbg: found szSemVer '%s' in line '%.*s'\n", szSemVer, lineLen, szLine);
+
+    // e.g. cba1855 fixes #271 v1.2.1 Added SemVer
+    if(!FlySemVerMatch(pFind->szRange, szSemVer) || !isxdigit((unsigned char)*szLine) ||
+       (pFind->szVer && FmkDepVerCmp(szSemVer, pFind->szVer) <= 0))
+    {
+      FlyFree(szSemVer);
+    }
+    else
+    {
+      FlyFreeIf(pFind->szSha);
+      FlyFreeIf(pFind->szVer);
+      size = (unsigned)FlyStrArgLen(szLine) + 1;
+      pFind->szSha = FlyAlloc(size);
+      if(pFind->szSha)
+      {
+        strncpy(pFind->szSha, szLine, size - 1);
+        pFind->szSha[size - 1] = '\0';
+        // debugging
+        if(FlyMakeDebug() >= FMK_DEBUG_MORE)
+          FlyMakePrintf("dbg: found sha '%s'\n", pFind->szSha);
+      }
+      pFind->szVer = szSemVer;
+    }
+  }
+
+  return (pFind->szVer && !pFind->fTags) ? FALSE : TRUE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Look up a version range in the versions cache, shared by all projects.
+
+  Each line of the cache is "key sha version", e.g. "0123456789abcdef 07d2d5d 1.0.0". The key is a
+  hash of the range, HEAD and all tags, so a new commit or tag means a new key.
+
+  @param  pOpts     Options, for -n
+  @param  key       hash of range, HEAD and tags
+  @param  pFind     return value, szSha and szVer if found
+  @return TRUE if found
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDepVerCacheFind(flyMakeOpts_t *pOpts, uint64_t key, fmkDepVerFind_t *pFind)
+{
+  char         szKey[20];
+  char        *szCache;
+  char        *szFile   = NULL;
+  const char  *szLine;
+  const char  *szVer;
+  unsigned     len;
+
+  snprintf(szKey, sizeof(szKey), "%016llx ", (unsigned long long)key);
+  szCache = FmkDepVerCacheAlloc(pOpts);
+  if(szCache)
+    szFile = FlyFileRead(szCache);
+
+  szLine = szFile;
+  while(szLine && *szLine && !pFind->szVer)
+  {
+    if(strncmp(szLine, szKey, strlen(szKey)) == 0)
+    {
+      szLine += strlen(szKey);
+      szVer = FlyStrArgNext(szLine);
+      len = (unsigned)FlyStrArgLen(szLine);
+      pFind->szSha = FlyAlloc(len + 1);
+      if(pFind->szSha)
+      {
+        strncpy(pFind->szSha, szLine, len);
+        pFind->szSha[len] = '\0';
+      }
+      len = (unsigned)FlyStrArgLen(szVer);
+      pFind->szVer = FlyAlloc(len + 1);
+      if(pFind->szVer)
+      {
+        strncpy(pFind->szVer, szVer, len);
+        pFind->szVer[len] = '\0';
+      }
+      if(!pFind->szSha || !pFind->szVer || !*pFind->szSha || !*pFind->szVer)
+      {
+        FlyFreeIf(pFind->szSha);
+        FlyFreeIf(pFind->szVer);
+        pFind->szSha = pFind->szVer = NULL;
+        break;
+      }
+    }
+    szLine = FlyStrLineNext(szLine);
+  }
+
+  FlyFreeIf(szFile);
+  FlyFreeIf(szCache);
+
+  return pFind->szVer ? TRUE : FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add a found version to the versions cache. See FmkDepVerCacheFind().
+
+  @param  pOpts     Options, for -n
+  @param  key       hash of range, HEAD and tags
+  @param  pFind     found szSha and szVer
+  @return none
+*///-----------------------------------------------------------------------------------------------
+static void FmkDepVerCacheAdd(flyMakeOpts_t *pOpts, uint64_t key, const fmkDepVerFind_t *pFind)
+{
+  char   *szCache;
+  FILE   *fp;
+
+  szCache = FmkDepVerCacheAlloc(pOpts);
+  if(szCache)
+  {
+    // a single short write with "a" is appended whole, even if another flymake adds at the same time
+    fp = fopen(szCache, "a");
+    if(fp)
+    {
+      fprintf(fp, "%016llx %s %s\n", (unsigned long long)key, pFind->szSha, pFind->szVer);
+      fclose(fp);
+    }
+    FlyFree(szCache);
+  }
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Given a version range, find a SHA that matches. Must be in the cloned folder, e.g. "deps/foo/".
+
+  For example, if version range is "1", then it will look for versions >= 1.0.0 and < 2.0.0.
+
+  Tags are checked first, and the highest version wins, e.g. "v1.2.0". If no tag matches, the git log is
+  searched, newest commit first, for a subject with a version, e.g. "cba1855 v1.2.1 Added SemVer".
+  The git log is read as it is output and stops at the first match, so large histories aren't read
+  in full. The result is cached, see FmkDepVerCacheFind().
+
+  @param  pOpts     So system calls are printed properly
+  @param  szRange   The version range to find
+  @param  ppszSha   return value, allocated SHA, or NULL if version not found
+  @return allocated version, or NULL if version not found
+*///-----------------------------------------------------------------------------------------------
+static char * FmkDepVersionFind(flyMakeOpts_t *pOpts, const char *szRange, char **ppszSha)
+{
+  static const char   szGitHead[] = "git rev-parse HEAD";
+  static const char   szGitTags[] = "git for-each-ref --format="
+                                    "'%(if)%(*objectname)%(then)%(*objectname:short)%(else)%(objectname:short)%(end) %(refname:short)'"
+                                    " refs/tags";
+  static const char   szGitLog[]  = "git log --oneline";
+  fmkDepVerFind_t     find;
+  flyMakeProc_t       head;
+  flyMakeProc_t       tags;
+  const char         *szLine;
+  uint64_t            key;
+
+  memset(&find, 0, sizeof(find));
+  find.szRange = szRange;
+  FlyMakeProcInit(&head, TRUE);
+  FlyMakeProcInit(&tags, TRUE);
+
+  FlyMakePrintfEx(FMK_VERBOSE_MORE, "%s\n%s\n", szGitHead, szGitTags);
+  if(!pOpts->fNoBuild && FlyMakeProcRun(szGitHead, &head) == 0 && FlyMakeProcRun(szGitTags, &tags) == 0)
+  {
+    // same range, HEAD and tags, same answer
+    key = FlyMakeHashStr(head.output.sz ? head.output.sz : "");
+    key = FlyMakeHash(szRange, strlen(szRange), key);
+    if(tags.output.sz)
+      key = FlyMakeHash(tags.output.sz, strlen(tags.output.sz), key);
+
+    if(!FmkDepVerCacheFind(pOpts, key, &find))
+    {
+      // highest matching tag
+      find.fTags = TRUE;
+      szLine = tags.output.sz;
+      while(szLine && *szLine)
+      {
+        FmkDepVerFindLine(szLine, &find);
+        szLine = FlyStrLineNext(szLine);
+      }
+
+      // then newest commit first in the log
+      find.fTags = FALSE;
+      if(!find.szVer)
+      {
+        FlyMakePrintfEx(FMK_VERBOSE_MORE, "%s\n", szGitLog);
+        FlyMakeProcLines(szGitLog, FmkDepVerFindLine, &find);
+      }
+
+      if(find.szSha && find.szVer)
+        FmkDepVerCacheAdd(pOpts, key, &find);
+    }
+  }
+
+  // must have both
+  if(!find.szSha || !find.szVer)
+  {
+    FlyFreeIf(find.szSha);
+    FlyFreeIf(find.szVer);
+    find.szSha = find.szVer = NULL;
+  }
+
+  FlyMakeProcUnInit(&head);
+  FlyMakeProcUnInit(&tags);
+
+  // return both SHA and found version
+  *ppszSha = find.szSha;
+  return find.szVer;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Checkout the given sha
+
+  @param  pOpts   Options for displaying system commands/errors.
+  @param  szSha   short SHA for checkout, e.g. "4cb16b7"
+  @return allocated SHA or NULL if version found
+*///-----------------------------------------------------------------------------------------------
+bool_t FmkDepCheckoutSha(flyMakeOpts_t *pOpts, const char *szSha)
+{
+  static const char szGitCheckout[] = "git checkout -q ";
+  char     *szCmdline;
+  unsigned  size;
+  bool_t    fWorked = FALSE;
+
+  size = sizeof(szGitCheckout) + strlen(szSha);
+  szCmdline = FlyAlloc(size);
+  if(szCmdline)
+  {
+    FlyStrZCpy(szCmdline, szGitCheckout, size);
+    FlyStrZCat(szCmdline, szSha, size);
+    if(FlyMakeSystem(FMK_VERBOSE_MORE, pOpts, szCmdline) == 0)
+      fWorked = TRUE;
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Has this szDepName already been cloned? Checks for "deps/<depname>/.git/" folder.
+
+  @param  pRootState      root state, for its dep folder, e.g. "deps/" or "../deps/"
+  @param  szDepName       dependency name, e.g. "foo"
+  @return TRUE if already cloned, FALSE if not
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDepPackageAlreadyCloned(flyMakeState_t *pRootState, const char *szDepName)
+{
+  const char          szGitFolder[] = ".git/";
+  flyMakeArenaMark_t  mark;
+  unsigned            size;
+  char               *szPath;
+  bool_t              fExists = FALSE;
+
+  // check if .git folder exists already, e.g. "deps/foo/.git/"
+  mark = FlyMakeArenaMark(&pRootState->arena);
+  size = strlen(pRootState->szDepDir) + strlen(szDepName) + sizeof(szGitFolder) + 4;
+  szPath = FlyMakeArenaAlloc(&pRootState->arena, size);
+  if(szPath)
+  {
+    FlyStrZCpy(szPath, pRootState->szDepDir, size);
+    FlyStrZCat(szPath, szDepName, size);
+    FlyStrZCat(szPath, "/", size);
+    FlyStrZCat(szPath, szGitFolder, size);
+    fExists = FlyFileExistsFolder(szPath);
+  }
+  FlyMakeArenaReset(&pRootState->arena, mark);
+
+  return fExists;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Determine how much of a git dependency to clone.
+
+  If clone= is not specified, a dependency pinned to a sha= or version= only needs the commit
+  history, not every version of every file, so is a partial clone. A dependency on the head of a
+  branch= needs only the last commit, so is a shallow clone. Otherwise it's a full clone.
+
+  @param  szClone     value of clone= key, e.g. "shallow", or NULL if not specified
+  @param  fBranch     TRUE if branch= is specified
+  @param  fPinned     TRUE if sha= or version= is specified
+  @return clone mode, or FMK_CLONE_INVALID if szClone is not "full", "shallow" or "partial"
+*///-----------------------------------------------------------------------------------------------
+static fmkDepClone_t FmkDepCloneMode(const char *szClone, bool_t fBranch, bool_t fPinned)
+{
+  fmkDepClone_t   mode = FMK_CLONE_FULL;
+
+  if(szClone)
+  {
+    if(strcmp(szClone, "full") == 0)
+      mode = FMK_CLONE_FULL;
+    else if(strcmp(szClone, "shallow") == 0)
+      mode = FMK_CLONE_SHALLOW;
+    else if(strcmp(szClone, "partial") == 0)
+      mode = FMK_CLONE_PARTIAL;
+    else
+      mode = FMK_CLONE_INVALID;
+  }
+  else if(fPinned)
+    mode = FMK_CLONE_PARTIAL;
+  else if(fBranch)
+    mode = FMK_CLONE_SHALLOW;
+
+  return mode;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Create the git clone command-line, e.g. "git clone -q --depth 1 --single-branch url -b main deps/foo/"
+
+  @param  pCmdline    return value, the command-line
+  @param  mode        how much to clone, see FmkDepCloneMode()
+  @param  szGitUrl    URL to git, e.g. "git@gitlab.com:drew.gislason/foo.git"
+  @param  szBranch    branch, e.g. "main", or NULL for the default branch
+  @param  szFolder    folder where to clone the git repo, e.g. "deps/foo/"
+  @return none
+*///-----------------------------------------------------------------------------------------------
+static void FmkDepCloneCmd(flyStrSmart_t *pCmdline, fmkDepClone_t mode, const char *szGitUrl,
+                           const char *szBranch, const char *szFolder)
+{
+  FlyStrSmartCpy(pCmdline, "git clone -q ");
+  if(mode == FMK_CLONE_SHALLOW)
+    FlyStrSmartCat(pCmdline, "--depth 1 --single-branch ");
+  else if(mode == FMK_CLONE_PARTIAL)
+  {
+    FlyStrSmartCat(pCmdline, "--filter=blob:none ");
+    if(szBranch)
+      FlyStrSmartCat(pCmdline, "--single-branch ");
+  }
+  FlyStrSmartCat(pCmdline, szGitUrl);
+  if(szBranch)
+  {
+    FlyStrSmartCat(pCmdline, " -b ");
+    FlyStrSmartCat(pCmdline, szBranch);
+  }
+  FlyStrSmartCat(pCmdline, " ");
+  FlyStrSmartCat(pCmdline, szFolder);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Find a dependency in flymake.lock, e.g. foo = { folder="deps/foo/", sha="..." }
+
+  @param  szLock    flymake.lock loaded into memory, or NULL
+  @param  szName    dependency name, e.g. "foo"
+  @param  pKey      return value, key for the dependency's inline table
+  @return TRUE if found
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDepLockFind(const char *szLock, const char *szName, tomlKey_t *pKey)
+{
+  const char   *pszIter = NULL;
+  bool_t        fFound  = FALSE;
+
+  if(szLock)
+    pszIter = FlyTomlTableFind(szLock, m_szDepTable);
+  if(pszIter)
+    pszIter = FlyTomlKeyIter(pszIter, pKey);
+  while(pszIter)
+  {
+    if(pKey->type == TOML_INLINE_TABLE && FlyTomlKeyLen(pKey->szKey) == strlen(szName) &&
+       strncmp(pKey->szKey, szName, strlen(szName)) == 0)
+    {
+      fFound = TRUE;
+      break;
+    }
+    pszIter = FlyTomlKeyIter(pszIter, pKey);
+  }
+
+  return fFound;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Allocate a string value from a flymake.lock inline table
+
+  @param  szInlineTable   inline table, e.g. { sha="..." }
+  @param  szKey           key name, e.g. "sha"
+  @return allocated string, or NULL if the key is missing or not a string
+*///-----------------------------------------------------------------------------------------------
+static char * FmkDepLockStrAlloc(const char *szInlineTable, const char *szKey)
+{
+  tomlKey_t   key;
+  char       *sz    = NULL;
+
+  memset(&key, 0, sizeof(key));
+  if(FlyTomlKeyFind(szInlineTable, szKey, &key) && key.type == TOML_STRING)
+    sz = FlyMakeTomlStrAlloc(key.szValue);
+
+  return sz;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Hash the keys that choose what is checked out for a git dependency, so flymake.lock knows if
+  they changed.
+
+  @param  pDepKeys    the dependency's keys
+  @return hash of git=, version=, sha= and branch=
+*///-----------------------------------------------------------------------------------------------
+static uint64_t FmkDepSpecHash(const fmkDepKeys_t *pDepKeys)
+{
+  const tomlKey_t  *apKeys[] = { &pDepKeys->keyGit, &pDepKeys->keyVer, &pDepKeys->keySha, &pDepKeys->keyBranch };
+  char             *sz;
+  uint64_t          hash    = 0;
+  unsigned          i;
+
+  for(i = 0; i < NumElements(apKeys); ++i)
+  {
+    // include the '\0' so "ab" + "c" differs from "a" + "bc"
+    sz = FlyMakeTomlStrAlloc(apKeys[i]->szValue);
+    hash = FlyMakeHash(sz ? sz : "", sz ? strlen(sz) + 1 : 1, hash);
+    FlyStrFreeIf(sz);
+  }
+
+  return hash;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Get the SHA and version flymake.lock recorded for a git dependency, if its git=, version=, sha=
+  and branch= haven't changed since. This makes a fresh checkout (e.g. on a CI machine) build the
+  same commits as the checkout that wrote flymake.lock.
+
+  @param  pDepKeys    the dependency's keys, including flymake.lock
+  @param  szDepName   dependency name, e.g. "foo"
+  @param  ppszSha     return value, allocated full SHA
+  @param  ppszVer     return value, allocated version, or NULL
+  @return TRUE if the dependency is locked
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDepLockSha(const fmkDepKeys_t *pDepKeys, const char *szDepName, char **ppszSha, char **ppszVer)
+{
+  tomlKey_t   keyLock;
+  char        szSpec[20];
+  char       *szLockSpec  = NULL;
+  char       *szSha       = NULL;
+  bool_t      fLocked     = FALSE;
+
+  if(FmkDepLockFind(pDepKeys->szLock, szDepName, &keyLock))
+  {
+    snprintf(szSpec, sizeof(szSpec), "%016llx", (unsigned long long)FmkDepSpecHash(pDepKeys));
+    szLockSpec = FmkDepLockStrAlloc(keyLock.szValue, "spec");
+    szSha = FmkDepLockStrAlloc(keyLock.szValue, "sha");
+    if(szLockSpec && szSha && *szSha && strcmp(szLockSpec, szSpec) == 0)
+    {
+      fLocked   = TRUE;
+      *ppszSha  = szSha;
+      *ppszVer  = FmkDepLockStrAlloc(keyLock.szValue, "version");
+      szSha     = NULL;
+    }
+  }
+  FlyStrFreeIf(szLockSpec);
+  FlyStrFreeIf(szSha);
+
+  return fLocked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Get the path to the local mirror of a git repo, e.g. "~/.cache/flymake/git/0123456789abcdef.git".
+  The mirror is a bare `git clone --mirror` shared by every project that uses the same URL.
+
+  @param  pOpts       Options, for -n
+  @param  szGitUrl    URL to git, e.g. "git@gitlab.com:drew.gislason/foo.git"
+  @return allocated path to mirror (which may not exist yet), or NULL if no cache folder
+*///-----------------------------------------------------------------------------------------------
+static char * FmkDepMirrorAlloc(flyMakeOpts_t *pOpts, const char *szGitUrl)
+{
+  char       *szCache;
+  char       *szMirror  = NULL;
+  unsigned    size;
+
+  szCache = FlyMakeCacheFolderAlloc(pOpts, "git/");
+  if(szCache)
+  {
+    size = strlen(szCache) + 16 + sizeof(".git");
+    szMirror = FlyAlloc(size);
+    if(szMirror)
+      snprintf(szMirror, size, "%s%016llx.git", szCache, (unsigned long long)FlyMakeHashStr(szGitUrl));
+    FlyFree(szCache);
+  }
+
+  return szMirror;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Create the command-line to bring the mirror up to date, then clone from it. Cloning from a local
+  mirror hard links the objects, so it is a disk operation, not a network one. The clone's origin
+  is then set back to the real URL.
+
+  For example: "git -C mirror fetch -q --prune && git clone -q mirror -b main deps/foo/ &&
+  git -C deps/foo/ remote set-url origin url"
+
+  @param  pCmdline    return value, the command-line
+  @param  szMirror    path to mirror, from FmkDepMirrorAlloc()
+  @param  szGitUrl    URL to git, e.g. "git@gitlab.com:drew.gislason/foo.git"
+  @param  szBranch    branch, e.g. "main", or NULL for the default branch
+  @param  szFolder    folder where to clone the git repo, e.g. "deps/foo/"
+  @return none
+*///-----------------------------------------------------------------------------------------------
+static void FmkDepMirrorCloneCmd(flyStrSmart_t *pCmdline, const char *szMirror, const char *szGitUrl,
+                                 const char *szBranch, const char *szFolder)
+{
+  if(FlyFileExistsFolder(szMirror))
+  {
+    FlyStrSmartCpy(pCmdline, "git -C ");
+    FlyStrSmartCat(pCmdline, szMirror);
+    FlyStrSmartCat(pCmdline, " fetch -q --prune && ");
+  }
+  else
+  {
+    FlyStrSmartCpy(pCmdline, "git clone -q --mirror ");
+    FlyStrSmartCat(pCmdline, szGitUrl);
+    FlyStrSmartCat(pCmdline, " ");
+    FlyStrSmartCat(pCmdline, szMirror);
+    FlyStrSmartCat(pCmdline, " && ");
+  }
+
+  FlyStrSmartCat(pCmdline, "git clone -q ");
+  FlyStrSmartCat(pCmdline, szMirror);
+  if(szBranch)
+  {
+    FlyStrSmartCat(pCmdline, " -b ");
+    FlyStrSmartCat(pCmdline, szBranch);
+  }
+  FlyStrSmartCat(pCmdline, " ");
+  FlyStrSmartCat(pCmdline, szFolder);
+  FlyStrSmartCat(pCmdline, " && git -C ");
+  FlyStrSmartCat(pCmdline, szFolder);
+  FlyStrSmartCat(pCmdline, " remote set-url origin ");
+  FlyStrSmartCat(pCmdline, szGitUrl);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Fetch the rest of a shallow or single-branch clone, because the sha= or version= wasn't in what
+  was cloned. Must be in the cloned folder, e.g. "deps/foo/".
+
+  The clone may have been made by FmkDepCloneAll() or from a mirror, so whether it's shallow is
+  found from the ".git/shallow" file git keeps.
+
+  @param  pOpts     Options for displaying system commands/errors.
+  @param  fBranch   TRUE if cloned with a branch= (maybe single-branch)
+  @return TRUE if there was more to fetch and it worked, FALSE if nothing more to try
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDepCloneDeepen(flyMakeOpts_t *pOpts, bool_t fBranch)
+{
+  static const char szGitUnshallow[] = "git fetch -q --unshallow origin '+refs/heads/*:refs/remotes/origin/*'";
+  static const char szGitFetchAll[]  = "git fetch -q origin '+refs/heads/*:refs/remotes/origin/*'";
+  bool_t    fWorked = FALSE;
+
+  if(FlyFileExistsFile(".git/shallow"))
+    fWorked = (FlyMakeSystem(FMK_VERBOSE_MORE, pOpts, szGitUnshallow) == 0) ? TRUE : FALSE;
+  else if(fBranch)
+    fWorked = (FlyMakeSystem(FMK_VERBOSE_MORE, pOpts, szGitFetchAll) == 0) ? TRUE : FALSE;
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Clone a project given a URL into the deps/<depname>/ folder.
+
+  Uses the optional `version=`, `brannch=`, `sha=` and `clone=` flags. A shallow or single-branch
+  clone is deepened only if the version or SHA isn't found in it.
+
+  @param  pDepKeys        Information needed clone
+  @param  szDepName       dependency name, e.g. "foo"
+  @param  szRange         version range, e.g. "1.2" means >=1.2 and <= 2.0
+  @param  szGitUrl        URL to git, e.g. "git@gitlab.com:drew.gislason/foo.git"
+  @param  szFolder        folder where to clone the git repo, e.g. "deps/foo/"
+  @param  ppszVer         return value, version found
+  @return FMK_ERR_NONE or FMK_ERR_CUSTOM
+*///-----------------------------------------------------------------------------------------------
+static fmkErr_t FmkDepPackageClone(
+  fmkDepKeys_t *pDepKeys, 
+  const char   *szDepName, 
+  const char   *szGitUrl,
+  char         *szFolder,
+  char        **ppszVer)
+{
+  flyStrSmart_t   cmdline;
+  char           *szBranch    = NULL;   // e.g. branch="main"
+  char           *szRange     = NULL;   // e.g. range="1.2", means >= 1.2.0 and < 2.0.0
+  char           *szSha       = NULL;   // e.g. sha="5e925d2" or "615619802b2c0b4105eabf516f05f3ad199ef8c9"
+  char           *szClone     = NULL;   // e.g. clone="shallow"
+  char           *szMirror    = NULL;   // e.g. "~/.cache/flymake/git/0123456789abcdef.git"
+  char           *szOrgDir    = NULL;
+  char           *szClonePath = NULL;
+  char           *szVer       = NULL;   // found version in git log
+  fmkDepClone_t   mode;
+  bool_t          fDeepened   = FALSE;
+  bool_t          fLocked     = FALSE;
+  int             ret         = -1;
+  fmkErr_t        err         = FMK_ERR_NONE;
+
+  // git -C mirror fetch && git clone mirror [-b branch] folder/, or if no mirror:
+  // git clone [--depth 1 | --filter=blob:none] url [-b branch] folder/
+  // git log --oneline >tmp.log
+  // git checkout sha
+  // git checkout branch
+
+  FlyAssertDbg(pDepKeys && pDepKeys->pRootState);
+
+  // determine path to clone into, e.g. deps/foo
+  FlyStrSmartInit(&cmdline);
+  szClonePath = FlyStrClone(szFolder);
+  if(!szClonePath)
+    err = FlyMakeErrMem();
+
+  // get a buffer for cloning system commands
+  if(!err && !FlyStrSmartInitEx(&cmdline, PATH_MAX))
+    err = FlyMakeErrMem();
+
+  // allocat strings
+  szBranch = FlyMakeTomlStrAlloc(pDepKeys->keyBranch.szValue);
+  szSha = FlyMakeTomlStrAlloc(pDepKeys->keySha.szValue);
+  szRange = FlyMakeTomlStrAlloc(pDepKeys->keyVer.szValue);
+  szClone = FlyMakeTomlStrAlloc(pDepKeys->keyClone.szValue);
+
+  // shallow or partial clone if pinned to a branch, sha or version
+  mode = FmkDepCloneMode(szClone, szBranch ? TRUE : FALSE, (szSha || szRange) ? TRUE : FALSE);
+  if(!err && mode == FMK_CLONE_INVALID)
+    err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keyClone.szValue, "expected clone=\"full\", \"shallow\" or \"partial\"");
+
+  // clone into the dep folder, e.g. "deps/foo/", unless FmkDepCloneAll() already did
+  if(!err && !pDepKeys->fCloned)
+  {
+    FlyMakeFolderRemove(FMK_VERBOSE_MORE, &pDepKeys->pRootState->opts, szClonePath);
+    FlyMakePrintfEx(FMK_VERBOSE_SOME, "# Cloning %s into %s\n", szGitUrl, szClonePath);
+
+    // clone the project from the local mirror if possible, otherwise from the URL
+    szMirror = FmkDepMirrorAlloc(&pDepKeys->pRootState->opts, szGitUrl);
+    if(szMirror)
+    {
+      FmkDepMirrorCloneCmd(&cmdline, szMirror, szGitUrl, szBranch, szClonePath);
+      ret = FlyMakeSystem(FMK_VERBOSE_MORE, &pDepKeys->pRootState->opts, cmdline.sz);
+      if(ret != 0)
+        FlyMakeFolderRemove(FMK_VERBOSE_MORE, &pDepKeys->pRootState->opts, szClonePath);
+    }
+    if(ret != 0)
+    {
+      FmkDepCloneCmd(&cmdline, mode, szGitUrl, szBranch, szClonePath);
+      ret = FlyMakeSystem(FMK_VERBOSE_MORE, &pDepKeys->pRootState->opts, cmdline.sz);
+    }
+    if(ret != 0)
+    {
+      FlyMakePrintf("error: cannot clone '%s'. Check URL or git permissions.\n", szGitUrl);
+      err = FMK_ERR_CUSTOM;
+    }
+  }
+
+  if(!err)
+  {
+    // don't specify both version and sha
+    if(szRange && szSha)
+    {
+      err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keyVer.szValue, "cannot specify both version and sha");
+    }
+
+    // check out what flymake.lock recorded, if the dependency hasn't changed
+    if(!err && !szSha && FmkDepLockSha(pDepKeys, szDepName, &szSha, &szVer))
+      fLocked = TRUE;
+
+    // user has specified version range or SHA. Find them.
+    if(!err && (szRange || szSha))
+    {
+      FlyFileGetCwd(cmdline.sz, cmdline.size);
+      szOrgDir = FlyStrClone(cmdline.sz);
+      if(!szOrgDir)
+        err = FlyMakeErrMem();
+      else
+      {
+        // change to deps/depname/ folder
+        FlyFileChangeDir(szClonePath);
+
+        // find the Git SHA of the specific version
+        if(szRange && !szSha)
+        {
+          szVer = FmkDepVersionFind(&pDepKeys->pRootState->opts, szRange, &szSha);
+          if(!szSha && FmkDepCloneDeepen(&pDepKeys->pRootState->opts, szBranch ? TRUE : FALSE))
+          {
+            fDeepened = TRUE;
+            FlyStrFreeIf(szVer);
+            szVer = FmkDepVersionFind(&pDepKeys->pRootState->opts, szRange, &szSha);
+          }
+          if(!szSha)
+          {
+            err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keyVer.szValue, "version not found");
+          }
+        }
+
+        // have a SHA, use it
+        if(!err && szSha && !FmkDepCheckoutSha(&pDepKeys->pRootState->opts, szSha))
+        {
+          if(fDeepened || !FmkDepCloneDeepen(&pDepKeys->pRootState->opts, szBranch ? TRUE : FALSE) ||
+             !FmkDepCheckoutSha(&pDepKeys->pRootState->opts, szSha))
+          {
+            if(fLocked)
+              err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keyGit.szValue, "SHA in flymake.lock not found");
+            else
+              err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keySha.szValue, "SHA not found");
+          }
+        }
+
+        // back to our original folder
+        FlyFileChangeDir(szOrgDir);
+      }
+    }
+  }
+
+  // return found version and clone path
+  if(!err)
+    *ppszVer = szVer;
+
+  // cleaup, but do not delete szVer or szClonePath as they are return values
+  FlyStrFreeIf(szOrgDir);
+  FlyStrFreeIf(szSha);
+  FlyStrFreeIf(szBranch);
+  FlyStrFreeIf(szClone);
+  FlyFreeIf(szMirror);
+  FlyStrSmartUnInit(&cmdline);
 
-  1. folder not a project (that is, contains no source files)
-  2. invalid flymake.toml file
-  3. project cannot be built as object file library (package)
+  return err;
+}
 
-  @param  pDepKeys    All the information needed to proce
-  @param  szFolder    file folder, e.g. "../foo/" or "deps/bar/"
-  @param  szDepName   
-  @param  ppState     Returned flyMakeState_t
-  @return FMK_ERR_NONE, FMK_ERR_MEM, FMK_ERR_CUSTOM
+/*-------------------------------------------------------------------------------------------------
+  Process prebuilt dependency.
+
+  This type of dependency is not built by flymake, but is simply included as-is.
+
+  Requires `path=` key to point to a valid `lib.a` file and `inc=` to an include `folder/`.
+
+  @param  pDepKeys      Information needed to process dependency
+  @return FMK_ERR_NONE or FMK_ERR_CUSTOM
 *///-----------------------------------------------------------------------------------------------
-static fmkErr_t FmkDepPackageValidate(
-  fmkDepKeys_t *pDepKeys,
-  const char *szFolder,
-  const char *szDepName,
-  const char *szVer,
-  flyMakeState_t **ppState)
+static fmkErr_t FmkDepProcessPrebuilt(fmkDepKeys_t *pDepKeys)
 {
-  flyMakeState_t *pState        = NULL;
-  fmkErr_t        err           = FMK_ERR_NONE;
-  const char     *szValue       = NULL;
+  flyMakeDep_t   *pDep        = NULL;
+  char           *szLibFile   = NULL;
+  char           *szIncFolder = NULL;
+  char           *szDepName   = NULL;
+  flyStrSmart_t  *pLibs       = NULL;
+  fmkErr_t        err         = FMK_ERR_NONE;
 
+  // should never get here without dep = { path="../some/folder/lib.a", inc="../some/folder/inc/" }
+  FlyAssert(pDepKeys && pDepKeys->keyDep.szKey);
+  FlyAssert(pDepKeys->keyInc.szValue);
+  FlyAssert(pDepKeys->keyPath.szValue);
 
-  FlyAssertDbg(pDepKeys && pDepKeys->pRootState);
-  FlyAssertDbg(szFolder);
-  FlyAssertDbg(ppState);
+  // allocate things we'll need
+  szDepName = FlyMakeTomlKeyAlloc(pDepKeys->keyDep.szKey);
+  szIncFolder = FmkTomlPath(pDepKeys->pState->szRoot, pDepKeys->keyInc.szValue);
+  szLibFile = FmkTomlPath(pDepKeys->pState->szRoot, pDepKeys->keyPath.szValue);
+  if(!szDepName || !szIncFolder || !szLibFile)
+    err = FlyMakeErrMem();
 
-  // create a new empty state, cloning options
+  // print the header
   if(!err)
+    FlyMakePrintfEx(FMK_VERBOSE_SOME, "# Dependency prebuilt: %s: ", szDepName);
+
+  // make sure inc/ folder exists
+  if(!err && !FlyFileExistsFolder(szIncFolder))
   {
-    pState = FlyMakeStateClone(pDepKeys->pRootState);
-    if(!pState)
-      err = FlyMakeErrMem();
+    FlyMakePrintfEx(FMK_VERBOSE_SOME, "\n");
+    err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keyInc.szValue, "include folder not found");
+  }
+
+  // path must point to valid prebuilt library file, e.g. "../project/lib/project.a"
+  if(!err && !FlyFileExistsFile(szLibFile))
+  {
+    FlyMakePrintfEx(FMK_VERBOSE_SOME, "\n");
+    err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keyPath.szValue, "library not found");
+  } 
+
+  // don't allow same dep name with different folders
+  if(!err)
+  {
+    pDep = FmkDepFind(pDepKeys->pRootState->pDepList, szDepName);
+    if(pDep)
+    {
+      if(!FlyFileIsSamePath(szIncFolder, pDep->szIncFolder))
+      {
+        FlyMakePrintfEx(FMK_VERBOSE_SOME, "\n");
+        err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keyInc.szValue, "duplicate dependency, different includer folder");
+        FlyMakePrintf("  previous include folder: %s\n", pDep->szIncFolder);
+      }
+    }
+  }
+
+  // only add dependency if it hasn't already been added (pDep will be non-NULL if previously added)
+  if(!err && !pDep)
+  {
+    pDep = FmkDepNew(szDepName, NULL);
+    if(!pDep)
+      err =  FlyMakeErrMem();
     else
     {
-      // always compile with lib rules, and don't rebuild with -B, only --all
-      pState->opts.fRulesLib = TRUE;
-      pState->opts.fRulesSrc = pState->opts.fRulesTools = FALSE;
-      pState->opts.fRebuild = (pState->opts.fAll) ? TRUE : FALSE;
+      pDepKeys->pRootState->pDepList = FlyListAppend(pDepKeys->pRootState->pDepList, pDep);
+
+      // add dependency library and inc folder to appropriate places
+      FlyMakePrintfEx(FMK_VERBOSE_SOME, "%s\n", szLibFile);
+      pLibs = FlyStrSmartNew(szLibFile);
+      FmkDepAddIncLibs(pDepKeys, szIncFolder, pLibs);
+
+      // remember them for flymake.lock
+      pDep->szIncFolder = FlyStrClone(szIncFolder);
+      if(!pDep->szIncFolder || !FlyStrSmartCpy(&pDep->libs, szLibFile))
+        err = FlyMakeErrMem();
     }
   }
 
-  // verify it's a valid root folder of a project
-  if(!err && !FlyMakeTomlRootFill(pState, szFolder))
+  // cleanup
+  FlyStrSmartFree(pLibs);
+  FlyStrFreeIf(szLibFile);
+  FlyStrFreeIf(szIncFolder);
+  FlyStrFreeIf(szDepName);
+
+  return err;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Process a project style dependency.
+
+  Requires `path=` key to point to a project folder.
+
+  This will set up a new state so that the project can be built, and will add it to the
+  flyMakeDep_t dependency root state's list.
+
+  @param  pDepKeys      All the information needed to proce
+  @return FMK_ERR_NONE or FMK_ERR_CUSTOM
+*///-----------------------------------------------------------------------------------------------
+static fmkErr_t FmkDepProcessPackage(fmkDepKeys_t *pDepKeys)
+{
+  flyMakeDep_t   *pDep       = NULL;
+  char           *szDepName  = NULL;
+  char           *szRange    = NULL;
+  char           *szFolder   = NULL;
+  fmkErr_t        err        = FMK_ERR_NONE;
+
+  FlyAssert(pDepKeys && pDepKeys->keyDep.szKey);
+  FlyAssert(pDepKeys->keyPath.szValue);
+
+  // specified folder in path= key must exist
+  szDepName = FlyMakeTomlKeyAlloc(pDepKeys->keyDep.szKey);
+  szRange   = FmkTomlVerAlloc(pDepKeys->keyVer.szValue);
+  szFolder  = FmkTomlPath(pDepKeys->pState->szRoot, pDepKeys->keyPath.szValue);
+  if(!szRange || !szDepName || !szFolder)
+    err = FlyMakeErrMem();
+
+  // print the header
+  if(!err)
+    FlyMakePrintfEx(FMK_VERBOSE_SOME, "# Dependency project : %s %s: %s\n", szDepName, szRange, szFolder);
+
+  // check for version conflict with existing dep
+  if(!err)
+    err = FmkDepVersionValidate(pDepKeys, szDepName, szRange, &pDep);
+
+  // if not already in dependency list, add the new dependency to the list
+  if(!err)
   {
-    szValue = pDepKeys->keyGit.szValue ? pDepKeys->keyGit.szValue : pDepKeys->keyPath.szValue;
-    err = FlyMakeErrToml(pDepKeys->pState, szValue, "folder not a project");
+    if(pDep)
+      FmkDepAddIncLibs(pDepKeys, pDep->szIncFolder, NULL);
+    else
+      err = FmkDepPackageAdd(pDepKeys, szFolder, szDepName, szRange, NULL, &pDep);
   }
 
-  // validate flymake.toml and allocate things like the name
-  if(!err && !FlyMakeTomlAlloc(pState, szDepName))
+  // display actual version found
+  if(!err)
   {
-    FlyAssert(szValue);
-    err = FlyMakeErrToml(pDepKeys->pState, szValue, "invalid flymake.toml file");
+    FlyAssert(pDep);
+    FlyMakePrintfEx(FMK_VERBOSE_SOME, "#     found version => %s\n", pDep->szVer);
   }
 
-  // fixup project version
-  if(!err && !pState->szProjVer)
+  // cleanup
+  FlyStrFreeIf(szFolder);
+  FlyStrFreeIf(szRange);
+  FlyStrFreeIf(szDepName);
+
+  return err;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Process "git" style dependency. Requires `git=` key to specify a URL.
+
+  Optionally, specify `version=` key to pick version.
+
+  See 
+
+  Requires the following (otherwise, error):
+
+  1. URL specifies a git repository
+  2. User has permissions to check out said repository
+  3. Repository is a valid package (contains source to build a library and an include folder)
+
+  @param  pDepKeys      All the information needed to proce
+  @return FMK_ERR_NONE or FMK_ERR_CUSTOM
+*///-----------------------------------------------------------------------------------------------
+static fmkErr_t FmkDepProcessGit(fmkDepKeys_t *pDepKeys)
+{
+  flyMakeDep_t   *pDep        = NULL;
+  char           *szFolder    = NULL;
+  char           *szDepName   = NULL;
+  char           *szRange     = NULL;
+  char           *szGitUrl    = NULL;
+  char           *szVer       = NULL;
+  unsigned        size;
+  fmkErr_t        err               = FMK_ERR_NONE;
+
+  // validate some parameters
+  FlyAssert(pDepKeys && pDepKeys->keyDep.szKey);
+  FlyAssert(pDepKeys->keyGit.szValue);
+
+  // specified folder in path= key must exist
+  szDepName = FlyMakeTomlKeyAlloc(pDepKeys->keyDep.szKey);
+  szRange   = FmkTomlVerAlloc(pDepKeys->keyVer.szValue);
+  szGitUrl  = FlyMakeTomlStrAlloc(pDepKeys->keyGit.szValue);
+  if(!szRange || !szDepName || !szGitUrl)
+    err = FlyMakeErrMem(); 
+  else
+    FlyMakePrintfEx(FMK_VERBOSE_SOME, "# Dependency git     : %s %s: %s\n", szDepName, szRange, szGitUrl);
+
+  // check if package already exists, and if so, is it in version range?
+  if(!err)
+    err = FmkDepVersionValidate(pDepKeys, szDepName, szRange, &pDep);
+
+  // package not checked out, so clone it here
+  if(!err)
   {
-    if(szVer)
-      pState->szProjVer = FlyStrClone(szVer);
+    // dependency already exists, just add to dep inc/ folder to state including that dependency
+    if(pDep)
+      FmkDepAddIncLibs(pDepKeys, pDep->szIncFolder, NULL);
+
+    // add new dependency
     else
-      pState->szProjVer = FlyStrClone("*");
+    {
+      size = strlen(pDepKeys->pRootState->szDepDir) + strlen(szDepName) + 3;
+      szFolder = FlyAlloc(size);
+      if(!szFolder)
+        err = FlyMakeErrMem();
+      else
+      {
+        strcpy(szFolder, pDepKeys->pRootState->szDepDir);
+        strcat(szFolder, szDepName);
+        strcat(szFolder, "/");
+      }
+
+      // only clone if not already cloned, but check out version if FmkDepCloneAll() just cloned it
+      if(!err && (pDepKeys->fCloned || !FmkDepPackageAlreadyCloned(pDepKeys->pRootState, szDepName)))
+        err = FmkDepPackageClone(pDepKeys, szDepName, szGitUrl, szFolder, &szVer);
+
+      // add the dependency to list
+      if(!err)
+        err = FmkDepPackageAdd(pDepKeys, szFolder, szDepName, szRange, szVer, &pDep);
+
+      // remember what was asked for, for flymake.lock
+      if(!err)
+      {
+        pDep->szGitUrl = FlyStrClone(szGitUrl);
+        pDep->specHash = FmkDepSpecHash(pDepKeys);
+        if(!pDep->szGitUrl)
+          err = FlyMakeErrMem();
+      }
+    }
   }
 
-  if(!err && !FlyMakeFolderFindByRule(pState->pFolderList, FMK_RULE_LIB))
+  // display actual version found
+  if(!err)
   {
-    FlyMakeStatePrint(pState);
-    err = FlyMakeErrToml(pDepKeys->pState, szValue, "project cannot be built as library");
+    FlyAssert(pDep);
+    FlyMakePrintfEx(FMK_VERBOSE_SOME, "#     found version => %s\n", pDep->szVer);
   }
 
-  // failed, free state
-  if(err)
-    FlyMakeStateFree(pState);
-  else
-    *ppState = pState;
+  // cleanup
+  FlyStrFreeIf(szVer);
+  FlyStrFreeIf(szGitUrl);
+  FlyStrFreeIf(szRange);
+  FlyStrFreeIf(szDepName);
 
   return err;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Vallidates and adds the git or package dependency to the deplist.
+  Is the name in a list of space separated names?
 
-  1. Checks that the folder can be built into one or more a libraries.
-  3. Validates actual version of project vs range specified by dependency
-  2. Adds lib to root project, adds inc/ folder to project referencing dependency
+  @param  szList    list of names, with a space before and after each, e.g. " foo bar "
+  @param  szName    name to find, e.g. "foo"
+  @return TRUE if name is in the list
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDepIsInList(const char *szList, const char *szName)
+{
+  const char  *psz;
+  size_t       len;
+  bool_t       fFound = FALSE;
 
-  The actual version found depends on a variety of factors:
+  len = strlen(szName);
+  psz = szList;
+  while((psz = strstr(psz, szName)) != NULL)
+  {
+    if(psz > szList && psz[-1] == ' ' && psz[len] == ' ')
+    {
+      fFound = TRUE;
+      break;
+    }
+    ++psz;
+  }
 
-  szRange  | szVer  | flymake.toml | resulting szProjVer
-  -------- | ------ | ------------ | -------------------
-  1.0      | NULL   | NULL         | *
-  1.0      | 1.3    | NULL         | 1.3
-  1.0      | 1.3    | 1.2          | 1.2
+  return fFound;
+}
 
-  @param  pDepKeys    Information needed to process dependency
-  @param  szFolder    Folder to add
+/*-------------------------------------------------------------------------------------------------
+  Clone all the new git dependencies in a `[dependencies]` table at once, up to FMK_CLONE_JOBS at a
+  time, as cloning is mostly waiting on the network. Versions and SHAs are still checked out one
+  dependency at a time by FmkDepPackageClone().
 
-  @return FMK_ERR_NONE or FMK_ERR_CUSTOM
+  A dependency that fails to clone here is not in pCloned, so FmkDepPackageClone() will try again
+  and report the error.
+
+  @param  pRootState    root project state
+  @param  szDepTable    TOML [dependencies] table
+  @param  pCloned       return value, names of dependencies cloned, e.g. " foo bar "
+  @return none
 *///-----------------------------------------------------------------------------------------------
-static fmkErr_t FmkDepPackageAdd(
-  fmkDepKeys_t *pDepKeys,
-  const char *szFolder,
-  const char *szDepName,
-  const char *szRange,    // version range specified by use, defaults to *
-  const char *szVer,      // may be NULL, what was found in git log
-  flyMakeDep_t **ppDep)
+static void FmkDepCloneAll(flyMakeState_t *pRootState, const char *szDepTable, flyStrSmart_t *pCloned)
 {
-  flyMakeDep_t     *pDep;
-  flyMakeState_t   *pState  = NULL;
-  char             *szLibs;
-  fmkErr_t          err     = FMK_ERR_NONE;
+  flyMakeOpts_t   opts;
+  tomlKey_t       keyDep;
+  tomlKey_t       keyGit;
+  tomlKey_t       keyBranch;
+  tomlKey_t       keyClone;
+  tomlKey_t       keyPin;
+  flyStrSmart_t   cmdline;
+  const char     *pszIter;
+  char           *szDepName   = NULL;
+  char           *szGitUrl    = NULL;
+  char           *szBranch    = NULL;
+  char           *szFolder    = NULL;
+  char           *szClone     = NULL;
+  char           *szMirror    = NULL;
+  fmkDepClone_t   mode;
+  bool_t          fPinned;
+  void           *hJobs;
+  unsigned        size;
+  unsigned        i;
 
-  // allocate a new state if this folder is a valid package
-  err = FmkDepPackageValidate(pDepKeys, szFolder, szDepName, szVer, &pState);
-  if(!err)
+  // clone in parallel, regardless of -j
+  opts = pRootState->opts;
+  opts.jobs = FMK_CLONE_JOBS;
+  hJobs = FlyMakeJobsNew(&opts);
+  FlyStrSmartInit(&cmdline);
+  FlyStrSmartCpy(pCloned, " ");
+
+  pszIter = FlyTomlKeyIter(szDepTable, &keyDep);
+  while(hJobs && pszIter)
   {
-    FlyAssert(pState);
+    // only new git dependencies, e.g. foo = { git="git@github.com:me/foo.git" }
+    memset(&keyGit, 0, sizeof(keyGit));
+    memset(&keyBranch, 0, sizeof(keyBranch));
+    memset(&keyClone, 0, sizeof(keyClone));
+    if(keyDep.type == TOML_INLINE_TABLE && FlyTomlKeyFind(keyDep.szValue, "git", &keyGit) &&
+       keyGit.type == TOML_STRING)
+    {
+      FlyTomlKeyFind(keyDep.szValue, "branch", &keyBranch);
+      FlyTomlKeyFind(keyDep.szValue, "clone", &keyClone);
+      fPinned = (FlyTomlKeyFind(keyDep.szValue, "sha", &keyPin) ||
+                 FlyTomlKeyFind(keyDep.szValue, "version", &keyPin)) ? TRUE : FALSE;
+      szDepName = FlyMakeTomlKeyAlloc(keyDep.szKey);
+      szGitUrl  = FlyMakeTomlStrAlloc(keyGit.szValue);
+      szBranch  = (keyBranch.type == TOML_STRING) ? FlyMakeTomlStrAlloc(keyBranch.szValue) : NULL;
+      szClone   = (keyClone.type == TOML_STRING) ? FlyMakeTomlStrAlloc(keyClone.szValue) : NULL;
+
+      // leave a bad clone= for FmkDepPackageClone() to report
+      mode = FmkDepCloneMode(szClone, szBranch ? TRUE : FALSE, fPinned);
+      if(szDepName && szGitUrl && mode != FMK_CLONE_INVALID && !FmkDepFind(pRootState->pDepList, szDepName) &&
+         !FmkDepPackageAlreadyCloned(pRootState, szDepName))
+      {
+        size = strlen(pRootState->szDepDir) + strlen(szDepName) + 2;
+        szFolder = FlyAlloc(size);
+        if(szFolder)
+        {
+          FlyStrZCpy(szFolder, pRootState->szDepDir, size);
+          FlyStrZCat(szFolder, szDepName, size);
+          FlyStrZCat(szFolder, "/", size);
+          FlyMakeFolderRemove(FMK_VERBOSE_MORE, &pRootState->opts, szFolder);
+          FlyMakePrintfEx(FMK_VERBOSE_SOME, "# Cloning %s into %s\n", szGitUrl, szFolder);
+          szMirror = FmkDepMirrorAlloc(&pRootState->opts, szGitUrl);
+          if(szMirror)
+            FmkDepMirrorCloneCmd(&cmdline, szMirror, szGitUrl, szBranch, szFolder);
+          else
+            FmkDepCloneCmd(&cmdline, mode, szGitUrl, szBranch, szFolder);
+          if(cmdline.sz)
+            FlyMakeJobsAdd(hJobs, szDepName, cmdline.sz, 0);
+        }
+      }
+      FlyStrFreeIf(szDepName);
+      FlyStrFreeIf(szGitUrl);
+      FlyStrFreeIf(szBranch);
+      FlyStrFreeIf(szClone);
+      FlyFreeIf(szFolder);
+      FlyFreeIf(szMirror);
+      szMirror = NULL;
+      szDepName = szGitUrl = szBranch = szFolder = szClone = NULL;
+    }
+
+    pszIter = FlyTomlKeyIter(pszIter, &keyDep);
   }
 
-  // create new dependency
-  if(!err)
+  // remember which dependencies were cloned
+  FlyMakeJobsWait(hJobs);
+  for(i = 0; i < FlyMakeJobsLen(hJobs); ++i)
   {
-    pDep = FmkDepNew(szDepName, szRange);
-    if(!pDep)
-      err = FlyMakeErrMem();
-    else
+    if(FlyMakeJobsStatus(hJobs, i) == 0)
     {
-      pDep->szVer       = FlyStrClone(pState->szProjVer);
-      szLibs            = FlyStrSmartCpy(&pDep->libs, pState->libs.sz);
-      pDep->szIncFolder = FlyStrClone(pState->szInc);
-      pDep->pState      = pState;
-      if(!pDep->szVer || !szLibs || !pDep->szIncFolder)
-        err = FlyMakeErrMem();
+      FlyStrSmartCat(pCloned, FlyMakeJobsGetName(hJobs, i));
+      FlyStrSmartCat(pCloned, " ");
     }
   }
 
-  // add dependency to root state
-  if(!err)
-    pDepKeys->pRootState->pDepList = FlyListAppend(pDepKeys->pRootState->pDepList, pDep);
-
-  // validate version of package vs specified version range (also fills in ppDep)
-  if(!err)
-    err = FmkDepVersionValidate(pDepKeys, szDepName, szRange, ppDep);
+  FlyMakeJobsFree(hJobs);
+  FlyStrSmartUnInit(&cmdline);
+}
 
-  // add include/ folder to current state and and library/file.a to root state
-  if(!err)
-    FmkDepAddIncLibs(pDepKeys, pState->szInc, &pState->libs);
+/*-------------------------------------------------------------------------------------------------
+  Recursively process flymake.toml `[dependencies]`. Results in pRootState->pDepList filled in.
 
-  if(err)
-    *ppDep = NULL;
+  Also updates pRootState->libs and pState->incs.
 
-  return err;
-}
+  Broad first, then deep. That is, process all `[dependencies]` in this TOML file, then check each
+  dependency for sub-dependencies and so on.
 
-/*-------------------------------------------------------------------------------------------------
-  Look in this line for semantic version, e.g. v1.2.3. or version 1 or ver 2.0.
+  Prints error and returns FMK_ERR_CUSTOM if there is a problem.
 
-  @param  szLine    a line of text
-  @param  lineLen   length of line
-  @return ptr to allocated string if semver found, otherwise NULL
+  @param  pRootState    root project state
+  @param  pState        state of project containing flymake.toml `[dependencies]`
+  @param  szLock        flymake.lock loaded into memory, or NULL
+  @return FMK_ERR_NONE or FMK_ERR_CUSTOM
 *///-----------------------------------------------------------------------------------------------
-char * FmkDepVerFindInLine(const char *szLine, unsigned lineLen)
+static fmkErr_t FmkDepProcessToml(flyMakeState_t *pRootState, flyMakeState_t *pState, const char *szLock)
 {
-  static const char  *aVerStrs[] = { "version", "ver", "v"};
-  char               *szSemVer = NULL;
-  unsigned            i;
-  unsigned            n;
-  bool_t              fFound = FALSE;
+  const char     *pszDepTable     = NULL; // table of [dependencies]
+  const char     *pszIter         = NULL; // iter through dependencies
+  const char     *pszInlineTable;
+  flyMakeDep_t   *pDep            = NULL;
+  fmkDepKeys_t    depKeys;
+  fmkDepKeyVal_t  aKeyVal[] =
+  {
+    { "git",     &depKeys.keyGit },
+    { "inc",     &depKeys.keyInc },
+    { "path",    &depKeys.keyPath },
+    { "version", &depKeys.keyVer },
+    { "sha",     &depKeys.keySha },
+    { "branch",  &depKeys.keyBranch },
+    { "clone",   &depKeys.keyClone },
+  };
+  flyStrSmart_t   cloned;
+  char           *szDepName;
+  unsigned        i;
+  fmkErr_t        err = FMK_ERR_NONE;
 
-  while(lineLen && !fFound)
+  // verify inputs
+  FlyAssert(FlyMakeIsState(pRootState));
+  FlyAssert(FlyMakeIsState(pState));
+  FlyAssert(pState->szRoot && pState->szFullPath);
+
+  FlyMakeDbgPrintf(FMK_DEBUG_SOME, "FmkDepProcessToml(%s,%s)\n", pRootState->szRoot, pState->szRoot);
+
+  // nothing to do if no flymake.toml or no [dependencies]
+  if(FmkDepNumDependencies(pState->szTomlFile) == 0)
   {
-    if(toupper(*szLine) == 'V')
+    FlyMakePrintfEx(FMK_VERBOSE_MORE, "# no dependencies in project `%s`\n", pState->szFullPath);
+    return FMK_ERR_NONE;
+  }
+
+  // initialize structure used to process dependencies
+  memset(&depKeys, 0, sizeof(depKeys));
+  depKeys.pRootState = pRootState;
+  depKeys.pState = pState;
+  depKeys.szLock = szLock;
+
+  // clone all new git dependencies at this level at once
+  FlyStrSmartInit(&cloned);
+  pszDepTable = FlyTomlTableFind(pState->szTomlFile, m_szDepTable);
+  if(pszDepTable)
+    FmkDepCloneAll(pRootState, pszDepTable, &cloned);
+
+  // process each dependency (TOML inline table)
+  if(pszDepTable)
+    pszIter = FlyTomlKeyIter(pszDepTable, &depKeys.keyDep);
+  while(!err && pszIter)
+  {
+    // every dependency must be a TOML inline table, e.g. foo = { "path" = "../foo/" }
+    if(depKeys.keyDep.type != TOML_INLINE_TABLE)
     {
-      for(i = 0; i < NumElements(aVerStrs); ++i)
+      FlyMakeErrToml(pState, depKeys.keyDep.szValue, "expected inline table");
+      err = FMK_ERR_CUSTOM;
+      break;
+    }
+
+    // look for inline table keys we recognize in this dependency
+    pszInlineTable = depKeys.keyDep.szValue;
+    for(i = 0; !err && i < NumElements(aKeyVal); ++i)
+    {
+      if(FlyTomlKeyFind(pszInlineTable, aKeyVal[i].szKey, aKeyVal[i].pKey))
+        err = FlyMakeTomlCheckString(pState, aKeyVal[i].pKey);
+    }
+
+    // print out keys found, all on one line
+    if(!err && FlyMakeDebug() >= FMK_DEBUG_MORE)
+    {
+      for(i = 0; i < NumElements(aKeyVal); ++i)
       {
-        n = strlen(aVerStrs[i]);
-        if(strncasecmp(szLine, aVerStrs[i], n) == 0)
+        if(i == 0)
         {
-          szLine = FlyStrSkipWhite(szLine + n);
-          n = FlySemVerCpy(NULL, szLine, lineLen);
-          if(n != 0)
-          {
-            szSemVer = FlyAlloc(n + 1);
-            FlySemVerCpy(szSemVer, szLine, n + 1);
-            fFound = TRUE;
-            break;
-          }
+          FlyMakePrintf("%.*s = { ",
+            FlyTomlKeyLen(depKeys.keyDep.szKey), depKeys.keyDep.szKey);
+        }
+        if(aKeyVal[i].pKey->szValue)
+        {
+          if(i != 0)
+            FlyMakePrintf(", ");
+          FmkTomlKeyPrint(aKeyVal[i].szKey, aKeyVal[i].pKey->szValue);
         }
       }
+      FlyMakePrintf(" }\n");
     }
-    ++szLine;
-    --lineLen;
+
+    // must have either a path= or git= key
+    if(!depKeys.keyGit.szValue && !depKeys.keyPath.szValue)
+      err = FlyMakeErrToml(pState, pszInlineTable, "expected \"path=\" or \"git=\" key in inline table");
+
+    // was it cloned by FmkDepCloneAll()? e.g. " foo " in " bar foo "
+    depKeys.fCloned = FALSE;
+    szDepName = FlyMakeTomlKeyAlloc(depKeys.keyDep.szKey);
+    if(szDepName && cloned.sz)
+      depKeys.fCloned = FmkDepIsInList(cloned.sz, szDepName);
+    FlyStrFreeIf(szDepName);
+
+    if(!err)
+    {
+      pDep = FmkDepTomlFind(pRootState->pDepList, depKeys.keyDep.szKey);
+      if(pDep)
+        FmkDepAddIncLibs(&depKeys, pDep->szIncFolder, NULL);
+      else if(depKeys.keyGit.szValue)
+        err = FmkDepProcessGit(&depKeys);
+      else if(depKeys.keyInc.szValue && depKeys.keyPath.szValue)
+        err = FmkDepProcessPrebuilt(&depKeys);
+      else
+        err = FmkDepProcessPackage(&depKeys);
+    }
+
+    // remember which dependencies each dependency needs, so they're built in order
+    if(!err && pState != pRootState)
+      err = FmkDepNeedsAdd(pRootState, pState, depKeys.keyDep.szKey);
+
+    // look for next dependency
+    pszIter = FlyTomlKeyIter(pszIter, &depKeys.keyDep);
   }
 
-  return szSemVer;
+  // iter through TOML file again and see if we need to recurse into any of the projects
+  if(pszDepTable)
+    pszIter = FlyTomlKeyIter(pszDepTable, &depKeys.keyDep);
+  while(!err && pszIter)
+  {
+    // process only those dependencies with flymake.toml files
+    pDep = FmkDepTomlFind(pRootState->pDepList, depKeys.keyDep.szKey);
+    if(pDep && pDep->pState && pDep->pState->szTomlFile && FmkDepNumDependencies(pDep->pState->szTomlFile))
+      err = FmkDepProcessToml(pRootState, pDep->pState, szLock);
+
+    // look for next dependency
+    pszIter = FlyTomlKeyIter(pszIter, &depKeys.keyDep);
+  }
+
+  FlyStrSmartUnInit(&cloned);
+  FlyMakeDbgPrintf(FMK_DEBUG_SOME, "  err %u, root: incs \"%s\", libs \"%s\"\n", err, pRootState->incs.sz, pRootState->libs.sz);
+
+  return err;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Given a version range, look in the git log for find a SHA that matches.
+  Builds all "standard" folders in the project
 
-  For example, if version range is "1", then it will look for versions >= 1.0.0 and < 2.0.0.
+  @param  pState          filled out state, e.g. pState->szRoot is filled out
+  @return FMK_ERR_NONE if worked, some other FMK_ERR if failed
+*///-----------------------------------------------------------------------------------------------
+static fmkErr_t FmkDepBuildProject(flyMakeState_t *pState)
+{
+  flyMakeFolder_t  *pFolder;
+  fmkErr_t          err = FMK_ERR_NONE;
+
+  // verify dependency state has been initialized
+  FlyAssert(FlyMakeIsState(pState) && pState->szRoot);
+  FlyMakeDbgPrintf(FMK_DEBUG_SOME, "FmkDepBuildProject(%s)\n", pState->szRoot);
+
+  // ignore cmdline rules for dependencies, use only specified folder rules
+  pState->opts.fRulesLib = pState->opts.fRulesSrc = pState->opts.fRulesTools = FALSE;
 
-  @param  pOpts     So system calls are printed properly
-  @param  szRange   The version range to find
-  @return allocated SHA or NULL if version found
-*///-----------------------------------------------------------------------------------------------
-static char * FmkDepVersionFind(flyMakeOpts_t *pOpts, const char *szRange, char **ppszSha)
-{
-  static const char   szMakeGitLog[]    = "git log --oneline >log.tmp";
-  static const char   szRemoveGitLog[]  = "rm -f log.tmp";
-  static const char   szLogFileName[]   = "log.tmp";
-  const char         *szLine;
-  char               *szTmpFile;
-  char               *szSemVer          = NULL;
-  char               *szSha             = NULL;
-  unsigned            size;
+  // build libraries first
+  err = FlyMakeBuildLibs(pState);
 
-  FlyMakeSystem(FMK_VERBOSE_MORE, pOpts, szMakeGitLog);
-  szTmpFile = FlyFileRead(szLogFileName);
-  if(szTmpFile)
+  // build all known and existing folders in dependency project
+  pFolder = pState->pFolderList;
+  while(!err && pFolder)
   {
-    szLine = szTmpFile;
-    while(*szLine)
-    {
-      szSemVer = FmkDepVerFindInLine(szLine, (unsigned)FlyStrLineLen(szLine));
-      if(szSemVer)
-      {
-        // debugging
-        if(FlyMakeDebug() >= FMK_DEBUG_MORE)
-          FlyMakePrintf("dbg: found szSemVer '%s' in line '%.*s'\n", szSemVer, (unsigned)FlyStrLineLen(szLine), szLine);
+    // build each existing folder
+    if(pFolder->rule == FMK_RULE_SRC && !FlyMakeBuildSrc(pState, pFolder->szFolder))
+      err = FMK_ERR_CUSTOM;
+    else if(pFolder->rule == FMK_RULE_TOOL && !FlyMakeBuildTools(pState, pFolder->szFolder, NULL))
+      err = FMK_ERR_CUSTOM;
 
-        // e.g. cba1855 fixes #271 v1.2.1 Added SemVer
-        if(!FlySemVerMatch(szRange, szSemVer) || !isxdigit(*szLine))
-          FlyFree(szSemVer);
-        else
-        {
-          size = FlyStrArgLen(szLine) + 1;
-          szSha = FlyAlloc(size);
-          if(szSha)
-          {
-            strncpy(szSha, szLine, size - 1);
-            szSha[size - 1] = '\0';
-            // debugging
-            if(FlyMakeDebug() >= FMK_DEBUG_MORE)
-              FlyMakePrintf("dbg: found sha '%s'\n", szSha);
-          }
-          break;
-        }
-      }
-      szLine = FlyStrLineNext(szLine);
-    }
+    pFolder = pFolder->pNext;
   }
-  FlyStrFreeIf(szTmpFile);
-  FlyMakeSystem(FMK_VERBOSE_MORE, pOpts, szRemoveGitLog);
 
-  // return both SHA and found version
-  *ppszSha = szSha;
-  return szSemVer;
+  return err;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Checkout the given sha
+  Is this target root folder the same as the target file/folder?
 
-  @param  pOpts   Options for displaying system commands/errors.
-  @param  szSha   short SHA for checkout, e.g. "4cb16b7"
-  @return allocated SHA or NULL if version found
+  @param    pState        filled in flymake state (must have pState->szRoot)
+  @param    szTargetRoot  target file/folder
+  @return   TRUE if same root folder
 *///-----------------------------------------------------------------------------------------------
-bool_t FmkDepCheckoutSha(flyMakeOpts_t *pOpts, const char *szSha)
+bool_t FlyMakeIsSameRoot(flyMakeState_t *pState, const char *szTarget)
 {
-  static const char szGitCheckout[] = "git checkout -q ";
-  char     *szCmdline;
-  unsigned  size;
-  bool_t    fWorked = FALSE;
+  char   *szTargetRoot;
+  bool_t  fIsSameRoot;
 
-  size = sizeof(szGitCheckout) + strlen(szSha);
-  szCmdline = FlyAlloc(size);
-  if(szCmdline)
-  {
-    FlyStrZCpy(szCmdline, szGitCheckout, size);
-    FlyStrZCat(szCmdline, szSha, size);
-    if(FlyMakeSystem(FMK_VERBOSE_MORE, pOpts, szCmdline) == 0)
-      fWorked = TRUE;
-  }
+  szTargetRoot = FlyMakeTomlRootFind(szTarget, pState->pCompilerList, NULL);
+  fIsSameRoot = FlyMakeIsSameFolder(pState->szRoot, szTargetRoot);
+  FlyFree(szTargetRoot);
 
-  return fWorked;
+  return fIsSameRoot;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Has this szDepName already been cloned? Checks for "deps/<depname>/.git/" folder.
+  Allocate the path to flymake.lock, e.g. "../flymake.lock"
 
-  @param  szDepDir        dep folder, e.g. "deps/" or "../deps/"
-  @param  szDepName       dependency name, e.g. "foo"
-  @return TRUE if already cloned, FALSE if not
+  @param  pRootState    root project state
+  @return allocated path, or NULL if out of memory
 *///-----------------------------------------------------------------------------------------------
-static bool_t FmkDepPackageAlreadyCloned(const char *szDepDir, const char *szDepName)
+static char * FmkDepLockPathAlloc(const flyMakeState_t *pRootState)
 {
-  const char szGitFolder[] = ".git/";
-  unsigned    size;
   char       *szPath;
-  bool_t      fExists = FALSE;
+  unsigned    size;
 
-  // check if .git folder exists already, e.g. "deps/foo/.git/"
-  size = strlen(szDepDir) + strlen(szDepName) + sizeof(szGitFolder) + 4;
+  size = strlen(pRootState->szRoot) + sizeof(m_szLockFile);
   szPath = FlyAlloc(size);
   if(szPath)
   {
-    FlyStrZCpy(szPath, szDepDir, size);
-    FlyStrZCat(szPath, szDepName, size);
-    FlyStrZCat(szPath, "/", size);
-    FlyStrZCat(szPath, szGitFolder, size);
-    fExists = FlyFileExistsFolder(szPath);
+    FlyStrZCpy(szPath, pRootState->szRoot, size);
+    FlyStrZCat(szPath, m_szLockFile, size);
   }
 
-  return fExists;
+  return szPath;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Clone a project given a URL into the deps/<depname>/ folder.
+  Append space separated paths, converting them between relative to the current folder (as used
+  in states) and relative to the root project (as saved in flymake.lock), e.g. "../deps/foo/inc/"
+  and "deps/foo/inc/" if the root is "../".
+
+  @param  pStr      string to append to
+  @param  szRoot    root of project, e.g. "../"
+  @param  szPaths   space separated paths
+  @param  fToLock   TRUE to remove szRoot from each path, FALSE to add it
+  @return none
+*///-----------------------------------------------------------------------------------------------
+static void FmkDepLockPathsCat(flyStrSmart_t *pStr, const char *szRoot, const char *szPaths, bool_t fToLock)
+{
+  char         *szCopy;
+  char         *psz;
+  char          c;
+  unsigned      len;
+  unsigned      rootLen;
+
+  rootLen = strlen(szRoot);
+  szCopy = FlyStrClone(szPaths);
+  psz = szCopy ? (char *)FlyStrSkipWhite(szCopy) : "";
+  while(*psz)
+  {
+    len = (unsigned)FlyStrArgLen(psz);
+    c = psz[len];
+    psz[len] = '\0';
+    if(pStr->sz && *pStr->sz && pStr->sz[strlen(pStr->sz) - 1] != ' ')
+      FlyStrSmartCat(pStr, " ");
+    if(fToLock && len >= rootLen && strncmp(psz, szRoot, rootLen) == 0)
+      FlyStrSmartCat(pStr, psz + rootLen);
+    else
+    {
+      if(!fToLock)
+        FlyStrSmartCat(pStr, szRoot);
+      FlyStrSmartCat(pStr, psz);
+    }
+    psz[len] = c;
+    psz = (char *)FlyStrSkipWhite(psz + len);
+  }
+  FlyStrFreeIf(szCopy);
+}
 
-  Uses the optional `version=`, `brannch=` and `sha=` flags. 
+/*-------------------------------------------------------------------------------------------------
+  Add the include folders of the dependencies in a flymake.toml to its state, the same as
+  FmkDepProcessToml() does, but from the dependency list restored from flymake.lock.
 
-  @param  pDepKeys        Information needed clone
-  @param  szDepName       dependency name, e.g. "foo"
-  @param  szRange         version range, e.g. "1.2" means >=1.2 and <= 2.0
-  @param  szGitUrl        URL to git, e.g. "git@gitlab.com:drew.gislason/foo.git"
-  @param  szFolder        folder where to clone the git repo, e.g. "deps/foo/"
-  @param  ppszVer         return value, version found
-  @return FMK_ERR_NONE or FMK_ERR_CUSTOM
+  @param  pRootState    root project state
+  @param  pState        state of project containing flymake.toml `[dependencies]`
+  @return TRUE if every dependency was in the list
 *///-----------------------------------------------------------------------------------------------
-static fmkErr_t FmkDepPackageClone(
-  fmkDepKeys_t *pDepKeys, 
-  const char   *szDepName, 
-  const char   *szGitUrl,
-  char         *szFolder,
-  char        **ppszVer)
+static bool_t FmkDepLockIncs(flyMakeState_t *pRootState, flyMakeState_t *pState)
 {
-  flyStrSmart_t   cmdline;
-  char           *szBranch    = NULL;   // e.g. branch="main"
-  char           *szRange     = NULL;   // e.g. range="1.2", means >= 1.2.0 and < 2.0.0
-  char           *szSha       = NULL;   // e.g. sha="5e925d2" or "615619802b2c0b4105eabf516f05f3ad199ef8c9"
-  char           *szOrgDir    = NULL;
-  char           *szClonePath = NULL;
-  char           *szVer       = NULL;   // found version in git log
-  fmkErr_t        err         = FMK_ERR_NONE;
-
-  // git clone url [-b branch] folder/
-  // git log --oneline >tmp.log
-  // git checkout sha
-  // git checkout branch
+  fmkDepKeys_t    depKeys;
+  flyMakeDep_t   *pDep;
+  const char     *pszIter = NULL;
+  bool_t          fWorked = TRUE;
 
-  FlyAssertDbg(pDepKeys && pDepKeys->pRootState);
+  memset(&depKeys, 0, sizeof(depKeys));
+  depKeys.pRootState = pRootState;
+  depKeys.pState = pState;
 
-  // determine path to clone into, e.g. deps/foo
-  FlyStrSmartInit(&cmdline);
-  szClonePath = FlyStrClone(szFolder);
-  if(!szClonePath)
-    err = FlyMakeErrMem();
+  if(pState->szTomlFile)
+    pszIter = FlyTomlTableFind(pState->szTomlFile, m_szDepTable);
+  if(pszIter)
+    pszIter = FlyTomlKeyIter(pszIter, &depKeys.keyDep);
+  while(fWorked && pszIter)
+  {
+    pDep = FmkDepTomlFind(pRootState->pDepList, depKeys.keyDep.szKey);
+    if(!pDep)
+      fWorked = FALSE;
+    else
+    {
+      FmkDepAddIncLibs(&depKeys, pDep->szIncFolder, NULL);
+      if(pState != pRootState && FmkDepNeedsAdd(pRootState, pState, depKeys.keyDep.szKey) != FMK_ERR_NONE)
+        fWorked = FALSE;
+    }
+    pszIter = FlyTomlKeyIter(pszIter, &depKeys.keyDep);
+  }
 
-  // get a buffer for cloning system commands
-  if(!err && !FlyStrSmartInitEx(&cmdline, PATH_MAX))
-    err = FlyMakeErrMem();
+  return fWorked;
+}
 
-  // allocat strings
-  szBranch = FlyMakeTomlStrAlloc(pDepKeys->keyBranch.szValue);
-  szSha = FlyMakeTomlStrAlloc(pDepKeys->keySha.szValue);
-  szRange = FlyMakeTomlStrAlloc(pDepKeys->keyVer.szValue);
+/*-------------------------------------------------------------------------------------------------
+  Restore one dependency from flymake.lock, checking that its folder and flymake.toml haven't
+  changed.
 
-  // nothing to do if already checked out (hidden .git folder present)
-  if(!err)
+  @param  pRootState    root project state
+  @param  szName        dependency name, e.g. "foo"
+  @param  keyLock       key in flymake.lock, e.g. foo = { folder="deps/foo/", ... }
+  @return new dependency, or NULL if flymake.lock no longer matches
+*///-----------------------------------------------------------------------------------------------
+static flyMakeDep_t * FmkDepLockDepNew(flyMakeState_t *pRootState, const char *szName, const tomlKey_t *pKeyLock)
+{
+  flyMakeDep_t     *pDep      = NULL;
+  flyMakeState_t   *pState    = NULL;
+  tomlKey_t         keyRange;
+  flyStrSmart_t     folder;
+  flyStrSmart_t     inc;
+  char             *szFolder;
+  char             *szInc;
+  char             *szLibs;
+  char             *szVer;
+  char             *szHash;
+  char             *szGitUrl;
+  char             *szSpec;
+  char              szTomlHash[20];
+  bool_t            fWorked   = TRUE;
+
+  FlyStrSmartInit(&folder);
+  FlyStrSmartInit(&inc);
+  memset(&keyRange, 0, sizeof(keyRange));
+  FlyTomlKeyFind(pKeyLock->szValue, "range", &keyRange);
+  szFolder  = FmkDepLockStrAlloc(pKeyLock->szValue, "folder");
+  szInc     = FmkDepLockStrAlloc(pKeyLock->szValue, "inc");
+  szLibs    = FmkDepLockStrAlloc(pKeyLock->szValue, "libs");
+  szVer     = FmkDepLockStrAlloc(pKeyLock->szValue, "version");
+  szHash    = FmkDepLockStrAlloc(pKeyLock->szValue, "hash");
+  szGitUrl  = FmkDepLockStrAlloc(pKeyLock->szValue, "git");
+  szSpec    = FmkDepLockStrAlloc(pKeyLock->szValue, "spec");
+
+  pDep = FmkDepNew(szName, (keyRange.type == TOML_STRING) ? keyRange.szValue : NULL);
+  if(!pDep)
+    fWorked = FALSE;
+
+  // project dependency, e.g. foo = { folder="deps/foo/", hash="..." }, must still have same flymake.toml
+  else if(szFolder)
   {
-    // clone into the dep folder, e.g. "deps/foo/"
-    FlyMakeFolderRemove(FMK_VERBOSE_MORE, &pDepKeys->pRootState->opts, szClonePath);
-    FlyMakePrintfEx(FMK_VERBOSE_SOME, "# Cloning %s into %s\n", szGitUrl, szClonePath);
-
-    // clone the project
-    FlyStrSmartCpy(&cmdline, "git clone -q ");
-    FlyStrSmartCat(&cmdline, szGitUrl);
-    FlyStrSmartCat(&cmdline, szBranch ? " -b " : " ");
-    if(szBranch)
-      FlyStrSmartCat(&cmdline, szBranch);
-    FlyStrSmartCat(&cmdline, szClonePath);
-    if(FlyMakeSystem(FMK_VERBOSE_MORE, &pDepKeys->pRootState->opts, cmdline.sz) != 0)
+    FmkDepLockPathsCat(&folder, pRootState->szRoot, szFolder, FALSE);
+    if(!folder.sz || (szGitUrl && !FmkDepPackageAlreadyCloned(pRootState, szName)))
+      fWorked = FALSE;
+    if(fWorked)
     {
-      FlyMakePrintf("error: cannot clone '%s'. Check URL or git permissions.\n", szGitUrl);
-      err = FMK_ERR_CUSTOM;
+      pState = FmkDepStateNew(pRootState);
+      if(!pState || !FlyMakeTomlRootFill(pState, folder.sz) || !FlyMakeTomlAlloc(pState, szName))
+        fWorked = FALSE;
     }
-
-    // don't specify both version and sha
-    if(szRange && szSha)
+    if(fWorked)
     {
-      err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keyVer.szValue, "cannot specify both version and sha");
+      snprintf(szTomlHash, sizeof(szTomlHash), "%016llx",
+               (unsigned long long)FlyMakeHashStr(pState->szTomlFile ? pState->szTomlFile : ""));
+      if(!szHash || strcmp(szHash, szTomlHash) != 0)
+        fWorked = FALSE;
     }
-
-    // user has specified version range or SHA. Find them.
-    if(!err && (szRange || szSha))
+    if(fWorked && !pState->szProjVer)
+      pState->szProjVer = FlyStrClone(szVer ? szVer : "*");
+    if(fWorked)
     {
-      FlyFileGetCwd(cmdline.sz, cmdline.size);
-      szOrgDir = FlyStrClone(cmdline.sz);
-      if(!szOrgDir)
-        err = FlyMakeErrMem();
-      else
-      {
-        // change to deps/depname/ folder
-        FlyFileChangeDir(szClonePath);
-
-        // find the Git SHA of the specific version
-        if(szRange && !szSha)
-        {
-          szVer = FmkDepVersionFind(&pDepKeys->pRootState->opts, szRange, &szSha);
-          if(!szSha)
-          {
-            err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keyVer.szValue, "version not found");
-          }
-        }
-
-        // have a SHA, use it
-        if(szSha && !FmkDepCheckoutSha(&pDepKeys->pRootState->opts, szSha))
-        {
-          err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keySha.szValue, "SHA not found");
-        }
-
-        // back to our original folder
-        FlyFileChangeDir(szOrgDir);
-      }
+      pDep->pState      = pState;
+      pState            = NULL;
+      pDep->szVer       = FlyStrClone(pDep->pState->szProjVer);
+      pDep->szIncFolder = FlyStrClone(pDep->pState->szInc);
+      if(!pDep->szVer || !pDep->szIncFolder || !FlyStrSmartCpy(&pDep->libs, pDep->pState->libs.sz))
+        fWorked = FALSE;
+    }
+    if(fWorked && szGitUrl)
+    {
+      pDep->szGitUrl = szGitUrl;
+      szGitUrl = NULL;
+      if(szSpec)
+        pDep->specHash = strtoull(szSpec, NULL, 16);
     }
   }
 
-  // return found version and clone path
-  if(!err)
-    *ppszVer = szVer;
+  // prebuilt dependency, e.g. foo = { inc="foo/inc/", libs="foo/lib/foo.a" }
+  else if(szInc && szLibs)
+  {
+    FmkDepLockPathsCat(&inc, pRootState->szRoot, szInc, FALSE);
+    FmkDepLockPathsCat(&pDep->libs, pRootState->szRoot, szLibs, FALSE);
+    pDep->szIncFolder = inc.sz ? FlyStrClone(inc.sz) : NULL;
+    if(!pDep->szIncFolder || !pDep->libs.sz || !FlyFileExistsFolder(pDep->szIncFolder) ||
+       !FlyFileExistsFile(pDep->libs.sz))
+    {
+      fWorked = FALSE;
+    }
+  }
+  else
+    fWorked = FALSE;
 
-  // cleaup, but do not delete szVer or szClonePath as they are return values
-  FlyStrFreeIf(szOrgDir);
-  FlyStrFreeIf(szSha);
-  FlyStrFreeIf(szBranch);
-  FlyStrSmartUnInit(&cmdline);
+  if(!fWorked && pDep)
+    pDep = FmkDepFree(pDep);
+  if(pState)
+    FlyMakeStateFree(pState);
+  FlyStrSmartUnInit(&folder);
+  FlyStrSmartUnInit(&inc);
+  FlyStrFreeIf(szFolder);
+  FlyStrFreeIf(szInc);
+  FlyStrFreeIf(szLibs);
+  FlyStrFreeIf(szVer);
+  FlyStrFreeIf(szHash);
+  FlyStrFreeIf(szGitUrl);
+  FlyStrFreeIf(szSpec);
 
-  return err;
+  return pDep;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Process prebuilt dependency.
-
-  This type of dependency is not built by flymake, but is simply included as-is.
-
-  Requires `path=` key to point to a valid `lib.a` file and `inc=` to an include `folder/`.
-
-  @param  pDepKeys      Information needed to process dependency
-  @return FMK_ERR_NONE or FMK_ERR_CUSTOM
-*///-----------------------------------------------------------------------------------------------
-static fmkErr_t FmkDepProcessPrebuilt(fmkDepKeys_t *pDepKeys)
-{
-  flyMakeDep_t   *pDep        = NULL;
-  char           *szLibFile   = NULL;
-  char           *szIncFolder = NULL;
-  char           *szDepName   = NULL;
-  flyStrSmart_t  *pLibs       = NULL;
-  fmkErr_t        err         = FMK_ERR_NONE;
-
-  // should never get here without dep = { path="../some/folder/lib.a", inc="../some/folder/inc/" }
-  FlyAssert(pDepKeys && pDepKeys->keyDep.szKey);
-  FlyAssert(pDepKeys->keyInc.szValue);
-  FlyAssert(pDepKeys->keyPath.szValue);
-
-  // allocate things we'll need
-  szDepName = FlyMakeTomlKeyAlloc(pDepKeys->keyDep.szKey);
-  szIncFolder = FmkTomlPath(pDepKeys->pState->szRoot, pDepKeys->keyInc.szValue);
-  szLibFile = FmkTomlPath(pDepKeys->pState->szRoot, pDepKeys->keyPath.szValue);
-  if(!szDepName || !szIncFolder || !szLibFile)
-    err = FlyMakeErrMem();
-
-  // print the header
-  if(!err)
-    FlyMakePrintfEx(FMK_VERBOSE_SOME, "# Dependency prebuilt: %s: ", szDepName);
+  Use flymake.lock instead of discovering the dependencies, if flymake.toml hasn't changed since
+  it was written and every dependency is still there, unchanged. No git commands are run and no
+  nested flymake.toml files are searched for dependencies.
 
-  // make sure inc/ folder exists
-  if(!err && !FlyFileExistsFolder(szIncFolder))
+  @param  pRootState    root project state, pDepList must be empty
+  @param  szLock        flymake.lock loaded into memory
+  @return TRUE if the dependency list was restored from flymake.lock
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDepLockApply(flyMakeState_t *pRootState, const char *szLock)
+{
+  const char     *pszTable;
+  const char     *pszIter   = NULL;
+  flyMakeDep_t   *pDep;
+  tomlKey_t       keyDep;
+  char           *szLockVer = NULL;
+  char           *szHash    = NULL;
+  char           *szName;
+  char           *szIncs    = NULL;
+  char           *szLibs    = NULL;
+  char            szTomlHash[20];
+  bool_t          fWorked   = TRUE;
+
+  FlyAssert(pRootState->pDepList == NULL);
+
+  // flymake.lock must be for this flymake.toml, e.g. [lock] version="1" toml="0123456789abcdef"
+  pszTable = FlyTomlTableFind(szLock, m_szLockTable);
+  if(pszTable)
   {
-    FlyMakePrintfEx(FMK_VERBOSE_SOME, "\n");
-    err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keyInc.szValue, "include folder not found");
+    szLockVer = FmkDepLockStrAlloc(pszTable, "version");
+    szHash    = FmkDepLockStrAlloc(pszTable, "toml");
   }
+  snprintf(szTomlHash, sizeof(szTomlHash), "%016llx", (unsigned long long)FlyMakeHashStr(pRootState->szTomlFile));
+  if(!szLockVer || strcmp(szLockVer, m_szLockVer) != 0 || !szHash || strcmp(szHash, szTomlHash) != 0)
+    fWorked = FALSE;
 
-  // path must point to valid prebuilt library file, e.g. "../project/lib/project.a"
-  if(!err && !FlyFileExistsFile(szLibFile))
+  // in case flymake.lock doesn't match after all
+  if(fWorked)
   {
-    FlyMakePrintfEx(FMK_VERBOSE_SOME, "\n");
-    err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keyPath.szValue, "library not found");
-  } 
+    szIncs = FlyStrClone(pRootState->incs.sz ? pRootState->incs.sz : "");
+    szLibs = FlyStrClone(pRootState->libs.sz ? pRootState->libs.sz : "");
+    if(!szIncs || !szLibs)
+      fWorked = FALSE;
+    else
+      pszIter = FlyTomlTableFind(szLock, m_szDepTable);
+  }
 
-  // don't allow same dep name with different folders
-  if(!err)
+  // restore each dependency, in the order they were discovered
+  if(pszIter)
+    pszIter = FlyTomlKeyIter(pszIter, &keyDep);
+  while(fWorked && pszIter)
   {
-    pDep = FmkDepFind(pDepKeys->pRootState->pDepList, szDepName);
-    if(pDep)
+    pDep = NULL;
+    szName = FlyMakeTomlKeyAlloc(keyDep.szKey);
+    if(szName && keyDep.type == TOML_INLINE_TABLE)
+      pDep = FmkDepLockDepNew(pRootState, szName, &keyDep);
+    FlyStrFreeIf(szName);
+    if(!pDep)
+      fWorked = FALSE;
+    else
     {
-      if(!FlyFileIsSamePath(szIncFolder, pDep->szIncFolder))
-      {
-        FlyMakePrintfEx(FMK_VERBOSE_SOME, "\n");
-        err = FlyMakeErrToml(pDepKeys->pState, pDepKeys->keyInc.szValue, "duplicate dependency, different includer folder");
-        FlyMakePrintf("  previous include folder: %s\n", pDep->szIncFolder);
-      }
+      pRootState->pDepList = FlyListAppend(pRootState->pDepList, pDep);
+      FlyStrSmartCat(&pRootState->libs, pDep->libs.sz);
+      FlyStrSmartCat(&pRootState->libs, " ");
     }
+    pszIter = FlyTomlKeyIter(pszIter, &keyDep);
   }
 
-  // only add dependency if it hasn't already been added (pDep will be non-NULL if previously added)
-  if(!err && !pDep)
+  // add include folders and needs, from the root and each dependency's flymake.toml
+  if(fWorked)
+    fWorked = FmkDepLockIncs(pRootState, pRootState);
+  for(pDep = pRootState->pDepList; fWorked && pDep; pDep = pDep->pNext)
   {
-    pDep = FmkDepNew(szDepName, NULL);
-    if(!pDep)
-      err =  FlyMakeErrMem();
-    else
-    {
-      pDepKeys->pRootState->pDepList = FlyListAppend(pDepKeys->pRootState->pDepList, pDep);
+    if(pDep->pState)
+      fWorked = FmkDepLockIncs(pRootState, pDep->pState);
+  }
 
-      // add dependency library and inc folder to appropriate places
-      FlyMakePrintfEx(FMK_VERBOSE_SOME, "%s\n", szLibFile);
-      pLibs = FlyStrSmartNew(szLibFile);
-      FmkDepAddIncLibs(pDepKeys, szIncFolder, pLibs);
+  // doesn't match, start over
+  if(!fWorked && szIncs && szLibs)
+  {
+    while(pRootState->pDepList)
+    {
+      pDep = pRootState->pDepList;
+      pRootState->pDepList = pDep->pNext;
+      FmkDepFree(pDep);
     }
+    FlyStrSmartCpy(&pRootState->incs, szIncs);
+    FlyStrSmartCpy(&pRootState->libs, szLibs);
   }
 
-  // cleanup
-  FlyStrSmartFree(pLibs);
-  FlyStrFreeIf(szLibFile);
-  FlyStrFreeIf(szIncFolder);
-  FlyStrFreeIf(szDepName);
+  FlyMakeDbgPrintf(FMK_DEBUG_SOME, "FmkDepLockApply(), fWorked %u\n", fWorked);
 
-  return err;
+  FlyStrFreeIf(szLockVer);
+  FlyStrFreeIf(szHash);
+  FlyStrFreeIf(szIncs);
+  FlyStrFreeIf(szLibs);
+
+  return fWorked;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Process a project style dependency.
+  Write flymake.lock, recording each dependency found, if it changed. Paths are relative to the
+  root project, so flymake.lock can be committed.
 
-  Requires `path=` key to point to a project folder.
+  Example flymake.lock:
 
-  This will set up a new state so that the project can be built, and will add it to the
-  flyMakeDep_t dependency root state's list.
+      [lock]
+      version = "1"
+      toml = "6a0a3e9d5ba27f4c"
 
-  @param  pDepKeys      All the information needed to proce
-  @return FMK_ERR_NONE or FMK_ERR_CUSTOM
+      [dependencies]
+      bar = { folder="deps/bar/", git="git@github.com:me/bar.git", spec="...", sha="...", version="1.0", ... }
+
+  @param  pRootState    root project state, with pDepList filled in
+  @param  szOldLock     flymake.lock as it was loaded, or NULL
+  @return none
 *///-----------------------------------------------------------------------------------------------
-static fmkErr_t FmkDepProcessPackage(fmkDepKeys_t *pDepKeys)
+static void FmkDepLockSave(flyMakeState_t *pRootState, const char *szOldLock)
 {
-  flyMakeDep_t   *pDep       = NULL;
-  char           *szDepName  = NULL;
-  char           *szRange    = NULL;
-  char           *szFolder   = NULL;
-  fmkErr_t        err        = FMK_ERR_NONE;
-
-  FlyAssert(pDepKeys && pDepKeys->keyDep.szKey);
-  FlyAssert(pDepKeys->keyPath.szValue);
-
-  // specified folder in path= key must exist
-  szDepName = FlyMakeTomlKeyAlloc(pDepKeys->keyDep.szKey);
-  szRange   = FmkTomlVerAlloc(pDepKeys->keyVer.szValue);
-  szFolder  = FmkTomlPath(pDepKeys->pState->szRoot, pDepKeys->keyPath.szValue);
-  if(!szRange || !szDepName || !szFolder)
-    err = FlyMakeErrMem();
-
-  // print the header
-  if(!err)
-    FlyMakePrintfEx(FMK_VERBOSE_SOME, "# Dependency project : %s %s: %s\n", szDepName, szRange, szFolder);
+  const flyMakeDep_t   *pDep;
+  flyStrSmart_t         lock;
+  flyStrSmart_t         paths;
+  flyStrSmart_t         cmdline;
+  flyMakeProc_t         proc;
+  char                 *szPath;
+  char                  szHash[20];
+  unsigned              len;
+
+  FlyStrSmartInit(&lock);
+  FlyStrSmartInit(&paths);
+  FlyStrSmartInit(&cmdline);
 
-  // check for version conflict with existing dep
-  if(!err)
-    err = FmkDepVersionValidate(pDepKeys, szDepName, szRange, &pDep);
+  FlyStrSmartCpy(&lock, "# flymake.lock - dependencies found by flymake. Delete to find them again.\n\n");
+  FlyStrSmartCat(&lock, "[lock]\nversion = \"");
+  FlyStrSmartCat(&lock, m_szLockVer);
+  snprintf(szHash, sizeof(szHash), "%016llx", (unsigned long long)FlyMakeHashStr(pRootState->szTomlFile));
+  FlyStrSmartCat(&lock, "\"\ntoml = \"");
+  FlyStrSmartCat(&lock, szHash);
+  FlyStrSmartCat(&lock, "\"\n\n[dependencies]\n");
 
-  // if not already in dependency list, add the new dependency to the list
-  if(!err)
+  for(pDep = pRootState->pDepList; pDep; pDep = pDep->pNext)
   {
-    if(pDep)
-      FmkDepAddIncLibs(pDepKeys, pDep->szIncFolder, NULL);
-    else
-      err = FmkDepPackageAdd(pDepKeys, szFolder, szDepName, szRange, NULL, &pDep);
+    FlyStrSmartCat(&lock, pDep->szName);
+    FlyStrSmartCat(&lock, " = { ");
+    if(pDep->pState)
+    {
+      FlyStrSmartCpy(&paths, "");
+      FmkDepLockPathsCat(&paths, pRootState->szRoot, pDep->pState->szRoot, TRUE);
+      FlyStrSmartCat(&lock, "folder=\"");
+      FlyStrSmartCat(&lock, paths.sz);
+      FlyStrSmartCat(&lock, "\", ");
+    }
+    if(pDep->szGitUrl)
+    {
+      FlyStrSmartCat(&lock, "git=\"");
+      FlyStrSmartCat(&lock, pDep->szGitUrl);
+      snprintf(szHash, sizeof(szHash), "%016llx", (unsigned long long)pDep->specHash);
+      FlyStrSmartCat(&lock, "\", spec=\"");
+      FlyStrSmartCat(&lock, szHash);
+      FlyStrSmartCat(&lock, "\", ");
+
+      // exact commit checked out
+      FlyStrSmartCpy(&cmdline, "git -C ");
+      FlyStrSmartCat(&cmdline, pDep->pState ? pDep->pState->szRoot : ".");
+      FlyStrSmartCat(&cmdline, " rev-parse HEAD");
+      FlyMakeProcInit(&proc, TRUE);
+      if(cmdline.sz && FlyMakeProcRun(cmdline.sz, &proc) == 0 && proc.output.sz)
+      {
+        len = (unsigned)FlyStrArgLen(proc.output.sz);
+        proc.output.sz[len] = '\0';
+        FlyStrSmartCat(&lock, "sha=\"");
+        FlyStrSmartCat(&lock, proc.output.sz);
+        FlyStrSmartCat(&lock, "\", ");
+      }
+      FlyMakeProcUnInit(&proc);
+    }
+    if(pDep->szVer)
+    {
+      FlyStrSmartCat(&lock, "version=\"");
+      FlyStrSmartCat(&lock, pDep->szVer);
+      FlyStrSmartCat(&lock, "\", ");
+    }
+    FlyStrSmartCat(&lock, "range=\"");
+    FlyStrSmartCat(&lock, pDep->szRange);
+    FlyStrSmartCat(&lock, "\", inc=\"");
+    FlyStrSmartCpy(&paths, "");
+    FmkDepLockPathsCat(&paths, pRootState->szRoot, pDep->szIncFolder ? pDep->szIncFolder : "", TRUE);
+    FlyStrSmartCat(&lock, paths.sz);
+    FlyStrSmartCat(&lock, "\", libs=\"");
+    FlyStrSmartCpy(&paths, "");
+    FmkDepLockPathsCat(&paths, pRootState->szRoot, pDep->libs.sz ? pDep->libs.sz : "", TRUE);
+    FlyStrSmartCat(&lock, paths.sz);
+    FlyStrSmartCat(&lock, "\"");
+    if(pDep->pState)
+    {
+      snprintf(szHash, sizeof(szHash), "%016llx",
+               (unsigned long long)FlyMakeHashStr(pDep->pState->szTomlFile ? pDep->pState->szTomlFile : ""));
+      FlyStrSmartCat(&lock, ", hash=\"");
+      FlyStrSmartCat(&lock, szHash);
+      FlyStrSmartCat(&lock, "\"");
+    }
+    FlyStrSmartCat(&lock, " }\n");
   }
 
-  // display actual version found
-  if(!err)
+  // only write if changed, so flymake.lock isn't touched every build
+  szPath = FmkDepLockPathAlloc(pRootState);
+  if(szPath && lock.sz && (!szOldLock || strcmp(szOldLock, lock.sz) != 0))
   {
-    FlyAssert(pDep);
-    FlyMakePrintfEx(FMK_VERBOSE_SOME, "#     found version => %s\n", pDep->szVer);
+    FlyMakePrintfEx(FMK_VERBOSE_MORE, "# Writing %s\n", szPath);
+    if(!FlyFileWrite(szPath, lock.sz))
+      FlyMakePrintf("warning: cannot write %s\n", szPath);
   }
 
-  // cleanup
-  FlyStrFreeIf(szFolder);
-  FlyStrFreeIf(szRange);
-  FlyStrFreeIf(szDepName);
-
-  return err;
+  FlyFreeIf(szPath);
+  FlyStrSmartUnInit(&lock);
+  FlyStrSmartUnInit(&paths);
+  FlyStrSmartUnInit(&cmdline);
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Process "git" style dependency. Requires `git=` key to specify a URL.
-
-  Optionally, specify `version=` key to pick version.
-
-  See 
-
-  Requires the following (otherwise, error):
+  Discover all dependencies.
 
-  1. URL specifies a git repository
-  2. User has permissions to check out said repository
-  3. Repository is a valid package (contains source to build a library and an include folder)
+  If flymake.lock matches flymake.toml, the dependencies are restored from it. Otherwise they are
+  found by processing flymake.toml files, cloning git dependencies at the SHA in flymake.lock if
+  they haven't changed, and flymake.lock is written.
 
-  @param  pDepKeys      All the information needed to proce
+  @param  pState    root project state
   @return FMK_ERR_NONE or FMK_ERR_CUSTOM
 *///-----------------------------------------------------------------------------------------------
-static fmkErr_t FmkDepProcessGit(fmkDepKeys_t *pDepKeys)
+fmkErr_t FlyMakeDepDiscover(flyMakeState_t *pRootState)
 {
-  flyMakeDep_t   *pDep        = NULL;
-  char           *szFolder    = NULL;
-  char           *szDepName   = NULL;
-  char           *szRange     = NULL;
-  char           *szGitUrl    = NULL;
-  char           *szVer       = NULL;
-  unsigned        size;
-  fmkErr_t        err               = FMK_ERR_NONE;
+  char     *szLockPath;
+  char     *szLock    = NULL;
+  fmkErr_t  err       = FMK_ERR_NONE;
 
-  // validate some parameters
-  FlyAssert(pDepKeys && pDepKeys->keyDep.szKey);
-  FlyAssert(pDepKeys->keyGit.szValue);
+  // if no [dependencies], then  nothing to do
+  if(FmkDepNumDependencies(pRootState->szTomlFile))
+  {
+    FlyMakeFolderCreate(&pRootState->opts, pRootState->szDepDir);
 
-  // specified folder in path= key must exist
-  szDepName = FlyMakeTomlKeyAlloc(pDepKeys->keyDep.szKey);
-  szRange   = FmkTomlVerAlloc(pDepKeys->keyVer.szValue);
-  szGitUrl  = FlyMakeTomlStrAlloc(pDepKeys->keyGit.szValue);
-  if(!szRange || !szDepName || !szGitUrl)
-    err = FlyMakeErrMem(); 
-  else
-    FlyMakePrintfEx(FMK_VERBOSE_SOME, "# Dependency git     : %s %s: %s\n", szDepName, szRange, szGitUrl);
+    szLockPath = FmkDepLockPathAlloc(pRootState);
+    if(szLockPath)
+      szLock = FlyFileRead(szLockPath);
 
-  // check if package already exists, and if so, is it in version range?
-  if(!err)
-    err = FmkDepVersionValidate(pDepKeys, szDepName, szRange, &pDep);
+    if(szLock && FmkDepLockApply(pRootState, szLock))
+      FlyMakePrintfEx(FMK_VERBOSE_SOME, "# Dependencies from %s\n", szLockPath);
+    else
+    {
+      err = FmkDepProcessToml(pRootState, pRootState, szLock);
+      if(!err && !pRootState->opts.fNoBuild)
+        FmkDepLockSave(pRootState, szLock);
+    }
 
-  // package not checked out, so clone it here
-  if(!err)
-  {
-    // dependency already exists, just add to dep inc/ folder to state including that dependency
-    if(pDep)
-      FmkDepAddIncLibs(pDepKeys, pDep->szIncFolder, NULL);
+    FlyFreeIf(szLockPath);
+    FlyFreeIf(szLock);
+  }
 
-    // add new dependency
+  return err;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Read the full SHA checked out in a git clone, without running git. Follows "ref: refs/heads/main"
+  to the branch, which may be in .git/packed-refs.
+
+  @param  szRoot    root of clone, e.g. "deps/foo/"
+  @param  szSha     return value, 40 hex digit SHA
+  @param  size      sizeof szSha, at least 41
+  @return TRUE if found
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDepGitHead(const char *szRoot, char *szSha, unsigned size)
+{
+  flyStrSmart_t   path;
+  char           *szHead    = NULL;
+  char           *szRefs    = NULL;
+  const char     *psz       = NULL;
+  const char     *szRef;
+  unsigned        len       = 0;
+  bool_t          fFound    = FALSE;
+
+  FlyStrSmartInit(&path);
+  FlyStrSmartCpy(&path, szRoot);
+  FlyStrSmartCat(&path, ".git/HEAD");
+  if(path.sz)
+    szHead = FlyFileRead(path.sz);
+
+  // e.g. "ref: refs/heads/main"
+  if(szHead && strncmp(szHead, "ref: ", 5) == 0)
+  {
+    szRef = szHead + 5;
+    len = (unsigned)FlyStrArgLen(szRef);
+    szHead[5 + len] = '\0';
+    FlyStrSmartCpy(&path, szRoot);
+    FlyStrSmartCat(&path, ".git/");
+    FlyStrSmartCat(&path, szRef);
+    if(path.sz)
+      szRefs = FlyFileRead(path.sz);
+    if(szRefs)
+      psz = szRefs;
     else
     {
-      size = strlen(pDepKeys->pRootState->szDepDir) + strlen(szDepName) + 3;
-      szFolder = FlyAlloc(size);
-      if(!szFolder)
-        err = FlyMakeErrMem();
-      else
+      // e.g. "615619802b2c0b4105eabf516f05f3ad199ef8c9 refs/heads/main"
+      FlyStrSmartCpy(&path, szRoot);
+      FlyStrSmartCat(&path, ".git/packed-refs");
+      if(path.sz)
+        szRefs = FlyFileRead(path.sz);
+      psz = szRefs;
+      while(psz && *psz)
       {
-        strcpy(szFolder, pDepKeys->pRootState->szDepDir);
-        strcat(szFolder, szDepName);
-        strcat(szFolder, "/");
+        if(isxdigit((unsigned char)*psz) && strncmp(FlyStrArgNext(psz), szRef, len) == 0 &&
+           isspace((unsigned char)FlyStrArgNext(psz)[len]))
+        {
+          break;
+        }
+        psz = FlyStrLineNext(psz);
       }
+    }
+  }
+  else
+    psz = szHead;
 
-      // only clone if not already cloned
-      if(!err && !FmkDepPackageAlreadyCloned(pDepKeys->pRootState->szDepDir, szDepName))
-        err = FmkDepPackageClone(pDepKeys, szDepName, szGitUrl, szFolder, &szVer);
+  // must be a full SHA
+  if(psz && *psz)
+  {
+    len = (unsigned)FlyStrArgLen(psz);
+    if(len == 40 && len < size)
+    {
+      memcpy(szSha, psz, len);
+      szSha[len] = '\0';
+      fFound = TRUE;
+    }
+  }
 
-      // add the dependency to list
-      if(!err)
-        err = FmkDepPackageAdd(pDepKeys, szFolder, szDepName, szRange, szVer, &pDep);
+  FlyFreeIf(szHead);
+  FlyFreeIf(szRefs);
+  FlyStrSmartUnInit(&path);
+
+  return fFound;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Hash the local changes in a git clone into a key: each tracked file that differs from HEAD, with
+  its size and modified time, so another edit to the same file changes the key again. Untracked
+  files are left out, as the libraries and out/ folder built in the clone are untracked.
+
+  @param  szRoot    root of the clone, e.g. "deps/foo/"
+  @param  pKey      key to hash into
+  @return TRUE if worked, FALSE if git failed
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDepGitDirtyHash(const char *szRoot, uint64_t *pKey)
+{
+  flyMakeProc_t     proc;
+  flyStrSmart_t     cmdline;
+  flyStrSmart_t     path;
+  sFlyFileInfo_t    info;
+  const char       *psz;
+  const char       *szRename;
+  unsigned          len;
+  bool_t            fWorked = FALSE;
+
+  // e.g. " M src/foo.c" or "R  old.c -> new.c"
+  FlyStrSmartInit(&cmdline);
+  FlyStrSmartInit(&path);
+  FlyMakeProcInit(&proc, TRUE);
+  FlyStrSmartSprintf(&cmdline, "git -C %s status --porcelain --untracked-files=no", szRoot);
+  if(cmdline.sz && FlyMakeProcRun(cmdline.sz, &proc) == 0)
+  {
+    fWorked = TRUE;
+    psz = proc.output.sz ? proc.output.sz : "";
+    *pKey = FlyMakeHash(psz, strlen(psz), *pKey);
+    while(*psz)
+    {
+      len = (unsigned)FlyStrLineLen(psz);
+      if(len > 3)
+      {
+        FlyStrSmartSprintf(&path, "%s%.*s", szRoot, (int)(len - 3), &psz[3]);
+        szRename = path.sz ? strstr(path.sz, " -> ") : NULL;
+        if(szRename)
+          FlyStrSmartSprintf(&path, "%s%s", szRoot, szRename + 4);
+        FlyFileInfoInit(&info);
+        if(path.sz && FlyFileInfoGetEx(&info, path.sz))
+        {
+          *pKey = FlyMakeHash(&info.size, sizeof(info.size), *pKey);
+          *pKey = FlyMakeHash(&info.modTime, sizeof(info.modTime), *pKey);
+        }
+      }
+      psz = FlyStrLineNext(psz);
     }
   }
+  FlyMakeProcUnInit(&proc);
+  FlyStrSmartUnInit(&cmdline);
+  FlyStrSmartUnInit(&path);
 
-  // display actual version found
-  if(!err)
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Compute the artifact cache key for a dependency: its git SHA and local changes, compiler formats and flags,
+  compiler and archiver programs, build configuration and the keys of the dependencies it needs,
+  as their headers are compiled in.
+
+  Only git dependencies (and the prebuilt ones they need) can be cached. A path dependency may be
+  edited at any time, so it has no key, and neither does anything that needs it. A git dependency
+  edited in place gets a new key, see FmkDepGitDirtyHash(), so it's built rather than trusted.
+
+  @param  pDep      ptr to dependency
+  @param  pKey      return value, the key
+  @param  depth     how deep in the needs, to stop a cycle
+  @return TRUE if the dependency can be cached
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDepCacheKey(const flyMakeDep_t *pDep, uint64_t *pKey, unsigned depth)
+{
+  const flyMakeCompiler_t  *pCompiler;
+  const char               *aszFmts[7];
+  sFlyFileInfo_t            info;
+  char                      szSha[48];
+  uint64_t                  key;
+  uint64_t                  keyNeed;
+  unsigned                  i;
+  bool_t                    fCacheable  = TRUE;
+
+  // prebuilt, e.g. foo = { path="../foo/lib/foo.a", inc="../foo/inc/" }
+  if(!pDep->pState)
   {
-    FlyAssert(pDep);
-    FlyMakePrintfEx(FMK_VERBOSE_SOME, "#     found version => %s\n", pDep->szVer);
+    key = FlyMakeHashStr(pDep->libs.sz ? pDep->libs.sz : "");
+    FlyFileInfoInit(&info);
+    if(pDep->libs.sz && FlyFileInfoGetEx(&info, pDep->libs.sz))
+    {
+      key = FlyMakeHash(&info.size, sizeof(info.size), key);
+      key = FlyMakeHash(&info.modTime, sizeof(info.modTime), key);
+    }
+  }
+  else if(!pDep->szGitUrl || depth >= FMK_CACHE_DEPTH || !FmkDepGitHead(pDep->pState->szRoot, szSha, sizeof(szSha)))
+    fCacheable = FALSE;
+  else
+  {
+    key = FlyMakeHashStr(szSha);
+    if(!FmkDepGitDirtyHash(pDep->pState->szRoot, &key))
+      fCacheable = FALSE;
+    key = FlyMakeHash(&pDep->pState->opts.dbg, sizeof(pDep->pState->opts.dbg), key);
+    key = FlyMakeHash(&pDep->pState->opts.fWarning, sizeof(pDep->pState->opts.fWarning), key);
+    key = FlyMakeHash(g_szFmtArchive, strlen(g_szFmtArchive), key);
+    key = FlyMakeHashTool(g_szFmtArchive, key);
+    for(pCompiler = pDep->pState->pCompilerList; pCompiler; pCompiler = pCompiler->pNext)
+    {
+      aszFmts[0] = pCompiler->szExts;
+      aszFmts[1] = pCompiler->szCc;
+      aszFmts[2] = pCompiler->szCcDbg;
+      aszFmts[3] = pCompiler->szInc;
+      aszFmts[4] = pCompiler->szWarn;
+      aszFmts[5] = pCompiler->szLl;
+      aszFmts[6] = pCompiler->szLlDbg;
+      for(i = 0; i < NumElements(aszFmts); ++i)
+        key = FlyMakeHash(aszFmts[i] ? aszFmts[i] : "", aszFmts[i] ? strlen(aszFmts[i]) + 1 : 1, key);
+      if(pCompiler->szCc)
+        key = FlyMakeHashTool(pCompiler->szCc, key);
+    }
+    for(i = 0; fCacheable && i < pDep->nNeeds; ++i)
+    {
+      if(!FmkDepCacheKey(pDep->apNeeds[i], &keyNeed, depth + 1))
+        fCacheable = FALSE;
+      else
+        key = FlyMakeHash(&keyNeed, sizeof(keyNeed), key);
+    }
   }
 
-  // cleanup
-  FlyStrFreeIf(szVer);
-  FlyStrFreeIf(szGitUrl);
-  FlyStrFreeIf(szRange);
-  FlyStrFreeIf(szDepName);
+  if(fCacheable)
+    *pKey = key;
 
-  return err;
+  return fCacheable;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Recursively process flymake.toml `[dependencies]`. Results in pRootState->pDepList filled in.
+  Allocate the path to the file that records the libraries were restored from the artifact cache,
+  e.g. "deps/foo/out/foo.cache". It contains the cache key.
 
-  Also updates pRootState->libs and pState->incs.
+  @param  pDep      ptr to dependency
+  @return allocated path or NULL
+*///-----------------------------------------------------------------------------------------------
+static char * FmkDepCacheMarkAlloc(const flyMakeDep_t *pDep)
+{
+  char       *szOutFolder;
+  char       *szMark      = NULL;
+  unsigned    size;
 
-  Broad first, then deep. That is, process all `[dependencies]` in this TOML file, then check each
-  dependency for sub-dependencies and so on.
+  szOutFolder = FmkOutFolderAlloc(pDep->pState, pDep->pState->szRoot, FALSE);
+  if(szOutFolder)
+  {
+    size = strlen(szOutFolder) + strlen(pDep->szName) + sizeof(m_szCacheExt);
+    szMark = FlyAlloc(size);
+    if(szMark)
+    {
+      FlyStrZCpy(szMark, szOutFolder, size);
+      FlyStrZCat(szMark, pDep->szName, size);
+      FlyStrZCat(szMark, m_szCacheExt, size);
+    }
+    FlyFree(szOutFolder);
+  }
+
+  return szMark;
+}
 
-  Prints error and returns FMK_ERR_CUSTOM if there is a problem.
+/*-------------------------------------------------------------------------------------------------
+  Copy the dependency's libraries into the artifact cache, e.g. into
+  "~/.cache/flymake/deps/0123456789abcdef/". Copies into a temporary folder first, then renames
+  it, so other flymakes never see a partial entry. The headers aren't copied, as a clone at the
+  same SHA already has them, see FmkDepCacheRestore().
 
-  @param  pRootState    root project state
-  @param  pState        state of project containing flymake.toml `[dependencies]`
-  @return FMK_ERR_NONE or FMK_ERR_CUSTOM
+  @param  pDep      ptr to dependency, just built
+  @param  szEntry   cache entry folder, e.g. "~/.cache/flymake/deps/0123456789abcdef/"
+  @return none
 *///-----------------------------------------------------------------------------------------------
-static fmkErr_t FmkDepProcessToml(flyMakeState_t *pRootState, flyMakeState_t *pState)
+static void FmkDepCacheStore(const flyMakeDep_t *pDep, const char *szEntry)
 {
-  const char     *pszDepTable     = NULL; // table of [dependencies]
-  const char     *pszIter         = NULL; // iter through dependencies
-  const char     *pszInlineTable;
-  flyMakeDep_t   *pDep            = NULL;
-  fmkDepKeys_t    depKeys;
-  fmkDepKeyVal_t  aKeyVal[] =
-  {
-    { "git",     &depKeys.keyGit },
-    { "inc",     &depKeys.keyInc },
-    { "path",    &depKeys.keyPath },
-    { "version", &depKeys.keyVer },
-    { "sha",     &depKeys.keySha },
-    { "branch",  &depKeys.keyBranch },
-  };
+  flyMakeOpts_t  *pOpts = &pDep->pState->opts;
+  flyStrSmart_t   tmp;
+  flyStrSmart_t   cmdline;
+  char          **aszLibs;
+  unsigned        nLibs = 0;
+  unsigned        len;
   unsigned        i;
-  fmkErr_t        err = FMK_ERR_NONE;
-
-  // verify inputs
-  FlyAssert(FlyMakeIsState(pRootState));
-  FlyAssert(FlyMakeIsState(pState));
-  FlyAssert(pState->szRoot && pState->szFullPath);
+  bool_t          fWorked;
 
-  FlyMakeDbgPrintf(FMK_DEBUG_SOME, "FmkDepProcessToml(%s,%s)\n", pRootState->szRoot, pState->szRoot);
+  // e.g. "~/.cache/flymake/deps/0123456789abcdef.1234/"
+  FlyStrSmartInit(&tmp);
+  FlyStrSmartInit(&cmdline);
+  len = (unsigned)strlen(szEntry) - 1;
+  FlyStrSmartSprintf(&tmp, "%.*s.%ld/", (int)len, szEntry, (long)getpid());
+  fWorked = (tmp.sz && FlyFileMakeDir(tmp.sz) >= 0) ? TRUE : FALSE;
+
+  // libraries, e.g. "deps/foo/lib/foo.a"
+  aszLibs = FmkObjsArrayNew(pDep->libs.sz ? pDep->libs.sz : "", &nLibs);
+  if(!aszLibs)
+    fWorked = FALSE;
+  for(i = 0; fWorked && i < nLibs; ++i)
+  {
+    FlyStrSmartSprintf(&cmdline, "cp %s %s", aszLibs[i], tmp.sz);
+    if(!cmdline.sz || FlyMakeSystem(FMK_VERBOSE_MORE, pOpts, cmdline.sz) != 0)
+      fWorked = FALSE;
+  }
+  FlyFreeIf(aszLibs);
 
-  // nothing to do if no flymake.toml or no [dependencies]
-  if(FmkDepNumDependencies(pState->szTomlFile) == 0)
+  // another flymake may have stored it first, which is fine, as it's the same key
+  if(fWorked)
   {
-    FlyMakePrintfEx(FMK_VERBOSE_MORE, "# no dependencies in project `%s`\n", pState->szFullPath);
-    return FMK_ERR_NONE;
+    FlyStrSmartSprintf(&cmdline, "%.*s", (int)len, szEntry);
+    tmp.sz[strlen(tmp.sz) - 1] = '\0';
+    if(cmdline.sz && rename(tmp.sz, cmdline.sz) == 0)
+      FlyMakePrintfEx(FMK_VERBOSE_MORE, "# cached %s in %s\n", pDep->szName, szEntry);
+    else
+      fWorked = FALSE;
   }
+  if(!fWorked && tmp.sz && FlyFileExistsFolder(tmp.sz))
+    FlyMakeFolderRemove(FMK_VERBOSE_MORE, pOpts, tmp.sz);
 
-  // initialize structure used to process dependencies
-  memset(&depKeys, 0, sizeof(depKeys));
-  depKeys.pRootState = pRootState;
-  depKeys.pState = pState;
+  FlyStrSmartUnInit(&tmp);
+  FlyStrSmartUnInit(&cmdline);
+}
 
-  // process each dependency (TOML inline table)
-  pszDepTable = FlyTomlTableFind(pState->szTomlFile, m_szDepTable);
-  if(pszDepTable)
-    pszIter = FlyTomlKeyIter(pszDepTable, &depKeys.keyDep);
-  while(!err && pszIter)
+/*-------------------------------------------------------------------------------------------------
+  Copy the dependency's libraries from the artifact cache. The headers are already in the clone,
+  as it's the same SHA.
+
+  @param  pDep      ptr to dependency
+  @param  szEntry   cache entry folder, e.g. "~/.cache/flymake/deps/0123456789abcdef/"
+  @return TRUE if all libraries were restored
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDepCacheRestore(const flyMakeDep_t *pDep, const char *szEntry)
+{
+  flyStrSmart_t   cmdline;
+  flyStrSmart_t   folder;
+  char          **aszLibs;
+  unsigned        nLibs     = 0;
+  unsigned        len;
+  unsigned        i;
+  bool_t          fWorked   = FALSE;
+
+  FlyStrSmartInit(&cmdline);
+  FlyStrSmartInit(&folder);
+  aszLibs = FmkObjsArrayNew(pDep->libs.sz ? pDep->libs.sz : "", &nLibs);
+  if(aszLibs && nLibs && FlyFileExistsFolder(szEntry))
   {
-    // every dependency must be a TOML inline table, e.g. foo = { "path" = "../foo/" }
-    if(depKeys.keyDep.type != TOML_INLINE_TABLE)
+    fWorked = TRUE;
+    for(i = 0; fWorked && i < nLibs; ++i)
     {
-      FlyMakeErrToml(pState, depKeys.keyDep.szValue, "expected inline table");
-      err = FMK_ERR_CUSTOM;
-      break;
-    }
+      // e.g. "deps/foo/lib/", which a fresh clone doesn't have
+      FlyStrSmartCpy(&folder, aszLibs[i]);
+      if(!folder.sz || !FlyMakeFolderCreate(&pDep->pState->opts, FlyStrPathOnly(folder.sz)))
+        fWorked = FALSE;
 
-    // look for inline table keys we recognize in this dependency
-    pszInlineTable = depKeys.keyDep.szValue;
-    for(i = 0; !err && i < NumElements(aKeyVal); ++i)
-    {
-      if(FlyTomlKeyFind(pszInlineTable, aKeyVal[i].szKey, aKeyVal[i].pKey))
-        err = FlyMakeTomlCheckString(pState, aKeyVal[i].pKey);
+      // copy, not link, as ar updates the library in place
+      FlyStrSmartSprintf(&cmdline, "cp %s%s %s", szEntry, FlyStrPathNameBase(aszLibs[i], &len), aszLibs[i]);
+      if(!fWorked || !cmdline.sz || FlyMakeSystem(FMK_VERBOSE_MORE, &pDep->pState->opts, cmdline.sz) != 0)
+        fWorked = FALSE;
     }
+  }
+  FlyFreeIf(aszLibs);
+  FlyStrSmartUnInit(&cmdline);
+  FlyStrSmartUnInit(&folder);
 
-    // print out keys found, all on one line
-    if(!err && FlyMakeDebug() >= FMK_DEBUG_MORE)
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Build the libraries of one dependency, using the artifact cache, shared by all projects.
+
+  If the dependency's libraries don't exist yet (e.g. a fresh clone), they are copied from the
+  cache if there, rather than compiled. Libraries restored this way aren't built again until
+  `--all`, as there are no object files. A dependency built from nothing is stored in the cache.
+
+  @param  pDep      ptr to dependency with a state
+  @return FMK_ERR_NONE if worked
+*///-----------------------------------------------------------------------------------------------
+static fmkErr_t FmkDepBuildLibsCached(flyMakeDep_t *pDep)
+{
+  flyMakeState_t *pState    = pDep->pState;
+  char          **aszLibs;
+  char           *szOutFolder;
+  char           *szCache   = NULL;
+  char           *szMark    = NULL;
+  char           *szMarkKey = NULL;
+  char            szKey[20];
+  uint64_t        key;
+  unsigned        nLibs     = 0;
+  unsigned        size;
+  unsigned        i;
+  bool_t          fMissing  = FALSE;
+  bool_t          fDone     = FALSE;
+  fmkErr_t        err       = FMK_ERR_NONE;
+
+  // -n or --all always builds, e.g. "~/.cache/flymake/deps/0123456789abcdef/"
+  if(!pState->opts.fNoBuild && !pState->opts.fRebuild && FmkDepCacheKey(pDep, &key, 0))
+  {
+    snprintf(szKey, sizeof(szKey), "%016llx", (unsigned long long)key);
+    szCache = FlyMakeCacheFolderAlloc(&pState->opts, "deps/");
+    if(szCache)
     {
-      for(i = 0; i < NumElements(aKeyVal); ++i)
+      size = (unsigned)(strlen(szCache) + strlen(szKey) + 2);
+      szCache = FlyRealloc(szCache, size);
+      if(szCache)
       {
-        if(i == 0)
-        {
-          FlyMakePrintf("%.*s = { ",
-            FlyTomlKeyLen(depKeys.keyDep.szKey), depKeys.keyDep.szKey);
-        }
-        if(aKeyVal[i].pKey->szValue)
-        {
-          if(i != 0)
-            FlyMakePrintf(", ");
-          FmkTomlKeyPrint(aKeyVal[i].szKey, aKeyVal[i].pKey->szValue);
-        }
+        FlyStrZCat(szCache, szKey, size);
+        FlyStrZCat(szCache, "/", size);
       }
-      FlyMakePrintf(" }\n");
     }
+  }
 
-    // must have either a path= or git= key
-    if(!depKeys.keyGit.szValue && !depKeys.keyPath.szValue)
-      err = FlyMakeErrToml(pState, pszInlineTable, "expected \"path=\" or \"git=\" key in inline table");
-
-    if(!err)
+  if(szCache)
+  {
+    aszLibs = FmkObjsArrayNew(pDep->libs.sz ? pDep->libs.sz : "", &nLibs);
+    for(i = 0; aszLibs && i < nLibs; ++i)
     {
-      pDep = FmkDepTomlFind(pRootState->pDepList, depKeys.keyDep.szKey);
-      if(pDep)
-        FmkDepAddIncLibs(&depKeys, pDep->szIncFolder, NULL);
-      else if(depKeys.keyGit.szValue)
-        err = FmkDepProcessGit(&depKeys);
-      else if(depKeys.keyInc.szValue && depKeys.keyPath.szValue)
-        err = FmkDepProcessPrebuilt(&depKeys);
-      else
-        err = FmkDepProcessPackage(&depKeys);
+      if(!FlyFileExistsFile(aszLibs[i]))
+        fMissing = TRUE;
     }
+    FlyFreeIf(aszLibs);
 
-    // look for next dependency
-    pszIter = FlyTomlKeyIter(pszIter, &depKeys.keyDep);
+    // restored from the cache by an earlier build, with this same key
+    szMark = FmkDepCacheMarkAlloc(pDep);
+    if(szMark)
+      szMarkKey = FlyFileRead(szMark);
+    if(!fMissing && szMarkKey && strncmp(szMarkKey, szKey, strlen(szKey)) == 0)
+      fDone = TRUE;
+
+    // e.g. a fresh clone, copy the libraries from the cache rather than compile them
+    else if(fMissing && szMark && FmkDepCacheRestore(pDep, szCache))
+    {
+      FlyMakePrintfEx(FMK_VERBOSE_SOME, "# restored %s from cache\n", pDep->libs.sz);
+      szOutFolder = FmkOutFolderAlloc(pState, pState->szRoot, FALSE);
+      if(szOutFolder && FlyMakeFolderCreate(&pState->opts, szOutFolder))
+        FlyFileWrite(szMark, szKey);
+      FlyFreeIf(szOutFolder);
+      pState->fLibCompiled = TRUE;
+      fDone = TRUE;
+    }
   }
 
-  // iter through TOML file again and see if we need to recurse into any of the projects
-  if(pszDepTable)
-    pszIter = FlyTomlKeyIter(pszDepTable, &depKeys.keyDep);
-  while(!err && pszIter)
+  if(!fDone)
   {
-    // process only those dependencies with flymake.toml files
-    pDep = FmkDepTomlFind(pRootState->pDepList, depKeys.keyDep.szKey);
-    if(pDep && pDep->pState && pDep->pState->szTomlFile && FmkDepNumDependencies(pDep->pState->szTomlFile))
-      err = FmkDepProcessToml(pRootState, pDep->pState);
-
-    // look for next dependency
-    pszIter = FlyTomlKeyIter(pszIter, &depKeys.keyDep);
+    if(szMark && FlyFileExistsFile(szMark))
+      remove(szMark);
+    err = FlyMakeBuildLibs(pState);
+    if(!err && fMissing)
+      FmkDepCacheStore(pDep, szCache);
   }
 
-  FlyMakeDbgPrintf(FMK_DEBUG_SOME, "  err %u, root: incs \"%s\", libs \"%s\"\n", err, pRootState->incs.sz, pRootState->libs.sz);
+  FlyFreeIf(szCache);
+  FlyFreeIf(szMark);
+  FlyFreeIf(szMarkKey);
 
   return err;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Builds all "standard" folders in the project
+  Build the libraries of one dependency. Runs in a child process, see FlyMakeJobsAddFn().
 
-  @param  pState          filled out state, e.g. pState->szRoot is filled out
-  @return FMK_ERR_NONE if worked, some other FMK_ERR if failed
+  A dependency built in a child process can't set fLibCompiled or nCompiled in this process, so
+  the exit code says what happened: 0 if up to date, 1 if failed, or FMK_JOB_CHANGED plus the # of
+  files compiled (at most 255) if the libraries changed. See FmkDepBuildJobDone().
+
+  @param  pArg    ptr to flyMakeDep_t
+  @return exit code
 *///-----------------------------------------------------------------------------------------------
-static fmkErr_t FmkDepBuildProject(flyMakeState_t *pState)
+static int FmkDepBuildJob(void *pArg)
 {
-  flyMakeFolder_t  *pFolder;
-  fmkErr_t          err = FMK_ERR_NONE;
+  flyMakeDep_t  *pDep     = pArg;
+  int            exitCode = 1;
 
-  // verify dependency state has been initialized
-  FlyAssert(FlyMakeIsState(pState) && pState->szRoot);
-  FlyMakeDbgPrintf(FMK_DEBUG_SOME, "FmkDepBuildProject(%s)\n", pState->szRoot);
+  if(FmkDepBuildLibsCached(pDep) == FMK_ERR_NONE)
+  {
+    exitCode = 0;
+    if(pDep->pState->fLibCompiled)
+    {
+      exitCode = FMK_JOB_CHANGED + (int)pDep->pState->nCompiled;
+      if(exitCode > 255)
+        exitCode = 255;
+    }
+  }
 
-  // ignore cmdline rules for dependencies, use only specified folder rules
-  pState->opts.fRulesLib = pState->opts.fRulesSrc = pState->opts.fRulesTools = FALSE;
+  return exitCode;
+}
 
-  // build libraries first
-  err = FlyMakeBuildLibs(pState);
+/*-------------------------------------------------------------------------------------------------
+  A dependency built by FmkDepBuildJob() is done. Copy what the child process did into this one.
 
-  // build all known and existing folders in dependency project
-  pFolder = pState->pFolderList;
-  while(!err && pFolder)
+  @param  pDep      ptr to dependency
+  @param  exitCode  exit code from FmkDepBuildJob()
+  @return none
+*///-----------------------------------------------------------------------------------------------
+static void FmkDepBuildJobDone(flyMakeDep_t *pDep, int exitCode)
+{
+  // with -n, the job ran in this process, so already counted
+  if(exitCode >= FMK_JOB_CHANGED && !pDep->pState->fLibCompiled)
   {
-    // build each existing folder
-    if(pFolder->rule == FMK_RULE_SRC && !FlyMakeBuildSrc(pState, pFolder->szFolder))
-      err = FMK_ERR_CUSTOM;
-    else if(pFolder->rule == FMK_RULE_TOOL && !FlyMakeBuildTools(pState, pFolder->szFolder, NULL))
-      err = FMK_ERR_CUSTOM;
-
-    pFolder = pFolder->pNext;
+    pDep->pState->fLibCompiled = TRUE;
+    pDep->pState->nCompiled   += (unsigned)(exitCode - FMK_JOB_CHANGED);
   }
-
-  return err;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Is this target root folder the same as the target file/folder?
+  Is this dependency ready to build, that is, are all the dependencies it needs built?
 
-  @param    pState        filled in flymake state (must have pState->szRoot)
-  @param    szTargetRoot  target file/folder
-  @return   TRUE if same root folder
+  @param  pDep      ptr to dependency
+  @param  apDeps    dependencies being built
+  @param  aBuild    build state of each dependency in apDeps
+  @param  nDeps     # of dependencies in apDeps
+  @return TRUE if ready to build
 *///-----------------------------------------------------------------------------------------------
-bool_t FlyMakeIsSameRoot(flyMakeState_t *pState, const char *szTarget)
+static bool_t FmkDepIsReady(const flyMakeDep_t *pDep, flyMakeDep_t **apDeps, const fmkDepBuild_t *aBuild,
+                            unsigned nDeps)
 {
-  char   *szTargetRoot;
-  bool_t  fIsSameRoot;
+  unsigned  i;
+  unsigned  j;
+  bool_t    fReady  = TRUE;
 
-  szTargetRoot = FlyMakeTomlRootFind(szTarget, pState->pCompilerList, NULL);
-  fIsSameRoot = FlyMakeIsSameFolder(pState->szRoot, szTargetRoot);
-  FlyFree(szTargetRoot);
+  // prebuilt dependencies aren't in apDeps, so are always ready
+  for(i = 0; fReady && i < pDep->nNeeds; ++i)
+  {
+    for(j = 0; j < nDeps; ++j)
+    {
+      if(apDeps[j] == pDep->apNeeds[i])
+      {
+        if(aBuild[j] != FMK_DEP_DONE)
+          fReady = FALSE;
+        break;
+      }
+    }
+  }
 
-  return fIsSameRoot;
+  return fReady;
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Discover all dependencies.
+  Build the dependencies in the order given by each dependency's own `[dependencies]`, so a
+  dependency is built after those it needs.
 
-    @param  pState    root project state
+  With -j, dependencies that don't need each other are built at the same time, each in a child
+  process, sharing the same job slots as the compiles (see flymakejobserver.c). Building all the
+  dependencies then takes about as long as the longest chain of them, not the sum of them all.
+
+  @param  pRootState    root project state, with the dependency list
   @return FMK_ERR_NONE or FMK_ERR_CUSTOM
 *///-----------------------------------------------------------------------------------------------
-fmkErr_t FlyMakeDepDiscover(flyMakeState_t *pRootState)
+static fmkErr_t FmkDepListBuildDag(flyMakeState_t *pRootState)
 {
-  fmkErr_t  err = FMK_ERR_NONE;
+  flyMakeDep_t   *pDep;
+  flyMakeDep_t  **apDeps    = NULL;
+  fmkDepBuild_t  *aBuild    = NULL;
+  void           *hJobs     = NULL;
+  unsigned        nDeps     = 0;
+  unsigned        nDone     = 0;
+  unsigned        nRunning;
+  unsigned        i;
+  unsigned        j;
+  bool_t          fStarted;
+  bool_t          fCycle    = FALSE;
+  fmkErr_t        err       = FMK_ERR_NONE;
 
-  // if no [dependencies], then  nothing to do
-  if(FmkDepNumDependencies(pRootState->szTomlFile))
+  // prebuilt dependencies have no state, so there is nothing to build
+  for(pDep = pRootState->pDepList; pDep; pDep = pDep->pNext)
   {
-    FlyMakeFolderCreate(&pRootState->opts, pRootState->szDepDir);
-    err = FmkDepProcessToml(pRootState, pRootState);
+    if(pDep->pState)
+      ++nDeps;
+  }
+  apDeps    = FlyAllocZ(sizeof(*apDeps) * (nDeps + 1));
+  aBuild    = FlyAllocZ(sizeof(*aBuild) * (nDeps + 1));
+  if(!apDeps || !aBuild)
+  {
+    err = FlyMakeErrMem();
+    nDeps = 0;
+  }
+  else
+  {
+    // statistics are per build, e.g. each build of flymake watch
+    i = 0;
+    for(pDep = pRootState->pDepList; pDep; pDep = pDep->pNext)
+    {
+      if(pDep->pState)
+      {
+        pDep->pState->fLibCompiled = FALSE;
+        pDep->pState->nCompiled    = 0;
+        apDeps[i++] = pDep;
+      }
+    }
+  }
+
+  if(nDeps > 1 && pRootState->opts.jobs > 1)
+    hJobs = FlyMakeJobsNew(&pRootState->opts);
+
+  while(nDone < nDeps)
+  {
+    // start each dependency whose needs are built, but none after an error
+    fStarted = FALSE;
+    for(i = 0; !err && i < nDeps; ++i)
+    {
+      if(aBuild[i] != FMK_DEP_WAITING || (!fCycle && !FmkDepIsReady(apDeps[i], apDeps, aBuild, nDeps)))
+        continue;
+      fCycle   = FALSE;
+      fStarted = TRUE;
+      if(hJobs)
+      {
+        aBuild[i]    = FMK_DEP_RUNNING;
+        FlyMakeJobsAddFn(hJobs, apDeps[i]->szName, NULL, FmkDepBuildJob, apDeps[i], i);
+      }
+      else
+      {
+        aBuild[i] = (FmkDepBuildLibsCached(apDeps[i]) == FMK_ERR_NONE) ? FMK_DEP_DONE : FMK_DEP_FAILED;
+        ++nDone;
+        if(aBuild[i] == FMK_DEP_FAILED)
+          err = FMK_ERR_CUSTOM;
+      }
+    }
+
+    // wait for a dependency to finish building
+    nRunning = 0;
+    if(hJobs)
+    {
+      FlyMakeJobsWaitAny(hJobs);
+      for(j = 0; j < FlyMakeJobsLen(hJobs); ++j)
+      {
+        i = FlyMakeJobsGetTag(hJobs, j);
+        if(aBuild[i] != FMK_DEP_RUNNING)
+          continue;
+        if(FlyMakeJobsStatus(hJobs, j) > 0)
+          ++nRunning;
+        else
+        {
+          ++nDone;
+          if(FlyMakeJobsStatus(hJobs, j) < 0)
+          {
+            aBuild[i] = FMK_DEP_FAILED;
+            err = FMK_ERR_CUSTOM;
+          }
+          else
+          {
+            aBuild[i] = FMK_DEP_DONE;
+            FmkDepBuildJobDone(apDeps[i], FlyMakeJobsExitCode(hJobs, j));
+          }
+        }
+      }
+    }
+
+    // nothing can start and nothing is running
+    if(!fStarted && !nRunning && nDone < nDeps)
+    {
+      if(err)
+        break;
+
+      // dependencies need each other, e.g. foo needs bar and bar needs foo, so just start one
+      FlyMakeDbgPrintf(FMK_DEBUG_SOME, "  dependency cycle, building in list order\n");
+      fCycle = TRUE;
+    }
+  }
+  hJobs = FlyMakeJobsFree(hJobs);
+
+  // any library compiled means the project must be relinked
+  for(i = 0; i < nDeps; ++i)
+  {
+    if(aBuild[i] == FMK_DEP_DONE)
+    {
+      apDeps[i]->fBuilt = TRUE;
+      if(apDeps[i]->pState->fLibCompiled)
+      {
+        pRootState->fLibCompiled = TRUE;
+        pRootState->nCompiled += apDeps[i]->pState->nCompiled ? apDeps[i]->pState->nCompiled : 1;
+      }
+    }
   }
 
+  FlyFreeIf(apDeps);
+  FlyFreeIf(aBuild);
+
   return err;
 }
 
@@ -2036,13 +4898,13 @@ fmkErr_t FlyMakeDepDiscover(flyMakeState_t *pRootState)
   3. Verifies version of dependency does not conflict
   4. Creates a pState for each dependency that must be built
   5. Recursively does all the above
+  6. Builds the dependencies, in parallel with -j, see FmkDepListBuildDag()
 
   @param  pState    root project state
   @return FMK_ERR_NONE or FMK_ERR_CUSTOM
 *///-----------------------------------------------------------------------------------------------
 fmkErr_t FlyMakeDepListBuild(flyMakeState_t *pRootState)
 {
-  flyMakeDep_t   *pDep;
   fmkErr_t        err = FMK_ERR_NONE;
 
   FlyAssert(pRootState && pRootState->szDepDir);
@@ -2050,9 +4912,12 @@ fmkErr_t FlyMakeDepListBuild(flyMakeState_t *pRootState)
   // if no [dependencies], then  nothing to do
   if(FmkDepNumDependencies(pRootState->szTomlFile))
   {
-    // discover all dependencies, includes cloning them if needed
-    FlyMakePrintfEx(FMK_VERBOSE_SOME, "\n# ---- Discovering dependencies... ----\n");
-    err = FlyMakeDepDiscover(pRootState);
+    // discover all dependencies, includes cloning them if needed. Already done if in daemon.
+    if(!pRootState->pDepList)
+    {
+      FlyMakePrintfEx(FMK_VERBOSE_SOME, "\n# ---- Discovering dependencies... ----\n");
+      err = FlyMakeDepDiscover(pRootState);
+    }
 
     // build dependencies with state
     if(!err && pRootState->pDepList)
@@ -2060,21 +4925,7 @@ fmkErr_t FlyMakeDepListBuild(flyMakeState_t *pRootState)
       if(FlyMakeDebug() >= FMK_DEBUG_SOME)
         FlyMakeDepListPrint(pRootState->pDepList);
       FlyMakePrintfEx(FMK_VERBOSE_SOME, "\n# ---- Building dependencies... ----\n");
-
-      pDep = pRootState->pDepList;
-      while(!err && pDep)
-      {
-        if(pDep->pState)
-        {
-          err = FlyMakeBuildLibs(pDep->pState);
-          if(pDep->pState->fLibCompiled)
-          {
-            pRootState->fLibCompiled = TRUE;
-            ++pRootState->nCompiled;
-          }
-        }
-        pDep = pDep->pNext;
-      }
+      err = FmkDepListBuildDag(pRootState);
       FlyMakePrintfEx(FMK_VERBOSE_SOME, "\n# ---- Building project... ----\n");
     }
   }
@@ -0,0 +1,283 @@
+/**************************************************************************************************
+  flymakedepfile.c - reads compiler generated dependency files, e.g. src/out/foo.d from -MMD
+  Copyright 2024 Drew Gislason
+  license: <https://mit-license.org>
+**************************************************************************************************/
+#include "flymake.h"
+
+#define DEPFILE_SANCHK    6301
+#define DEPFILE_MAX_NAMES   32  // allocate blocks of names
+
+typedef struct
+{
+  unsigned      sanchk;
+  char         *szContents;   // contents of depfile, rewritten in place into '\0' terminated names
+  const char  **aszNames;     // prerequisites, e.g. "src/foo.c", "inc/foo.h"
+  unsigned      len;
+  unsigned      maxLen;
+} fmkDepFile_t;
+
+/*-------------------------------------------------------------------------------------------------
+  Is this a depfile handle?
+
+  @param  hDepFile    handle from FlyMakeDepFileNew()
+  @return TRUE if this is a depfile handle
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeDepFileIs(void *hDepFile)
+{
+  fmkDepFile_t  *pDepFile = hDepFile;
+  return (pDepFile && pDepFile->sanchk == DEPFILE_SANCHK) ? TRUE : FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Is this a line continuation, that is a backslash followed by "\n" or "\r\n"?
+
+  @param  psz   ptr to string
+  @return length of line continuation (2-3), or 0 if not a line continuation
+*///-----------------------------------------------------------------------------------------------
+static unsigned FmkDepFileIsContinue(const char *psz)
+{
+  unsigned  len = 0;
+
+  if(*psz == '\\')
+  {
+    if(psz[1] == '\n')
+      len = 2;
+    else if(psz[1] == '\r' && psz[2] == '\n')
+      len = 3;
+  }
+
+  return len;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add a prerequisite name to the depfile list
+
+  @param  pDepFile    ptr to depfile
+  @param  szName      name, points into pDepFile->szContents
+  @return TRUE if worked, FALSE if out of memory
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDepFileAdd(fmkDepFile_t *pDepFile, const char *szName)
+{
+  const char  **aszNew;
+  bool_t        fWorked = TRUE;
+
+  if(pDepFile->len >= pDepFile->maxLen)
+  {
+    aszNew = FlyRealloc(pDepFile->aszNames, sizeof(char *) * pDepFile->maxLen * 2);
+    if(!aszNew)
+      fWorked = FALSE;
+    else
+    {
+      pDepFile->aszNames = aszNew;
+      pDepFile->maxLen   = pDepFile->maxLen * 2;
+    }
+  }
+
+  if(fWorked)
+  {
+    pDepFile->aszNames[pDepFile->len] = szName;
+    ++pDepFile->len;
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Parse a make style rule into a list of prerequisites. Handles line continuations, escaped spaces
+  and "$$". Any other targets, such as the phony rules from -MP, are skipped.
+
+      src/out/foo.o: src/foo.c inc/foo.h \
+        ../deps/bar/inc/bar\ baz.h
+
+  @param  pDepFile    ptr to depfile, with szContents loaded
+  @return TRUE if worked, FALSE if out of memory or no target found
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkDepFileParse(fmkDepFile_t *pDepFile)
+{
+  char       *pszIn;
+  char       *pszOut;
+  char       *szName;
+  unsigned    len;
+  bool_t      fWorked = TRUE;
+
+  // skip the target, e.g. "src/out/foo.o:", allowing for drive letters such as "C:\"
+  pszIn = pDepFile->szContents;
+  while(*pszIn)
+  {
+    if(*pszIn == '\\' && pszIn[1])
+      ++pszIn;
+    else if(*pszIn == ':' && (pszIn[1] == '\0' || isspace((unsigned char)pszIn[1])))
+      break;
+    ++pszIn;
+  }
+  if(*pszIn != ':')
+    fWorked = FALSE;
+  else
+    ++pszIn;
+
+  // each prerequisite is unescaped in place, so pszOut never passes pszIn
+  while(fWorked && *pszIn)
+  {
+    // skip whitespace and line continuations
+    len = FmkDepFileIsContinue(pszIn);
+    if(len)
+    {
+      pszIn += len;
+      continue;
+    }
+    if(isspace((unsigned char)*pszIn))
+    {
+      ++pszIn;
+      continue;
+    }
+
+    szName = pszOut = pszIn;
+    while(*pszIn && !isspace((unsigned char)*pszIn) && !FmkDepFileIsContinue(pszIn))
+    {
+      if(*pszIn == '\\' && (pszIn[1] == ' ' || pszIn[1] == '#'))
+        ++pszIn;
+      else if(*pszIn == '$' && pszIn[1] == '$')
+        ++pszIn;
+      *pszOut++ = *pszIn++;
+    }
+
+    // skip the delimiter before terminating the name, as the '\0' may overwrite it
+    len = 0;
+    if(*pszIn)
+    {
+      len = FmkDepFileIsContinue(pszIn);
+      if(!len)
+        len = 1;
+    }
+    *pszOut = '\0';
+    pszIn += len;
+
+    // a name ending in ':' is another target, not a prerequisite
+    if(*szName && FlyStrCharLast(szName) != ':')
+      fWorked = FmkDepFileAdd(pDepFile, szName);
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Read a depfile created by the compiler, e.g. with `-MMD -MF src/out/foo.d`
+
+  Example use:
+
+      void *hDepFile = FlyMakeDepFileNew("src/out/foo.d");
+
+      if(!hDepFile || FlyMakeDepFileIsNewer(hDepFile, objModTime))
+        printf("needs compiling\n");
+      FlyMakeDepFileFree(hDepFile);
+
+  @param    szDepFile   path to depfile
+  @return   handle to depfile or NULL if depfile missing, invalid or out of memory
+*///-----------------------------------------------------------------------------------------------
+void * FlyMakeDepFileNew(const char *szDepFile)
+{
+  fmkDepFile_t   *pDepFile;
+  bool_t          fWorked = TRUE;
+
+  pDepFile = FlyAllocZ(sizeof(*pDepFile));
+  if(!pDepFile)
+    fWorked = FALSE;
+  else
+  {
+    pDepFile->sanchk      = DEPFILE_SANCHK;
+    pDepFile->maxLen      = DEPFILE_MAX_NAMES;
+    pDepFile->aszNames    = FlyAlloc(sizeof(char *) * pDepFile->maxLen);
+    pDepFile->szContents  = FlyFileRead(szDepFile);
+    if(!pDepFile->aszNames || !pDepFile->szContents)
+      fWorked = FALSE;
+  }
+
+  if(fWorked)
+    fWorked = FmkDepFileParse(pDepFile);
+
+  if(!fWorked && pDepFile)
+    pDepFile = FlyMakeDepFileFree(pDepFile);
+
+  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "FlyMakeDepFileNew(%s), len %u\n", szDepFile,
+                   FlyMakeDepFileLen(pDepFile));
+
+  return pDepFile;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Return # of prerequisites in the depfile
+
+  @param    hDepFile    handle from FlyMakeDepFileNew()
+  @return   # of prerequisites
+*///-----------------------------------------------------------------------------------------------
+unsigned FlyMakeDepFileLen(void *hDepFile)
+{
+  fmkDepFile_t  *pDepFile = hDepFile;
+  return FlyMakeDepFileIs(hDepFile) ? pDepFile->len : 0;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Get prerequisite i from the depfile, e.g. "inc/foo.h"
+
+  @param    hDepFile    handle from FlyMakeDepFileNew()
+  @param    i           index 0-(n-1)
+  @return   name of prerequisite, or NULL if bad index
+*///-----------------------------------------------------------------------------------------------
+const char * FlyMakeDepFileGetName(void *hDepFile, unsigned i)
+{
+  fmkDepFile_t  *pDepFile = hDepFile;
+  return (FlyMakeDepFileIs(hDepFile) && i < pDepFile->len) ? pDepFile->aszNames[i] : NULL;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Are any prerequisites newer than the given time (usually the modified time of the .o file)?
+
+  A missing prerequisite (e.g. a header that was deleted) counts as newer, so the file is rebuilt.
+
+  @param    hDepFile    handle from FlyMakeDepFileNew()
+  @param    modTime     time to compare against
+  @return   TRUE if any prerequisite is newer or missing
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeDepFileIsNewer(void *hDepFile, time_t modTime)
+{
+  sFlyFileInfo_t  info;
+  const char     *szName;
+  unsigned        i;
+  bool_t          fNewer = FALSE;
+
+  for(i = 0; i < FlyMakeDepFileLen(hDepFile); ++i)
+  {
+    szName = FlyMakeDepFileGetName(hDepFile, i);
+    FlyFileInfoInit(&info);
+    if(!FlyFileInfoGetEx(&info, szName) || !info.fExists || difftime(info.modTime, modTime) > 0)
+    {
+      FlyMakeDbgPrintf(FMK_DEBUG_MORE, "  %s is newer\n", szName);
+      fNewer = TRUE;
+      break;
+    }
+  }
+
+  return fNewer;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Free the depfile
+
+  @param    hDepFile    handle from FlyMakeDepFileNew()
+  @return   NULL
+*///-----------------------------------------------------------------------------------------------
+void * FlyMakeDepFileFree(void *hDepFile)
+{
+  fmkDepFile_t  *pDepFile = hDepFile;
+
+  if(FlyMakeDepFileIs(hDepFile))
+  {
+    FlyFreeIf(pDepFile->szContents);
+    FlyFreeIf(pDepFile->aszNames);
+    memset(pDepFile, 0, sizeof(*pDepFile));
+    FlyFree(pDepFile);
+  }
+
+  return NULL;
+}
@@ -0,0 +1,835 @@
+/**************************************************************************************************
+  flymakeexec.c - runs actions (see flymakeaction.c) locally or through a sandbox executor
+  Copyright 2024 Drew Gislason
+  license: <https://mit-license.org>
+
+  Each executor is a table of functions, so a remote executor for a build farm can be added beside
+  the two here:
+
+  local   - runs the command-line in the current folder, the default
+  sandbox - (--sandbox) a stand-in for remote execution. A server process, started by flymake, runs
+            each action in an empty temporary folder holding only the action's inputs, and sends
+            back its outputs. It talks to flymake over a unix socket with the protocol below.
+
+  The protocol has the shape of remote execution APIs: inputs are sent by digest, and the server
+  only asks for the contents it doesn't already have in its content addressed store (CAS).
+
+      flymake                                 server
+      -------                                 ------
+      cmd <len>\n<cmdline>
+      in <digest> <size> <path>\n ...
+      dir <path>\n ...
+      out <path>\n ...
+      end\n
+                                              missing <digest>\n ...
+                                              end\n
+      blob <digest> <size>\n<contents> ...
+      end\n
+                                              exit <code>\n
+                                              log <len>\n<stdout and stderr>
+                                              out <size> <path>\n<contents> ...
+                                              end\n
+
+  An action that isn't hermetic, or that the sandbox couldn't run, is run locally. So is one that
+  failed in the sandbox for a missing file, e.g. a header missed by the include scan. Any other
+  failure is the result, as a compile error would fail locally too.
+**************************************************************************************************/
+#include "flymake.h"
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define EXEC_UNAVAILABLE  -2    // executor couldn't run the action, so run it locally
+#define EXEC_SZ_LINE      1024  // longest protocol line
+
+typedef struct
+{
+  const char   *szName;
+  bool_t      (*pfnInit)(void);
+  int         (*pfnRun)(const flyMakeAction_t *pAction, flyStrSmart_t *pOutput);
+  void        (*pfnExit)(void);
+} fmkExec_t;
+
+static int    FmkExecLocalRun     (const flyMakeAction_t *pAction, flyStrSmart_t *pOutput);
+static bool_t FmkExecSandboxInit  (void);
+static int    FmkExecSandboxRun   (const flyMakeAction_t *pAction, flyStrSmart_t *pOutput);
+static void   FmkExecSandboxExit  (void);
+
+static const fmkExec_t m_execLocal    = { "local",   NULL,               FmkExecLocalRun,   NULL };
+static const fmkExec_t m_execSandbox  = { "sandbox", FmkExecSandboxInit, FmkExecSandboxRun, FmkExecSandboxExit };
+
+static const fmkExec_t   *m_pExec         = &m_execLocal;
+static flyMakeOpts_t     *m_pOpts         = NULL;
+static pid_t              m_pidOwner      = -1;   // process that started the executor
+static pid_t              m_pidServer     = -1;
+static char               m_szFolder[64];         // e.g. "/tmp/flymake.a1b2c3/"
+static char               m_szSocket[96];         // e.g. "/tmp/flymake.a1b2c3/sock"
+
+/*-------------------------------------------------------------------------------------------------
+  Run an action in the current folder, capturing its output
+
+  @param    pAction   ptr to action
+  @param    pOutput   return value, stdout and stderr of the command
+  @return   exit code of command
+*///-----------------------------------------------------------------------------------------------
+static int FmkExecLocalRun(const flyMakeAction_t *pAction, flyStrSmart_t *pOutput)
+{
+  flyMakeProc_t   proc;
+  int             exitCode;
+
+  FlyMakeProcInit(&proc, TRUE);
+  exitCode = FlyMakeProcRun(pAction->szCmdline, &proc);
+  if(proc.output.sz)
+    FlyStrSmartCat(pOutput, proc.output.sz);
+  FlyMakeProcUnInit(&proc);
+
+  return exitCode;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Make a folder and any parent folders, e.g. "src/out/rel/" (OK if already exists)
+
+  @param    szPath    folder, or file if fFile
+  @param    fFile     TRUE to only make the folders before the last '/', e.g. "src/" for "src/foo.c"
+  @return   TRUE if worked
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkExecMakeDirs(const char *szPath, bool_t fFile)
+{
+  char       *szDir;
+  char       *psz;
+  size_t      len;
+  bool_t      fWorked = TRUE;
+
+  // e.g. "src/out/rel/", so each folder ends in a slash
+  len = strlen(szPath);
+  szDir = FlyAlloc(len + 2);
+  if(!szDir)
+    fWorked = FALSE;
+  else
+  {
+    memcpy(szDir, szPath, len + 1);
+    if(fFile)
+    {
+      psz = strrchr(szDir, '/');
+      *(psz ? psz + 1 : szDir) = '\0';
+    }
+    else if(len && szDir[len - 1] != '/')
+      FlyStrZCat(szDir, "/", len + 2);
+  }
+
+  for(psz = szDir; fWorked && *szDir && (psz = strchr(psz + 1, '/')) != NULL; )
+  {
+    *psz = '\0';
+    if(mkdir(szDir, 0777) != 0 && errno != EEXIST)
+      fWorked = FALSE;
+    *psz = '/';
+  }
+  FlyFreeIf(szDir);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Write a whole file through a temporary file, so a partial file is never seen
+
+  @param    szPath    e.g. "src/out/rel/foo.o"
+  @param    pData     contents
+  @param    size      size of contents
+  @return   TRUE if worked
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkExecFileWrite(const char *szPath, const void *pData, size_t size)
+{
+  flyStrSmart_t   tmp;
+  FILE           *fp        = NULL;
+  bool_t          fWorked   = FALSE;
+
+  FlyStrSmartInit(&tmp);
+  FlyStrSmartSprintf(&tmp, "%s.%ld", szPath, (long)getpid());
+  if(tmp.sz)
+    fp = fopen(tmp.sz, "wb");
+  if(fp)
+  {
+    fWorked = (fwrite(pData, 1, size, fp) == size) ? TRUE : FALSE;
+    if(fclose(fp) != 0)
+      fWorked = FALSE;
+    if(fWorked && rename(tmp.sz, szPath) != 0)
+      fWorked = FALSE;
+    if(!fWorked)
+      remove(tmp.sz);
+  }
+  FlyStrSmartUnInit(&tmp);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Read a protocol line, without the '\n'
+
+  @param    fp        socket, opened for reading
+  @param    szLine    buffer for line
+  @return   TRUE if a complete line was read
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkExecReadLine(FILE *fp, char szLine[EXEC_SZ_LINE])
+{
+  size_t    len;
+  bool_t    fWorked = FALSE;
+
+  if(fgets(szLine, EXEC_SZ_LINE, fp))
+  {
+    len = strlen(szLine);
+    if(len && szLine[len - 1] == '\n')
+    {
+      szLine[len - 1] = '\0';
+      fWorked = TRUE;
+    }
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Read a block of data that follows a protocol line, e.g. the contents of "blob <digest> <size>\n"
+
+  @param    fp        socket, opened for reading
+  @param    size      size of data
+  @return   allocated data, '\0' terminated, or NULL if failed
+*///-----------------------------------------------------------------------------------------------
+static char * FmkExecReadData(FILE *fp, size_t size)
+{
+  char     *pData;
+
+  pData = FlyAlloc(size + 1);
+  if(pData)
+  {
+    if(fread(pData, 1, size, fp) != size)
+    {
+      FlyFree(pData);
+      pData = NULL;
+    }
+    else
+      pData[size] = '\0';
+  }
+
+  return pData;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Path to a blob in the server's content addressed store, e.g. "/tmp/flymake.a1b2c3/cas/0123..."
+
+  @param    pPath     return value, path
+  @param    digest    digest of blob
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkExecCasPath(flyStrSmart_t *pPath, uint64_t digest)
+{
+  FlyStrSmartSprintf(pPath, "%scas/%016llx", m_szFolder, (unsigned long long)digest);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Server: read an action from the socket, as sent by FmkExecSandboxRun()
+
+  @param    fpIn      socket, opened for reading
+  @return   allocated action, or NULL if failed
+*///-----------------------------------------------------------------------------------------------
+static flyMakeAction_t * FmkExecServeReadAction(FILE *fpIn)
+{
+  flyMakeAction_t  *pAction   = NULL;
+  char              szLine[EXEC_SZ_LINE];
+  char             *szCmdline = NULL;
+  unsigned long long digest;
+  size_t            size;
+  int               pos;
+  bool_t            fWorked   = FALSE;
+
+  if(FmkExecReadLine(fpIn, szLine) && sscanf(szLine, "cmd %zu", &size) == 1)
+    szCmdline = FmkExecReadData(fpIn, size);
+  if(szCmdline)
+    pAction = FlyMakeActionNew(szCmdline);
+
+  while(pAction && FmkExecReadLine(fpIn, szLine))
+  {
+    pos = 0;
+    if(strcmp(szLine, "end") == 0)
+    {
+      fWorked = TRUE;
+      break;
+    }
+    else if(sscanf(szLine, "in %llx %zu %n", &digest, &size, &pos) == 2 && pos)
+    {
+      if(!FlyMakeActionAddDigest(pAction, &szLine[pos], (uint64_t)digest, size))
+        break;
+    }
+    else if(strncmp(szLine, "dir ", 4) == 0)
+    {
+      if(!FlyMakeActionAddDir(pAction, &szLine[4]))
+        break;
+    }
+    else if(strncmp(szLine, "out ", 4) == 0)
+    {
+      if(!FlyMakeActionAddOutput(pAction, &szLine[4]))
+        break;
+    }
+    else
+      break;
+  }
+
+  // the server only runs what it can sandbox
+  if(pAction && (!fWorked || !pAction->fHermetic))
+    pAction = FlyMakeActionFree(pAction);
+  FlyFreeIf(szCmdline);
+
+  return pAction;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Server: ask for inputs not in the content addressed store, and store them as they arrive. Each
+  blob is checked against its digest.
+
+  @param    fpIn      socket, opened for reading
+  @param    fpOut     socket, opened for writing
+  @param    pAction   action with inputs
+  @return   TRUE if all inputs are in the store
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkExecServeBlobs(FILE *fpIn, FILE *fpOut, const flyMakeAction_t *pAction)
+{
+  flyStrSmart_t       path;
+  char                szLine[EXEC_SZ_LINE];
+  char               *pData;
+  unsigned long long  digest;
+  size_t              size;
+  unsigned            i;
+  bool_t              fWorked = TRUE;
+
+  FlyStrSmartInit(&path);
+  for(i = 0; i < pAction->nInputs; ++i)
+  {
+    FmkExecCasPath(&path, pAction->aInputs[i].digest);
+    if(path.sz && access(path.sz, F_OK) != 0)
+      fprintf(fpOut, "missing %016llx\n", (unsigned long long)pAction->aInputs[i].digest);
+  }
+  fprintf(fpOut, "end\n");
+  fflush(fpOut);
+
+  while(fWorked && FmkExecReadLine(fpIn, szLine) && strcmp(szLine, "end") != 0)
+  {
+    fWorked = FALSE;
+    if(sscanf(szLine, "blob %llx %zu", &digest, &size) == 2)
+    {
+      pData = FmkExecReadData(fpIn, size);
+      FmkExecCasPath(&path, (uint64_t)digest);
+      if(pData && path.sz && FlyMakeHash(pData, size, 0) == (uint64_t)digest)
+        fWorked = FmkExecFileWrite(path.sz, pData, size);
+      FlyFreeIf(pData);
+    }
+  }
+
+  // every input must be there now
+  for(i = 0; fWorked && i < pAction->nInputs; ++i)
+  {
+    FmkExecCasPath(&path, pAction->aInputs[i].digest);
+    if(!path.sz || access(path.sz, F_OK) != 0)
+      fWorked = FALSE;
+  }
+  FlyStrSmartUnInit(&path);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Server: handle one connection. Runs in its own process, so it can change folders.
+
+  @param    fd        connected socket
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkExecServeAction(int fd)
+{
+  flyMakeAction_t  *pAction   = NULL;
+  flyMakeProc_t     proc;
+  flyStrSmart_t     path;
+  flyStrSmart_t     sandbox;
+  FILE             *fpIn;
+  FILE             *fpOut;
+  char             *pData;
+  size_t            size;
+  unsigned          i;
+  bool_t            fWorked   = FALSE;
+
+  FlyStrSmartInit(&path);
+  FlyStrSmartInit(&sandbox);
+  FlyMakeProcInit(&proc, TRUE);
+  fpIn  = fdopen(fd, "rb");
+  fpOut = fdopen(dup(fd), "wb");
+  if(fpIn && fpOut)
+    pAction = FmkExecServeReadAction(fpIn);
+  if(pAction)
+    fWorked = FmkExecServeBlobs(fpIn, fpOut, pAction);
+
+  // an empty folder with just the inputs, e.g. "/tmp/flymake.a1b2c3/run.1234/"
+  if(fWorked)
+  {
+    FlyStrSmartSprintf(&sandbox, "%srun.%ld/", m_szFolder, (long)getpid());
+    fWorked = (sandbox.sz && FmkExecMakeDirs(sandbox.sz, FALSE) && chdir(sandbox.sz) == 0) ? TRUE : FALSE;
+  }
+  for(i = 0; fWorked && i < pAction->nDirs; ++i)
+    fWorked = FmkExecMakeDirs(pAction->aszDirs[i], FALSE);
+  for(i = 0; fWorked && i < pAction->nOutputs; ++i)
+    fWorked = FmkExecMakeDirs(pAction->aszOutputs[i], TRUE);
+  for(i = 0; fWorked && i < pAction->nInputs; ++i)
+  {
+    FmkExecCasPath(&path, pAction->aInputs[i].digest);
+    fWorked = FmkExecMakeDirs(pAction->aInputs[i].szPath, TRUE);
+    if(fWorked && (!path.sz || link(path.sz, pAction->aInputs[i].szPath) != 0))
+      fWorked = FALSE;
+  }
+
+  // run it and send back the outputs
+  if(fWorked)
+  {
+    FlyMakeProcRun(pAction->szCmdline, &proc);
+    fprintf(fpOut, "exit %d\n", proc.exitCode);
+    fprintf(fpOut, "log %zu\n%s", proc.output.sz ? strlen(proc.output.sz) : 0, proc.output.sz ? proc.output.sz : "");
+    for(i = 0; i < pAction->nOutputs; ++i)
+    {
+      pData = FlyMakeActionFileAlloc(pAction->aszOutputs[i], &size);
+      if(pData)
+      {
+        fprintf(fpOut, "out %zu %s\n", size, pAction->aszOutputs[i]);
+        fwrite(pData, 1, size, fpOut);
+        FlyFree(pData);
+      }
+    }
+  }
+  if(fpOut)
+  {
+    fprintf(fpOut, "end\n");
+    fclose(fpOut);
+  }
+  if(fpIn)
+    fclose(fpIn);
+
+  if(sandbox.sz && chdir(m_szFolder) == 0)
+  {
+    FlyStrSmartSprintf(&path, "rm -rf %s", sandbox.sz);
+    if(path.sz)
+      FlyMakeProcRun(path.sz, NULL);
+  }
+
+  FlyMakeActionFree(pAction);
+  FlyMakeProcUnInit(&proc);
+  FlyStrSmartUnInit(&path);
+  FlyStrSmartUnInit(&sandbox);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Server: accept connections until flymake exits, each handled in its own process, so -j runs
+  actions in parallel.
+
+  @param    fdListen    listening socket
+  @param    pidParent   flymake, the server ends when it does
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkExecServe(int fdListen, pid_t pidParent)
+{
+  struct pollfd   pfd;
+  pid_t           pid;
+  int             fd;
+
+  // connections are reaped automatically
+  signal(SIGCHLD, SIG_IGN);
+  while(getppid() == pidParent)
+  {
+    pfd.fd      = fdListen;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    if(poll(&pfd, 1, 1000) <= 0)
+      continue;
+    fd = accept(fdListen, NULL, NULL);
+    if(fd < 0)
+      continue;
+    pid = fork();
+    if(pid == 0)
+    {
+      signal(SIGCHLD, SIG_DFL);
+      close(fdListen);
+      FmkExecServeAction(fd);
+      _exit(0);
+    }
+    close(fd);
+  }
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Start the sandbox server in a temporary folder, listening on a unix socket
+
+  @return   TRUE if worked
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkExecSandboxInit(void)
+{
+  struct sockaddr_un  addr;
+  flyStrSmart_t       cas;
+  char                szTemplate[]  = "/tmp/flymake.XXXXXX";
+  int                 fdListen      = -1;
+  pid_t               pidParent;
+  bool_t              fWorked       = FALSE;
+
+  // e.g. "/tmp/flymake.a1b2c3/sock" and "/tmp/flymake.a1b2c3/cas/"
+  FlyStrSmartInit(&cas);
+  if(mkdtemp(szTemplate))
+  {
+    snprintf(m_szFolder, sizeof(m_szFolder), "%s/", szTemplate);
+    snprintf(m_szSocket, sizeof(m_szSocket), "%ssock", m_szFolder);
+    FlyStrSmartSprintf(&cas, "%scas/", m_szFolder);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    FlyStrZCpy(addr.sun_path, m_szSocket, sizeof(addr.sun_path));
+    fdListen = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fdListen >= 0 && cas.sz && FmkExecMakeDirs(cas.sz, FALSE) &&
+       bind(fdListen, (struct sockaddr *)&addr, sizeof(addr)) == 0 && listen(fdListen, 16) == 0)
+    {
+      fWorked = TRUE;
+    }
+  }
+
+  if(fWorked)
+  {
+    pidParent = getpid();
+    fflush(stdout);
+    m_pidServer = fork();
+    if(m_pidServer == 0)
+    {
+      FmkExecServe(fdListen, pidParent);
+      _exit(0);
+    }
+    if(m_pidServer < 0)
+      fWorked = FALSE;
+  }
+  if(fdListen >= 0)
+    close(fdListen);
+  if(!fWorked)
+    FmkExecSandboxExit();
+
+  FlyMakeDbgPrintf(FMK_DEBUG_SOME, "FmkExecSandboxInit(%s), fWorked %u\n", m_szSocket, fWorked);
+  FlyStrSmartUnInit(&cas);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Send the action's inputs the server asked for
+
+  @param    fpIn      socket, opened for reading
+  @param    fpOut     socket, opened for writing
+  @param    pAction   ptr to action
+  @return   TRUE if worked, FALSE if an input is gone or has changed
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkExecSandboxSendBlobs(FILE *fpIn, FILE *fpOut, const flyMakeAction_t *pAction)
+{
+  char                szLine[EXEC_SZ_LINE];
+  char               *pData;
+  unsigned long long  digest;
+  size_t              size;
+  unsigned            i;
+  bool_t              fEnd      = FALSE;
+  bool_t              fWorked   = TRUE;
+
+  while(fWorked && !fEnd)
+  {
+    fWorked = FALSE;
+    if(!FmkExecReadLine(fpIn, szLine))
+      break;
+    if(strcmp(szLine, "end") == 0)
+    {
+      fEnd = TRUE;
+      fWorked = TRUE;
+    }
+    else if(sscanf(szLine, "missing %llx", &digest) == 1)
+    {
+      for(i = 0; i < pAction->nInputs; ++i)
+      {
+        if(pAction->aInputs[i].digest == (uint64_t)digest)
+          break;
+      }
+      pData = (i < pAction->nInputs) ? FlyMakeActionFileAlloc(pAction->aInputs[i].szPath, &size) : NULL;
+      if(pData && FlyMakeHash(pData, size, 0) == (uint64_t)digest)
+      {
+        fprintf(fpOut, "blob %016llx %zu\n", digest, size);
+        if(fwrite(pData, 1, size, fpOut) == size)
+          fWorked = TRUE;
+      }
+      FlyFreeIf(pData);
+    }
+  }
+
+  if(fWorked)
+  {
+    fprintf(fpOut, "end\n");
+    if(fflush(fpOut) != 0)
+      fWorked = FALSE;
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Read the result of an action from the server, writing its outputs
+
+  @param    fpIn      socket, opened for reading
+  @param    pAction   ptr to action
+  @param    pOutput   return value, stdout and stderr of the command
+  @return   exit code of the command, or EXEC_UNAVAILABLE if the server couldn't run it
+*///-----------------------------------------------------------------------------------------------
+static int FmkExecSandboxResult(FILE *fpIn, const flyMakeAction_t *pAction, flyStrSmart_t *pOutput)
+{
+  char        szLine[EXEC_SZ_LINE];
+  char       *pData     = NULL;
+  size_t      size;
+  unsigned    i;
+  int         exitCode  = EXEC_UNAVAILABLE;
+  int         pos;
+  bool_t      fWorked   = FALSE;
+
+  if(FmkExecReadLine(fpIn, szLine) && sscanf(szLine, "exit %d", &exitCode) == 1 &&
+     FmkExecReadLine(fpIn, szLine) && sscanf(szLine, "log %zu", &size) == 1)
+  {
+    pData = FmkExecReadData(fpIn, size);
+    if(pData)
+    {
+      FlyStrSmartCat(pOutput, pData);
+      FlyFree(pData);
+      fWorked = TRUE;
+    }
+  }
+
+  // only outputs the action expects are written
+  while(fWorked && FmkExecReadLine(fpIn, szLine) && strcmp(szLine, "end") != 0)
+  {
+    fWorked = FALSE;
+    pos = 0;
+    if(sscanf(szLine, "out %zu %n", &size, &pos) == 1 && pos)
+    {
+      for(i = 0; i < pAction->nOutputs; ++i)
+      {
+        if(strcmp(pAction->aszOutputs[i], &szLine[pos]) == 0)
+          break;
+      }
+      pData = FmkExecReadData(fpIn, size);
+      if(pData && i < pAction->nOutputs)
+        fWorked = FmkExecFileWrite(pAction->aszOutputs[i], pData, size);
+      FlyFreeIf(pData);
+    }
+  }
+
+  if(!fWorked)
+    exitCode = EXEC_UNAVAILABLE;
+
+  return exitCode;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Run an action in the sandbox server, see the protocol at the top of this file
+
+  @param    pAction   ptr to action
+  @param    pOutput   return value, stdout and stderr of the command
+  @return   exit code of command, or EXEC_UNAVAILABLE if couldn't run it in the sandbox
+*///-----------------------------------------------------------------------------------------------
+static int FmkExecSandboxRun(const flyMakeAction_t *pAction, flyStrSmart_t *pOutput)
+{
+  struct sockaddr_un  addr;
+  FILE               *fpIn      = NULL;
+  FILE               *fpOut     = NULL;
+  unsigned            i;
+  int                 fd;
+  int                 exitCode  = EXEC_UNAVAILABLE;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  FlyStrZCpy(addr.sun_path, m_szSocket, sizeof(addr.sun_path));
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd >= 0)
+  {
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+    {
+      fpIn  = fdopen(fd, "rb");
+      fpOut = fdopen(dup(fd), "wb");
+    }
+    if(!fpIn)
+      close(fd);
+  }
+
+  // the action, by digest
+  if(fpIn && fpOut)
+  {
+    fprintf(fpOut, "cmd %zu\n%s", strlen(pAction->szCmdline), pAction->szCmdline);
+    for(i = 0; i < pAction->nInputs; ++i)
+    {
+      fprintf(fpOut, "in %016llx %zu %s\n", (unsigned long long)pAction->aInputs[i].digest,
+              pAction->aInputs[i].size, pAction->aInputs[i].szPath);
+    }
+    for(i = 0; i < pAction->nDirs; ++i)
+      fprintf(fpOut, "dir %s\n", pAction->aszDirs[i]);
+    for(i = 0; i < pAction->nOutputs; ++i)
+      fprintf(fpOut, "out %s\n", pAction->aszOutputs[i]);
+    fprintf(fpOut, "end\n");
+    if(fflush(fpOut) == 0 && FmkExecSandboxSendBlobs(fpIn, fpOut, pAction))
+      exitCode = FmkExecSandboxResult(fpIn, pAction, pOutput);
+  }
+
+  if(fpOut)
+    fclose(fpOut);
+  if(fpIn)
+    fclose(fpIn);
+
+  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "FmkExecSandboxRun(%s) = %d\n", pAction->szCmdline, exitCode);
+
+  return exitCode;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Stop the sandbox server and remove its temporary folder
+
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkExecSandboxExit(void)
+{
+  flyStrSmart_t   cmdline;
+
+  if(m_pidServer > 0)
+  {
+    kill(m_pidServer, SIGTERM);
+    FlyMakeProcWait(m_pidServer);
+    m_pidServer = -1;
+  }
+  if(*m_szFolder)
+  {
+    FlyStrSmartInit(&cmdline);
+    FlyStrSmartSprintf(&cmdline, "rm -rf %s", m_szFolder);
+    if(cmdline.sz)
+      FlyMakeProcRun(cmdline.sz, NULL);
+    FlyStrSmartUnInit(&cmdline);
+    *m_szFolder = '\0';
+  }
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Called when flymake exits. Child processes (e.g. jobs) leave the executor to flymake itself.
+*///-----------------------------------------------------------------------------------------------
+static void FmkExecAtExit(void)
+{
+  if(getpid() == m_pidOwner && m_pExec->pfnExit)
+    (*m_pExec->pfnExit)();
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Choose the executor for actions: the sandbox with --sandbox, otherwise local. If the sandbox
+  can't start, actions run locally.
+
+  @param    pOpts     options, for --sandbox and -n
+  @return   TRUE if the executor chosen is running
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeExecInit(flyMakeOpts_t *pOpts)
+{
+  bool_t    fWorked = TRUE;
+
+  m_pOpts = pOpts;
+  if(pOpts->fSandbox && !pOpts->fNoBuild)
+  {
+    m_pExec = &m_execSandbox;
+    if(m_pExec->pfnInit && !(*m_pExec->pfnInit)())
+    {
+      FlyMakePrintf("# could not start sandbox, compiling locally\n");
+      m_pExec = &m_execLocal;
+      fWorked = FALSE;
+    }
+    else
+    {
+      m_pidOwner = getpid();
+      atexit(FmkExecAtExit);
+    }
+  }
+
+  FlyMakeDbgPrintf(FMK_DEBUG_SOME, "FlyMakeExecInit(), executor %s, fWorked %u\n", m_pExec->szName, fWorked);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Is the executor local? If so, callers may run command-lines directly, e.g. in the job pool,
+  rather than making actions.
+
+  @return   TRUE if local
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeExecIsLocal(void)
+{
+  return (m_pExec == &m_execLocal) ? TRUE : FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Did an action fail in the executor because an input wasn't sent? Looks for what compilers print
+  for a missing file, e.g. "fatal error: foo.h: No such file or directory" (gcc) or
+  "fatal error: 'foo.h' file not found" (clang).
+
+  @param    szOutput  stdout and stderr of the command
+  @return   TRUE if an input was missing
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkExecIsMissingInput(const char *szOutput)
+{
+  static const char *aszMissing[] = { "No such file or directory", "file not found", "Cannot open include file" };
+  unsigned  i;
+
+  for(i = 0; szOutput && i < NumElements(aszMissing); ++i)
+  {
+    if(strstr(szOutput, aszMissing[i]))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Run an action with the executor, printing its command-line and then its output. An action that
+  isn't hermetic, or that the executor couldn't run or that failed there for a missing input, is
+  run locally.
+
+  With -n, just prints the command-line.
+
+  @param    pAction   ptr to action
+  @return   exit code of command, 0 if worked
+*///-----------------------------------------------------------------------------------------------
+int FlyMakeExecRun(const flyMakeAction_t *pAction)
+{
+  flyStrSmart_t   output;
+  int             exitCode  = EXEC_UNAVAILABLE;
+
+  FlyMakePrintfEx(FMK_VERBOSE_SOME, "%s\n", pAction->szCmdline);
+  if(m_pOpts && m_pOpts->fNoBuild)
+    exitCode = 0;
+  else
+  {
+    if(FlyMakeDebug() >= FMK_DEBUG_MORE)
+      FlyMakeActionPrint(pAction);
+    FlyStrSmartInit(&output);
+    if(pAction->fHermetic && !FlyMakeExecIsLocal())
+    {
+      exitCode = (*m_pExec->pfnRun)(pAction, &output);
+
+      // a compile error is the result, only a missing input is worth running again locally
+      if(exitCode != 0 && (exitCode == EXEC_UNAVAILABLE || FmkExecIsMissingInput(output.sz)))
+      {
+        FlyMakeDbgPrintf(FMK_DEBUG_SOME, "  %s executor: exit %d, running locally\n", m_pExec->szName, exitCode);
+        exitCode = EXEC_UNAVAILABLE;
+        FlyStrSmartCpy(&output, "");
+      }
+    }
+    if(exitCode == EXEC_UNAVAILABLE)
+      exitCode = FmkExecLocalRun(pAction, &output);
+    if(output.sz && *output.sz)
+      FlyMakePrintf("%s", output.sz);
+    FlyStrSmartUnInit(&output);
+  }
+
+  return exitCode;
+}
@@ -0,0 +1,214 @@
+/**************************************************************************************************
+  flymakehash.c - fast 64-bit non-cryptographic hash (XXH64) for command-lines and file contents
+  Copyright 2024 Drew Gislason
+  license: <https://mit-license.org>
+
+  Implements the XXH64 algorithm. See <https://github.com/Cyan4973/xxHash>.
+**************************************************************************************************/
+#include "flymake.h"
+#include "FlyStr.h"
+
+static const uint64_t m_prime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t m_prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t m_prime3 = 0x165667B19E3779F9ULL;
+static const uint64_t m_prime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t m_prime5 = 0x27D4EB2F165667C5ULL;
+
+static uint64_t FmkHashRotl(uint64_t x, unsigned r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t FmkHashRead64(const uint8_t *p)
+{
+  uint64_t  v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t FmkHashRead32(const uint8_t *p)
+{
+  uint32_t  v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint64_t FmkHashRound(uint64_t acc, uint64_t input)
+{
+  acc += input * m_prime2;
+  acc  = FmkHashRotl(acc, 31);
+  acc *= m_prime1;
+  return acc;
+}
+
+static uint64_t FmkHashMerge(uint64_t acc, uint64_t val)
+{
+  acc ^= FmkHashRound(0, val);
+  acc  = acc * m_prime1 + m_prime4;
+  return acc;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Hash a block of memory. Assumes a little endian host, as the hash is only used for local files.
+
+  @param    pData     ptr to data
+  @param    len       length of data in bytes
+  @param    seed      seed, 0 for most uses, or the previous hash to chain hashes
+  @return   64-bit hash
+*///-----------------------------------------------------------------------------------------------
+uint64_t FlyMakeHash(const void *pData, size_t len, uint64_t seed)
+{
+  const uint8_t  *p     = pData;
+  const uint8_t  *pEnd  = p + len;
+  uint64_t        v1, v2, v3, v4;
+  uint64_t        h;
+
+  if(len >= 32)
+  {
+    v1 = seed + m_prime1 + m_prime2;
+    v2 = seed + m_prime2;
+    v3 = seed;
+    v4 = seed - m_prime1;
+    do
+    {
+      v1 = FmkHashRound(v1, FmkHashRead64(p));
+      v2 = FmkHashRound(v2, FmkHashRead64(p + 8));
+      v3 = FmkHashRound(v3, FmkHashRead64(p + 16));
+      v4 = FmkHashRound(v4, FmkHashRead64(p + 24));
+      p += 32;
+    } while(p + 32 <= pEnd);
+
+    h = FmkHashRotl(v1, 1) + FmkHashRotl(v2, 7) + FmkHashRotl(v3, 12) + FmkHashRotl(v4, 18);
+    h = FmkHashMerge(h, v1);
+    h = FmkHashMerge(h, v2);
+    h = FmkHashMerge(h, v3);
+    h = FmkHashMerge(h, v4);
+  }
+  else
+    h = seed + m_prime5;
+
+  h += (uint64_t)len;
+
+  while(p + 8 <= pEnd)
+  {
+    h ^= FmkHashRound(0, FmkHashRead64(p));
+    h  = FmkHashRotl(h, 27) * m_prime1 + m_prime4;
+    p += 8;
+  }
+  if(p + 4 <= pEnd)
+  {
+    h ^= (uint64_t)FmkHashRead32(p) * m_prime1;
+    h  = FmkHashRotl(h, 23) * m_prime2 + m_prime3;
+    p += 4;
+  }
+  while(p < pEnd)
+  {
+    h ^= (*p) * m_prime5;
+    h  = FmkHashRotl(h, 11) * m_prime1;
+    ++p;
+  }
+
+  // avalanche
+  h ^= h >> 33;
+  h *= m_prime2;
+  h ^= h >> 29;
+  h *= m_prime3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Hash a string, e.g. a command-line
+
+  @param    sz      '\0' terminated string
+  @return   64-bit hash
+*///-----------------------------------------------------------------------------------------------
+uint64_t FlyMakeHashStr(const char *sz)
+{
+  return FlyMakeHash(sz, strlen(sz), 0);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Hash the contents of a file, e.g. a source file or header. The whole file is hashed, including
+  anything after an embedded '\0'.
+
+  @param    szPath    path to file, e.g. "inc/foo.h"
+  @param    pHash     return value, 64-bit hash of contents
+  @return   TRUE if the file could be read
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeHashFile(const char *szPath, uint64_t *pHash)
+{
+  char       *pData;
+  size_t      size;
+  bool_t      fWorked = FALSE;
+
+  pData = FlyMakeActionFileAlloc(szPath, &size);
+  if(pData)
+  {
+    *pHash = FlyMakeHash(pData, size, 0);
+    FlyFree(pData);
+    fWorked = TRUE;
+  }
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add the identity of the program run by a command-line to a hash, e.g. "cc" in "cc {in} -c ...".
+  The program is found in the PATH, and its path, size and modified time are hashed, so upgrading
+  the compiler changes the hash, without running it to ask its version.
+
+  @param    szCmdline   command-line or format, e.g. "cc {in} -c {incs}{warn}{debug}{dep}-o {out}"
+  @param    hash        hash so far, or 0
+  @return   64-bit hash
+*///-----------------------------------------------------------------------------------------------
+uint64_t FlyMakeHashTool(const char *szCmdline, uint64_t hash)
+{
+  sFlyFileInfo_t  info;
+  flyStrSmart_t   path;
+  const char     *psz;
+  int             len;
+  int             dirLen;
+  bool_t          fFound  = FALSE;
+
+  FlyStrSmartInit(&path);
+  szCmdline = FlyStrSkipWhite(szCmdline);
+  len = (int)FlyStrArgLen(szCmdline);
+
+  // e.g. "/usr/bin/cc", or search each folder in the PATH, e.g. "/usr/local/bin:/usr/bin"
+  FlyFileInfoInit(&info);
+  if(memchr(szCmdline, '/', len))
+  {
+    FlyStrSmartSprintf(&path, "%.*s", len, szCmdline);
+    if(path.sz && FlyFileInfoGetEx(&info, path.sz) && !info.fIsDir)
+      fFound = TRUE;
+  }
+  else
+  {
+    psz = getenv("PATH");
+    while(!fFound && psz && *psz)
+    {
+      dirLen = (int)strcspn(psz, ":");
+      FlyStrSmartSprintf(&path, "%.*s/%.*s", dirLen, psz, len, szCmdline);
+      if(dirLen && path.sz && FlyFileInfoGetEx(&info, path.sz) && !info.fIsDir)
+        fFound = TRUE;
+      psz += dirLen;
+      if(*psz == ':')
+        ++psz;
+    }
+  }
+
+  if(fFound)
+  {
+    hash = FlyMakeHash(path.sz, strlen(path.sz), hash);
+    hash = FlyMakeHash(&info.size, sizeof(info.size), hash);
+    hash = FlyMakeHash(&info.modTime, sizeof(info.modTime), hash);
+  }
+  else
+    hash = FlyMakeHash(szCmdline, (size_t)len, hash);
+
+  FlyStrSmartUnInit(&path);
+
+  return hash;
+}
@@ -0,0 +1,576 @@
+/**************************************************************************************************
+  flymakejobs.c - a bounded pool of child processes, used to compile files in parallel (-j)
+  Copyright 2024 Drew Gislason
+  license: <https://mit-license.org>
+**************************************************************************************************/
+#include "flymake.h"
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+
+#define JOBS_SANCHK     4049
+#define JOBS_MAX_JOBS     16  // allocate blocks of jobs
+
+typedef enum
+{
+  FMK_JOB_RUNNING = 1,
+  FMK_JOB_OK      = 0,
+  FMK_JOB_FAILED  = -1
+} fmkJobStatus_t;
+
+typedef struct
+{
+  char           *szName;     // name for reporting, e.g. "src/foo.c"
+  char           *szCmdline;  // e.g. "cc src/foo.c -c -I. -Iinc/ -Wall -Werror -o src/out/foo.o"
+  flyStrSmart_t   output;     // stdout/stderr from child, printed all at once when job is done
+  pid_t           pid;
+  int             fd;         // read side of child's stdout/stderr, or -1 if not running
+  fmkJobStatus_t  status;
+  int             exitCode;   // exit code, once done
+  unsigned        tag;        // caller's tag, e.g. index of the tool this file belongs to
+  bool_t          fFn;        // job is a function run in a child process, see FlyMakeJobsAddFn()
+} fmkJob_t;
+
+typedef struct
+{
+  unsigned        sanchk;
+  flyMakeOpts_t  *pOpts;
+  fmkJob_t       *aJobs;
+  unsigned        nJobs;
+  unsigned        nMaxJobs;   // # of jobs allocated in aJobs
+  unsigned        nRunning;
+  unsigned        maxRunning; // from -j=N
+  unsigned        nTokens;    // jobserver tokens held, one for each running job beyond the 1st
+  unsigned        nFailed;
+} fmkJobs_t;
+
+/*-------------------------------------------------------------------------------------------------
+  Is this a job pool?
+
+  @param  hJobs   handle from FlyMakeJobsNew()
+  @return TRUE if this is a job pool
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeJobsIs(void *hJobs)
+{
+  fmkJobs_t  *pJobs = hJobs;
+  return (pJobs && pJobs->sanchk == JOBS_SANCHK) ? TRUE : FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Return the number of online CPUs, used as the default for a bare -j
+
+  @return   # of CPUs, always at least 1
+*///-----------------------------------------------------------------------------------------------
+unsigned FlyMakeJobsCpus(void)
+{
+  long    nCpus;
+
+  nCpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if(nCpus < 1)
+    nCpus = 1;
+
+  return (unsigned)nCpus;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Create a new pool of jobs. Up to pOpts->jobs child processes run at once. If there is a jobserver
+  (see FlyMakeJobServerInit()), each job beyond the first also needs a token from the jobserver.
+
+  Example use:
+
+      void *hJobs = FlyMakeJobsNew(&pState->opts);
+
+      FlyMakeJobsAdd(hJobs, "src/foo.c", "cc src/foo.c -c -o src/out/foo.o", 0);
+      FlyMakeJobsAdd(hJobs, "src/bar.c", "cc src/bar.c -c -o src/out/bar.o", 0);
+      if(FlyMakeJobsWait(hJobs))
+        printf("something failed\n");
+      FlyMakeJobsFree(hJobs);
+
+  @param    pOpts     options, for -j, -n and -v
+  @return   handle to job pool or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+void * FlyMakeJobsNew(flyMakeOpts_t *pOpts)
+{
+  fmkJobs_t  *pJobs;
+
+  pJobs = FlyAllocZ(sizeof(*pJobs));
+  if(pJobs)
+  {
+    pJobs->aJobs = FlyAllocZ(sizeof(fmkJob_t) * JOBS_MAX_JOBS);
+    if(!pJobs->aJobs)
+    {
+      FlyFree(pJobs);
+      pJobs = NULL;
+    }
+    else
+    {
+      pJobs->sanchk     = JOBS_SANCHK;
+      pJobs->pOpts      = pOpts;
+      pJobs->nMaxJobs   = JOBS_MAX_JOBS;
+      pJobs->maxRunning = (pOpts->jobs > 0) ? (unsigned)pOpts->jobs : 1;
+    }
+  }
+
+  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "FlyMakeJobsNew(jobs %d) = %p\n", pOpts->jobs, pJobs);
+
+  return pJobs;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  A job has ended (EOF on its output). Reap the child and print its cmdline and output together so
+  output from different compilers doesn't interleave.
+
+  @param    pJobs     ptr to job pool
+  @param    pJob      ptr to job that has ended
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkJobDone(fmkJobs_t *pJobs, fmkJob_t *pJob)
+{
+  close(pJob->fd);
+  pJob->fd = -1;
+  pJob->exitCode = FlyMakeProcWait(pJob->pid);
+  if(pJob->exitCode == 0 || (pJob->fFn && pJob->exitCode >= FMK_JOB_CHANGED))
+    pJob->status = FMK_JOB_OK;
+  else
+  {
+    pJob->status = FMK_JOB_FAILED;
+    ++pJobs->nFailed;
+  }
+  --pJobs->nRunning;
+
+  // give back tokens no longer needed, so other processes sharing the jobserver can use them
+  while(pJobs->nTokens && pJobs->nTokens >= pJobs->nRunning)
+  {
+    FlyMakeJobServerRelease();
+    --pJobs->nTokens;
+  }
+
+  if(!pJob->fFn)
+    FlyMakePrintfEx(FMK_VERBOSE_SOME, "%s\n", pJob->szCmdline);
+  if(pJob->output.sz && *pJob->output.sz)
+    FlyMakePrintf("%s", pJob->output.sz);
+  fflush(stdout);
+
+  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "  job %s done, status %d\n", pJob->szName, pJob->status);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Is there a free slot to start another job? The first job always runs on flymake's own slot. Each
+  job after that needs a token from the jobserver, if there is one.
+
+  @param    pJobs     ptr to job pool
+  @return   TRUE if another job can be started now
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkJobsSlot(fmkJobs_t *pJobs)
+{
+  bool_t    fSlot = FALSE;
+
+  if(pJobs->nRunning == 0)
+    fSlot = TRUE;
+  else if(pJobs->nRunning < pJobs->maxRunning)
+  {
+    if(pJobs->nTokens >= pJobs->nRunning)
+      fSlot = TRUE;
+    else if(FlyMakeJobServerAcquire())
+    {
+      if(FlyMakeJobServerFd() >= 0)
+        ++pJobs->nTokens;
+      fSlot = TRUE;
+    }
+  }
+
+  return fSlot;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Wait for output from any running job, buffering it. Reaps any job that has finished.
+
+  @param    pJobs     ptr to job pool
+  @param    fToken    also wake up if the jobserver may have a token
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkJobsPoll(fmkJobs_t *pJobs, bool_t fToken)
+{
+  struct pollfd  *aFds;
+  unsigned       *aIndex;
+  char            szBuf[512];
+  ssize_t         len;
+  unsigned        i;
+  unsigned        n = 0;
+
+  aFds    = FlyAlloc(sizeof(*aFds) * (pJobs->nRunning + 1));
+  aIndex  = FlyAlloc(sizeof(*aIndex) * (pJobs->nRunning + 1));
+  if(aFds && aIndex)
+  {
+    for(i = 0; i < pJobs->nJobs && n < pJobs->nRunning; ++i)
+    {
+      if(pJobs->aJobs[i].status == FMK_JOB_RUNNING)
+      {
+        aFds[n].fd      = pJobs->aJobs[i].fd;
+        aFds[n].events  = POLLIN;
+        aFds[n].revents = 0;
+        aIndex[n]       = i;
+        ++n;
+      }
+    }
+
+    // jobserver is last, so it's not mistaken for a job
+    if(fToken && FlyMakeJobServerFd() >= 0 && pJobs->nRunning < pJobs->maxRunning)
+    {
+      aFds[n].fd      = FlyMakeJobServerFd();
+      aFds[n].events  = POLLIN;
+      aFds[n].revents = 0;
+      aIndex[n]       = pJobs->nJobs;
+      ++n;
+    }
+
+    if(poll(aFds, n, -1) > 0)
+    {
+      for(i = 0; i < n; ++i)
+      {
+        if(aFds[i].revents == 0 || aIndex[i] >= pJobs->nJobs)
+          continue;
+        len = read(aFds[i].fd, szBuf, sizeof(szBuf) - 1);
+        if(len > 0)
+        {
+          szBuf[len] = '\0';
+          FlyStrSmartCat(&pJobs->aJobs[aIndex[i]].output, szBuf);
+        }
+        else if(len == 0 || errno != EINTR)
+          FmkJobDone(pJobs, &pJobs->aJobs[aIndex[i]]);
+      }
+    }
+  }
+
+  FlyFreeIf(aFds);
+  FlyFreeIf(aIndex);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Start a function in a child process, as if it were a command-line. The child is a copy of
+  flymake, so the function can use any flymake state. Its return value is the exit code.
+
+  @param    pfnJob    function to run in the child process
+  @param    pArg      argument to function
+  @param    fdOut     file descriptor for child's stdout and stderr
+  @param    fdClose   file descriptor to close in child (e.g. read side of pipe)
+  @return   process id, or -1 if couldn't start the process
+*///-----------------------------------------------------------------------------------------------
+static pid_t FmkJobsFork(pfnFlyMakeJob_t pfnJob, void *pArg, int fdOut, int fdClose)
+{
+  pid_t   pid;
+  int     exitCode;
+
+  // don't let the child inherit unflushed output
+  fflush(stdout);
+  pid = fork();
+  if(pid == 0)
+  {
+    close(fdClose);
+    dup2(fdOut, STDOUT_FILENO);
+    dup2(fdOut, STDERR_FILENO);
+    close(fdOut);
+    exitCode = (*pfnJob)(pArg);
+    fflush(stdout);
+    _exit(exitCode);
+  }
+
+  return pid;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add a command-line or function job to the pool. See FlyMakeJobsAdd() and FlyMakeJobsAddFn().
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkJobsAdd(fmkJobs_t *pJobs, const char *szName, const char *szCmdline,
+                         pfnFlyMakeJob_t pfnJob, void *pArg, unsigned tag)
+{
+  fmkJob_t   *pJob      = NULL;
+  fmkJob_t   *aJobsNew;
+  int         fds[2];
+  bool_t      fWorked   = TRUE;
+
+  // make room for the new job
+  if(pJobs->nJobs >= pJobs->nMaxJobs)
+  {
+    aJobsNew = FlyRealloc(pJobs->aJobs, sizeof(fmkJob_t) * pJobs->nMaxJobs * 2);
+    if(!aJobsNew)
+      fWorked = FALSE;
+    else
+    {
+      memset(&aJobsNew[pJobs->nMaxJobs], 0, sizeof(fmkJob_t) * pJobs->nMaxJobs);
+      pJobs->aJobs    = aJobsNew;
+      pJobs->nMaxJobs = pJobs->nMaxJobs * 2;
+    }
+  }
+
+  if(fWorked)
+  {
+    pJob = &pJobs->aJobs[pJobs->nJobs];
+    memset(pJob, 0, sizeof(*pJob));
+    pJob->fd        = -1;
+    pJob->tag       = tag;
+    pJob->fFn       = pfnJob ? TRUE : FALSE;
+    pJob->szName    = FlyStrClone(szName);
+    pJob->szCmdline = FlyStrClone(szCmdline);
+    FlyStrSmartInit(&pJob->output);
+    if(!pJob->szName || !pJob->szCmdline)
+    {
+      FlyStrFreeIf(pJob->szName);
+      FlyStrFreeIf(pJob->szCmdline);
+      fWorked = FALSE;
+    }
+    else
+      ++pJobs->nJobs;
+  }
+
+  // dry run, just show what would be done, functions are run in place to print their commands
+  if(fWorked && pJobs->pOpts->fNoBuild)
+  {
+    if(pfnJob)
+    {
+      pJob->exitCode = (*pfnJob)(pArg);
+      pJob->status = (pJob->exitCode == 0 || pJob->exitCode >= FMK_JOB_CHANGED) ? FMK_JOB_OK : FMK_JOB_FAILED;
+    }
+    else
+    {
+      FlyMakePrintfEx(FMK_VERBOSE_SOME, "%s\n", szCmdline);
+      pJob->status = FMK_JOB_OK;
+    }
+    if(pJob->status == FMK_JOB_FAILED)
+      ++pJobs->nFailed;
+  }
+
+  else if(fWorked)
+  {
+    // wait for a free slot
+    while(!FmkJobsSlot(pJobs))
+      FmkJobsPoll(pJobs, TRUE);
+
+    // child's stdout/stderr go to the pipe, see FmkJobsPoll()
+    if(pipe(fds) != 0)
+      fWorked = FALSE;
+    else
+    {
+      // later jobs must not inherit this job's pipe
+      fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+      // compiles and dependency builds share flymake's jobserver, nothing else sees it
+      FlyMakeJobServerExport(TRUE);
+      if(pfnJob)
+        pJob->pid = FmkJobsFork(pfnJob, pArg, fds[1], fds[0]);
+      else
+        pJob->pid = FlyMakeProcSpawn(szCmdline, fds[1], fds[0]);
+      FlyMakeJobServerExport(FALSE);
+      close(fds[1]);
+      if(pJob->pid < 0)
+      {
+        close(fds[0]);
+        fWorked = FALSE;
+      }
+      else
+      {
+        pJob->fd     = fds[0];
+        pJob->status = FMK_JOB_RUNNING;
+        ++pJobs->nRunning;
+      }
+    }
+
+    if(!fWorked)
+    {
+      pJob->status   = FMK_JOB_FAILED;
+      pJob->exitCode = -1;
+      ++pJobs->nFailed;
+      FlyMakePrintf("%s\n# could not start job\n", szCmdline);
+    }
+  }
+
+  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "FmkJobsAdd(%s), nRunning %u, fWorked %u\n", szName,
+                   pJobs->nRunning, fWorked);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add a job to the pool. If the pool is full, waits for a running job to finish first.
+
+  The job's command-line and output are printed when it finishes. With -n (fNoBuild), the
+  command-line is printed and the job is considered successful without running anything.
+
+  @param    hJobs       handle from FlyMakeJobsNew()
+  @param    szName      name of job for reporting, e.g. "src/foo.c"
+  @param    szCmdline   command-line to run, see FlyMakeProcSpawn()
+  @param    tag         caller defined value, see FlyMakeJobsGetTag()
+  @return   TRUE if job was started, FALSE if out of memory or couldn't start it
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeJobsAdd(void *hJobs, const char *szName, const char *szCmdline, unsigned tag)
+{
+  FlyAssert(FlyMakeJobsIs(hJobs));
+  return FmkJobsAdd(hJobs, szName, szCmdline, NULL, NULL, tag);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add a function job to the pool, e.g. building a dependency. The function runs in a child process
+  and its return value is the exit code, 0 for success. If the pool is full, waits for a running
+  job to finish first.
+
+  The function's output is printed when it finishes. With -n (fNoBuild), the function is called
+  in place, so it can print what it would do.
+
+  @param    hJobs       handle from FlyMakeJobsNew()
+  @param    szName      name of job for reporting, e.g. "foo"
+  @param    szCmdline   command-line the function runs, see FlyMakeJobsGetCmdline(), or NULL for szName
+  @param    pfnJob      function to run, returns 0 if worked
+  @param    pArg        argument to function
+  @param    tag         caller defined value, see FlyMakeJobsGetTag()
+  @return   TRUE if job was started, FALSE if out of memory or couldn't start it
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeJobsAddFn(void *hJobs, const char *szName, const char *szCmdline, pfnFlyMakeJob_t pfnJob,
+                        void *pArg, unsigned tag)
+{
+  FlyAssert(FlyMakeJobsIs(hJobs));
+  return FmkJobsAdd(hJobs, szName, szCmdline ? szCmdline : szName, pfnJob, pArg, tag);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Wait for at least one running job to finish. Returns right away if no jobs are running.
+
+  @param    hJobs     handle from FlyMakeJobsNew()
+  @return   # of jobs still running
+*///-----------------------------------------------------------------------------------------------
+unsigned FlyMakeJobsWaitAny(void *hJobs)
+{
+  fmkJobs_t  *pJobs = hJobs;
+  unsigned    nRunning;
+
+  FlyAssert(FlyMakeJobsIs(hJobs));
+  nRunning = pJobs->nRunning;
+  while(pJobs->nRunning && pJobs->nRunning == nRunning)
+    FmkJobsPoll(pJobs, FALSE);
+
+  return pJobs->nRunning;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Wait for all jobs in the pool to complete.
+
+  @param    hJobs     handle from FlyMakeJobsNew()
+  @return   # of jobs that failed (0 if all worked)
+*///-----------------------------------------------------------------------------------------------
+unsigned FlyMakeJobsWait(void *hJobs)
+{
+  fmkJobs_t  *pJobs = hJobs;
+
+  FlyAssert(FlyMakeJobsIs(hJobs));
+  while(pJobs->nRunning)
+    FmkJobsPoll(pJobs, FALSE);
+
+  return pJobs->nFailed;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Return # of jobs added to the pool
+
+  @param    hJobs     handle from FlyMakeJobsNew()
+  @return   # of jobs
+*///-----------------------------------------------------------------------------------------------
+unsigned FlyMakeJobsLen(void *hJobs)
+{
+  fmkJobs_t  *pJobs = hJobs;
+  return FlyMakeJobsIs(hJobs) ? pJobs->nJobs : 0;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Get name of job i, e.g. "src/foo.c"
+
+  @param    hJobs     handle from FlyMakeJobsNew()
+  @param    i         index of job 0-(n-1)
+  @return   name of job or NULL if bad index
+*///-----------------------------------------------------------------------------------------------
+const char * FlyMakeJobsGetName(void *hJobs, unsigned i)
+{
+  fmkJobs_t  *pJobs = hJobs;
+  return (FlyMakeJobsIs(hJobs) && i < pJobs->nJobs) ? pJobs->aJobs[i].szName : NULL;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Get command-line of job i, e.g. "cc src/foo.c -c -I. -Iinc/ -o src/out/foo.o"
+
+  @param    hJobs     handle from FlyMakeJobsNew()
+  @param    i         index of job 0-(n-1)
+  @return   command-line of job or NULL if bad index
+*///-----------------------------------------------------------------------------------------------
+const char * FlyMakeJobsGetCmdline(void *hJobs, unsigned i)
+{
+  fmkJobs_t  *pJobs = hJobs;
+  return (FlyMakeJobsIs(hJobs) && i < pJobs->nJobs) ? pJobs->aJobs[i].szCmdline : NULL;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Get the caller's tag of job i, as given to FlyMakeJobsAdd()
+
+  @param    hJobs     handle from FlyMakeJobsNew()
+  @param    i         index of job 0-(n-1)
+  @return   tag
+*///-----------------------------------------------------------------------------------------------
+unsigned FlyMakeJobsGetTag(void *hJobs, unsigned i)
+{
+  fmkJobs_t  *pJobs = hJobs;
+  return (FlyMakeJobsIs(hJobs) && i < pJobs->nJobs) ? pJobs->aJobs[i].tag : 0;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Get the status of job i
+
+  @param    hJobs     handle from FlyMakeJobsNew()
+  @param    i         index of job 0-(n-1)
+  @return   0 if worked, -1 if failed, 1 if still running
+*///-----------------------------------------------------------------------------------------------
+int FlyMakeJobsStatus(void *hJobs, unsigned i)
+{
+  fmkJobs_t  *pJobs = hJobs;
+  return (FlyMakeJobsIs(hJobs) && i < pJobs->nJobs) ? (int)pJobs->aJobs[i].status : FMK_JOB_FAILED;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Get the exit code of job i, once done. A function job (see FlyMakeJobsAddFn()) may return
+  FMK_JOB_CHANGED or more to report it worked and did something, e.g. compiled files.
+
+  @param    hJobs     handle from FlyMakeJobsNew()
+  @param    i         index of job 0-(n-1)
+  @return   exit code 0-255, or -1 if still running, couldn't start or killed by a signal
+*///-----------------------------------------------------------------------------------------------
+int FlyMakeJobsExitCode(void *hJobs, unsigned i)
+{
+  fmkJobs_t  *pJobs = hJobs;
+  return (FlyMakeJobsIs(hJobs) && i < pJobs->nJobs && pJobs->aJobs[i].status != FMK_JOB_RUNNING) ?
+         pJobs->aJobs[i].exitCode : -1;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Free the job pool. Waits for any running jobs first.
+
+  @param    hJobs     handle from FlyMakeJobsNew()
+  @return   NULL
+*///-----------------------------------------------------------------------------------------------
+void * FlyMakeJobsFree(void *hJobs)
+{
+  fmkJobs_t  *pJobs = hJobs;
+  unsigned    i;
+
+  if(FlyMakeJobsIs(hJobs))
+  {
+    FlyMakeJobsWait(hJobs);
+    for(i = 0; i < pJobs->nJobs; ++i)
+    {
+      FlyStrFreeIf(pJobs->aJobs[i].szName);
+      FlyStrFreeIf(pJobs->aJobs[i].szCmdline);
+      FlyStrSmartUnInit(&pJobs->aJobs[i].output);
+    }
+    FlyFree(pJobs->aJobs);
+    memset(pJobs, 0, sizeof(*pJobs));
+    FlyFree(pJobs);
+  }
+
+  return NULL;
+}
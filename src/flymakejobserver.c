@@ -0,0 +1,346 @@
+/**************************************************************************************************
+  flymakejobserver.c - shares job slots with GNU make and nested builds (the make jobserver)
+  Copyright 2024 Drew Gislason
+  license: <https://mit-license.org>
+
+  The jobserver is a pipe (or named fifo) holding one byte, a token, per job slot beyond the first.
+  Every process in the build owns one implicit slot. To run another child process at the same time,
+  a process reads a token from the jobserver, and writes the same token back when the child ends.
+
+  If flymake is run by make with a jobserver in MAKEFLAGS, it is a client. Otherwise, with -j=N,
+  flymake creates the jobserver itself, so compilers, nested flymake and make it runs share the N
+  slots. See <https://www.gnu.org/software/make/manual/html_node/Job-Slots.html>.
+
+  A jobserver flymake creates is only given to the compiles and dependency builds started by the
+  job pool, see FlyMakeJobServerExport(). Programs run by `flymake run` or `flymake test` don't see
+  it in MAKEFLAGS and don't inherit its pipe.
+
+  Flymake must never block reading a token. On Linux, /proc/self/fd/N gives flymake a non-blocking
+  read side of its own. Elsewhere, the shared read side is made non-blocking just for each read, see
+  FlyMakeJobServerAcquire().
+**************************************************************************************************/
+#include "flymake.h"
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#define JOBSERVER_MAX_TOKENS  256   // most tokens held at once
+
+static const char m_szMakeFlags[]   = "MAKEFLAGS";
+static const char m_szAuth[]        = "--jobserver-auth=";
+static const char m_szFds[]         = "--jobserver-fds=";   // before GNU make 4.2
+static const char m_szFifo[]        = "fifo:";              // GNU make 4.4 and later
+
+static int      m_fdRead      = -1;   // read side for flymake's own use
+static int      m_fdWrite     = -1;
+static bool_t   m_fBlocking   = FALSE;  // m_fdRead is shared and blocking, see FmkJobServerOpenRead()
+static int      m_fdServer    = -1;     // read side of the pipe flymake created, given to children
+static char    *m_szServer    = NULL;   // MAKEFLAGS for children, if flymake created the jobserver
+static char    *m_szPrevFlags = NULL;   // MAKEFLAGS before, if any
+static unsigned m_nTokens     = 0;
+static char     m_aTokens[JOBSERVER_MAX_TOKENS];
+
+/*-------------------------------------------------------------------------------------------------
+  Is this file descriptor open?
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkJobServerFdIsOpen(int fd)
+{
+  return (fd >= 0 && fcntl(fd, F_GETFD) >= 0) ? TRUE : FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Open a private non-blocking read side of a jobserver pipe. The pipe is shared with make and other
+  processes, so setting O_NONBLOCK on it directly would change it for them too. On Linux, opening
+  /proc/self/fd/N gives a separate open file for the same pipe.
+
+  Without /proc, the fd is a dup() sharing the blocking open file, and m_fBlocking is set.
+
+  @param    fd      read side of jobserver pipe
+  @return   non-blocking fd, or a dup of fd if that's not possible, or -1 if failed
+*///-----------------------------------------------------------------------------------------------
+static int FmkJobServerOpenRead(int fd)
+{
+  char    szPath[32];
+  int     fdRead;
+
+  snprintf(szPath, sizeof(szPath), "/proc/self/fd/%d", fd);
+  fdRead = open(szPath, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  m_fBlocking = FALSE;
+  if(fdRead < 0)
+  {
+    fdRead = dup(fd);
+    if(fdRead >= 0)
+    {
+      fcntl(fdRead, F_SETFD, FD_CLOEXEC);
+      m_fBlocking = TRUE;
+    }
+  }
+
+  return fdRead;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Look for a jobserver in MAKEFLAGS, e.g. " -j8 --jobserver-auth=3,4" or "--jobserver-auth=fifo:/tmp/x"
+
+  @param    szMakeFlags   value of MAKEFLAGS
+  @return   TRUE if a usable jobserver was found
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkJobServerClient(const char *szMakeFlags)
+{
+  const char   *szAuth  = NULL;
+  const char   *psz;
+  char         *szFifo  = NULL;
+  unsigned      len;
+  int           fdRead  = -1;
+  int           fdWrite = -1;
+  bool_t        fFound  = FALSE;
+
+  // the last one wins, as make appends to MAKEFLAGS from outer makes
+  psz = szMakeFlags;
+  while((psz = strstr(psz, "--jobserver-")) != NULL)
+  {
+    if(strncmp(psz, m_szAuth, sizeof(m_szAuth) - 1) == 0)
+      szAuth = psz + sizeof(m_szAuth) - 1;
+    else if(strncmp(psz, m_szFds, sizeof(m_szFds) - 1) == 0)
+      szAuth = psz + sizeof(m_szFds) - 1;
+    ++psz;
+  }
+
+  if(szAuth && strncmp(szAuth, m_szFifo, sizeof(m_szFifo) - 1) == 0)
+  {
+    szAuth += sizeof(m_szFifo) - 1;
+    len = 0;
+    while(szAuth[len] && !isspace((unsigned char)szAuth[len]))
+      ++len;
+    szFifo = FlyAlloc(len + 1);
+    if(szFifo)
+    {
+      memcpy(szFifo, szAuth, len);
+      szFifo[len] = '\0';
+      m_fdRead  = open(szFifo, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+      m_fdWrite = open(szFifo, O_WRONLY | O_CLOEXEC);
+      FlyFree(szFifo);
+    }
+  }
+  else if(szAuth && sscanf(szAuth, "%d,%d", &fdRead, &fdWrite) == 2)
+  {
+    // make only passes the pipe to recursive makes, so it may not really be open
+    if(FmkJobServerFdIsOpen(fdRead) && FmkJobServerFdIsOpen(fdWrite))
+    {
+      m_fdRead  = FmkJobServerOpenRead(fdRead);
+      m_fdWrite = fdWrite;
+    }
+  }
+
+  if(m_fdRead >= 0 && m_fdWrite >= 0)
+    fFound = TRUE;
+  else
+  {
+    if(m_fdRead >= 0)
+      close(m_fdRead);
+    m_fdRead  = -1;
+    m_fdWrite = -1;
+  }
+
+  FlyMakeDbgPrintf(FMK_DEBUG_SOME, "FmkJobServerClient(%s), fFound %u\n", FlyStrNullOk(szAuth), fFound);
+
+  return fFound;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Create a jobserver with jobs - 1 tokens. The MAKEFLAGS for it is kept, rather than set, so only
+  the children given it by FlyMakeJobServerExport() see it. Until then, the pipe is close-on-exec.
+
+  @param    jobs      # of job slots, from -j=N
+  @return   TRUE if worked
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkJobServerServer(unsigned jobs)
+{
+  const char     *szMakeFlags;
+  flyStrSmart_t  *pFlags    = NULL;
+  char            token     = '+';
+  int             fds[2]    = { -1, -1 };
+  unsigned        i;
+  bool_t          fWorked   = TRUE;
+
+  if(pipe(fds) != 0)
+    fWorked = FALSE;
+  else
+  {
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    for(i = 1; fWorked && i < jobs; ++i)
+    {
+      if(write(fds[1], &token, 1) != 1)
+        fWorked = FALSE;
+    }
+  }
+
+  // e.g. MAKEFLAGS=" -j8 --jobserver-auth=3,4"
+  if(fWorked)
+  {
+    szMakeFlags = getenv(m_szMakeFlags);
+    pFlags = FlyStrSmartAlloc((szMakeFlags ? strlen(szMakeFlags) : 0) + 64);
+    if(pFlags)
+    {
+      FlyStrSmartSprintf(pFlags, "%s -j%u %s%d,%d", szMakeFlags ? szMakeFlags : "", jobs, m_szAuth,
+                         fds[0], fds[1]);
+      m_szServer = FlyStrClone(pFlags->sz);
+    }
+    if(szMakeFlags)
+      m_szPrevFlags = FlyStrClone(szMakeFlags);
+    if(!m_szServer || (szMakeFlags && !m_szPrevFlags))
+      fWorked = FALSE;
+    FlyStrSmartFree(pFlags);
+  }
+
+  if(fWorked)
+  {
+    m_fdServer = fds[0];
+    m_fdRead   = FmkJobServerOpenRead(fds[0]);
+    m_fdWrite  = fds[1];
+  }
+  else
+  {
+    FlyFreeIf(m_szServer);
+    FlyFreeIf(m_szPrevFlags);
+    m_szServer = m_szPrevFlags = NULL;
+    if(fds[0] >= 0)
+    {
+      close(fds[0]);
+      close(fds[1]);
+    }
+  }
+
+  FlyMakeDbgPrintf(FMK_DEBUG_SOME, "FmkJobServerServer(jobs %u), fWorked %u\n", jobs, fWorked);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Join the jobserver in MAKEFLAGS, or if there isn't one and -j=N, create one for child processes.
+
+  When run by make with a jobserver and no -j option, -j is set to the # of CPUs, so flymake
+  compiles in parallel as much as the jobserver allows.
+
+  @param    pOpts     options, for -j
+  @return   TRUE if a jobserver is in use
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeJobServerInit(flyMakeOpts_t *pOpts)
+{
+  const char   *szMakeFlags;
+  bool_t        fActive = FALSE;
+
+  szMakeFlags = getenv(m_szMakeFlags);
+  if(szMakeFlags && FmkJobServerClient(szMakeFlags))
+  {
+    fActive = TRUE;
+    if(pOpts->jobs == 0)
+      pOpts->jobs = (int)FlyMakeJobsCpus();
+  }
+  else if(pOpts->jobs > 1)
+    fActive = FmkJobServerServer((unsigned)pOpts->jobs);
+
+  return fActive;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Give the jobserver flymake created to the next child process started, or stop giving it. Call
+  with TRUE just before starting a compile or dependency build, and with FALSE right after, e.g.
+
+      FlyMakeJobServerExport(TRUE);
+      pid = FlyMakeProcSpawn(szCmdline, fdOut, fdClose);
+      FlyMakeJobServerExport(FALSE);
+
+  Sets MAKEFLAGS and lets the pipe be inherited, then puts both back. Does nothing if flymake is a
+  client of make's jobserver (make already decided who sees it), or if there is no jobserver.
+
+  @param    fExport   TRUE to give the jobserver to children, FALSE to stop
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeJobServerExport(bool_t fExport)
+{
+  if(m_szServer)
+  {
+    if(fExport)
+      setenv(m_szMakeFlags, m_szServer, 1);
+    else if(m_szPrevFlags)
+      setenv(m_szMakeFlags, m_szPrevFlags, 1);
+    else
+      unsetenv(m_szMakeFlags);
+    fcntl(m_fdServer, F_SETFD, fExport ? 0 : FD_CLOEXEC);
+    fcntl(m_fdWrite,  F_SETFD, fExport ? 0 : FD_CLOEXEC);
+  }
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Return the read side of the jobserver, which can be polled for a token, or -1 if no jobserver
+
+  @return   file descriptor or -1
+*///-----------------------------------------------------------------------------------------------
+int FlyMakeJobServerFd(void)
+{
+  return m_fdRead;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Try to take a token from the jobserver, without waiting. Poll FlyMakeJobServerFd() to wait.
+
+  If the read side is shared and blocking (no /proc), another process may take the token between
+  poll() and read(), so O_NONBLOCK is set on it just for the read, and put back right after. A
+  GNU make reading at that moment gets EAGAIN, which it handles by waiting again.
+
+  @return   TRUE if got a token (or no jobserver), FALSE if no token is available right now
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeJobServerAcquire(void)
+{
+  struct pollfd   pfd;
+  char            token;
+  int             flags = 0;
+  bool_t          fGot  = TRUE;
+
+  if(m_fdRead >= 0)
+  {
+    fGot = FALSE;
+    if(m_nTokens < JOBSERVER_MAX_TOKENS)
+    {
+      pfd.fd      = m_fdRead;
+      pfd.events  = POLLIN;
+      pfd.revents = 0;
+      if(poll(&pfd, 1, 0) > 0)
+      {
+        if(m_fBlocking)
+        {
+          flags = fcntl(m_fdRead, F_GETFL);
+          if(flags >= 0)
+            fcntl(m_fdRead, F_SETFL, flags | O_NONBLOCK);
+        }
+        if(read(m_fdRead, &token, 1) == 1)
+        {
+          m_aTokens[m_nTokens++] = token;
+          fGot = TRUE;
+        }
+        if(m_fBlocking && flags >= 0)
+          fcntl(m_fdRead, F_SETFL, flags);
+      }
+    }
+  }
+
+  return fGot;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Give a token back to the jobserver. Each token from FlyMakeJobServerAcquire() must be released.
+
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeJobServerRelease(void)
+{
+  if(m_fdWrite >= 0 && m_nTokens)
+  {
+    --m_nTokens;
+    while(write(m_fdWrite, &m_aTokens[m_nTokens], 1) < 0 && errno == EINTR)
+      ;
+  }
+}
@@ -2,20 +2,79 @@
   flymakelist.c - lists of source files
   Copyright 2024 Drew Gislason
   license: <https://mit-license.org>
+
+  A single command may need the same folder's files many times: `flymake test` builds the tools in
+  test/, then finds them again to run them. Each state keeps the lists it has made, so each folder
+  is scanned only once per invocation. See FlyMakeScanSrcList() and FlyMakeScanToolList().
+
+  On Linux, folders are walked with getdents64(), see FmkSrcWalk(). Each entry's type comes with its
+  name, so source files are found without a stat() per file, and names are kept in one block.
 **************************************************************************************************/
 #include "flymake.h"
 #include "FlySort.h"
+#ifdef __linux__
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <dirent.h>
+ #include <sys/stat.h>
+ #include <sys/syscall.h>
+#endif
 
 #define SRCLIST_SANCHK 9979
 
 typedef struct
 {
-  void         *hList;    // list of source files
-  bool_t       *pfUsed;   // for marking off when making tool lists
+  void         *hList;    // list of source files from FlyFileListNewExts(), or NULL if walked
+  char         *pArena;   // names of source files if walked, e.g. "src/a.c\0src/b.c\0"
+  const char  **aszNames; // sorted source file names
   unsigned      sanchk;
   unsigned      len;
 } fmkSrcList_t;
 
+#ifdef __linux__
+#define WALK_MAX_EXTS   32      // more source extensions than this uses FlyFileListNewExts()
+#define WALK_SZ_BUF     8192    // getdents64() buffer, one per folder level
+
+// as returned by getdents64()
+typedef struct
+{
+  uint64_t        d_ino;
+  int64_t         d_off;
+  unsigned short  d_reclen;
+  unsigned char   d_type;
+  char            d_name[];
+} fmkDirent64_t;
+
+// state of a folder walk, see FmkSrcWalk()
+typedef struct
+{
+  const char     *apExts[WALK_MAX_EXTS];  // each extension, e.g. ".c" in ".c.cpp"
+  unsigned        aExtLen[WALK_MAX_EXTS];
+  unsigned        nExts;
+  char           *pArena;                 // names, each '\0' terminated
+  size_t          arenaLen;
+  size_t          arenaMax;
+  size_t         *aOffsets;               // offset of each name in pArena
+  unsigned        nNames;
+  unsigned        maxNames;
+  const char     *szDepDir;               // dependency folder to skip, e.g. "deps/", or NULL
+  size_t          folderLen;              // length of the folder listed, e.g. 4 for "src/"
+  char            szPath[PATH_MAX];       // folder being walked, e.g. "src/sub/"
+} fmkWalk_t;
+#endif
+
+// a scanned folder, see FlyMakeScanSrcList()
+typedef struct
+{
+  void           *pNext;
+  char           *szFolder;   // e.g. "src/"
+  unsigned        depth;      // subfolders deep
+  void           *hSrcList;   // source files in folder
+  fmkToolList_t  *pToolList;  // tools from hSrcList, made on first use, owns hSrcList
+} fmkScan_t;
+
+FMK_STATIC fmkToolList_t * FmkToolListAlloc(void *hSrcList);
+
 /*-------------------------------------------------------------------------------------------------
   Is this a src list?
 
@@ -28,6 +87,342 @@ bool_t FlyMakeSrcListIs(void *pSrcList_)
   return (pSrcList && pSrcList->sanchk == SRCLIST_SANCHK) ? TRUE : FALSE;
 }
 
+/*-------------------------------------------------------------------------------------------------
+  Sort compare for source file names
+*///-----------------------------------------------------------------------------------------------
+static int FmkSrcCmp(const void *p1, const void *p2)
+{
+  return strcmp(*(const char * const *)p1, *(const char * const *)p2);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Is this path left out of a source list? Skipped are the out/ folder directly in the folder listed,
+  the dependency folder, and hidden files and folders (starting with '.'). Used both when walking
+  folders and to filter FlyFileListNewExts(), so every platform lists the same files.
+
+  @param    szPath      file or folder, e.g. "src/sub/foo.c" or "src/out/"
+  @param    folderLen   length of the folder listed in szPath, e.g. 4 for "src/"
+  @param    szDepDir    dependency folder, e.g. "deps/", or NULL
+  @return   TRUE to skip
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkSrcIsSkipped(const char *szPath, size_t folderLen, const char *szDepDir)
+{
+  const char  *psz;
+  size_t       len;
+
+  psz = &szPath[folderLen];
+  len = strlen(FMK_SZ_OUT);
+  if(strncmp(psz, FMK_SZ_OUT, len - 1) == 0 && (psz[len - 1] == '\0' || isslash(psz[len - 1])))
+    return TRUE;
+
+  if(szDepDir && *szDepDir && strncmp(szPath, szDepDir, strlen(szDepDir)) == 0)
+    return TRUE;
+
+  while(*psz)
+  {
+    if(*psz == '.')
+      return TRUE;
+    psz += strcspn(psz, "/\\");
+    if(*psz)
+      ++psz;
+  }
+
+  return FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Length of a folder as a prefix of the names in its source list, e.g. 4 for "src" or "src/"
+
+  @param    szFolder    e.g. "", "src/", "../lib"
+  @return   length with slash
+*///-----------------------------------------------------------------------------------------------
+static size_t FmkSrcFolderLen(const char *szFolder)
+{
+  size_t  len = strlen(szFolder);
+
+  if(len && !isslash(szFolder[len - 1]))
+    ++len;
+  return len;
+}
+
+#ifdef __linux__
+/*-------------------------------------------------------------------------------------------------
+  Is this file name a source file? Compares the last extension, e.g. ".c" of "foo.test.c".
+
+  @param    pWalk     walk state with extensions
+  @param    szName    file name, e.g. "foo.c"
+  @return   TRUE if a source file
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkWalkIsSrc(const fmkWalk_t *pWalk, const char *szName)
+{
+  const char  *szExt;
+  size_t       len;
+  unsigned     i;
+
+  szExt = strrchr(szName, '.');
+  if(szExt && szExt != szName)
+  {
+    len = strlen(szExt);
+    for(i = 0; i < pWalk->nExts; ++i)
+    {
+      if(pWalk->aExtLen[i] == len && memcmp(pWalk->apExts[i], szExt, len) == 0)
+        return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Add a source file name, prefixed by the folder being walked, to the walk's arena
+
+  @param    pWalk     walk state, szPath holds folder, e.g. "src/sub/"
+  @param    pathLen   length of folder in szPath
+  @param    szName    file name, e.g. "foo.c"
+  @return   TRUE if worked, FALSE if out of memory
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkWalkAdd(fmkWalk_t *pWalk, size_t pathLen, const char *szName)
+{
+  size_t    size;
+  size_t    nameLen = strlen(szName);
+  void     *pNew;
+
+  // grow arena and offsets as needed, doubling each time
+  size = pathLen + nameLen + 1;
+  if(pWalk->arenaLen + size > pWalk->arenaMax)
+  {
+    pWalk->arenaMax = (pWalk->arenaMax + size) * 2;
+    pNew = FlyRealloc(pWalk->pArena, pWalk->arenaMax);
+    if(!pNew)
+      return FALSE;
+    pWalk->pArena = pNew;
+  }
+  if(pWalk->nNames >= pWalk->maxNames)
+  {
+    pWalk->maxNames = pWalk->maxNames ? pWalk->maxNames * 2 : 64;
+    pNew = FlyRealloc(pWalk->aOffsets, sizeof(size_t) * pWalk->maxNames);
+    if(!pNew)
+      return FALSE;
+    pWalk->aOffsets = pNew;
+  }
+
+  // e.g. "src/sub/foo.c"
+  pWalk->aOffsets[pWalk->nNames++] = pWalk->arenaLen;
+  memcpy(&pWalk->pArena[pWalk->arenaLen], pWalk->szPath, pathLen);
+  memcpy(&pWalk->pArena[pWalk->arenaLen + pathLen], szName, nameLen + 1);
+  pWalk->arenaLen += size;
+
+  return TRUE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Walk an open folder, adding source files, then subfolders up to depth deep. Skips folders and
+  files as FmkSrcIsSkipped() does.
+
+  @param    pWalk     walk state, szPath holds this folder, e.g. "src/sub/"
+  @param    fd        open folder, closed when done
+  @param    pathLen   length of folder in szPath
+  @param    depth     0-n, how many subfolders deep
+  @return   TRUE if worked, FALSE if out of memory or a read failed
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkWalkFolder(fmkWalk_t *pWalk, int fd, size_t pathLen, unsigned depth)
+{
+  char            aBuf[WALK_SZ_BUF];
+  fmkDirent64_t  *pEnt;
+  struct stat     st;
+  long            n;
+  long            off;
+  size_t          nameLen;
+  unsigned char   type;
+  int             fdSub;
+  bool_t          fWorked = TRUE;
+
+  while(fWorked)
+  {
+    n = syscall(SYS_getdents64, fd, aBuf, sizeof(aBuf));
+    if(n <= 0)
+    {
+      if(n < 0)
+        fWorked = FALSE;
+      break;
+    }
+
+    for(off = 0; fWorked && off < n; off += pEnt->d_reclen)
+    {
+      pEnt = (fmkDirent64_t *)(aBuf + off);
+      if(pEnt->d_name[0] == '.')
+        continue;
+
+      // only symbolic links and some filesystems need a stat()
+      type = pEnt->d_type;
+      if(type == DT_UNKNOWN || type == DT_LNK)
+      {
+        type = DT_UNKNOWN;
+        if(fstatat(fd, pEnt->d_name, &st, 0) == 0)
+        {
+          if(S_ISREG(st.st_mode))
+            type = DT_REG;
+          else if(S_ISDIR(st.st_mode))
+            type = DT_DIR;
+        }
+      }
+
+      if(type == DT_REG && FmkWalkIsSrc(pWalk, pEnt->d_name))
+        fWorked = FmkWalkAdd(pWalk, pathLen, pEnt->d_name);
+
+      // e.g. "src/sub/"
+      else if(type == DT_DIR && depth)
+      {
+        nameLen = strlen(pEnt->d_name);
+        if(pathLen + nameLen + 2 > sizeof(pWalk->szPath))
+          continue;
+        memcpy(&pWalk->szPath[pathLen], pEnt->d_name, nameLen);
+        pWalk->szPath[pathLen + nameLen] = '/';
+        pWalk->szPath[pathLen + nameLen + 1] = '\0';
+        if(FmkSrcIsSkipped(pWalk->szPath, pWalk->folderLen, pWalk->szDepDir))
+          continue;
+        fdSub = openat(fd, pEnt->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if(fdSub >= 0)
+          fWorked = FmkWalkFolder(pWalk, fdSub, pathLen + nameLen + 1, depth - 1);
+      }
+    }
+  }
+  close(fd);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Fill in source list by walking the folder tree with getdents64(). Names are stored in one arena.
+
+  @param    pSrcList    empty source list
+  @param    szFolder    folder to check for source files, e.g. "", "src/", "../lib/"
+  @param    szExtList   source file extensions, e.g. ".c.cpp.c++"
+  @param    depth       0-n, how many subfolders deep to add to source list
+  @param    szDepDir    dependency folder to skip, e.g. "deps/", or NULL
+  @param    pfWorked    return value, FALSE if bad path or out of memory
+  @return   TRUE if walked, FALSE if too many extensions and folder must be listed another way
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkSrcWalk(fmkSrcList_t *pSrcList, const char *szFolder, const char *szExtList, unsigned depth,
+                         const char *szDepDir, bool_t *pfWorked)
+{
+  fmkWalk_t    *pWalk;
+  const char   *psz;
+  size_t        pathLen;
+  unsigned      i;
+  int           fd;
+  bool_t        fWorked = FALSE;
+
+  pWalk = FlyAllocZ(sizeof(*pWalk));
+  if(!pWalk)
+  {
+    *pfWorked = FALSE;
+    return TRUE;
+  }
+
+  // split extensions, e.g. ".c.cpp" into ".c", ".cpp"
+  for(psz = szExtList; *psz == '.'; psz += pWalk->aExtLen[pWalk->nExts++])
+  {
+    if(pWalk->nExts >= WALK_MAX_EXTS)
+    {
+      FlyFree(pWalk);
+      return FALSE;
+    }
+    pWalk->apExts[pWalk->nExts] = psz;
+    pWalk->aExtLen[pWalk->nExts] = 1 + strcspn(psz + 1, ".");
+  }
+
+  // e.g. "src/" or "" for current folder
+  pathLen = strlen(szFolder);
+  if(pathLen + 2 <= sizeof(pWalk->szPath))
+  {
+    memcpy(pWalk->szPath, szFolder, pathLen);
+    if(pathLen && !isslash(szFolder[pathLen - 1]))
+      pWalk->szPath[pathLen++] = '/';
+    pWalk->folderLen = pathLen;
+    pWalk->szDepDir  = szDepDir;
+    fd = open(*szFolder ? szFolder : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd >= 0)
+      fWorked = FmkWalkFolder(pWalk, fd, pathLen, depth);
+  }
+
+  // offsets become pointers now that the arena won't move
+  if(fWorked && pWalk->nNames)
+  {
+    pSrcList->aszNames = FlyAlloc(sizeof(char *) * pWalk->nNames);
+    if(!pSrcList->aszNames)
+      fWorked = FALSE;
+    else
+    {
+      for(i = 0; i < pWalk->nNames; ++i)
+        pSrcList->aszNames[i] = &pWalk->pArena[pWalk->aOffsets[i]];
+      pSrcList->len    = pWalk->nNames;
+      pSrcList->pArena = pWalk->pArena;
+      pWalk->pArena    = NULL;
+    }
+  }
+
+  FlyFreeIf(pWalk->pArena);
+  FlyFreeIf(pWalk->aOffsets);
+  FlyFree(pWalk);
+  *pfWorked = fWorked;
+
+  return TRUE;
+}
+#endif
+
+/*-------------------------------------------------------------------------------------------------
+  Fill in the source list with the source files in a folder tree, unsorted. Skips the same files
+  on every platform, see FmkSrcIsSkipped().
+
+  @param    pSrcList    empty source list
+  @param    szFolder    folder to check for source files, e.g. "", "src/", "../lib/"
+  @param    szExtList   source file extensions, e.g. ".c.cpp.c++"
+  @param    depth       0-n, how many subfolders deep to add to source list
+  @param    szDepDir    dependency folder to skip, e.g. "deps/", or NULL
+  @return   TRUE if worked, FALSE if bad path or out of memory
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkSrcListFill(fmkSrcList_t *pSrcList, const char *szFolder, const char *szExtList, unsigned depth,
+                             const char *szDepDir)
+{
+  const char   *szName;
+  size_t        folderLen;
+  unsigned      i;
+  bool_t        fWorked = FALSE;
+
+#ifdef __linux__
+  if(FmkSrcWalk(pSrcList, szFolder, szExtList, depth, szDepDir, &fWorked))
+    return fWorked;
+#endif
+
+  pSrcList->hList = FlyFileListNewExts(szFolder, szExtList, depth);
+  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "  hList %p, len %u\n", pSrcList->hList, FlyFileListLen(pSrcList->hList));
+  if(pSrcList->hList)
+  {
+    fWorked = TRUE;
+    pSrcList->len = FlyFileListLen(pSrcList->hList);
+    if(pSrcList->len)
+    {
+      pSrcList->aszNames = FlyAlloc(sizeof(char *) * pSrcList->len);
+      if(!pSrcList->aszNames)
+        fWorked = FALSE;
+      else
+      {
+        folderLen = FmkSrcFolderLen(szFolder);
+        pSrcList->len = 0;
+        for(i = 0; i < FlyFileListLen(pSrcList->hList); ++i)
+        {
+          szName = FlyFileListGetName(pSrcList->hList, i);
+          if(!FmkSrcIsSkipped(szName, folderLen, szDepDir))
+            pSrcList->aszNames[pSrcList->len++] = szName;
+        }
+      }
+    }
+  }
+
+  return fWorked;
+}
+
 /*-------------------------------------------------------------------------------------------------
   Create a new list of 0 or more source files based on a folder tree and file extensions.
 
@@ -41,7 +436,7 @@ bool_t FlyMakeSrcListIs(void *pSrcList_)
 
   Example use:
 
-      void *hList = FlyMakeSrcListNew(pCompilerList, "folder/");
+      void *hList = FlyMakeSrcListNew(pCompilerList, "folder/", 0, NULL);
       
       if(!hList)
         printf("bad path\n");
@@ -53,11 +448,12 @@ bool_t FlyMakeSrcListIs(void *pSrcList_)
   @param    pCompilerList   contains source file extensions, e.g. ".c" or ".cpp.c++"
   @param    szFolder        folder to check for source files, e.g. "", "src/", "../lib/"
   @param    depth           0-n, how many subfolders deep to add to source list
+  @param    szDepDir        dependency folder to skip, e.g. "deps/", or NULL
   @return   handle to source list or NULL if bad folder path
 *///-----------------------------------------------------------------------------------------------
-void * FlyMakeSrcListNew(flyMakeCompiler_t *pCompilerList, const char *szFolder, unsigned depth)
+void * FlyMakeSrcListNew(flyMakeCompiler_t *pCompilerList, const char *szFolder, unsigned depth,
+                         const char *szDepDir)
 {
-  void         *hList;
   char         *szExtList;
   fmkSrcList_t *pSrcList    = NULL;
   bool_t        fWorked     = TRUE;
@@ -70,43 +466,25 @@ void * FlyMakeSrcListNew(flyMakeCompiler_t *pCompilerList, const char *szFolder,
     fWorked = FALSE;
   FlyMakeDbgPrintf(FMK_DEBUG_MORE, "  szExtList %s\n", FlyStrNullOk(szExtList));
 
-  // look for only source files
-  if(fWorked)
-  {
-    hList = FlyFileListNewExts(szFolder, szExtList, depth);
-    FlyMakeDbgPrintf(FMK_DEBUG_MORE, "  hList %p, len %u\n", hList, FlyFileListLen(hList));
-    if(!hList)
-      fWorked = FALSE;
-    else
-      FlyFileListSort(hList, NULL);
-  }
-
-  // allocate srcList and source file array
+  // allocate srcList
   if(fWorked)
   {
     pSrcList = FlyAllocZ(sizeof(*pSrcList));
     if(!pSrcList)
       fWorked = FALSE;
     else
-    {
       pSrcList->sanchk  = SRCLIST_SANCHK;
-      pSrcList->hList   = hList;
-      pSrcList->len     = FlyFileListLen(hList);
-      pSrcList->pfUsed  = FlyAllocZ(sizeof(bool_t) * pSrcList->len);
-      if(!pSrcList->pfUsed)
-        fWorked = FALSE;
-    }
   }
 
+  // look for only source files
+  if(fWorked)
+    fWorked = FmkSrcListFill(pSrcList, szFolder, szExtList, depth, szDepDir);
+  if(fWorked && pSrcList->len)
+    FlySortQSort(pSrcList->aszNames, pSrcList->len, sizeof(char *), FmkSrcCmp);
 
   FlyFreeIf(szExtList);
-  if(!fWorked)
-  {
-    if(pSrcList)
-      FlyMakeSrcListFree(pSrcList);
-    else if(hList)
-      FlyFileListFree(hList);
-  }
+  if(!fWorked && pSrcList)
+    pSrcList = FlyMakeSrcListFree(pSrcList);
 
   FlyMakeDbgPrintf(FMK_DEBUG_SOME, "  fWorked %u\n", fWorked);
   if(FlyMakeDebug() >= FMK_DEBUG_MAX)
@@ -126,8 +504,8 @@ const char * FlyMakeSrcListGetName(void *hSrcList, unsigned i)
 {
   fmkSrcList_t   *pSrcList    = hSrcList;
   const char     *szFileName  = NULL;
-  if(FlyMakeSrcListIs(hSrcList))
-    szFileName = FlyFileListGetName(pSrcList->hList, i);
+  if(FlyMakeSrcListIs(hSrcList) && i < pSrcList->len)
+    szFileName = pSrcList->aszNames[i];
   return szFileName;
 }
 
@@ -143,7 +521,7 @@ unsigned FlyMakeSrcListLen(void *hSrcList)
   unsigned        len       = 0;
 
   if(FlyMakeSrcListIs(hSrcList))
-    len = FlyFileListLen(pSrcList->hList);
+    len = pSrcList->len;
 
   return len;
 }
@@ -162,9 +540,10 @@ void * FlyMakeSrcListFree(void *hSrcList)
   {
     if(pSrcList->hList)
       FlyFileListFree(pSrcList->hList);
-    if(pSrcList->pfUsed)
-      FlyFree(pSrcList->pfUsed);
+    FlyFreeIf(pSrcList->pArena);
+    FlyFreeIf(pSrcList->aszNames);
     memset(pSrcList, 0, sizeof(*pSrcList));
+    FlyFree(pSrcList);
   }
 
   return NULL;
@@ -188,89 +567,63 @@ void FlyMakeSrcListPrint(void *hSrcList)
   {
     FlyMakePrintf("%u file(s)\n", pSrcList->len);
     for(i = 0; i < pSrcList->len; ++i)
-      printf("  %u: Used %u %s\n", i, pSrcList->pfUsed[i], FlyMakeSrcListGetName(hSrcList, i));
+      printf("  %u: %s\n", i, FlyMakeSrcListGetName(hSrcList, i));
   }
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Given a source file, allocate a tool and add all files to that match.
+  Given the first source file of a tool, allocate the tool and add all files that match, that is,
+  all files that begin with the tool's path and name, e.g. "tools/my_tool.c", "tools/my_tool_x.c".
 
-  Marks of any matching source files as "used".
+  As the source list is sorted, the files that match are the ones that follow the first.
 
   @param    hSrcList    handle to source file list
   @param    index       index 1st source file in tool
+  @param    pNext       return value, index of 1st source file after this tool
   @return   ptr to allocated tool list for this file
 *///-----------------------------------------------------------------------------------------------
-fmkTool_t * FmkToolAlloc(void *hSrcList, unsigned index)
+static fmkTool_t * FmkToolAlloc(void *hSrcList, unsigned index, unsigned *pNext)
 {
   fmkSrcList_t   *pSrcList    = hSrcList;
-  fmkTool_t      *pTool;
+  fmkTool_t      *pTool       = NULL;
   char           *szToolname;   // e.g. "my_tool"
   const char     *szFilename;   // e.g. "../tools/my_tool.c"
   const char     *psz;
   unsigned        len;          // e.g. length of "../tools/my_tool"
   unsigned        i;
-  unsigned        n;
-  unsigned        nSrcFiles   = 0;
-  bool_t          fWorked     = TRUE;
+  unsigned        nSrcFiles;
 
-  // should never try to allocate tool based on file that's already used or out of bounds
+  // should never try to allocate tool based on file that's out of bounds
   FlyAssert(FlyMakeSrcListIs(hSrcList) && index < FlyMakeSrcListLen(hSrcList));
-  FlyAssert(!pSrcList->pfUsed[index]);
 
   // allocate toolname for index
   szFilename = FlyMakeSrcListGetName(hSrcList, index);  // e.g. "../tools/my_tool.c"
   psz = FlyStrPathNameBase(szFilename, &len);
   szToolname = FlyStrAllocN(psz, len);                  // e.g. "my_tool"
-  if(!szToolname)
-    fWorked = FALSE;
   len += (unsigned)(psz - szFilename);                  // e.g. length of "../tools/my_tool"
 
   // count # of files that match this tool
-  if(fWorked)
+  for(i = index + 1; i < pSrcList->len; ++i)
   {
-    nSrcFiles = 0;
-    for(i = 0; i < pSrcList->len; ++i)
-    {
-      if(!pSrcList->pfUsed[i] && (strncmp(szFilename, FlyMakeSrcListGetName(hSrcList, i), len) == 0))
-        ++nSrcFiles;
-    }
+    if(strncmp(szFilename, FlyMakeSrcListGetName(hSrcList, i), len) != 0)
+      break;
   }
+  nSrcFiles = i - index;
+  *pNext = i;
 
   // allocate the tool
-  if(fWorked)
-  {
+  if(szToolname)
     pTool = FlyAllocZ(sizeof(*pTool) + (sizeof(char *) * nSrcFiles));
-    if(!pTool)
-      fWorked = FALSE;
-    else
-    {
-      pTool->szName = szToolname;
-      pTool->aszSrcFiles = (void *)(pTool + 1);
-      pTool->nSrcFiles = nSrcFiles;
-
-      n = 0;
-      for(i = 0; i < pSrcList->len; ++i)
-      {
-        psz = FlyMakeSrcListGetName(hSrcList, i);
-        if(!pSrcList->pfUsed[i] && (strncmp(szFilename, psz, len) == 0))
-        {
-          pTool->aszSrcFiles[n] = psz;
-          pSrcList->pfUsed[i] = TRUE;
-          ++n;
-        }
-      }
-    }
-  }
-
-  if(!fWorked)
+  if(pTool)
   {
-    if(szToolname)
-      FlyFree(szToolname);
-    if(pTool)
-      FlyFree(pTool);
-    pTool = NULL;
+    pTool->szName = szToolname;
+    pTool->aszSrcFiles = (void *)(pTool + 1);
+    pTool->nSrcFiles = nSrcFiles;
+    for(i = 0; i < nSrcFiles; ++i)
+      pTool->aszSrcFiles[i] = FlyMakeSrcListGetName(hSrcList, index + i);
   }
+  else
+    FlyFreeIf(szToolname);
 
   return pTool;
 }
@@ -308,7 +661,26 @@ bool_t FlyMakeToolListIs(const fmkToolList_t *pToolList)
 *///-----------------------------------------------------------------------------------------------
 fmkToolList_t * FlyMakeToolListNew(flyMakeCompiler_t *pCompilerList, const char *szFolder)
 {
-  fmkSrcList_t     *pSrcList    = NULL;
+  void  *hSrcList;
+
+  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "FlyMakeToolListNew(%s)\n", szFolder);
+
+  // get a list of source files, all type (.c, .c++, etc...)
+  hSrcList = FlyMakeSrcListNew(pCompilerList, szFolder, 0, NULL);
+
+  return hSrcList ? FmkToolListAlloc(hSrcList) : NULL;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Group a list of source files into tools, see FlyMakeToolListNew(). The tool list owns the source
+  list, so FlyMakeToolListFree() frees both, even if this fails.
+
+  @param    hSrcList   source files from FlyMakeSrcListNew()
+  @return   ptr to tool list or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+FMK_STATIC fmkToolList_t * FmkToolListAlloc(void *hSrcList)
+{
+  fmkSrcList_t     *pSrcList    = hSrcList;
   fmkToolList_t    *pToolList   = NULL;
   fmkToolList_t    *pToolListNew;
   fmkTool_t        *pTool;
@@ -316,13 +688,6 @@ fmkToolList_t * FlyMakeToolListNew(flyMakeCompiler_t *pCompilerList, const char
   unsigned          size;
   bool_t            fWorked     = TRUE;
 
-  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "FlyMakeToolListNew(%s)\n", szFolder);
-
-  // get a list of source files, all type (.c, .c++, etc...)
-  pSrcList = FlyMakeSrcListNew(pCompilerList, szFolder, 0);
-  if(!pSrcList)
-    fWorked = FALSE;
-
   // allocate a tool list
   if(fWorked)
   {
@@ -338,61 +703,52 @@ fmkToolList_t * FlyMakeToolListNew(flyMakeCompiler_t *pCompilerList, const char
     }
   }
 
-  // add each tool until no unused files
-  if(fWorked && FlyMakeSrcListLen(pSrcList))
+  // add each tool in one pass, the files of a tool are together in the sorted list
+  i = 0;
+  while(fWorked && i < FlyMakeSrcListLen(pSrcList))
   {
-    // find 1st unused file
-    while(TRUE)
+    // if we need room for more tools, make it now (doubles nMaxTools)
+    if(pToolList->nTools >= pToolList->nMaxTools)
     {
-      for(i = 0; i < FlyMakeSrcListLen(pSrcList); ++i)
+      size = sizeof(*pToolList) + (sizeof(fmkTool_t *) * (pToolList->nMaxTools * 2));
+      FlyMakeDbgPrintf(FMK_DEBUG_MORE, "  realloc new size %u", size);
+      pToolListNew = FlyRealloc(pToolList, size);
+      if(!pToolListNew)
       {
-        if(!pSrcList->pfUsed[i])
-          break;
-      }
-      if(i == FlyMakeSrcListLen(pSrcList))
+        FlyMakeDbgPrintf(FMK_DEBUG_MORE, " (failed)\n");
+        fWorked = FALSE;
         break;
-
-      // found another tool
-      if(i < FlyMakeSrcListLen(pSrcList))
+      }
+      else
       {
-        // if we need room for more tools, make it now (doubles nMaxTools)
-        if(pToolList->nTools >= pToolList->nMaxTools)
-        {
-          size = sizeof(*pToolList) + (sizeof(fmkTool_t *) * (pToolList->nMaxTools * 2));
-          FlyMakeDbgPrintf(FMK_DEBUG_MORE, "  realloc new size %u", size);
-          pToolListNew = FlyRealloc(pToolList, size);
-          if(!pToolListNew)
-          {
-            FlyMakeDbgPrintf(FMK_DEBUG_MORE, " (failed)\n");
-            fWorked = FALSE;
-          }
-          else
-          {
-            pToolList = pToolListNew;
-            pToolList->apTools   = (void *)(pToolList + 1);
-            memset(&pToolList->apTools[pToolList->nMaxTools], 0, (sizeof(fmkTool_t *) * pToolList->nMaxTools));
-            pToolList->nMaxTools = pToolList->nMaxTools * 2;
-            FlyMakeDbgPrintf(FMK_DEBUG_MORE, ", new max %u, pToolList %p, new apTools %p\n",
-                          pToolList->nMaxTools, pToolList, pToolList->apTools);
-          }
-        }
-
-        // allocate the tool
-        pTool = FmkToolAlloc(pSrcList, i);
-        if(!pTool)
-          fWorked = FALSE;
-        else
-        {
-          pToolList->apTools[pToolList->nTools] = pTool;
-          ++pToolList->nTools;
-        }
+        pToolList = pToolListNew;
+        pToolList->apTools   = (void *)(pToolList + 1);
+        memset(&pToolList->apTools[pToolList->nMaxTools], 0, (sizeof(fmkTool_t *) * pToolList->nMaxTools));
+        pToolList->nMaxTools = pToolList->nMaxTools * 2;
+        FlyMakeDbgPrintf(FMK_DEBUG_MORE, ", new max %u, pToolList %p, new apTools %p\n",
+                      pToolList->nMaxTools, pToolList, pToolList->apTools);
       }
     }
+
+    // allocate the tool, i becomes 1st file of next tool
+    pTool = FmkToolAlloc(pSrcList, i, &i);
+    if(!pTool)
+      fWorked = FALSE;
+    else
+    {
+      pToolList->apTools[pToolList->nTools] = pTool;
+      ++pToolList->nTools;
+    }
   }
 
   // free the tool list if failed
-  if(!fWorked && pToolList)
-    pToolList = FlyMakeToolListFree(pToolList);
+  if(!fWorked)
+  {
+    if(pToolList)
+      pToolList = FlyMakeToolListFree(pToolList);
+    else
+      FlyMakeSrcListFree(pSrcList);
+  }
 
   FlyMakeDbgPrintf(FMK_DEBUG_MORE, "  fWorked %u, pToolList %p\n", fWorked, pToolList);
   if(pToolList && FlyMakeDebug() >= FMK_DEBUG_MUCH)
@@ -445,7 +801,10 @@ void * FlyMakeToolListFree(fmkToolList_t *pToolList)
     for(i = 0; i < pToolList->nTools; ++i)
     {
       if(pToolList->apTools[i])
+      {
+        FlyFreeIf(pToolList->apTools[i]->szName);
         FlyFree(pToolList->apTools[i]);
+      }
     }
 
     // free the src list structure
@@ -502,3 +861,112 @@ void FlyMakeToolListPrint(const fmkToolList_t *pToolList)
     }
   }
 }
+
+/*-------------------------------------------------------------------------------------------------
+  Find or make the scan of a folder
+
+  @param    pState      project state, holds the scans
+  @param    szFolder    folder to scan, e.g. "", "src/", "../lib/"
+  @param    depth       0-n, how many subfolders deep
+  @return   ptr to scan, or NULL if bad folder path or out of memory
+*///-----------------------------------------------------------------------------------------------
+static fmkScan_t * FmkScanGet(flyMakeState_t *pState, const char *szFolder, unsigned depth)
+{
+  fmkScan_t  *pScan;
+  void       *hSrcList;
+
+  for(pScan = pState->pScanList; pScan; pScan = pScan->pNext)
+  {
+    if(pScan->depth == depth && strcmp(pScan->szFolder, szFolder) == 0)
+      break;
+  }
+
+  // not scanned yet
+  if(!pScan)
+  {
+    hSrcList = FlyMakeSrcListNew(pState->pCompilerList, szFolder, depth, pState->szDepDir);
+    if(hSrcList)
+    {
+      pScan = FlyAllocZ(sizeof(*pScan));
+      if(pScan)
+        pScan->szFolder = FlyStrClone(szFolder);
+      if(!pScan || !pScan->szFolder)
+      {
+        FlyFreeIf(pScan);
+        FlyMakeSrcListFree(hSrcList);
+        pScan = NULL;
+      }
+      else
+      {
+        pScan->depth    = depth;
+        pScan->hSrcList = hSrcList;
+        pState->pScanList = FlyListAppend(pState->pScanList, pScan);
+      }
+    }
+  }
+
+  return pScan;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Get the source files in a folder, scanning the folder only the first time asked. Source files
+  aren't created or removed by building, so the list stays valid until the state is freed.
+
+  @param    pState      project state, holds the scans
+  @param    szFolder    folder to scan, e.g. "", "src/", "../lib/"
+  @param    depth       0-n, how many subfolders deep to add to source list
+  @return   handle to source list or NULL if bad folder path. Do not free.
+*///-----------------------------------------------------------------------------------------------
+void * FlyMakeScanSrcList(flyMakeState_t *pState, const char *szFolder, unsigned depth)
+{
+  fmkScan_t  *pScan;
+
+  pScan = FmkScanGet(pState, szFolder, depth);
+  return pScan ? pScan->hSrcList : NULL;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Get the tools in a folder, see FlyMakeToolListNew(). The folder is scanned and grouped into tools
+  only the first time asked.
+
+  @param    pState      project state, holds the scans
+  @param    szFolder    folder with 0 or more source files, e.g. "", "test/", "../tools/"
+  @return   ptr to tool list or NULL if bad folder path. Do not free.
+*///-----------------------------------------------------------------------------------------------
+fmkToolList_t * FlyMakeScanToolList(flyMakeState_t *pState, const char *szFolder)
+{
+  fmkScan_t  *pScan;
+
+  pScan = FmkScanGet(pState, szFolder, 0);
+  if(pScan && !pScan->pToolList)
+  {
+    pScan->pToolList = FmkToolListAlloc(pScan->hSrcList);
+    if(!pScan->pToolList)
+      pScan->hSrcList = NULL;
+  }
+
+  return pScan ? pScan->pToolList : NULL;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Free all folder scans of a state
+
+  @param    pState      project state
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeScanListFree(flyMakeState_t *pState)
+{
+  fmkScan_t  *pScan;
+
+  while(pState->pScanList)
+  {
+    pScan = pState->pScanList;
+    pState->pScanList = pScan->pNext;
+    if(pScan->pToolList)
+      FlyMakeToolListFree(pScan->pToolList);
+    else
+      FlyMakeSrcListFree(pScan->hSrcList);
+    FlyFree(pScan->szFolder);
+    FlyFree(pScan);
+  }
+}
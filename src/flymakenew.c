@@ -273,7 +273,8 @@ static const char m_szFmtFileCppTest[] =
   "}\n";
 
 /*-------------------------------------------------------------------------------------------------
-  Execute the system command.
+  Execute the system command. Runs the command directly, only using the shell if the command-line
+  needs it. See FlyMakeProcRun().
 
   @param    szCmdline      command to execute
   @param    pOpts          options like verbose, fNoBuild
@@ -287,7 +288,7 @@ int FlyMakeSystem(fmkVerbose_t verbose, flyMakeOpts_t *pOpts, const char *szCmdl
     FlyMakePrintf("%s\n", szCmdline);
   if(!pOpts->fNoBuild)
   {
-    ret = system(szCmdline);
+    ret = FlyMakeProcRun(szCmdline, NULL);
     if(ret != 0)
       ret = -1;
   }
@@ -340,6 +341,75 @@ bool_t FlyMakeFolderCreate(flyMakeOpts_t *pOpts, const char *szFolder)
   return fWorked;
 }
 
+/*-------------------------------------------------------------------------------------------------
+  Get the user's flymake cache folder, shared by all projects, creating it if needed. This is
+  $FLYMAKE_CACHE_DIR, or $XDG_CACHE_HOME/flymake/, or ~/.cache/flymake/. Setting FLYMAKE_CACHE_DIR
+  to "" turns off the cache.
+
+  @param    pOpts       ptr to options, nothing is created if -n
+  @param    szSub       sub-folder in the cache, e.g. "git/"
+  @return   allocated folder with trailing slash, e.g. "/home/me/.cache/flymake/git/", or NULL
+*///-----------------------------------------------------------------------------------------------
+char * FlyMakeCacheFolderAlloc(flyMakeOpts_t *pOpts, const char *szSub)
+{
+  const char   *szBase;
+  const char   *szFlymake = "";
+  char         *szFolder  = NULL;
+  char         *psz;
+  unsigned      size;
+
+  szBase = getenv("FLYMAKE_CACHE_DIR");
+  if(!szBase)
+  {
+    szBase = getenv("XDG_CACHE_HOME");
+    szFlymake = "flymake/";
+    if(!szBase || !*szBase)
+    {
+      szBase = getenv("HOME");
+      szFlymake = ".cache/flymake/";
+    }
+  }
+
+  if(szBase && *szBase)
+  {
+    size = strlen(szBase) + strlen(szFlymake) + strlen(szSub) + 3;
+    szFolder = FlyAlloc(size);
+    if(szFolder)
+    {
+      FlyStrZCpy(szFolder, szBase, size);
+      if(!isslash(szFolder[strlen(szFolder) - 1]))
+        FlyStrZCat(szFolder, "/", size);
+      FlyStrZCat(szFolder, szFlymake, size);
+      FlyStrZCat(szFolder, szSub, size);
+      if(!isslash(szFolder[strlen(szFolder) - 1]))
+        FlyStrZCat(szFolder, "/", size);
+
+      // create each parent folder in turn, e.g. ~/.cache/, then ~/.cache/flymake/
+      if(!pOpts->fNoBuild && !FlyFileExistsFolder(szFolder))
+      {
+        for(psz = szFolder + 1; *psz; ++psz)
+        {
+          if(isslash(*psz))
+          {
+            *psz = '\0';
+            if(!FlyFileExistsFolder(szFolder))
+              FlyFileMakeDir(szFolder);
+            *psz = '/';
+          }
+        }
+        if(!FlyFileExistsFolder(szFolder))
+        {
+          FlyMakeDbgPrintf(FMK_DEBUG_SOME, "FlyMakeCacheFolderAlloc: cannot create %s\n", szFolder);
+          FlyFree(szFolder);
+          szFolder = NULL;
+        }
+      }
+    }
+  }
+
+  return szFolder;
+}
+
 /*-------------------------------------------------------------------------------------------------
   Force remove an entire folder tree.
 
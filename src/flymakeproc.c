@@ -0,0 +1,380 @@
+/**************************************************************************************************
+  flymakeproc.c - runs child processes (compilers, ar, git) without a shell where possible
+  Copyright 2024 Drew Gislason
+  license: <https://mit-license.org>
+
+  Most command-lines flymake runs are simple, e.g. "cc src/foo.c -c -I. -o src/out/rel/foo.o", so
+  they are split into an argv and started directly with posix_spawn(). Only command-lines that
+  need the shell (quotes, globs, redirection, pipes, etc.) are run with "sh -c".
+**************************************************************************************************/
+#include "flymake.h"
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+// any of these means the command-line must be run by the shell
+static const char m_szShellChars[] = "|&;<>()$`\\\"'*?[#~\n";
+
+/*-------------------------------------------------------------------------------------------------
+  Does this command-line need the shell? For example "cc *.c -o foo" does (glob), but
+  "cc src/foo.c -c -o src/out/rel/foo.o" does not.
+
+  @param    szCmdline   command-line
+  @return   TRUE if the command-line must be run with "sh -c"
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeProcNeedsShell(const char *szCmdline)
+{
+  const char   *psz;
+  bool_t        fNeedsShell = FALSE;
+
+  if(strpbrk(szCmdline, m_szShellChars))
+    fNeedsShell = TRUE;
+
+  // environment assignment, e.g. "CC=gcc make"
+  else
+  {
+    psz = szCmdline;
+    while(isspace((unsigned char)*psz))
+      ++psz;
+    while(*psz && !isspace((unsigned char)*psz))
+    {
+      if(*psz == '=')
+      {
+        fNeedsShell = TRUE;
+        break;
+      }
+      ++psz;
+    }
+  }
+
+  return fNeedsShell;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Split a simple command-line into an argv. The argv and its strings are a single allocation, so
+  free with FlyFree().
+
+  @param    szCmdline   command-line that doesn't need the shell, see FlyMakeProcNeedsShell()
+  @return   allocated argv, NULL terminated, or NULL if out of memory or no command
+*///-----------------------------------------------------------------------------------------------
+static char ** FmkProcArgvNew(const char *szCmdline)
+{
+  char        **argv;
+  char         *psz;
+  unsigned      nArgs;
+  unsigned      i     = 0;
+  size_t        len;
+
+  // worst case is every other char is an arg
+  len = strlen(szCmdline);
+  nArgs = (unsigned)(len / 2) + 2;
+  argv = FlyAlloc(sizeof(char *) * nArgs + len + 1);
+  if(argv)
+  {
+    psz = (char *)&argv[nArgs];
+    memcpy(psz, szCmdline, len + 1);
+    while(*psz)
+    {
+      while(isspace((unsigned char)*psz))
+        *psz++ = '\0';
+      if(*psz)
+      {
+        argv[i++] = psz;
+        while(*psz && !isspace((unsigned char)*psz))
+          ++psz;
+      }
+    }
+    argv[i] = NULL;
+
+    if(i == 0)
+    {
+      FlyFree(argv);
+      argv = NULL;
+    }
+  }
+
+  return argv;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Start a child process. Does not wait for it, see FlyMakeProcWait().
+
+  @param    szCmdline   command-line, e.g. "cc src/foo.c -c -o src/out/rel/foo.o"
+  @param    fdOut       file descriptor for child's stdout and stderr, or -1 to inherit them
+  @param    fdClose     file descriptor to close in child (e.g. read side of pipe), or -1
+  @return   process id, or -1 if couldn't start the process
+*///-----------------------------------------------------------------------------------------------
+pid_t FlyMakeProcSpawn(const char *szCmdline, int fdOut, int fdClose)
+{
+  static char                 szSh[]    = "sh";
+  static char                 szDashC[] = "-c";
+  posix_spawn_file_actions_t  actions;
+  char                      **argv      = NULL;
+  char                       *aszShell[4];
+  pid_t                       pid       = -1;
+  bool_t                      fShell;
+
+  fShell = FlyMakeProcNeedsShell(szCmdline);
+  if(fShell)
+  {
+    aszShell[0] = szSh;
+    aszShell[1] = szDashC;
+    aszShell[2] = (char *)szCmdline;
+    aszShell[3] = NULL;
+  }
+  else
+    argv = FmkProcArgvNew(szCmdline);
+
+  if((fShell || argv) && posix_spawn_file_actions_init(&actions) == 0)
+  {
+    if(fdOut >= 0)
+    {
+      posix_spawn_file_actions_adddup2(&actions, fdOut, STDOUT_FILENO);
+      posix_spawn_file_actions_adddup2(&actions, fdOut, STDERR_FILENO);
+      posix_spawn_file_actions_addclose(&actions, fdOut);
+    }
+    if(fdClose >= 0)
+      posix_spawn_file_actions_addclose(&actions, fdClose);
+
+    // don't let the child inherit unflushed output
+    fflush(stdout);
+    if(fShell)
+    {
+      if(posix_spawn(&pid, "/bin/sh", &actions, NULL, aszShell, environ) != 0)
+        pid = -1;
+    }
+    else if(posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ) != 0)
+      pid = -1;
+    posix_spawn_file_actions_destroy(&actions);
+  }
+
+  FlyMakeDbgPrintf(FMK_DEBUG_MUCH, "FlyMakeProcSpawn(%s), fShell %u, pid %d\n", szCmdline, fShell, (int)pid);
+  FlyFreeIf(argv);
+
+  return pid;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Wait for a child process to exit, and say which signal killed it, if any
+
+  @param    pid       process id from FlyMakeProcSpawn()
+  @param    pSig      return value, signal that killed the process, or 0
+  @return   exit code of process (0-255), or -1 if killed by a signal or no such process
+*///-----------------------------------------------------------------------------------------------
+static int FmkProcWaitSig(pid_t pid, int *pSig)
+{
+  int     status    = 0;
+  int     exitCode  = -1;
+
+  *pSig = 0;
+  if(pid > 0)
+  {
+    while(waitpid(pid, &status, 0) < 0)
+    {
+      if(errno != EINTR)
+      {
+        status = -1;
+        break;
+      }
+    }
+    if(status != -1 && WIFEXITED(status))
+      exitCode = WEXITSTATUS(status);
+    else if(status != -1 && WIFSIGNALED(status))
+      *pSig = WTERMSIG(status);
+  }
+
+  return exitCode;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Wait for a child process started with FlyMakeProcSpawn() to exit.
+
+  @param    pid       process id from FlyMakeProcSpawn()
+  @return   exit code of process (0-255), or -1 if killed by a signal or no such process
+*///-----------------------------------------------------------------------------------------------
+int FlyMakeProcWait(pid_t pid)
+{
+  int     sig;
+
+  return FmkProcWaitSig(pid, &sig);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Elapsed time in seconds from a monotonic clock
+*///-----------------------------------------------------------------------------------------------
+static double FmkProcSeconds(void)
+{
+  struct timespec   ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Initialize a process result before FlyMakeProcRun()
+
+  @param    pProc       ptr to process result
+  @param    fCapture    TRUE to capture stdout/stderr into pProc->output, FALSE to let it print
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeProcInit(flyMakeProc_t *pProc, bool_t fCapture)
+{
+  memset(pProc, 0, sizeof(*pProc));
+  pProc->fCapture = fCapture;
+  pProc->exitCode = -1;
+  FlyStrSmartInit(&pProc->output);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Free any captured output in the process result
+
+  @param    pProc       ptr to process result
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+void FlyMakeProcUnInit(flyMakeProc_t *pProc)
+{
+  FlyStrSmartUnInit(&pProc->output);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Run a command-line and wait for it to finish.
+
+  Example use:
+
+      flyMakeProc_t proc;
+
+      FlyMakeProcInit(&proc, TRUE);
+      if(FlyMakeProcRun("git describe --tags", &proc) == 0)
+        printf("took %.3fs: %s", proc.seconds, proc.output.sz);
+      FlyMakeProcUnInit(&proc);
+
+  If -1 is returned, pProc->sig tells the two apart: it is the signal that killed the process, or
+  0 if the process couldn't be started at all.
+
+  @param    szCmdline   command-line, e.g. "ar -crs lib/foo.a lib/out/rel/foo.o"
+  @param    pProc       ptr to process result from FlyMakeProcInit(), or NULL
+  @return   exit code of process (0-255), or -1 if couldn't run or killed by a signal
+*///-----------------------------------------------------------------------------------------------
+int FlyMakeProcRun(const char *szCmdline, flyMakeProc_t *pProc)
+{
+  char        szBuf[512];
+  ssize_t     len;
+  double      start;
+  int         fds[2]    = { -1, -1 };
+  int         exitCode  = -1;
+  int         sig;
+  pid_t       pid       = -1;
+
+  start = FmkProcSeconds();
+  if(pProc && pProc->fCapture)
+  {
+    if(pipe(fds) == 0)
+      pid = FlyMakeProcSpawn(szCmdline, fds[1], fds[0]);
+    if(fds[1] >= 0)
+      close(fds[1]);
+
+    // read until child closes its output
+    while(pid > 0)
+    {
+      len = read(fds[0], szBuf, sizeof(szBuf) - 1);
+      if(len > 0)
+      {
+        szBuf[len] = '\0';
+        FlyStrSmartCat(&pProc->output, szBuf);
+      }
+      else if(len == 0 || errno != EINTR)
+        break;
+    }
+    if(fds[0] >= 0)
+      close(fds[0]);
+  }
+  else
+    pid = FlyMakeProcSpawn(szCmdline, -1, -1);
+
+  exitCode = FmkProcWaitSig(pid, &sig);
+  if(pProc)
+  {
+    pProc->exitCode = exitCode;
+    pProc->sig      = sig;
+    pProc->seconds  = FmkProcSeconds() - start;
+  }
+
+  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "FlyMakeProcRun(%s) = %d, sig %d\n", szCmdline, exitCode, sig);
+
+  return exitCode;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Run a command-line and pass each line of its output to a callback as it is read, without
+  collecting the whole output. If the callback returns FALSE, the process is stopped, so a long
+  output like "git log --oneline" is only read as far as needed.
+
+  Lines longer than 1K are cut short, and the rest of the line is skipped.
+
+  @param    szCmdline   command-line, e.g. "git log --oneline"
+  @param    pfnLine     called with each line, without the '\n'
+  @param    pArg        passed to pfnLine
+  @return   exit code of process (0-255), 0 if stopped by pfnLine, or -1 if couldn't run
+*///-----------------------------------------------------------------------------------------------
+int FlyMakeProcLines(const char *szCmdline, pfnFlyMakeProcLine_t pfnLine, void *pArg)
+{
+  char        szLine[1024];
+  FILE       *fp        = NULL;
+  size_t      len;
+  int         fds[2]    = { -1, -1 };
+  int         exitCode  = -1;
+  pid_t       pid       = -1;
+  bool_t      fStopped  = FALSE;
+  bool_t      fPartial  = FALSE;
+
+  if(pipe(fds) == 0)
+  {
+    pid = FlyMakeProcSpawn(szCmdline, fds[1], fds[0]);
+    close(fds[1]);
+    fp = fdopen(fds[0], "r");
+    if(!fp)
+      close(fds[0]);
+  }
+
+  while(pid > 0 && fp && fgets(szLine, sizeof(szLine), fp))
+  {
+    // only pass the start of a long line
+    len = strlen(szLine);
+    if(len && szLine[len - 1] == '\n')
+    {
+      szLine[len - 1] = '\0';
+      if(fPartial)
+      {
+        fPartial = FALSE;
+        continue;
+      }
+    }
+    else if(fPartial)
+      continue;
+    else
+      fPartial = TRUE;
+
+    if(!(*pfnLine)(szLine, pArg))
+    {
+      fStopped = TRUE;
+      kill(pid, SIGTERM);
+      break;
+    }
+  }
+  if(fp)
+    fclose(fp);
+
+  exitCode = FlyMakeProcWait(pid);
+  if(fStopped)
+    exitCode = 0;
+
+  FlyMakeDbgPrintf(FMK_DEBUG_MORE, "FlyMakeProcLines(%s) = %d, fStopped %u\n", szCmdline, exitCode, fStopped);
+
+  return exitCode;
+}
@@ -39,12 +39,19 @@ flyMakeState_t * FlyMakeStateClone(flyMakeState_t *pState)
 
 /*-------------------------------------------------------------------------------------------------
   Free a state and all of it's pointers. Knows about each subsystem that's part of the state.
+  Only for a state from FlyMakeStateClone(), as the state itself is freed too.
 
+  @param    pState    state from FlyMakeStateClone()
   @return   NULL
 *///-----------------------------------------------------------------------------------------------
 void *FlyMakeStateFree(flyMakeState_t *pState)
 {
-  (void)pState;
+  FlyMakeScanListFree(pState);
+  FlyMakeDbListFree(pState);
+  FlyMakeArenaUnInit(&pState->arena);
+  FlyStrSmartUnInit(&pState->cmdline);
+  memset(pState, 0, sizeof(*pState));
+  FlyFree(pState);
   return NULL;
 }
 
@@ -9,6 +9,7 @@ typedef struct
 {
   const char  *szMarker;  // marker string in format string
   unsigned     found;     // # of times it was found
+  bool_t       fOptional; // marker may be missing, but not repeated
 } fmkMarker_t;
 
 // for new projects, default flymake.toml file
@@ -24,8 +25,8 @@ static const char m_szTomlFmtDefault[] =
   "# flylib = { git=\"git@github.com:drewagislason/flylibc.git\" }\n"
   "\n"
   "[compiler]\n"
-  "# \".c\" = { cc=\"cc {in} -c {incs}{warn}{debug}-o {out}\", ll=\"cc {in} {libs}{debug}-o {out}\" }\n"
-  "# \".c++.cpp.cxx.cc.C\" = { cc=\"c++ {in} -c {incs}{warn}{debug} -o {out}\", ll=\"c++ {in} {libs}{debug}-o {out}\" }\n"
+  "# \".c\" = { cc=\"cc {in} -c {incs}{warn}{debug}{dep}-o {out}\", ll=\"cc {in} {libs}{debug}-o {out}\" }\n"
+  "# \".c++.cpp.cxx.cc.C\" = { cc=\"c++ {in} -c {incs}{warn}{debug}{dep}-o {out}\", ll=\"c++ {in} {libs}{debug}-o {out}\" }\n"
   "\n"
   "[folders]\n"
   "# \"lib/\" = \"--rl\"\n"
@@ -35,20 +36,23 @@ static const char m_szTomlFmtDefault[] =
 
 // archiving .o (objs) into a library is the same for all languages
 const char g_szFmtArchive[]           = "ar -crs %s %s";
+const char g_szFmtArchiveAdd[]        = "ar -rs %s %s";   // replace changed members
+const char g_szFmtArchiveDel[]        = "ar -ds %s %s";   // delete members of removed objects
 
 // default compile/link/archive format strings
-// .c = { cc="cc {in} -c {inc} {warn} -o {out}", ll="cc {in} {libs} -o {out} ", cc_dbg="-g -DDEBUG=1", ll_dbg="-g" }
+// .c = { cc="cc {in} -c {inc} {warn} -o {out}", ll="cc {in} {libs} -o {out} ", cc_dbg="-g -DDEBUG=1", ll_dbg="-g", dep="-MMD -MF " }
 
 static const char m_szExtsC[]         = ".c";
-static const char m_szDefCc[]         = "cc {in} -c {incs}{warn}{debug}-o {out}";
+static const char m_szDefCc[]         = "cc {in} -c {incs}{warn}{debug}{dep}-o {out}";
 static const char m_szDefLl[]         = "cc {in} {libs}{debug}-o {out}";
 static const char m_szDefCcDbg[]      = "-g -DDEBUG={n} ";  // see FmkAllocCcDbg()
 static const char m_szDefLlDbg[]      = "-g ";
 static const char m_szDefInc[]        = "-I";
 static const char m_szDefWarn[]       = "-Wall -Werror ";
+static const char m_szDefDep[]        = "-MMD -MF ";          // followed by depfile, e.g. "src/out/foo.d "
 
 static const char m_szCppExts[]       = ".c++.cpp.cxx.cc.C";
-static const char m_szCppDefCc[]      = "c++ {in} -c {incs}{warn}{debug}-o {out}";
+static const char m_szCppDefCc[]      = "c++ {in} -c {incs}{warn}{debug}{dep}-o {out}";
 static const char m_szCppDefLl[]      = "c++ {in} {libs}{debug}-o {out}";
 
 
@@ -58,6 +62,8 @@ static const char m_szKeyLl[]         = "ll";
 static const char m_szKeyLlDbg[]      = "ll_dbg";
 static const char m_szKeyInc[]        = "inc";
 static const char m_szKeyWarn[]       = "warn";
+static const char m_szKeyDep[]        = "dep";
+static const char m_szMarkerDep[]     = "{dep}";
 
 static const char m_szDepDir[]        = FMK_SZ_DEP_DIR;
 const char        g_szTomlFile[]      = FMK_SZ_FLYMAKE_TOML;  // used as a public API
@@ -284,6 +290,7 @@ static flyMakeCompiler_t * FmkCompilerFree(flyMakeCompiler_t *pCompiler)
   FlyStrFreeIf(pCompiler->szWarn);
   FlyStrFreeIf(pCompiler->szLl);
   FlyStrFreeIf(pCompiler->szLlDbg);
+  FlyStrFreeIf(pCompiler->szDep);
   memset(pCompiler, 0, sizeof(*pCompiler));
   return NULL;
 }
@@ -312,9 +319,9 @@ void FmkCompilerListFree(flyMakeCompiler_t *pHead)
 *///-----------------------------------------------------------------------------------------------
 void FlyMakeCompilerPrint(const flyMakeCompiler_t *pCompiler)
 {
-  FlyMakePrintf("%s={cc=%s, ll=%s,\n    cc_dbg=%s, ll_dbg=%s, inc=%s, warn=%s}\n",
+  FlyMakePrintf("%s={cc=%s, ll=%s,\n    cc_dbg=%s, ll_dbg=%s, inc=%s, warn=%s, dep=%s}\n",
       pCompiler->szExts, pCompiler->szCc, pCompiler->szLl, pCompiler->szCcDbg,
-      pCompiler->szLlDbg, pCompiler->szInc, pCompiler->szWarn);
+      pCompiler->szLlDbg, pCompiler->szInc, pCompiler->szWarn, pCompiler->szDep);
 }
 
 /*--------------------------------------------------------------------------------------------------
@@ -379,24 +386,26 @@ flyMakeCompiler_t * FlyMakeCompilerListDefault(flyMakeState_t *pState)
   if(pCompiler)
   {
     pCompilerList = pCompiler;
-    pCompiler->szCc     = FlyStrClone(m_szDefCc);             // "cc {in} -c {incs}{warn}{debug}-o {out}"
+    pCompiler->szCc     = FlyStrClone(m_szDefCc);             // "cc {in} -c {incs}{warn}{debug}{dep}-o {out}"
     pCompiler->szLl     = FlyStrClone(m_szDefLl);             // "cc {in} {libs}{debug}-o {out}"
     pCompiler->szInc    = FlyStrClone(m_szDefInc);            // "-I"
     pCompiler->szWarn   = FlyStrClone(m_szDefWarn);           // "-Wall -Werror"
     pCompiler->szCcDbg  = FmkAllocCcDbg(m_szDefCcDbg, pState->opts.dbg);  // "-g -DDEBUG=1"
     pCompiler->szLlDbg  = FlyStrClone(m_szDefLlDbg);          // "-g"
+    pCompiler->szDep    = FlyStrClone(m_szDefDep);            // "-MMD -MF "
 
     // create default C++ compiler structure
     pCompiler = FmkCompilerNew(m_szCppExts);
     if(pCompiler)
     {
       pCompilerList->pNext = pCompiler;
-      pCompiler->szCc     = FlyStrClone(m_szCppDefCc);        // "c++ {in} -c {incs}{warn}{debug}-o {out}"
+      pCompiler->szCc     = FlyStrClone(m_szCppDefCc);        // "c++ {in} -c {incs}{warn}{debug}{dep}-o {out}"
       pCompiler->szLl     = FlyStrClone(m_szCppDefLl);        // "c++ {in} {libs}{debug}-o {out}"
       pCompiler->szInc    = FlyStrClone(m_szDefInc);          // "-I"
       pCompiler->szWarn   = FlyStrClone(m_szDefWarn);         // "-Wall -Werror"
       pCompiler->szCcDbg  = FmkAllocCcDbg(m_szDefCcDbg, pState->opts.dbg);  //"-g -DDEBUG=1"
       pCompiler->szLlDbg  = FlyStrClone(m_szDefLlDbg);        // "-g";
+      pCompiler->szDep    = FlyStrClone(m_szDefDep);          // "-MMD -MF "
     }
   }
 
@@ -404,16 +413,17 @@ flyMakeCompiler_t * FlyMakeCompilerListDefault(flyMakeState_t *pState)
 }
 
 /*-------------------------------------------------------------------------------------------------
-  Converts a space separate list of folders to an allocated list of include options.
+  Converts a space separate list of folders to a list of include options, allocated from the arena.
 
   For example, converts ". inc/ deps/dep1/inc/" to "-I. -Iinc/ -Ideps/dep1/inc/"
-  If szIncs is "", then returns allocated ""
+  If szIncs is "", then returns ""
 
+  @param  pArena  arena to allocate from
   @param  szIncs list of include folders, e.g. ". inc/ deps/dep1/inc/"
   @param  szIncOpt, e.g. "-I"
-  @return allocated string or NULL if failed to allocate memory.
+  @return string in arena or NULL if failed to allocate memory.
 *///-----------------------------------------------------------------------------------------------
-static char * FmkAddIncOpts(const char *szIncs, const char *szIncOpt)
+static char * FmkAddIncOpts(flyMakeArena_t *pArena, const char *szIncs, const char *szIncOpt)
 {
   const char *psz;
   char       *pszNewIncs = NULL;
@@ -430,15 +440,15 @@ static char * FmkAddIncOpts(const char *szIncs, const char *szIncOpt)
     psz = FlyStrArgNext(psz);
   } while(len);
 
-  // no include folders, return allocated empty string
+  // no include folders, return empty string
   if(size == 0)
-    pszNewIncs = FlyStrClone("");
+    pszNewIncs = FlyMakeArenaStrClone(pArena, "");
 
   // create list of include options, e.g. "-I. -Iinc/ -Ideps/dep1/inc/"
   else
   {
     ++size;
-    pszNewIncs = FlyAlloc(size);
+    pszNewIncs = FlyMakeArenaAlloc(pArena, size);
     if(pszNewIncs)
     {
       memset(pszNewIncs, 0, size);
@@ -460,30 +470,78 @@ static char * FmkAddIncOpts(const char *szIncs, const char *szIncOpt)
   return pszNewIncs;
 }
 
+/*-------------------------------------------------------------------------------------------------
+  Allocate the dependency options for the {dep} marker from the arena.
+
+  For example, converts "src/out/foo.d" to "-MMD -MF src/out/foo.d ". If either szDepOpt or
+  szDepFile is NULL, then returns "".
+
+  @param  pArena      arena to allocate from
+  @param  szDepOpt    e.g. "-MMD -MF "
+  @param  szDepFile   e.g. "src/out/foo.d"
+  @return string in arena or NULL if failed to allocate memory.
+*///-----------------------------------------------------------------------------------------------
+static char * FmkAllocDepOpts(flyMakeArena_t *pArena, const char *szDepOpt, const char *szDepFile)
+{
+  char       *szDep;
+  size_t      size = 1;
+
+  if(szDepOpt && szDepFile)
+    size += strlen(szDepOpt) + strlen(szDepFile) + 1;
+  szDep = FlyMakeArenaAlloc(pArena, size);
+  if(szDep)
+  {
+    *szDep = '\0';
+    if(szDepOpt && szDepFile)
+    {
+      FlyStrZCpy(szDep, szDepOpt, size);
+      FlyStrZCat(szDep, szDepFile, size);
+      FlyStrZCat(szDep, " ", size);
+    }
+  }
+
+  return szDep;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Does this compiler produce depfiles? That is, does the cc= format contain the {dep} marker?
+
+  @param  pComplier   compiler to check
+  @return TRUE if compiler produces depfiles
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeCompilerHasDep(const flyMakeCompiler_t *pCompiler)
+{
+  return (pCompiler->szDep && strstr(pCompiler->szCc, m_szMarkerDep)) ? TRUE : FALSE;
+}
+
 /*-------------------------------------------------------------------------------------------------
   Does the substiturions, converting from {makers} to the given strings
 
   This will either ammend an existing flyMakeCompiler_t, or prepend a new one to the list.
 
   @param  pStr        return value, smart string to be filled in
+  @param  pArena      arena for temporary options, released by the caller
   @param  pComplier   compiler to use with format strings
   @param  szIn        input file(s)
   @param  szInc       include libraries, e.g. "mylib.a deplib.a "
   @param  szWarn      warning options, e.g. "-Wall -Werror"
   @param  szDebug     debug options, e.g. "-g -DEBUG=1"
+  @param  szDepFile   depfile for optional {dep} marker, e.g. "src/out/foo.d", or NULL for none
   @param  szOut       output file(s)
   @return TRUE if worked, FALSE if no memory
 *///-----------------------------------------------------------------------------------------------
 bool_t FlyMakeCompilerFmtCompile(
   flyStrSmart_t *pStr,
+  flyMakeArena_t *pArena,
   const flyMakeCompiler_t *pCompiler,
   const char *szIn,
   const char *szIncs,
   const char *szWarn,
   const char *szDebug,
+  const char *szDepFile,
   const char *szOut)
 {
-  const char *aszMarkers[] = { "{in}", "{incs}", "{warn}", "{debug}", "{out}" };
+  const char *aszMarkers[] = { "{in}", "{incs}", "{warn}", "{debug}", "{out}", m_szMarkerDep };
   char       *psz;
   const char *szSub;
   unsigned    len;
@@ -493,6 +551,8 @@ bool_t FlyMakeCompilerFmtCompile(
 
   // make sure input smart string is large enough
   len = strlen(pCompiler->szCc) + strlen(szIn) + strlen(szIncs) + strlen(szWarn) + strlen(szDebug) + strlen(szOut);
+  if(szDepFile && pCompiler->szDep)
+    len += strlen(pCompiler->szDep) + strlen(szDepFile) + 1;
   if(!FlyStrSmartResize(pStr, len))
     fWorked = FALSE;
   else
@@ -500,8 +560,10 @@ bool_t FlyMakeCompilerFmtCompile(
     FlyStrSmartCpy(pStr, pCompiler->szCc);
     for(i = 0; fWorked && i < NumElements(aszMarkers); ++i)
     {
-      // markers must have already been validated
+      // markers must have already been validated, only {dep} is optional
       psz = strstr(pStr->sz, aszMarkers[i]);
+      if(!psz && aszMarkers[i] == m_szMarkerDep)
+        continue;
       FlyAssert(psz);
 
       // substitute each marker
@@ -510,7 +572,7 @@ bool_t FlyMakeCompilerFmtCompile(
       else if(i == 1)
       {
         // converts ". inc/ dep/foo/inc/" to "-I. -Iinc/ -Idep/foo/inc/ "
-        szSub = FmkAddIncOpts(szIncs, pCompiler->szInc);
+        szSub = FmkAddIncOpts(pArena, szIncs, pCompiler->szInc);
         if(!szSub)
           fWorked = FALSE;
       }
@@ -518,8 +580,15 @@ bool_t FlyMakeCompilerFmtCompile(
         szSub = szWarn;
       else if(i == 3)
         szSub = szDebug;
-      else
+      else if(i == 4)
         szSub = szOut;
+      else
+      {
+        // converts "src/out/foo.d" to "-MMD -MF src/out/foo.d "
+        szSub = FmkAllocDepOpts(pArena, pCompiler->szDep, szDepFile);
+        if(!szSub)
+          fWorked = FALSE;
+      }
 
       // do the substitution
       if(fWorked)
@@ -528,8 +597,6 @@ bool_t FlyMakeCompilerFmtCompile(
         lenSub = strlen(szSub);
         memmove(&psz[lenSub], &psz[len], strlen(&psz[len]) + 1);
         memcpy(psz, szSub, lenSub);
-        if(i == 1)
-          FlyFree((void *)szSub);
       }
     }
   }
@@ -625,10 +692,10 @@ static bool_t  FmkTomlCheckMarkers(const char *sz, fmkMarker_t *aMarkers, unsign
       ++aMarkers[i].found;
   }
 
-  // all markers must be there, once and only once
+  // all markers must be there, once and only once, optional markers at most once
   for(i = 0; i < n; ++i)
   {
-    if(aMarkers[i].found != 1)
+    if(aMarkers[i].found > 1 || (aMarkers[i].found == 0 && !aMarkers[i].fOptional))
     {
       fWorked = FALSE;
       break;
@@ -675,13 +742,14 @@ char * FmkAddSpace(char *sz)
 *///-----------------------------------------------------------------------------------------------
 fmkErr_t FmkTomlProcessCompilerKey(flyMakeState_t *pState, tomlKey_t *pKey)
 {
-  fmkMarker_t aMarkersCompile[]   = { {"{in}"}, {"{incs}"}, {"{warn}"}, {"{debug}"}, {"{out}"} };
+  fmkMarker_t aMarkersCompile[]   = { {"{in}"}, {"{incs}"}, {"{warn}"}, {"{debug}"}, {"{out}"},
+                                      {m_szMarkerDep, 0, TRUE} };
   fmkMarker_t aMarkersLink[]      = { {"{in}"}, {"{libs}"}, {"{debug}"}, {"{out}"} };
-  static const char szTomlCompileErr[]  = "cc= must contain: {in} {incs} {warn} {debug} {out}";
+  static const char szTomlCompileErr[]  = "cc= must contain: {in} {incs} {warn} {debug} {out}, optional {dep}";
   static const char szTomlLinkErr[]     = "ll= must contain: {in} {libs} {debug} {out}";
 
   tomlKey_t           key;
-  flyMakeCompiler_t  *pCompiler;
+  flyMakeCompiler_t  *pCompiler = NULL;
   const char         *szIter;
   char               *szValue;
   char               *szKey;
@@ -785,6 +853,13 @@ fmkErr_t FmkTomlProcessCompilerKey(flyMakeState_t *pState, tomlKey_t *pKey)
         pCompiler->szWarn = FmkAddSpace(szValue);
       }
 
+      // dep= "-MMD -MF "
+      else if(strcmp(szKey, m_szKeyDep) == 0)
+      {
+        FlyStrFreeIf(pCompiler->szDep);
+        pCompiler->szDep = FmkAddSpace(szValue);
+      }
+
       FlyStrFreeIf(szKey);
       szIter = FlyTomlKeyIter(szIter, &key);
     }
@@ -807,6 +882,8 @@ fmkErr_t FmkTomlProcessCompilerKey(flyMakeState_t *pState, tomlKey_t *pKey)
       pCompiler->szLlDbg = FlyStrClone(m_szDefLlDbg);
     if(!pCompiler->szWarn)
       pCompiler->szWarn = FlyStrClone(m_szDefWarn);
+    if(!pCompiler->szDep)
+      pCompiler->szDep = FlyStrClone(m_szDefDep);
   }
 
   return err;
@@ -1300,7 +1377,7 @@ bool_t FmkTomlProcessFolders(flyMakeState_t *pState)
   // if no folders and there are source files in the root, it's a simple project
   if(pState->pFolderList == NULL)
   {
-    hList = FlyMakeSrcListNew(pState->pCompilerList, pState->szRoot, 0);
+    hList = FlyMakeScanSrcList(pState, pState->szRoot, 0);
     if(FlyMakeSrcListLen(hList) > 0)
     {
       pState->fIsSimple = TRUE;
@@ -1321,7 +1398,6 @@ bool_t FmkTomlProcessFolders(flyMakeState_t *pState)
         pFolder->rule = rule;
         pState->pFolderList = FlyListAppend(pState->pFolderList, pFolder);
       }
-      FlyFileListFree(hList);
     }
   }
 
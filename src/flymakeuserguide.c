@@ -49,25 +49,31 @@ const char g_szFlyMakeUserGuide[] =
   "Options:\n"
   "-B             Rebuild project or package (but not dependencies)\n"
   "-D[=#]         For build command: add -DDEBUG=1 flag when compiling. Use -D=2 to set -DDEBUG=2\n"
+  "-j[=#]         Compile up to # files at once. -j alone uses all CPUs. Default is 1 at a time\n"
   "-n             Dry run (don't create any files)\n"
   "-v[=#]         Verbose level: -v- (error output only), -v (default: some), or -v=2 (more)\n"
   "--             For run/test commands: all following args/opts are sent to subprogram(s)\n"
   "--all          Rebuild project or package plus all dependencies\n"
+  "--cache        Copy objects from a cache shared by all projects, rather than compile them\n"
   "--cpp          For new command: create a C++ project or package\n"
+  "--hash         Compile files whose contents changed, ignoring dates (for CI, NFS)\n"
   "--help         This help screen\n"
   "--lib          For new command: create library folder\n"
   "--rN           Force build rules to one of: --rl (lib), --rs (src), --rt (test)\n"
+  "--sandbox      Compile each file in a sandbox with only its inputs, as a build server would\n"
   "--user-guide   Print flyamke user guide to the screen\n"
   "--version      Display flymake version\n"
   "-w-            Turn off warning as errors on compile\n"
   "\n"
   "Commands:\n"
   "\n"
-  "build  [--all] [-B] [-D] [--rN] [-w] [targets...]       Builds project or specific target(s)\n"
+  "build  [--all] [-B] [-D] [-j] [--rN] [-w] [targets...]  Builds project or specific target(s)\n"
   "clean  [--all] [-B]                                     Clean all .o and other temporary files\n"
+  "daemon [-j]                                             Keep project loaded, serve build/run/test from it\n"
   "new    [--all] [--cpp] [--lib] folder                   Create a new C or C++ project or package\n"
   "run    [--all] [-B] [-D] [targets...] [-- arg1 -opt1]   Build and run target program(s)\n"
   "test   [--all] [-B] [-D] [targets...] [-- arg1 -opt1]   Build and run the program(s) in test/ folder\n"
+  "watch  [-B] [-D] [-j] [--rN] [-w] [targets...]          Build, then rebuild each time a source file changes\n"
   "```\n"
   "\n"
   "### 1.2 - Flymake Command Examples\n"
@@ -91,6 +97,7 @@ const char g_szFlyMakeUserGuide[] =
   "$ flymake                         # same as flymake build\n"
   "$ flymake build -B -D             # rebuild project with debug version\n"
   "$ flymake build -all              # rebuild project and all dependencies\n"
+  "$ flymake build -j                # build using all CPUs\n"
   "$ flymake build test/test_sample  # build the single program test/test_sample\n"
   "$ flymake clean                   # clean all .o (object) files in project\n"
   "$ flymake clean --all             # clean everything including libraries, programs and dependencies\n"
@@ -118,10 +125,11 @@ const char g_szFlyMakeUserGuide[] =
   "\n"
   "# flymake v1.0\n"
   "mkdir out/\n"
-  "cc proj_main.c -c -I. -Wall -Werror -o out/proj_main.o\n"
-  "cc proj_mem.c -c -I. -Wall -Werror -o out/proj_mem.o\n"
-  "cc proj_more.c -c -I. -Wall -Werror -o out/proj_more.o\n"
-  "cc proj_other.c -c -I. -Wall -Werror -o out/proj_other.o\n"
+  "mkdir out/rel/\n"
+  "cc proj_main.c -c -I. -Wall -Werror -o out/rel/proj_main.o\n"
+  "cc proj_mem.c -c -I. -Wall -Werror -o out/rel/proj_mem.o\n"
+  "cc proj_more.c -c -I. -Wall -Werror -o out/rel/proj_more.o\n"
+  "cc proj_other.c -c -I. -Wall -Werror -o out/rel/proj_other.o\n"
   "# created program project\n"
   "```\n"
   "\n"
@@ -129,14 +137,18 @@ const char g_szFlyMakeUserGuide[] =
   "and asserts. Type:\n"
   "\n"
   "```\n"
-  "$ flymake build -B -D=2\n"
-  "cc proj_main.c -c -I. -DDEBUG=2 -Wall -Werror -o out/proj_main.o\n"
-  "cc proj_mem.c -c -I. -DDEBUG=2 -Wall -Werror -o out/proj_mem.o\n"
-  "cc proj_more.c -c -I. -DDEBUG=2 -Wall -Werror -o out/proj_more.o\n"
-  "cc proj_other.c -c -I. -DDEBUG=2 -Wall -Werror -o out/proj_other.o\n"
+  "$ flymake build -D=2\n"
+  "cc proj_main.c -c -I. -DDEBUG=2 -Wall -Werror -o out/dbg2/proj_main.o\n"
+  "cc proj_mem.c -c -I. -DDEBUG=2 -Wall -Werror -o out/dbg2/proj_mem.o\n"
+  "cc proj_more.c -c -I. -DDEBUG=2 -Wall -Werror -o out/dbg2/proj_more.o\n"
+  "cc proj_other.c -c -I. -DDEBUG=2 -Wall -Werror -o out/dbg2/proj_other.o\n"
   "# created (debug) program project\n"
   "```\n"
   "\n"
+  "Each configuration has its own objects, in `out/rel/` for release and in `out/dbg1/`, `out/dbg2/`,\n"
+  "etc. for debug levels. Once both have been built, switching between `flymake build` and\n"
+  "`flymake build -D=2` only relinks the program.\n"
+  "\n"
   "Flymakes turns on maximum warnings/errors \"-Wall -Werror\" by default. Why not let the compiler\n"
   "catch as many errors as possible? This can cause troubles if you are trying to build legacy code\n"
   "or a 3rd party library. To turn off this feature, use the `-w-` option.\n"
@@ -166,30 +178,30 @@ const char g_szFlyMakeUserGuide[] =
   "# flymake v1.0\n"
   "\n"
   "# ---- Locating dependencies... ----\n"
-  "# Dependency git     : bar *: git@github.com:drewagislason/bar.git\n"
   "# Cloning git@github.com:drewagislason/bar.git into deps/bar/\n"
+  "# Cloning git@github.com:drewagislason/baz.git into deps/baz/\n"
+  "# Dependency git     : bar *: git@github.com:drewagislason/bar.git\n"
   "#     found version => 1.0\n"
   "# Dependency git     : baz 1.1: git@github.com:drewagislason/baz.git\n"
-  "# Cloning git@github.com:drewagislason/baz.git into deps/baz/\n"
   "#     found version => 1.1\n"
-  "# Dependency git     : qux *: git@github.com:drewagislason/qux.git\n"
   "# Cloning git@github.com:drewagislason/qux.git into deps/qux/\n"
+  "# Dependency git     : qux *: git@github.com:drewagislason/qux.git\n"
   "#     found version => *\n"
   "\n"
   "# ---- Building dependencies... ----\n"
-  "cc deps/bar/lib/bar.c -c -I. -Ideps/bar/inc/ -Wall -Werror -o deps/bar/lib/out/bar.o\n"
-  "ar -crs deps/bar/lib/bar.a deps/bar/lib/out/*.o\n"
+  "cc deps/bar/lib/bar.c -c -I. -Ideps/bar/inc/ -Wall -Werror -o deps/bar/lib/out/rel/bar.o\n"
+  "ar -crs deps/bar/lib/bar.a deps/bar/lib/out/rel/bar.o\n"
   "# created library deps/bar/lib/bar.a\n"
-  "cc deps/baz/lib/baz.c -c -I. -Ideps/baz/inc/ -Ideps/qux/ -Wall -Werror -o deps/baz/lib/out/baz.o\n"
-  "ar -crs deps/baz/lib/baz.a deps/baz/lib/out/*.o\n"
-  "# created library deps/baz/lib/baz.a\n"
-  "cc deps/qux/qux.c -c -I. -Ideps/qux/ -Wall -Werror -o deps/qux/out/qux.o\n"
-  "ar -crs deps/qux/qux.a deps/qux/out/*.o\n"
+  "cc deps/qux/qux.c -c -I. -Ideps/qux/ -Wall -Werror -o deps/qux/out/rel/qux.o\n"
+  "ar -crs deps/qux/qux.a deps/qux/out/rel/qux.o\n"
   "# created library deps/qux/qux.a\n"
+  "cc deps/baz/lib/baz.c -c -I. -Ideps/baz/inc/ -Ideps/qux/ -Wall -Werror -o deps/baz/lib/out/rel/baz.o\n"
+  "ar -crs deps/baz/lib/baz.a deps/baz/lib/out/rel/baz.o\n"
+  "# created library deps/baz/lib/baz.a\n"
   "\n"
   "# ---- Building project... ----\n"
-  "cc foo.c -c -I. -Ideps/bar/inc/ -Ideps/baz/inc/ -Wall -Werror -o out/foo.o\n"
-  "cc out/*.o deps/bar/lib/bar.a deps/baz/lib/baz.a deps/qux/qux.a -o foo\n"
+  "cc foo.c -c -I. -Ideps/bar/inc/ -Ideps/baz/inc/ -Wall -Werror -o out/rel/foo.o\n"
+  "cc out/rel/foo.o deps/bar/lib/bar.a deps/baz/lib/baz.a deps/qux/qux.a -o foo\n"
   "# created program foo\n"
   "```\n"
   "\n"
@@ -309,8 +321,8 @@ const char g_szFlyMakeUserGuide[] =
   "# flylibc = { git=\"git@github.com:drewagislason/flylibc.git\" }\n"
   "\n"
   "[compiler]\n"
-  "# \".c\" = { cc=\"cc {in} -c {incs}{warn}{debug} -o {out}\", ll=\"cc {in} {libs}{debug}-o {out}\" }\n"
-  "# \".cc.cpp.c++\" = { cc=\"c++ {in} -c {incs}{warn}{debug} -o {out}\", ll=\"c++ {in} {libs}{debug}-o {out}\" }\n"
+  "# \".c\" = { cc=\"cc {in} -c {incs}{warn}{debug}{dep}-o {out}\", ll=\"cc {in} {libs}{debug}-o {out}\" }\n"
+  "# \".cc.cpp.c++\" = { cc=\"c++ {in} -c {incs}{warn}{debug}{dep}-o {out}\", ll=\"c++ {in} {libs}{debug}-o {out}\" }\n"
   "\n"
   "[folders]\n"
   "# \"lib\" = \"--rl\"\n"
@@ -362,24 +374,25 @@ const char g_szFlyMakeUserGuide[] =
   "\n"
   "```\n"
   "[compiler]\n"
-  "\".c\" = { cc=\"cc {in} -c {incs}{warn}{debug}-o {out}\", ll=\"cc {in} {libs}{debug}-o {out}\" }\n"
-  "\".c++.cpp.cxx.cc..C\" = { cc=\"c++ {in} -c {incs}{warn}{debug}-o {out}\", ll=\"c++ {in} {libs}{debug}-o {out}\" }\n"
+  "\".c\" = { cc=\"cc {in} -c {incs}{warn}{debug}{dep}-o {out}\", ll=\"cc {in} {libs}{debug}-o {out}\" }\n"
+  "\".c++.cpp.cxx.cc..C\" = { cc=\"c++ {in} -c {incs}{warn}{debug}{dep}-o {out}\", ll=\"c++ {in} {libs}{debug}-o {out}\" }\n"
   "```\n"
   "\n"
   "The main keys in the `[compiler]` table specify the file extensions, for each compiler. For\n"
   "example, files ending in `.c` will be compiled with the `cc` compiler, whereas files ending in\n"
   "`.c++`, `.cpp` or `.cc` will be compiled with the `c++` compiler.\n"
   "\n"
-  "Each TOML inline table (in curly brackets) defines up to 6 keys\n"
+  "Each TOML inline table (in curly brackets) defines up to 7 keys\n"
   "\n"
   "TOML Key  | Definition            | Default\n"
   "--------- | --------------------- | ------------\n"
-  "`cc=`     | compiler command-line | \"cc {in} -c {incs}{warn}{debug}-o {out}\"\n"
+  "`cc=`     | compiler command-line | \"cc {in} -c {incs}{warn}{debug}{dep}-o {out}\"\n"
   "`ll=`     | linker command-line   | \"cc {in} {libs}{debug}-o {out}\"\n"
   "`cc_dbg=` | compile debug options | \"-g -DDEBUG=1\"\n"
   "`ll_dbg=` | link debug options    | \"-g\"\n"
   "`inc=`    | include option        | \"-I\"\n"
   "`warn=`   | warning options       | \"-Wall -Werror\"\n"
+  "`dep=`    | depfile options       | \"-MMD -MF \"\n"
   "\n"
   "For a discussion of C compiler versions, see <https://en.wikipedia.org/wiki/ANSI_C>  \n"
   "For a discussion of C++ compiler versions, see <https://en.wikipedia.org/wiki/C%2B%2B#History>  \n"
@@ -387,6 +400,28 @@ const char g_szFlyMakeUserGuide[] =
   "The `{markers}` such as `{in}` or `{out}` must be present in the `cc=` and `ll=` keys. Flymake uses\n"
   "these markers to know where to put the various values. \n"
   "\n"
+  "The `{dep}` marker is optional. If present, it is replaced by the `dep=` options followed by the\n"
+  "name of a depfile, e.g. `-MMD -MF src/out/rel/foo.d`. The compiler writes the list of headers that\n"
+  "each source file includes to the depfile, and flymake recompiles only those source files whose\n"
+  "headers have changed since they were last compiled. Without `{dep}`, flymake only checks the date\n"
+  "of the source file itself, so use `-B` to rebuild after changing a header.\n"
+  "\n"
+  "Flymake remembers what it compiled, and with which command-line, in a small build database in\n"
+  "each `out/` folder, e.g. `src/out/rel/.flymake.db`. When nothing has changed, this lets flymake\n"
+  "skip reading every depfile, so a build that has nothing to do finishes quickly. The database is\n"
+  "deleted along with the `out/` folder by `flymake clean`, and is simply rebuilt if missing.\n"
+  "\n"
+  "Programs and libraries are linked from the objects of the current source files only, never from\n"
+  "whatever happens to be in the `out/` folder. When a source file is deleted or renamed, its object\n"
+  "and depfile are removed from `out/` and the program or library is relinked. If the list of\n"
+  "objects is very long, it is passed to the linker or archiver in a response file, e.g.\n"
+  "`@src/out/rel/foo.rsp`.\n"
+  "\n"
+  "A library is archived from scratch with `ar -crs` only when it is missing or the configuration\n"
+  "changed. After that, only the objects that were recompiled are replaced with `ar -rs`, and objects\n"
+  "of removed source files are deleted with `ar -ds`, so updating a large library after an edit is\n"
+  "quick. The objects in each library are remembered in a list file, e.g. `lib/out/rel/foo.lst`.\n"
+  "\n"
   "### 4.3 - flymake.toml `[folders]` Section\n"
   "\n"
   "The flymake.toml file in the root of the project make optionally contain a `[folders]` section.\n"
@@ -431,13 +466,17 @@ const char g_szFlyMakeUserGuide[] =
   "given git repository.\n"
   "\n"
   "In the case of a git dependency, the git repo is checked out into the `deps/` folder created off\n"
-  "the root of the main project, e.g. `myproject/deps/flylib/`.\n"
+  "the root of the main project, e.g. `myproject/deps/flylib/`. All new git dependencies in the same\n"
+  "`[dependencies]` section are cloned at the same time, then the version of each is checked out.\n"
   "\n"
   "Note that the `path` to a dependency, if relative, is relative to the `flymake.toml` file that\n"
   "specified the dependency.\n"
   "\n"
   "The order of dependencies in the `[dependencies]` section of `flymake.toml` defines the order of\n"
-  "the include folders, and the order in which the packages are built and linked.\n"
+  "the include folders, and the order in which the packages are linked. A dependency is always built\n"
+  "after the dependencies in its own `[dependencies]` section. With `-j`, dependencies that don't\n"
+  "depend on each other are built at the same time, sharing the same `-j` job slots, and the output\n"
+  "of each dependency is printed together when it finishes.\n"
   "\n"
   "Dependencies are recursive, that is a dependency may depend on another set of dependencies and so\n"
   "forth. They are processed wide first, then deep. That is, all the dependencies in a single\n"
@@ -538,8 +577,41 @@ const char g_szFlyMakeUserGuide[] =
   "\n"
   "The optional `branch=` field is the git branch. By default, the branch is usually `main`.\n"
   "\n"
-  "Versions are really flexible, but require that the developer uses versions in the commit log. If\n"
-  "not, versions won't work.\n"
+  "The optional `clone=` field controls how much of the git repository is downloaded. If not\n"
+  "specified, flymake picks the smallest clone that works:\n"
+  "\n"
+  "```\n"
+  "clone=\"full\"      all branches and history, the default without sha=, version= or branch=\n"
+  "clone=\"shallow\"   only the latest commit, the default with just branch=\n"
+  "clone=\"partial\"   all history, but files only for the commit checked out, the default with sha=\n"
+  "                  or version=\n"
+  "```\n"
+  "\n"
+  "If the `sha=` or `version=` isn't found in a shallow or single branch clone, flymake fetches the rest\n"
+  "of the repository and tries again.\n"
+  "\n"
+  "Flymake keeps a mirror of each git dependency in a cache folder shared by all your projects,\n"
+  "`~/.cache/flymake/git/`. The mirror is updated with `git fetch`, then the dependency is cloned from\n"
+  "the mirror, which is fast and uses little extra disk space. So checking out the same dependency in\n"
+  "many projects, or again after `flymake clean --all`, only downloads what's new. Set\n"
+  "`FLYMAKE_CACHE_DIR` to use a different cache folder, or to `\"\"` to not use a cache. If\n"
+  "`XDG_CACHE_HOME` is set, the cache is in `$XDG_CACHE_HOME/flymake/`.\n"
+  "\n"
+  "Built git dependencies are cached too, in `~/.cache/flymake/deps/`. Each entry holds the libraries,\n"
+  "and is keyed by the dependency's SHA and local edits to its tracked files, the `[compiler]` formats,\n"
+  "the debug and warning options, the compiler and archiver programs, and the entries of the\n"
+  "dependencies it needs. When a dependency's libraries don't exist yet, such as after a fresh clone,\n"
+  "they are copied from the cache rather than compiled. Libraries restored from the cache aren't built\n"
+  "again until a tracked file in the dependency is edited, or until the next `flymake --all`, which\n"
+  "always compiles and doesn't use the cache. Path dependencies are never cached, as they may be\n"
+  "edited at any time.\n"
+  "\n"
+  "Versions are really flexible, but require that the developer uses versions in git tags or in the\n"
+  "commit log. If not, versions won't work.\n"
+  "\n"
+  "Tags such as `v1.2.0` or `1.2.0` are checked first, and the highest matching version is used. If no\n"
+  "tag matches, the commit log is searched, newest commit first. The version found is cached in\n"
+  "`~/.cache/flymake/git/versions`, so the same lookup isn't repeated until new commits or tags appear.\n"
   "\n"
   "The version string specifies a range as shown in the table below:\n"
   "\n"
@@ -570,6 +642,21 @@ const char g_szFlyMakeUserGuide[] =
   "dee4fc6 flymake: version 0.1.2 first checkin. Can only do --version and --help\n"
   "```\n"
   "\n"
+  "#### 4.4.5 flymake.lock\n"
+  "\n"
+  "After finding the dependencies, flymake writes `flymake.lock` next to `flymake.toml`. It records\n"
+  "each dependency's folder, git URL, exact SHA, version, include folder, libraries and a hash of its\n"
+  "`flymake.toml`.\n"
+  "\n"
+  "If `flymake.toml` hasn't changed since `flymake.lock` was written, and each dependency is still\n"
+  "there with the same `flymake.toml`, flymake uses `flymake.lock` and skips finding dependencies, so\n"
+  "no git commands are run.\n"
+  "\n"
+  "Commit `flymake.lock` for reproducible builds. When a git dependency is cloned again, for example\n"
+  "on a new machine or after `flymake clean --all`, the SHA in `flymake.lock` is checked out, as long\n"
+  "as the dependency's `git=`, `version=`, `sha=` and `branch=` haven't changed. To get the latest\n"
+  "versions in range, delete `flymake.lock`.\n"
+  "\n"
   "## 5 - A Discussion on C Dependies\n"
   "\n"
   "Lets face it, C and C++ don't handle dependency versions well. For example, say you want to use\n"
@@ -653,9 +740,11 @@ const char g_szFlyMakeUserGuide[] =
   "```\n"
   "build  [--all] [-B] [-D] [--rX] [targets...]            Builds target(s)\n"
   "clean  [--all] [targets...]                                  Clean all .o and other temporary files\n"
+  "daemon                                                       Keep project loaded for other commands\n"
   "new    [--all] [--cpp] [--lib] folder                        Create a new C or C++ project or library\n"
   "run    [--all] [-B] [-D] [targets...] [-- arg1 -opt1]   Build and run the main program\n"
   "test   [--all] [-B] [-D] [targets...] [-- arg1 -opt1]   Build and run the test suite\n"
+  "watch  [-B] [-D] [-j] [targets...]                      Build, then rebuild when source files change\n"
   "```\n"
   "\n"
   "Single letter options start with a dash. Multi-letter options start with a double dash. Options can\n"
@@ -672,15 +761,52 @@ const char g_szFlyMakeUserGuide[] =
   "The basic syntax is below:\n"
   "\n"
   "```bash\n"
-  "build  [--all] [-B] [-D[=#]] [--rN] [targets...]\n"
+  "build  [--all] [-B] [--cache] [-D[=#]] [--hash] [-j[=#]] [--rN] [--sandbox] [targets...]\n"
   "```\n"
   "\n"
   "Each option is described below:\n"
   "\n"
   "- `--all` rebuilds all dependencies in addition to all files in the project or target\n"
   "- `-B` rebuilds files in the project, but not the files in the dependencies\n"
+  "- `--cache` copies objects from the object cache when the same file was compiled before\n"
   "- `-D` adds the flags `-g` and `-DDEBUG=1` flags to the compiler and linker\n"
+  "- `--hash` compiles files whose contents changed, rather than files with newer dates\n"
+  "- `-j` compiles the files in each folder in parallel, using all CPUs, or `-j=#` for # at a time\n"
   "- `--rl`, `--rs` and `--rt` build with library, source and tool rules respectively\n"
+  "- `--sandbox` compiles each file in an empty temporary folder holding only the files it needs\n"
+  "\n"
+  "Flymake remembers the compile command-line used for each object file. Changing an option such as\n"
+  "`-D` or `-w` between builds recompiles the files whose command-line changed, so `-B` is not needed\n"
+  "to avoid mixing debug and release objects.\n"
+  "\n"
+  "Normally a file is compiled if it, or a header it includes, is newer than its object file. Dates\n"
+  "are not always reliable: `git checkout` sets every file it writes to the current time, and network\n"
+  "filesystems may have clocks that differ from yours. With `--hash`, flymake records a hash of the\n"
+  "contents of each source file and header in the build database (`out/.flymake.db`), and only\n"
+  "compiles a file if the contents of it or its headers changed. Files whose date and size haven't\n"
+  "changed aren't read, so `--hash` is nearly as fast as a normal build. Files compiled without\n"
+  "`--hash` have no hash recorded, so they are compiled again the first time their date changes.\n"
+  "\n"
+  "With `--cache`, each object compiled is also stored in `~/.cache/flymake/obj/`, shared by all your\n"
+  "projects. Before compiling a file, flymake hashes its command-line, the compiler program, the source\n"
+  "file and the headers it included last time it was compiled. If an object with that hash is in the\n"
+  "cache, it is copied into `out/` instead. So a fresh clone, a branch switch or `flymake clean` is\n"
+  "rebuilt in seconds. Only compilers with a `{dep}` marker in `[compiler]` use the cache, as flymake\n"
+  "needs the depfile to know the headers. `-B` and `--all` always compile, but still store the objects.\n"
+  "Debug objects (`-D`, or any `-g` option) record the folder they were compiled in, so for those the\n"
+  "project folder is part of the hash too, and each checkout has its own debug objects.\n"
+  "\n"
+  "With `--sandbox`, each compile is described as an action: its command-line, every file it reads\n"
+  "(the source and the headers it includes, found by scanning for `#include`), with a hash of each,\n"
+  "and the files it writes. Flymake starts a small server that runs each action in an empty temporary\n"
+  "folder holding only those inputs, and copies the outputs back. The server keeps each input by hash,\n"
+  "so a header shared by many files is sent once. This is how a build server or build farm runs\n"
+  "compiles, so `--sandbox` finds files that compile only because of something else in the folder.\n"
+  "\n"
+  "A compile that fails in the sandbox because a file is missing (e.g. a header the `#include` scan\n"
+  "didn't find) is run again in the project folder. Any other error is reported once, from the\n"
+  "sandbox, as it would fail in the project folder too. Files that include headers from outside the project (e.g. `../foo/inc/`), or\n"
+  "use `#include MACRO`, are compiled in the project folder.\n"
   "\n"
   "For each target argument, flymake always builds one of:\n"
   "\n"
@@ -734,17 +860,29 @@ const char g_szFlyMakeUserGuide[] =
   "$ flymake --all\n"
   "\n"
   "# flymake v1.0\n"
-  "cc lib/all_print.c -c -I. -Iinc/ -Wall -Werror -o lib/out/all_print.o\n"
-  "ar -crs lib/all.a lib/out/*.o\n"
+  "cc lib/all_print.c -c -I. -Iinc/ -Wall -Werror -MMD -MF lib/out/rel/all_print.d -o lib/out/rel/all_print.o\n"
+  "ar -crs lib/all.a lib/out/rel/all_print.o\n"
   "# created library lib/all.a\n"
-  "cc test/test_all.c -c -I. -Iinc/ -Wall -Werror -o test/out/test_all.o\n"
-  "cc test/out/test_all.o  lib/all.a -o test/test_all\n"
+  "cc test/test_all.c -c -I. -Iinc/ -Wall -Werror -MMD -MF test/out/rel/test_all.d -o test/out/rel/test_all.o\n"
+  "cc test/out/rel/test_all.o  lib/all.a -o test/test_all\n"
   "# created program test_all\n"
-  "cc src/all.c -c -I. -Iinc/ -Wall -Werror -o src/out/all.o\n"
-  "cc src/out/*.o lib/all.a -o src/all\n"
+  "cc src/all.c -c -I. -Iinc/ -Wall -Werror -MMD -MF src/out/rel/all.d -o src/out/rel/all.o\n"
+  "cc src/out/rel/all.o lib/all.a -o src/all\n"
   "# created program src/all\n"
   "```\n"
   "\n"
+  "With `-j`, the command-line and any compiler output for each file are printed together when that\n"
+  "file finishes compiling, so the output from different files does not interleave. The order of the\n"
+  "lines may differ from build to build.\n"
+  "\n"
+  "Flymake works with the GNU make jobserver. When run from a makefile with `make -j`, e.g. as\n"
+  "`+flymake build`, flymake compiles in parallel using the job slots make gives it, so several\n"
+  "flymake builds run by the same make never use more than `make -j` slots in total. When flymake is\n"
+  "run directly with `-j=#`, it becomes the jobserver for the compiles and dependency builds it runs,\n"
+  "so a compiler (e.g. `gcc -flto=jobserver`) or dependency build started from flymake shares the same\n"
+  "`#` slots. Programs run by `flymake run` or `flymake test` don't get flymake's jobserver in\n"
+  "`MAKEFLAGS`.\n"
+  "\n"
   "Flymake can only build one project at a time. For example, this won't work:\n"
   "\n"
   "```bash\n"
@@ -931,4 +1069,64 @@ const char g_szFlyMakeUserGuide[] =
   "\n"
   "test/test_bar\n"
   "test_bar passed\n"
-  "```\n";
+  "```\n"
+  "\n"
+  "### 6.6 - Daemon Command\n"
+  "\n"
+  "Syntax: `flymake daemon`\n"
+  "\n"
+  "Before compiling anything, flymake finds the project root, reads flymake.toml, finds the project\n"
+  "folders and discovers the dependencies. On a large project with many dependencies, that can take\n"
+  "longer than the build itself, especially when little has changed.\n"
+  "\n"
+  "`flymake daemon` does all that once and then waits. While it runs, `flymake build`, `clean`, `run`\n"
+  "and `test` from the same folder are sent to the daemon, which runs them with the project already\n"
+  "loaded. The output and exit code are the same as without the daemon. Stop the daemon with Ctrl-C.\n"
+  "\n"
+  "```\n"
+  "$ flymake daemon &\n"
+  "# flymake daemon serving /Users/me/git/foo/, Ctrl-C to stop\n"
+  "$ flymake -j\n"
+  "# flymake build -j\n"
+  "...\n"
+  "```\n"
+  "\n"
+  "Notes:\n"
+  "\n"
+  "- The daemon serves the folder it was started in. Commands from other folders run as usual\n"
+  "- Commands run with the environment of the shell they were typed in, e.g. `PATH` and `CC`, not\n"
+  "  the daemon's\n"
+  "- If flymake.toml, flymake.lock, a dependency's flymake.toml or the folders in the project root\n"
+  "  change, the daemon restarts to load them again\n"
+  "- Commands that would load the project differently, such as another project, `-D` or `--rN` when the\n"
+  "  daemon was started without them, run without the daemon\n"
+  "- Inside a make jobserver (`make -j`), commands run without the daemon\n"
+  "- The socket is in `~/.cache/flymake/daemon/`\n"
+  "\n"
+  "### 6.7 - Watch Command\n"
+  "\n"
+  "Syntax: `flymake watch [-B] [-D] [-j] [--rN] [-w] [targets...]`\n"
+  "\n"
+  "Builds the project (or targets) like `flymake build`, then waits. Each time a source or header file\n"
+  "is saved, added, removed or renamed, it builds again. Stop it with Ctrl-C.\n"
+  "\n"
+  "```\n"
+  "$ flymake watch -j\n"
+  "...\n"
+  "# watching 5 folder(s) for changes, Ctrl-C to stop\n"
+  "```\n"
+  "\n"
+  "This is faster than running `flymake build` in a loop. The project and its build databases stay\n"
+  "loaded between builds, and folders are only scanned again when files are added or removed. Each\n"
+  "build after the first only looks at the source files that changed, or that include a header that\n"
+  "changed (as listed in the compiler's depfile). Dependencies are only built again when a file in\n"
+  "`deps/` or outside the project changes, and `-B` only rebuilds the first time.\n"
+  "\n"
+  "Notes:\n"
+  "\n"
+  "- Watches the project folders (and their subfolders), the include folders and the project root\n"
+  "- Files in `out/` and `deps/`, hidden files, and files that aren't source or headers (`.h*`) are\n"
+  "  ignored, so building doesn't cause another build\n"
+  "- If flymake.toml changes, watch restarts to load it again\n"
+  "- Objects removed by hand aren't noticed until their source changes. `flymake clean` is noticed\n"
+  "- Linux only, as it uses inotify\n";
@@ -0,0 +1,427 @@
+/**************************************************************************************************
+  flymakewatch.c - `flymake watch`, rebuild whenever a source file changes
+  Copyright 2024 Drew Gislason
+  license: <https://mit-license.org>
+
+  Builds once, then waits for changes using inotify on each project folder (and its subfolders),
+  each include folder and the project root. When a source or header file is saved, created, removed
+  or renamed, it builds again. The project stays loaded between builds, as do the folder scans (see
+  FlyMakeScanSrcList()), which are only redone when files are added or removed.
+
+  Builds after the first are incremental. The build databases stay loaded (see FlyMakeDbOpen()),
+  and are told the paths of the changed files, so only the source files that changed or include a
+  changed header are checked, see FlyMakeDbListChanged(). Dependencies are only built again if a
+  file changed in deps/ or outside the project, e.g. "../dep1/inc/dep1.h".
+
+  If flymake.toml changes, watch starts over by running itself again with the same command-line.
+
+  Linux only. Other systems loop on `flymake build` instead.
+**************************************************************************************************/
+#include "flymake.h"
+#ifdef __linux__
+ #include <unistd.h>
+ #include <poll.h>
+ #include <sys/inotify.h>
+#endif
+
+#ifdef __linux__
+#define WATCH_QUIET_MS    50      // editors save in several steps, wait for quiet before building
+#define WATCH_SZ_BUF      8192
+#define WATCH_MASK        (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+
+// a watched folder
+typedef struct
+{
+  int     wd;           // from inotify_add_watch()
+  char   *szFolder;     // e.g. "src/sub/"
+} fmkWatchDir_t;
+
+typedef struct
+{
+  int               fd;         // from inotify_init1()
+  fmkWatchDir_t    *aDirs;
+  unsigned          nDirs;
+  unsigned          maxDirs;
+  char             *szExtList;  // source extensions, e.g. ".c.cpp"
+  const char       *szRoot;     // project root, e.g. "" or "../"
+  const char       *szDepDir;   // dependencies of project, e.g. "deps/"
+  char            **aszPaths;   // files changed since last build, e.g. "src/foo.c", "inc/foo.h"
+  unsigned          nPaths;
+  unsigned          maxPaths;
+  bool_t            fChanged;   // a source or header changed, build again
+  bool_t            fAll;       // folders changed, check every file, see FlyMakeDbListChanged()
+  bool_t            fDeps;      // a dependency may have changed, build dependencies too
+  bool_t            fRescan;    // files were added or removed, scan folders again
+  bool_t            fReload;    // flymake.toml changed
+} fmkWatch_t;
+
+/*-------------------------------------------------------------------------------------------------
+  Watch a folder, and its subfolders up to depth deep. Skips out/, deps/ and hidden folders.
+
+  @param    pWatch      watch state
+  @param    szFolder    folder, e.g. "src/" or "" for current folder
+  @param    depth       0-n, how many subfolders deep
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkWatchAdd(fmkWatch_t *pWatch, const char *szFolder, unsigned depth)
+{
+  fmkWatchDir_t  *aDirs;
+  void           *hList;
+  flyStrSmart_t   path;
+  const char     *szName;
+  const char     *psz;
+  unsigned        i;
+  int             wd;
+
+  wd = inotify_add_watch(pWatch->fd, *szFolder ? szFolder : ".", WATCH_MASK | IN_ONLYDIR);
+  if(wd < 0)
+    return;
+
+  // the same folder may be reached twice, e.g. "inc/" as a project folder and include folder
+  for(i = 0; i < pWatch->nDirs; ++i)
+  {
+    if(pWatch->aDirs[i].wd == wd)
+      break;
+  }
+  if(i == pWatch->nDirs)
+  {
+    if(pWatch->nDirs >= pWatch->maxDirs)
+    {
+      aDirs = FlyRealloc(pWatch->aDirs, sizeof(*aDirs) * (pWatch->maxDirs + 16));
+      if(!aDirs)
+        return;
+      pWatch->aDirs    = aDirs;
+      pWatch->maxDirs += 16;
+    }
+    pWatch->aDirs[i].wd       = wd;
+    pWatch->aDirs[i].szFolder = FlyStrClone(szFolder);
+    ++pWatch->nDirs;
+    FlyMakeDbgPrintf(FMK_DEBUG_MORE, "  watch %d %s\n", wd, szFolder);
+  }
+
+  // add subfolders, e.g. "src/sub/"
+  if(depth)
+  {
+    FlyStrSmartInit(&path);
+    FlyStrSmartSprintf(&path, "%s*", szFolder);
+    hList = path.sz ? FlyFileListNew(path.sz) : NULL;
+    for(i = 0; hList && i < FlyFileListLen(hList); ++i)
+    {
+      szName = FlyFileListGetName(hList, i);
+      if(!FlyStrPathIsFolder(szName))
+        continue;
+      psz = FlyStrPathNameLast(szName, NULL);
+      if(*psz == '.' || strcmp(psz, FMK_SZ_OUT) == 0 || strcmp(psz, FMK_SZ_DEP_DIR) == 0)
+        continue;
+      FmkWatchAdd(pWatch, szName, depth - 1);
+    }
+    if(hList)
+      FlyFileListFree(hList);
+    FlyStrSmartUnInit(&path);
+  }
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Watch each include folder, e.g. "-I. -Iinc/ -I../dep1/inc/"
+
+  @param    pWatch      watch state
+  @param    szIncs      include options
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkWatchAddIncs(fmkWatch_t *pWatch, const char *szIncs)
+{
+  flyStrSmart_t   folder;
+  const char     *psz;
+  unsigned        len;
+
+  FlyStrSmartInit(&folder);
+  for(psz = FlyStrSkipWhite(szIncs); *psz; psz = FlyStrSkipWhite(psz + len))
+  {
+    len = FlyStrArgLen(psz);
+    if(len > 2 && strncmp(psz, "-I", 2) == 0)
+    {
+      FlyStrSmartSprintf(&folder, "%.*s", (int)(len - 2), psz + 2);
+      if(folder.sz && strcmp(folder.sz, ".") == 0)
+        FlyStrSmartCpy(&folder, "");
+      if(folder.sz)
+        FmkWatchAdd(pWatch, folder.sz, 0);
+    }
+  }
+  FlyStrSmartUnInit(&folder);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Does this file affect the build? Source files by compiler extension and headers (".h*").
+
+  @param    pWatch      watch state
+  @param    szName      file name, e.g. "foo.c"
+  @return   TRUE if a source or header file
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkWatchIsSrc(const fmkWatch_t *pWatch, const char *szName)
+{
+  const char  *szExt;
+  const char  *psz;
+  size_t       len;
+
+  szExt = strrchr(szName, '.');
+  if(!szExt || szExt == szName)
+    return FALSE;
+  if(szExt[1] == 'h')
+    return TRUE;
+
+  // e.g. ".c" in ".c.cpp", but not in ".cpp"
+  len = strlen(szExt);
+  for(psz = strstr(pWatch->szExtList, szExt); psz; psz = strstr(psz + 1, szExt))
+  {
+    if(psz[len] == '.' || psz[len] == '\0')
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Is the path in this folder, or its subfolders? For example, "src/foo.c" is in "src/" and "",
+  but "../dep1/inc/dep1.h" is in neither.
+
+  @param    szFolder    folder, e.g. "src/", "../" or "" for current folder
+  @param    szPath      path, e.g. "src/foo.c"
+  @return   TRUE if in folder
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkWatchIsIn(const char *szFolder, const char *szPath)
+{
+  size_t  len = strlen(szFolder);
+
+  if(strncmp(szFolder, szPath, len) != 0)
+    return FALSE;
+  szPath += len;
+  return (*szPath != '/' && strncmp(szPath, "../", 3) != 0) ? TRUE : FALSE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Remember a changed file or folder for the next build. A change in deps/ or outside the project
+  means dependencies must be built too.
+
+  @param    pWatch      watch state
+  @param    szFolder    folder of event, e.g. "src/"
+  @param    szName      file or folder name, e.g. "foo.c"
+  @return   none
+*///-----------------------------------------------------------------------------------------------
+static void FmkWatchChanged(fmkWatch_t *pWatch, const char *szFolder, const char *szName)
+{
+  char    **aszPaths;
+  char     *szPath;
+  size_t    size;
+
+  size = strlen(szFolder) + strlen(szName) + 1;
+  szPath = FlyAlloc(size);
+  if(szPath)
+  {
+    FlyStrZCpy(szPath, szFolder, size);
+    FlyStrZCat(szPath, szName, size);
+    if((pWatch->szDepDir && FmkWatchIsIn(pWatch->szDepDir, szPath)) || !FmkWatchIsIn(pWatch->szRoot, szPath))
+      pWatch->fDeps = TRUE;
+  }
+
+  if(szPath && pWatch->nPaths >= pWatch->maxPaths)
+  {
+    aszPaths = FlyRealloc(pWatch->aszPaths, sizeof(char *) * (pWatch->maxPaths + 16));
+    if(aszPaths)
+    {
+      pWatch->aszPaths  = aszPaths;
+      pWatch->maxPaths += 16;
+    }
+  }
+
+  // if out of memory, check everything
+  if(szPath && pWatch->nPaths < pWatch->maxPaths)
+    pWatch->aszPaths[pWatch->nPaths++] = szPath;
+  else
+  {
+    FlyFreeIf(szPath);
+    pWatch->fAll = pWatch->fDeps = TRUE;
+  }
+  pWatch->fChanged = TRUE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Process the inotify events ready to read
+
+  @param    pWatch      watch state
+  @return   FALSE if inotify failed
+*///-----------------------------------------------------------------------------------------------
+static bool_t FmkWatchRead(fmkWatch_t *pWatch)
+{
+  char                    aBuf[WATCH_SZ_BUF] __attribute__((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event  *pEvent;
+  flyStrSmart_t           path;
+  const char             *szFolder;
+  ssize_t                 n;
+  ssize_t                 off;
+  unsigned                i;
+
+  n = read(pWatch->fd, aBuf, sizeof(aBuf));
+  if(n <= 0)
+    return FALSE;
+
+  FlyStrSmartInit(&path);
+  for(off = 0; off < n; off += sizeof(*pEvent) + pEvent->len)
+  {
+    pEvent = (const struct inotify_event *)&aBuf[off];
+
+    // find folder of event
+    szFolder = NULL;
+    for(i = 0; i < pWatch->nDirs; ++i)
+    {
+      if(pWatch->aDirs[i].wd == pEvent->wd)
+      {
+        szFolder = pWatch->aDirs[i].szFolder;
+        break;
+      }
+    }
+    if(!szFolder)
+      continue;
+
+    // folder was removed
+    if(pEvent->mask & IN_IGNORED)
+    {
+      FmkWatchChanged(pWatch, szFolder, "");
+      FlyFree(pWatch->aDirs[i].szFolder);
+      pWatch->aDirs[i] = pWatch->aDirs[--pWatch->nDirs];
+      pWatch->fRescan = pWatch->fAll = TRUE;
+      continue;
+    }
+    if(!pEvent->len || pEvent->name[0] == '.')
+      continue;
+
+    // new folder, e.g. "src/sub/"
+    if(pEvent->mask & IN_ISDIR)
+    {
+      if(pEvent->mask & (IN_CREATE | IN_MOVED_TO))
+      {
+        FlyStrSmartSprintf(&path, "%s%s/", szFolder, pEvent->name);
+        if(path.sz)
+          FmkWatchAdd(pWatch, path.sz, 0);
+      }
+      FmkWatchChanged(pWatch, szFolder, pEvent->name);
+      pWatch->fRescan = pWatch->fAll = TRUE;
+    }
+
+    // flymake.toml in project root
+    else if(strcmp(pEvent->name, FMK_SZ_FLYMAKE_TOML) == 0 && FlyMakeIsSameFolder(szFolder, pWatch->szRoot))
+      pWatch->fReload = TRUE;
+
+    else if(FmkWatchIsSrc(pWatch, pEvent->name))
+    {
+      FlyMakeDbgPrintf(FMK_DEBUG_SOME, "  changed %s%s, mask %x\n", szFolder, pEvent->name, pEvent->mask);
+      if(pEvent->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))
+        pWatch->fRescan = TRUE;
+      FmkWatchChanged(pWatch, szFolder, pEvent->name);
+    }
+  }
+  FlyStrSmartUnInit(&path);
+
+  return TRUE;
+}
+#endif
+
+/*-------------------------------------------------------------------------------------------------
+  Build, then build again each time a source file changes, until Ctrl-C. The project state must
+  already be loaded (see FlyMakeTomlAlloc()).
+
+  @param    pState      root project state
+  @param    argv        command-line, NULL terminated, to restart if flymake.toml changes
+  @param    pfnBuild    builds the project
+  @return   FALSE if couldn't watch the project
+*///-----------------------------------------------------------------------------------------------
+bool_t FlyMakeWatch(flyMakeState_t *pState, const char *argv[], pfnFlyMakeWatchBuild_t pfnBuild)
+{
+#ifdef __linux__
+  fmkWatch_t        watch;
+  flyMakeFolder_t  *pFolder;
+  struct pollfd     pfd;
+  unsigned          i;
+  bool_t            fWorked = TRUE;
+
+  memset(&watch, 0, sizeof(watch));
+  watch.szRoot    = pState->szRoot;
+  watch.szDepDir  = pState->szDepDir;
+  watch.szExtList = FlyMakeCompilerAllExts(pState->pCompilerList);
+  watch.fd        = inotify_init1(IN_CLOEXEC);
+  if(watch.fd < 0 || !watch.szExtList)
+  {
+    FlyMakePrintf("flymake error: cannot watch for file changes\n");
+    fWorked = FALSE;
+  }
+
+  // watch before the first build, so no edits are missed
+  if(fWorked)
+  {
+    FmkWatchAdd(&watch, pState->szRoot, 0);
+    for(pFolder = pState->pFolderList; pFolder; pFolder = pFolder->pNext)
+      FmkWatchAdd(&watch, pFolder->szFolder, pFolder->rule == FMK_RULE_TOOL ? 0 : FlyMakeStateDepth(pState));
+    FmkWatchAddIncs(&watch, pState->incs.sz ? pState->incs.sz : "");
+    watch.fChanged = watch.fDeps = TRUE;
+    pState->fDbKeep = TRUE;
+  }
+
+  while(fWorked)
+  {
+    if(watch.fReload)
+    {
+      FlyMakePrintf("\n# %s changed, restarting\n", FMK_SZ_FLYMAKE_TOML);
+      fflush(stdout);
+      close(watch.fd);
+      execvp(argv[0], (char * const *)argv);
+      FlyMakePrintf("flymake error: could not restart\n");
+      fWorked = FALSE;
+      break;
+    }
+
+    if(watch.fChanged)
+    {
+      if(watch.fRescan)
+        FlyMakeScanListFree(pState);
+      FlyMakeDbListChanged(pState, watch.fAll ? NULL : (const char **)watch.aszPaths, watch.nPaths);
+      for(i = 0; i < watch.nPaths; ++i)
+        FlyFree(watch.aszPaths[i]);
+      watch.nPaths = 0;
+      (*pfnBuild)(pState, watch.fDeps);
+      watch.fChanged = watch.fRescan = watch.fAll = watch.fDeps = FALSE;
+      FlyMakePrintf("\n# watching %u folder(s) for changes, Ctrl-C to stop\n", watch.nDirs);
+      fflush(stdout);
+    }
+
+    // wait for a change, then for the saves to settle
+    pfd.fd      = watch.fd;
+    pfd.events  = POLLIN;
+    if(poll(&pfd, 1, -1) > 0)
+    {
+      do
+      {
+        if(!FmkWatchRead(&watch))
+          fWorked = FALSE;
+        pfd.revents = 0;
+      } while(fWorked && poll(&pfd, 1, WATCH_QUIET_MS) > 0);
+    }
+  }
+
+  if(watch.fd >= 0)
+    close(watch.fd);
+  for(i = 0; i < watch.nDirs; ++i)
+    FlyFree(watch.aDirs[i].szFolder);
+  FlyFreeIf(watch.aDirs);
+  for(i = 0; i < watch.nPaths; ++i)
+    FlyFree(watch.aszPaths[i]);
+  FlyFreeIf(watch.aszPaths);
+  FlyFreeIf(watch.szExtList);
+
+  return fWorked;
+#else
+  (void)pState;
+  (void)argv;
+  (void)pfnBuild;
+  FlyMakePrintf("flymake error: watch needs Linux inotify\n");
+  return FALSE;
+#endif
+}
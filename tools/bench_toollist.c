@@ -0,0 +1,430 @@
+/**************************************************************************************************
+  bench_toollist.c - time tool grouping and check it against the original quadratic grouping
+  Copyright 2024 Drew Gislason
+  license: <https://mit-license.org>
+
+  Tools (e.g. in test/) are grouped from a sorted source list by FmkToolListAlloc() in
+  flymakelist.c. Built with FMK_BENCH, that function isn't static, so this can call it directly
+  and compare it to the original grouping, which searched the whole list for every tool.
+
+      bench_toollist --gen=4000 tmp_toollist/   # make 12,000+ empty source files in 4,000 tools
+      bench_toollist tmp_toollist/              # time both groupings on a folder, check the same
+      bench_toollist --random=200               # check the same on 200 random small folders
+
+  See `make bench` in tools/Makefile. Exits 1 if the groupings differ.
+**************************************************************************************************/
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "flymake.h"
+
+#define BTL_RANDOM_MAX_FILES  64
+#define BTL_RANDOM_FOLDER     "tmp_random/"
+
+static const char m_szSyntax[] =
+  "bench_toollist [--gen=tools] [--random=folders] [folder/]\n";
+
+/*-------------------------------------------------------------------------------------------------
+  flymake's objects need these from flymake.c, which isn't linked as it has flymake's main()
+*///-----------------------------------------------------------------------------------------------
+const char m_szFmkBanner[] = "bench_toollist %s\n";
+
+fmkDebug_t FlyMakeDebug(void)
+{
+  return FMK_DEBUG_NONE;
+}
+
+fmkVerbose_t FlyMakeVerbose(void)
+{
+  return FMK_VERBOSE_NONE;
+}
+
+void FlyMakeErrExit(void)
+{
+  exit(1);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Return a monotonic time in milliseconds
+*///-----------------------------------------------------------------------------------------------
+static double BtlMsec(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1000000.0);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  The original FmkToolAlloc(). Allocates a tool from the 1st unused file, with all unused files
+  anywhere in the list that begin with the tool's path and name. Marks them used.
+
+  @param    hSrcList    handle to source file list
+  @param    pfUsed      array of used flags, one per source file
+  @param    index       index 1st unused source file
+  @return   ptr to allocated tool, or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+static fmkTool_t * BtlOldToolAlloc(void *hSrcList, bool_t *pfUsed, unsigned index)
+{
+  fmkTool_t      *pTool       = NULL;
+  char           *szToolname;
+  const char     *szFilename;
+  const char     *psz;
+  unsigned        len;
+  unsigned        i;
+  unsigned        n;
+  unsigned        nSrcFiles   = 0;
+
+  szFilename = FlyMakeSrcListGetName(hSrcList, index);
+  psz = FlyStrPathNameBase(szFilename, &len);
+  szToolname = FlyStrAllocN(psz, len);
+  len += (unsigned)(psz - szFilename);
+
+  for(i = 0; i < FlyMakeSrcListLen(hSrcList); ++i)
+  {
+    if(!pfUsed[i] && (strncmp(szFilename, FlyMakeSrcListGetName(hSrcList, i), len) == 0))
+      ++nSrcFiles;
+  }
+
+  if(szToolname)
+    pTool = FlyAllocZ(sizeof(*pTool) + (sizeof(char *) * nSrcFiles));
+  if(pTool)
+  {
+    pTool->szName = szToolname;
+    pTool->aszSrcFiles = (void *)(pTool + 1);
+    pTool->nSrcFiles = nSrcFiles;
+    n = 0;
+    for(i = 0; i < FlyMakeSrcListLen(hSrcList); ++i)
+    {
+      psz = FlyMakeSrcListGetName(hSrcList, i);
+      if(!pfUsed[i] && (strncmp(szFilename, psz, len) == 0))
+      {
+        pTool->aszSrcFiles[n++] = psz;
+        pfUsed[i] = TRUE;
+      }
+    }
+  }
+  else
+    FlyFreeIf(szToolname);
+
+  return pTool;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  The original grouping: for each tool, search from the start of the list for the 1st unused file.
+  The tool list doesn't own the source list, so free it with BtlToolsFree().
+
+  @param    hSrcList    handle to source file list
+  @param    pnTools     return value, # of tools
+  @return   array of tools, or NULL if out of memory
+*///-----------------------------------------------------------------------------------------------
+static fmkTool_t ** BtlOldToolListAlloc(void *hSrcList, unsigned *pnTools)
+{
+  fmkTool_t     **apTools;
+  bool_t         *pfUsed;
+  unsigned        len     = FlyMakeSrcListLen(hSrcList);
+  unsigned        nTools  = 0;
+  unsigned        i;
+  bool_t          fWorked = TRUE;
+
+  // never more tools than files
+  apTools = FlyAllocZ(sizeof(fmkTool_t *) * (len + 1));
+  pfUsed  = FlyAllocZ(sizeof(bool_t) * (len + 1));
+  if(!apTools || !pfUsed)
+    fWorked = FALSE;
+
+  while(fWorked)
+  {
+    for(i = 0; i < len; ++i)
+    {
+      if(!pfUsed[i])
+        break;
+    }
+    if(i == len)
+      break;
+
+    apTools[nTools] = BtlOldToolAlloc(hSrcList, pfUsed, i);
+    if(!apTools[nTools])
+      fWorked = FALSE;
+    else
+      ++nTools;
+  }
+
+  FlyFreeIf(pfUsed);
+  if(!fWorked && apTools)
+  {
+    for(i = 0; i < nTools; ++i)
+    {
+      FlyFree(apTools[i]->szName);
+      FlyFree(apTools[i]);
+    }
+    FlyFree(apTools);
+    apTools = NULL;
+  }
+  *pnTools = nTools;
+
+  return apTools;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Free the tools from BtlOldToolListAlloc()
+*///-----------------------------------------------------------------------------------------------
+static void BtlToolsFree(fmkTool_t **apTools, unsigned nTools)
+{
+  unsigned  i;
+
+  for(i = 0; i < nTools; ++i)
+  {
+    FlyFree(apTools[i]->szName);
+    FlyFree(apTools[i]);
+  }
+  FlyFree(apTools);
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Compare the new grouping to the original. Prints the 1st difference, if any.
+
+  @return   TRUE if the same tools, with the same files in the same order
+*///-----------------------------------------------------------------------------------------------
+static bool_t BtlSame(const fmkToolList_t *pToolList, fmkTool_t **apTools, unsigned nTools)
+{
+  const fmkTool_t  *pNew;
+  const fmkTool_t  *pOld;
+  unsigned          i;
+  unsigned          j;
+
+  if(pToolList->nTools != nTools)
+  {
+    printf("differ: %u tools, was %u\n", pToolList->nTools, nTools);
+    return FALSE;
+  }
+
+  for(i = 0; i < nTools; ++i)
+  {
+    pNew = pToolList->apTools[i];
+    pOld = apTools[i];
+    if(strcmp(pNew->szName, pOld->szName) != 0 || pNew->nSrcFiles != pOld->nSrcFiles)
+    {
+      printf("differ: tool %u is %s with %u file(s), was %s with %u file(s)\n", i, pNew->szName,
+             pNew->nSrcFiles, pOld->szName, pOld->nSrcFiles);
+      return FALSE;
+    }
+    for(j = 0; j < pOld->nSrcFiles; ++j)
+    {
+      if(strcmp(pNew->aszSrcFiles[j], pOld->aszSrcFiles[j]) != 0)
+      {
+        printf("differ: tool %s file %u is %s, was %s\n", pNew->szName, j, pNew->aszSrcFiles[j],
+               pOld->aszSrcFiles[j]);
+        return FALSE;
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Group a source list both ways, and check they're the same. Frees hSrcList.
+
+  @param    hSrcList    from FlyMakeSrcListNew()
+  @param    fTime       TRUE to print how long each grouping took
+  @return   TRUE if the same
+*///-----------------------------------------------------------------------------------------------
+static bool_t BtlCheck(void *hSrcList, bool_t fTime)
+{
+  fmkToolList_t  *pToolList;
+  fmkTool_t     **apTools;
+  unsigned        nFiles  = FlyMakeSrcListLen(hSrcList);
+  unsigned        nTools  = 0;
+  double          msOld;
+  double          msNew;
+  bool_t          fSame   = FALSE;
+
+  msOld     = BtlMsec();
+  apTools   = BtlOldToolListAlloc(hSrcList, &nTools);
+  msOld     = BtlMsec() - msOld;
+
+  // the tool list owns the source list from here on
+  msNew     = BtlMsec();
+  pToolList = FmkToolListAlloc(hSrcList);
+  msNew     = BtlMsec() - msNew;
+
+  if(!apTools || !pToolList)
+    printf("out of memory\n");
+  else
+  {
+    fSame = BtlSame(pToolList, apTools, nTools);
+    if(fTime)
+    {
+      printf("%u files, %u tools: old %.1f ms, new %.1f ms, %s\n", nFiles, nTools, msOld, msNew,
+             fSame ? "same" : "DIFFERENT");
+    }
+  }
+
+  if(apTools)
+    BtlToolsFree(apTools, nTools);
+  if(pToolList)
+    FlyMakeToolListFree(pToolList);
+
+  return fSame;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Make a folder of empty source files for nTools tools. Each tool has 3 files, e.g. t00012.c,
+  t00012_a.c, t00012_b.c, and every 7th also has a t00012-c.c, which sorts before t00012.c and so
+  is a tool of its own.
+
+  @param    szFolder    folder to make, e.g. "tmp_toollist/"
+  @param    nTools      # of tools
+  @return   TRUE if worked
+*///-----------------------------------------------------------------------------------------------
+static bool_t BtlGen(const char *szFolder, unsigned nTools)
+{
+  static const char *aszFmts[] = { "%st%05u.c", "%st%05u_a.c", "%st%05u_b.c", "%st%05u-c.c" };
+  char          szPath[PATH_MAX];
+  FILE         *fp;
+  unsigned      nFiles  = 0;
+  unsigned      i;
+  unsigned      j;
+  bool_t        fWorked = TRUE;
+
+  mkdir(szFolder, 0755);
+  for(i = 0; fWorked && i < nTools; ++i)
+  {
+    for(j = 0; fWorked && j < NumElements(aszFmts); ++j)
+    {
+      if(j == 3 && (i % 7) != 0)
+        break;
+      snprintf(szPath, sizeof(szPath), aszFmts[j], szFolder, i);
+      fp = fopen(szPath, "w");
+      if(!fp)
+      {
+        printf("can't create %s\n", szPath);
+        fWorked = FALSE;
+      }
+      else
+      {
+        fclose(fp);
+        ++nFiles;
+      }
+    }
+  }
+
+  if(fWorked)
+    printf("%s: %u files\n", szFolder, nFiles);
+
+  return fWorked;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  Make a source list of random names, e.g. "ab_a.c", "ab-b.c", "a.b.c", from a small folder of
+  empty files. Names are short so many share a tool prefix, and mix '-', '_' and '.' around it.
+  The files are removed once listed.
+
+  @param    pCompiler   compiler with the ".c" extension
+  @return   handle to source list, or NULL if failed
+*///-----------------------------------------------------------------------------------------------
+static void * BtlRandomSrcList(flyMakeCompiler_t *pCompiler)
+{
+  static const char *aszSeps[] = { "", "_", "-", "." };
+  void           *hSrcList;
+  char            szPath[PATH_MAX];
+  FILE           *fp;
+  unsigned        nFiles;
+  unsigned        len;
+  unsigned        i;
+  unsigned        j;
+
+  mkdir(BTL_RANDOM_FOLDER, 0755);
+  nFiles = 1 + (unsigned)(rand() % BTL_RANDOM_MAX_FILES);
+  for(i = 0; i < nFiles; ++i)
+  {
+    len = strlen(strcpy(szPath, BTL_RANDOM_FOLDER));
+    for(j = 1 + (unsigned)(rand() % 3); j; --j)
+      szPath[len++] = (char)('a' + rand() % 2);
+    szPath[len] = '\0';
+    if(rand() % 2)
+      sprintf(&szPath[len], "%s%c", aszSeps[rand() % NumElements(aszSeps)], 'a' + rand() % 2);
+    strcat(szPath, ".c");
+    fp = fopen(szPath, "w");
+    if(fp)
+      fclose(fp);
+  }
+
+  hSrcList = FlyMakeSrcListNew(pCompiler, BTL_RANDOM_FOLDER, 0, NULL);
+  for(i = 0; hSrcList && i < FlyMakeSrcListLen(hSrcList); ++i)
+    unlink(FlyMakeSrcListGetName(hSrcList, i));
+  rmdir(BTL_RANDOM_FOLDER);
+
+  return hSrcList;
+}
+
+/*-------------------------------------------------------------------------------------------------
+  bench_toollist [--gen=tools] [--random=folders] [folder/]
+*///-----------------------------------------------------------------------------------------------
+int main(int argc, const char *argv[])
+{
+  flyMakeCompiler_t   compiler;
+  void               *hSrcList;
+  const char         *szFolder  = NULL;
+  unsigned            nGen      = 0;
+  unsigned            nRandom   = 0;
+  unsigned            nSame     = 0;
+  unsigned            i;
+  bool_t              fWorked   = TRUE;
+
+  for(i = 1; i < (unsigned)argc; ++i)
+  {
+    if(strncmp(argv[i], "--gen=", 6) == 0)
+      nGen = (unsigned)atoi(&argv[i][6]);
+    else if(strncmp(argv[i], "--random=", 9) == 0)
+      nRandom = (unsigned)atoi(&argv[i][9]);
+    else if(argv[i][0] != '-')
+      szFolder = argv[i];
+    else
+    {
+      printf("%s", m_szSyntax);
+      return 1;
+    }
+  }
+  if(!szFolder && !nRandom)
+  {
+    printf("%s", m_szSyntax);
+    return 1;
+  }
+
+  memset(&compiler, 0, sizeof(compiler));
+  compiler.szExts = ".c";
+
+  // random folders, always the same ones
+  if(nRandom)
+  {
+    srand(1);
+    for(i = 0; i < nRandom; ++i)
+    {
+      hSrcList = BtlRandomSrcList(&compiler);
+      if(hSrcList && BtlCheck(hSrcList, FALSE))
+        ++nSame;
+    }
+    printf("%u of %u random folders group the same\n", nSame, nRandom);
+    if(nSame != nRandom)
+      fWorked = FALSE;
+  }
+
+  if(fWorked && szFolder && nGen)
+    fWorked = BtlGen(szFolder, nGen);
+
+  else if(fWorked && szFolder)
+  {
+    hSrcList = FlyMakeSrcListNew(&compiler, szFolder, 0, NULL);
+    if(!hSrcList)
+    {
+      printf("no source files in %s\n", szFolder);
+      fWorked = FALSE;
+    }
+    else
+      fWorked = BtlCheck(hSrcList, TRUE);
+  }
+
+  return fWorked ? 0 : 1;
+}